@@ -0,0 +1,87 @@
+#include "arena.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define ARENA_ALIGNMENT _Alignof(max_align_t)
+
+// Header of a block, its bytes follow it
+struct ArenaBlock {
+  ArenaBlock *next;
+  size_t size;
+  size_t used;
+};
+
+// Block headers keep the bytes after them aligned
+#define ARENA_HEADER_SIZE                                                      \
+  ((sizeof(ArenaBlock) + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1))
+
+Arena MakeArena(size_t blockSize) {
+  Arena arena = {0};
+  arena.blockSize = blockSize != 0 ? blockSize : ARENA_DEFAULT_BLOCK_SIZE;
+  return arena;
+}
+
+static ArenaBlock *MakeBlock(Arena *arena, size_t size) {
+  ArenaBlock *block = malloc(ARENA_HEADER_SIZE + size);
+  if (block == NULL) {
+    return NULL;
+  }
+
+  block->next = NULL;
+  block->size = size;
+  block->used = 0;
+  arena->blockBytes += ARENA_HEADER_SIZE + size;
+  return block;
+}
+
+void *ArenaAlloc(Arena *arena, size_t size) {
+  assert(arena != NULL && "invalid arg arena: cannot be NULL");
+  if (size > SIZE_MAX - ARENA_HEADER_SIZE - ARENA_ALIGNMENT) {
+    return NULL;
+  }
+
+  // Every allocation keeps the next one aligned, empty ones take a slot too
+  size_t rounded = (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+  rounded = rounded != 0 ? rounded : ARENA_ALIGNMENT;
+
+  // Large allocations go after the current block, which keeps its room
+  ArenaBlock *block = arena->blocks;
+  if (rounded > arena->blockSize / 2) {
+    block = MakeBlock(arena, rounded);
+    if (block == NULL) {
+      return NULL;
+    }
+
+    ArenaBlock **link = arena->blocks != NULL ? &arena->blocks->next
+                                              : &arena->blocks;
+    block->next = *link;
+    *link = block;
+  } else if (block == NULL || block->size - block->used < rounded) {
+    block = MakeBlock(arena, arena->blockSize);
+    if (block == NULL) {
+      return NULL;
+    }
+
+    block->next = arena->blocks;
+    arena->blocks = block;
+  }
+
+  void *ptr = (char *)block + ARENA_HEADER_SIZE + block->used;
+  block->used += rounded;
+  arena->allocations++;
+  arena->allocatedBytes += size;
+  return ptr;
+}
+
+void DestroyArena(Arena *arena) {
+  assert(arena != NULL && "invalid arg arena: cannot be NULL");
+  ArenaBlock *block = arena->blocks;
+  while (block != NULL) {
+    ArenaBlock *next = block->next;
+    free(block);
+    block = next;
+  }
+  *arena = MakeArena(arena->blockSize);
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <stddef.h>
+
+// Bytes of the blocks allocations are taken from when none is given
+#define ARENA_DEFAULT_BLOCK_SIZE (1 << 20)
+
+typedef struct ArenaBlock ArenaBlock;
+
+// Linear allocator: allocations are taken in order from large blocks and
+// released all at once with the arena, there is no freeing a single one.
+// Allocations larger than half a block get a block of their own. Not thread
+// safe, allocate before handing the memory to jobs.
+typedef struct {
+  ArenaBlock *blocks;
+  size_t blockSize;
+
+  // Allocations made, bytes they asked for and bytes of the blocks held
+  size_t allocations;
+  size_t allocatedBytes;
+  size_t blockBytes;
+} Arena;
+
+// Make an empty arena taking blocks of blockSize bytes on demand, zero uses
+// ARENA_DEFAULT_BLOCK_SIZE.
+Arena MakeArena(size_t blockSize);
+
+// Allocate size bytes aligned for any type, NULL when out of memory.
+void *ArenaAlloc(Arena *arena, size_t size);
+
+// Release every allocation and block of an arena, it can be used again.
+void DestroyArena(Arena *arena);
@@ -0,0 +1,5 @@
+layout (std140) uniform Camera {
+  mat4 view;
+  mat4 proj;
+  mat4 viewProj;
+};
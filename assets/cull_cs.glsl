@@ -0,0 +1,61 @@
+#version 430 core
+
+// Frustum culling of the GPU scene instances, see gpuscene.h. Each invocation
+// tests one instance and writes the instance count of its draw command.
+layout (local_size_x = 64) in;
+
+struct Instance {
+  mat4 model;
+  vec3 boundsMin;
+  uint command;
+  vec3 boundsMax;
+  uint padding;
+};
+
+struct DrawCommand {
+  uint count;
+  uint instanceCount;
+  uint firstIndex;
+  int baseVertex;
+  uint baseInstance;
+};
+
+layout (std430, binding = 0) readonly buffer Instances {
+  Instance instances[];
+};
+
+layout (std430, binding = 1) buffer Commands {
+  DrawCommand commands[];
+};
+
+uniform vec4 planes[6];
+uniform uint instancesCount;
+
+void main() {
+  uint id = gl_GlobalInvocationID.x;
+  if (id >= instancesCount) {
+    return;
+  }
+
+  Instance inst = instances[id];
+
+  // World space box enclosing the transformed model space box
+  vec3 center = (inst.boundsMin + inst.boundsMax) * 0.5;
+  vec3 extent = (inst.boundsMax - inst.boundsMin) * 0.5;
+  vec3 worldCenter = (inst.model * vec4(center, 1.0)).xyz;
+  mat3 absModel = mat3(abs(inst.model[0].xyz), abs(inst.model[1].xyz),
+                       abs(inst.model[2].xyz));
+  vec3 worldExtent = absModel * extent;
+
+  bool visible = true;
+  for (int i = 0; i < 6; i++) {
+    float dist = dot(planes[i].xyz, worldCenter) + planes[i].w;
+    float radius = dot(abs(planes[i].xyz), worldExtent);
+    if (dist + radius < 0.0) {
+      visible = false;
+      break;
+    }
+  }
+
+  commands[inst.command].instanceCount = visible ? 1u : 0u;
+}
@@ -1,8 +1,16 @@
 #version 330 core
 
 in vec4 vCol;
+in vec2 vUvs;
 out vec4 FragColor;
 
+#ifdef HAS_TEXTURE
+uniform sampler2D baseColor;
+#endif
+
 void main() {
   FragColor = vCol;
+#ifdef HAS_TEXTURE
+  FragColor *= texture(baseColor, vUvs);
+#endif
 }
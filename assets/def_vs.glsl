@@ -4,14 +4,42 @@ layout (location = 0) in vec3 inPos;
 layout (location = 1) in vec3 inNor;
 layout (location = 2) in vec2 inUvs;
 layout (location = 3) in vec4 inCol;
+#ifdef HAS_SKINNING
+layout (location = 4) in vec4 inJoints;
+layout (location = 5) in vec4 inWeights;
+#endif
 
 out vec4 vCol;
+out vec2 vUvs;
 
-uniform mat4 proj;
-uniform mat4 view;
+#include "camera.glsl"
+
+#ifdef HAS_INDIRECT
+// Model matrix of the instance, fed from the GPU scene instances buffer
+layout (location = 6) in mat4 model;
+#else
 uniform mat4 model;
+#endif
+#ifdef HAS_SKINNING
+#define MAX_JOINTS 64
+uniform mat4 joints[MAX_JOINTS];
+#endif
 
 void main() {
-  gl_Position = proj * view * model * vec4(inPos, 1.0);
+  vec4 pos = vec4(inPos, 1.0);
+#ifdef HAS_SKINNING
+  mat4 skin = inWeights.x * joints[int(inJoints.x)] +
+              inWeights.y * joints[int(inJoints.y)] +
+              inWeights.z * joints[int(inJoints.z)] +
+              inWeights.w * joints[int(inJoints.w)];
+  pos = skin * pos;
+#endif
+
+  gl_Position = viewProj * model * pos;
+#ifdef HAS_VERTEX_COLORS
   vCol = inCol;
+#else
+  vCol = vec4(1.0);
+#endif
+  vUvs = inUvs;
 }
@@ -0,0 +1,165 @@
+#include "base64.h"
+
+#include <assert.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#include "profile.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define BASE64_USE_SSE
+#endif
+
+// Bytes decoded by a job, a multiple of 3 so every chunk starts at a group
+// of 4 characters
+#define BASE64_CHUNK_BYTES (3 << 20)
+
+// Characters translated together and the bytes they give. Blocks store 2
+// bytes past their own, they run while those fit before the end.
+#define BASE64_BLOCK_CHARS 16
+#define BASE64_BLOCK_BYTES 12
+#define BASE64_BLOCK_STORE_BYTES 14
+
+typedef struct {
+  uint8_t *dst;
+  size_t size;
+  const char *src;
+  atomic_bool failed;
+} Base64Chunks;
+
+// Value of a character of the alphabet, -1 when outside it
+static int DecodeChar(uint8_t c) {
+  if (c >= 'A' && c <= 'Z') {
+    return c - 'A';
+  }
+  if (c >= 'a' && c <= 'z') {
+    return c - 'a' + 26;
+  }
+  if (c >= '0' && c <= '9') {
+    return c - '0' + 52;
+  }
+  if (c == '+') {
+    return 62;
+  }
+  return c == '/' ? 63 : -1;
+}
+
+#if defined(BASE64_USE_SSE)
+// Translate 16 characters to their 12 bytes, storing 14. Returns false when
+// one of them is outside the alphabet.
+static bool DecodeBlock(uint8_t *dst, const uint8_t *src) {
+  __m128i c = _mm_loadu_si128((const __m128i *)src);
+
+  // Ranges of the alphabet with the offset to their values, bytes above 127
+  // are negative and fall outside all of them
+  __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('A' - 1)),
+                                _mm_cmplt_epi8(c, _mm_set1_epi8('Z' + 1)));
+  __m128i lower = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('a' - 1)),
+                                _mm_cmplt_epi8(c, _mm_set1_epi8('z' + 1)));
+  __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)),
+                                _mm_cmplt_epi8(c, _mm_set1_epi8('9' + 1)));
+  __m128i plus = _mm_cmpeq_epi8(c, _mm_set1_epi8('+'));
+  __m128i slash = _mm_cmpeq_epi8(c, _mm_set1_epi8('/'));
+  __m128i valid = _mm_or_si128(_mm_or_si128(upper, lower),
+                               _mm_or_si128(_mm_or_si128(digit, plus), slash));
+  if (_mm_movemask_epi8(valid) != 0xFFFF) {
+    return false;
+  }
+
+  __m128i offset = _mm_or_si128(
+      _mm_or_si128(_mm_and_si128(upper, _mm_set1_epi8(-'A')),
+                   _mm_and_si128(lower, _mm_set1_epi8(26 - 'a'))),
+      _mm_or_si128(_mm_and_si128(digit, _mm_set1_epi8(52 - '0')),
+                   _mm_or_si128(_mm_and_si128(plus, _mm_set1_epi8(62 - '+')),
+                                _mm_and_si128(slash,
+                                              _mm_set1_epi8(63 - '/')))));
+  __m128i v = _mm_add_epi8(c, offset);
+
+  // Pairs of 6 bits to 12 in every 16 bit lane, pairs of those to 24 in
+  // every 32 bit lane, the first character in the highest bits
+  __m128i pairs = _mm_or_si128(
+      _mm_slli_epi16(_mm_and_si128(v, _mm_set1_epi16(0xFF)), 6),
+      _mm_srli_epi16(v, 8));
+  __m128i groups = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+
+  // Bytes of every group in order, then the 3 of each group next to each
+  // other in 6 of every 8
+  __m128i bytes = _mm_or_si128(
+      _mm_or_si128(_mm_and_si128(_mm_srli_epi32(groups, 16),
+                                 _mm_set1_epi32(0xFF)),
+                   _mm_and_si128(groups, _mm_set1_epi32(0xFF00))),
+      _mm_slli_epi32(_mm_and_si128(groups, _mm_set1_epi32(0xFF)), 16));
+  __m128i packed = _mm_or_si128(
+      _mm_and_si128(bytes, _mm_set1_epi64x(0xFFFFFF)),
+      _mm_and_si128(_mm_srli_epi64(bytes, 8),
+                    _mm_set1_epi64x(0xFFFFFF000000)));
+  _mm_storel_epi64((__m128i *)dst, packed);
+  _mm_storel_epi64((__m128i *)(dst + 6), _mm_srli_si128(packed, 8));
+  return true;
+}
+#endif
+
+// Decode the bytes from begin to end, begin a multiple of 3, from the
+// characters of their groups
+static bool DecodeRange(uint8_t *dst, size_t begin, size_t end,
+                        const char *src) {
+  const uint8_t *in = (const uint8_t *)src + begin / 3 * 4;
+  size_t i = begin;
+#if defined(BASE64_USE_SSE)
+  for (; i + BASE64_BLOCK_STORE_BYTES <= end; i += BASE64_BLOCK_BYTES) {
+    if (!DecodeBlock(dst + i, in)) {
+      return false;
+    }
+    in += BASE64_BLOCK_CHARS;
+  }
+#endif
+
+  // Groups of 4 characters, the last one may only need 2 or 3 of them
+  for (; i < end; i += 3, in += 4) {
+    size_t bytes = end - i < 3 ? end - i : 3;
+    uint32_t group = 0;
+    for (size_t k = 0; k < 4; k++) {
+      int v = k <= bytes ? DecodeChar(in[k]) : 0;
+      if (v < 0) {
+        return false;
+      }
+      group = group << 6 | (uint32_t)v;
+    }
+
+    for (size_t k = 0; k < bytes; k++) {
+      dst[i + k] = (uint8_t)(group >> (16 - k * 8));
+    }
+  }
+  return true;
+}
+
+static void DecodeChunk(void *data, size_t index) {
+  Base64Chunks *chunks = data;
+  size_t begin = index * BASE64_CHUNK_BYTES;
+  size_t end = chunks->size - begin < BASE64_CHUNK_BYTES
+                   ? chunks->size
+                   : begin + BASE64_CHUNK_BYTES;
+  if (!DecodeRange(chunks->dst, begin, end, chunks->src)) {
+    atomic_store(&chunks->failed, true);
+  }
+}
+
+StatusCode DecodeBase64(uint8_t *dst, size_t size, const char *src,
+                        size_t length, JobPool *pool) {
+  assert((dst != NULL || size == 0) && "invalid arg dst: cannot be NULL");
+  assert((src != NULL || length == 0) && "invalid arg src: cannot be NULL");
+  PROFILE_ZONE("DecodeBase64");
+
+  // 4 characters per 3 bytes, a last byte or two need one more than them
+  size_t needed = size / 3 * 4 + (size % 3 != 0 ? size % 3 + 1 : 0);
+  if (length < needed) {
+    return E_CANNOT_LOAD_FILE;
+  }
+
+  Base64Chunks chunks = {dst, size, src};
+  atomic_init(&chunks.failed, false);
+  size_t count = (size + BASE64_CHUNK_BYTES - 1) / BASE64_CHUNK_BYTES;
+  JobPoolParallelFor(count > 1 ? pool : NULL, count, DecodeChunk, &chunks);
+  return atomic_load(&chunks.failed) ? E_CANNOT_LOAD_FILE : SUCCESS;
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core.h"
+#include "jobs.h"
+
+// Decode size bytes from the first characters of the base64 text src of
+// length characters, as cgltf does with data: URIs: padding and anything
+// after the characters needed is ignored. Characters are translated 16 at a
+// time. The pool decodes chunks of several megabytes, NULL runs it on the
+// calling thread. Returns E_CANNOT_LOAD_FILE when src is too short or one of
+// the characters needed is outside the alphabet, dst is left undefined then.
+StatusCode DecodeBase64(uint8_t *dst, size_t size, const char *src,
+                        size_t length, JobPool *pool);
@@ -0,0 +1,173 @@
+// Base64 decoding benchmark: encodes a buffer of random bytes the size of a
+// large embedded glTF buffer and decodes it on the calling thread and across
+// a pool, and reports the decoded bytes per second. Checks that both give
+// back the bytes, that every length of a short buffer does, and that text
+// too short or outside the alphabet is rejected. Exits with an error when a
+// check fails.
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "base64.h"
+#include "core.h"
+#include "jobs.h"
+
+#define BENCH_DEFAULT_MEGABYTES 96
+#define BENCH_DEFAULT_ROUNDS 5
+
+// Lengths of the short buffers checked, every remainder of 3 and of blocks
+#define BENCH_SHORT_BYTES 100
+
+static uint32_t rngState = 0x9E3779B9u;
+
+static uint8_t RandomByte() {
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 17;
+  rngState ^= rngState << 5;
+  return (uint8_t)(rngState >> 24);
+}
+
+// Encode with padding, as exporters write data: URIs. Returns the length.
+static size_t EncodeBase64(char *dst, const uint8_t *src, size_t size) {
+  static const char alphabet[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  char *out = dst;
+  for (size_t i = 0; i < size; i += 3) {
+    uint32_t group = (uint32_t)src[i] << 16;
+    group |= i + 1 < size ? (uint32_t)src[i + 1] << 8 : 0;
+    group |= i + 2 < size ? src[i + 2] : 0;
+    *out++ = alphabet[group >> 18];
+    *out++ = alphabet[(group >> 12) & 63];
+    *out++ = i + 1 < size ? alphabet[(group >> 6) & 63] : '=';
+    *out++ = i + 2 < size ? alphabet[group & 63] : '=';
+  }
+  *out = '\0';
+  return (size_t)(out - dst);
+}
+
+static double Decode(uint8_t *dst, size_t size, const char *src,
+                     size_t length, JobPool *pool, int rounds, bool *failed) {
+  double best = 1e30;
+  for (int round = 0; round < rounds; round++) {
+    double start = GetTime();
+    *failed = *failed ||
+              DecodeBase64(dst, size, src, length, pool) != SUCCESS;
+    best = fmin(best, GetTime() - start);
+  }
+  return best;
+}
+
+// Every length up to a few blocks, and text cut short or with a character
+// outside the alphabet among the ones needed
+static bool CheckShort() {
+  uint8_t bytes[BENCH_SHORT_BYTES];
+  uint8_t decoded[BENCH_SHORT_BYTES];
+  char text[BENCH_SHORT_BYTES / 3 * 4 + 8];
+  for (size_t i = 0; i < BENCH_SHORT_BYTES; i++) {
+    bytes[i] = RandomByte();
+  }
+
+  for (size_t size = 0; size <= BENCH_SHORT_BYTES; size++) {
+    size_t length = EncodeBase64(text, bytes, size);
+    size_t needed = size / 3 * 4 + (size % 3 != 0 ? size % 3 + 1 : 0);
+    if (DecodeBase64(decoded, size, text, length, NULL) != SUCCESS ||
+        memcmp(decoded, bytes, size) != 0 ||
+        (size > 0 &&
+         DecodeBase64(decoded, size, text, needed - 1, NULL) == SUCCESS)) {
+      return false;
+    }
+
+    // Corrupt every needed character in turn
+    for (size_t c = 0; c < needed; c++) {
+      char saved = text[c];
+      text[c] = c % 2 == 0 ? '.' : (char)0xC3;
+      bool rejected = DecodeBase64(decoded, size, text, length, NULL) ==
+                      E_CANNOT_LOAD_FILE;
+      text[c] = saved;
+      if (!rejected) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+static void PrintUsage(const char *program) {
+  fprintf(stderr, "usage: %s [-s megabytes] [-n rounds] [-j threads]\n",
+          program);
+}
+
+int main(int argc, char **argv) {
+  int megabytes = BENCH_DEFAULT_MEGABYTES;
+  int rounds = BENCH_DEFAULT_ROUNDS;
+  int threads = (int)GetProcessorsCount() - 1;
+  for (int i = 1; i < argc; i++) {
+    if (i + 1 >= argc) {
+      PrintUsage(argv[0]);
+      return 1;
+    }
+
+    if (strcmp(argv[i], "-s") == 0) {
+      megabytes = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-n") == 0) {
+      rounds = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-j") == 0) {
+      threads = atoi(argv[++i]);
+    } else {
+      PrintUsage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (megabytes <= 0 || rounds <= 0 || threads < 0) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  // A size that leaves a partial group at the end
+  size_t size = (size_t)megabytes * 1000000 + 1;
+  JobPool *pool = MakeJobPool((size_t)threads);
+  uint8_t *bytes = malloc(size);
+  uint8_t *decoded = malloc(size);
+  char *text = malloc((size + 2) / 3 * 4 + 1);
+  if (pool == NULL || bytes == NULL || decoded == NULL || text == NULL) {
+    Log(LOG_ERROR, "cannot setup benchmark (out of memory)");
+    return 1;
+  }
+
+  for (size_t i = 0; i < size; i++) {
+    bytes[i] = RandomByte();
+  }
+  size_t length = EncodeBase64(text, bytes, size);
+  printf("buffer:    %.2f MB from %.2f MB of text\n", (double)size * 1e-6,
+         (double)length * 1e-6);
+
+  bool failed = false;
+  double serial = Decode(decoded, size, text, length, NULL, rounds, &failed);
+  bool same = memcmp(decoded, bytes, size) == 0;
+  printf("%-10s %8.2f ms %6.2f GB/s\n", "1 thread", serial * 1000.0,
+         (double)size / serial * 1e-9);
+
+  memset(decoded, 0, size);
+  double parallel = Decode(decoded, size, text, length, pool, rounds,
+                           &failed);
+  same = same && memcmp(decoded, bytes, size) == 0;
+  char name[32];
+  snprintf(name, sizeof(name), "%zu threads", pool->threadsCount + 1);
+  printf("%-10s %8.2f ms %6.2f GB/s\n", name, parallel * 1000.0,
+         (double)size / parallel * 1e-9);
+
+  bool shortOk = CheckShort();
+  failed = failed || !same || !shortOk;
+  printf("checks:    %s bytes, short buffers %s%s\n",
+         same ? "same" : "DIFFERENT", shortOk ? "ok" : "WRONG",
+         failed ? ", FAILED" : "");
+
+  free(bytes);
+  free(decoded);
+  free(text);
+  DestroyJobPool(pool);
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,309 @@
+// GPU culling benchmark: a wide field of small spheres, most of them outside
+// the view, drawn by a GpuScene (compute culling and indirect multi draws)
+// or, without GL 4.3 or with -c, by a RenderQueue issuing one draw per
+// sphere. The nearest spheres move every frame. With -v the last frame is
+// drawn by both paths, both images must be the same.
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glad/glad.h>
+
+#include "camera.h"
+#include "core.h"
+#include "gpuscene.h"
+#include "model.h"
+#include "render.h"
+#include "shapes.h"
+
+#define BENCH_DEFAULT_SIZE 512
+#define BENCH_DEFAULT_FRAMES 100
+#define BENCH_PROPS_X 96
+#define BENCH_PROPS_Y 8
+#define BENCH_PROPS_Z 24
+#define BENCH_PROPS (BENCH_PROPS_X * BENCH_PROPS_Y * BENCH_PROPS_Z)
+
+// The first spheres bob up and down every frame
+#define BENCH_MOVING (BENCH_PROPS / 16)
+
+static void PlaceProps(Model *props, Model sphere) {
+  for (int i = 0; i < BENCH_PROPS; i++) {
+    int x = i % BENCH_PROPS_X;
+    int y = (i / BENCH_PROPS_X) % BENCH_PROPS_Y;
+    int z = i / (BENCH_PROPS_X * BENCH_PROPS_Y);
+    props[i] = sphere;
+    props[i].transform.origin =
+        (Vec3){((float)x - 47.5f) * 1.5f, ((float)y - 3.5f) * 1.5f,
+               -2.0f - (float)z * 1.5f};
+    props[i].transform.scale = Vec3Scale(Vec3One, 0.4f);
+  }
+}
+
+// Move the bobbing spheres and the camera to the given frame
+static void AnimateScene(Model *props, Camera *camera, Vec3 origin,
+                         int frame) {
+  camera->transform.origin.x = origin.x - sinf((float)frame * 0.02f) * 40.0f;
+  for (int i = 0; i < BENCH_MOVING; i++) {
+    int y = (i / BENCH_PROPS_X) % BENCH_PROPS_Y;
+    float phase = (float)frame * 0.1f + (float)i;
+    props[i].transform.origin.y =
+        ((float)y - 3.5f) * 1.5f + sinf(phase) * 0.3f;
+  }
+}
+
+static void UpdateGpuScene(GpuScene *scene, const Model *props) {
+  for (int i = 0; i < BENCH_MOVING; i++) {
+    GpuSceneSetTransform(scene, (size_t)i,
+                         TransformGetModelMatrix(props[i].transform));
+  }
+}
+
+static void DrawQueue(RenderQueue *queue, Camera camera, const Model *props) {
+  RenderQueueBegin(queue, camera);
+  for (int i = 0; i < BENCH_PROPS; i++) {
+    RenderQueueSubmit(queue, props + i, RENDER_PASS_OPAQUE);
+  }
+  RenderQueueFlush(queue);
+}
+
+static uint8_t *ReadFrame(int size) {
+  uint8_t *rgb = malloc((size_t)size * size * 3);
+  if (rgb != NULL) {
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, size, size, GL_RGB, GL_UNSIGNED_BYTE, rgb);
+  }
+  return rgb;
+}
+
+static void WritePpm(const char *path, const uint8_t *rgb, int size) {
+  FILE *file = fopen(path, "wb");
+  if (file == NULL) {
+    Log(LOG_ERROR, "cannot write image: %s", path);
+    return;
+  }
+
+  // GL rows start at the bottom
+  fprintf(file, "P6\n%d %d\n255\n", size, size);
+  for (int y = size - 1; y >= 0; y--) {
+    fwrite(rgb + (size_t)y * size * 3, 1, (size_t)size * 3, file);
+  }
+  fclose(file);
+}
+
+static void PrintUsage(const char *program) {
+  fprintf(stderr,
+          "usage: %s [-s size] [-n frames] [-g max GL version] [-c] [-v] "
+          "[-o image.ppm]\n",
+          program);
+}
+
+int main(int argc, char **argv) {
+  int size = BENCH_DEFAULT_SIZE;
+  int frames = BENCH_DEFAULT_FRAMES;
+  int maxGLVersion = APP_DEFAULT_GL_VERSION;
+  bool forceCpu = false;
+  bool verify = false;
+  const char *output = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-c") == 0) {
+      forceCpu = true;
+      continue;
+    }
+
+    if (strcmp(argv[i], "-v") == 0) {
+      verify = true;
+      continue;
+    }
+
+    if (i + 1 >= argc) {
+      PrintUsage(argv[0]);
+      return 1;
+    }
+
+    if (strcmp(argv[i], "-s") == 0) {
+      size = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-n") == 0) {
+      frames = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-g") == 0) {
+      maxGLVersion = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-o") == 0) {
+      output = argv[++i];
+    } else {
+      PrintUsage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (size <= 0 || frames <= 0 || maxGLVersion < APP_MIN_GL_VERSION ||
+      maxGLVersion > 46) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  AppSetMaxGLVersion(maxGLVersion);
+  StatusCode status = AppInitHeadless(size, size);
+  if (status != SUCCESS) {
+    return AppClose(status);
+  }
+
+  bool useGpu = !forceCpu && GpuSceneIsSupported();
+  if (!useGpu && !forceCpu) {
+    Log(LOG_WARN, "GL %d.%d cannot cull on the GPU, using a render queue",
+        AppGetGLVersion() / 10, AppGetGLVersion() % 10);
+  }
+
+  if (verify && !GpuSceneIsSupported()) {
+    Log(LOG_ERROR, "verification needs GPU culling (GL 4.3)");
+    return AppClose(E_CANNOT_LOAD_GL);
+  }
+
+  Model sphere = MakeSphere(8);
+  Model *props = calloc(BENCH_PROPS, sizeof(Model));
+  if (sphere.status != SUCCESS || props == NULL) {
+    Log(LOG_ERROR, "cannot setup benchmark (out of memory)");
+    return AppClose(E_OUT_OF_MEMORY);
+  }
+
+  status = UploadModel(&sphere);
+  if (status != SUCCESS) {
+    return AppClose(status);
+  }
+
+  Shader shader = BeginLoadShader("assets/def_vs.glsl", "assets/def_fs.glsl",
+                                  SHADER_VARIANT_VERTEX_COLORS);
+  Shader indirectShader = {0};
+  if (useGpu || verify) {
+    indirectShader =
+        BeginLoadShader("assets/def_vs.glsl", "assets/def_fs.glsl",
+                        SHADER_VARIANT_VERTEX_COLORS | SHADER_VARIANT_INDIRECT);
+    status = FinishLoadShader(&indirectShader);
+    if (status != SUCCESS) {
+      return AppClose(status);
+    }
+  }
+
+  status = FinishLoadShader(&shader);
+  if (status != SUCCESS) {
+    return AppClose(status);
+  }
+
+  PlaceProps(props, sphere);
+
+  GpuScene scene = {0};
+  if (useGpu || verify) {
+    scene = MakeGpuScene("assets/cull_cs.glsl");
+    if (scene.status != SUCCESS) {
+      return AppClose(scene.status);
+    }
+
+    for (int i = 0; i < BENCH_PROPS; i++) {
+      props[i].shader = indirectShader;
+      GpuSceneAdd(&scene, props + i);
+      props[i].shader = shader;
+    }
+  } else {
+    for (int i = 0; i < BENCH_PROPS; i++) {
+      props[i].shader = shader;
+    }
+  }
+
+  RenderQueue queue = MakeRenderQueue(BENCH_PROPS);
+  if (queue.status != SUCCESS) {
+    return AppClose(queue.status);
+  }
+
+  Camera camera = MakeDefaultCamera();
+  UpdateCamera(&camera);
+  Vec3 origin = camera.transform.origin;
+
+  double cpuMs = 0.0;
+  size_t drawCalls = 0;
+  size_t uploadedBytes = 0;
+  double start = GetTime();
+  for (int frame = 0; frame < frames; frame++) {
+    AnimateScene(props, &camera, origin, frame);
+
+    BeginFrame();
+    if (useGpu) {
+      UpdateGpuScene(&scene, props);
+      GpuSceneDraw(&scene, camera);
+      cpuMs += scene.stats.cpuMs;
+      drawCalls += scene.stats.drawCalls;
+      uploadedBytes += scene.stats.uploadedBytes;
+    } else {
+      double cpuStart = GetTime();
+      DrawQueue(&queue, camera, props);
+      cpuMs += (GetTime() - cpuStart) * 1000.0;
+      drawCalls += BENCH_PROPS;
+    }
+    EndFrame();
+  }
+  glFinish();
+  double elapsed = GetTime() - start;
+
+  printf("path:           %s (GL %d.%d)\n",
+         useGpu ? "GPU culling, indirect multi draws" : "render queue",
+         AppGetGLVersion() / 10, AppGetGLVersion() % 10);
+  printf("resolution:     %dx%d\n", size, size);
+  printf("instances:      %d (%d moving)\n", BENCH_PROPS, BENCH_MOVING);
+  printf("frames:         %d (%.3f ms/frame)\n", frames,
+         elapsed * 1000.0 / frames);
+  printf("cpu:            %.3f ms/frame\n", cpuMs / frames);
+  printf("draw calls:     %zu per frame\n", drawCalls / frames);
+  if (useGpu) {
+    printf("uploaded:       %zu bytes per frame\n", uploadedBytes / frames);
+    printf("visible:        %zu of %d in the last frame\n",
+           GpuSceneGetVisibleCount(&scene), BENCH_PROPS);
+  }
+
+  int exitCode = 0;
+  if (verify || output != NULL) {
+    BeginFrame();
+    DrawQueue(&queue, camera, props);
+    uint8_t *full = ReadFrame(size);
+
+    uint8_t *culled = NULL;
+    if (verify) {
+      BeginFrame();
+      UpdateGpuScene(&scene, props);
+      GpuSceneDraw(&scene, camera);
+      culled = ReadFrame(size);
+    }
+
+    if (full == NULL || (verify && culled == NULL)) {
+      Log(LOG_ERROR, "cannot read back frames (out of memory)");
+      return AppClose(E_OUT_OF_MEMORY);
+    }
+
+    if (verify) {
+      size_t differ = 0;
+      size_t pixels = (size_t)size * size;
+      for (size_t i = 0; i < pixels * 3; i += 3) {
+        differ += memcmp(full + i, culled + i, 3) != 0;
+      }
+
+      printf("verify:         %zu of %zu pixels differ\n", differ, pixels);
+      exitCode = differ > 0;
+    }
+
+    if (output != NULL) {
+      WritePpm(output, culled != NULL ? culled : full, size);
+    }
+    free(culled);
+    free(full);
+  }
+
+  DestroyRenderQueue(queue);
+  if (useGpu || verify) {
+    DestroyGpuScene(scene);
+    DestroyShader(indirectShader);
+  }
+  DestroyCameraUniforms();
+  DestroyShader(shader);
+  free(props);
+  DestroyModel(sphere);
+  AppClose(SUCCESS);
+  return exitCode;
+}
@@ -0,0 +1,223 @@
+// JSON parsing benchmark: generates a glTF document of many megabytes with
+// tens of thousands of nodes, meshes and accessors, and parses it with the
+// stock cgltf_parse, which tokenizes the JSON twice, and with the token count
+// of CountJsonTokens, which lets it tokenize once. Reports the time of both
+// and the throughput of the count alone. Checks that both parses give the
+// same model and that the count is exact, cgltf rejecting one token less.
+// Exits with an error when a check fails.
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cgltf.h"
+#include "core.h"
+#include "json.h"
+
+#define BENCH_DEFAULT_NODES 50000
+#define BENCH_DEFAULT_ROUNDS 5
+
+// Accessors of a mesh: positions, normals and indices
+#define BENCH_MESH_ACCESSORS 3
+
+typedef struct {
+  char *data;
+  size_t size;
+  size_t capacity;
+  bool failed;
+} Document;
+
+static void Append(Document *doc, const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  char line[512];
+  int written = vsnprintf(line, sizeof(line), fmt, args);
+  va_end(args);
+  if (written < 0 || (size_t)written >= sizeof(line) || doc->failed) {
+    doc->failed = true;
+    return;
+  }
+
+  if (doc->size + (size_t)written + 1 > doc->capacity) {
+    size_t capacity = doc->capacity * 2 + sizeof(line);
+    char *data = realloc(doc->data, capacity);
+    if (data == NULL) {
+      doc->failed = true;
+      return;
+    }
+    doc->data = data;
+    doc->capacity = capacity;
+  }
+
+  memcpy(doc->data + doc->size, line, (size_t)written + 1);
+  doc->size += (size_t)written;
+}
+
+// A scene of nodes placed on a grid, every fourth one with a mesh of its
+// own. Names have escaped quotes, as exporters write them.
+static Document MakeDocument(size_t nodes) {
+  Document doc = {0};
+  size_t meshes = (nodes + 3) / 4;
+  size_t accessors = meshes * BENCH_MESH_ACCESSORS;
+  Append(&doc, "{\n  \"asset\": {\"version\": \"2.0\", "
+               "\"generator\": \"SimpleGLTF json bench\"},\n");
+  Append(&doc, "  \"scene\": 0,\n  \"scenes\": [{\"nodes\": [");
+  for (size_t i = 0; i < nodes; i++) {
+    Append(&doc, i + 1 < nodes ? "%zu, " : "%zu", i);
+  }
+  Append(&doc, "]}],\n  \"nodes\": [\n");
+  for (size_t i = 0; i < nodes; i++) {
+    Append(&doc,
+           "    {\"name\": \"node \\\"%zu\\\"\", \"translation\": [%.3f, "
+           "%.3f, %.3f], \"rotation\": [0.0, 0.0, 0.0, 1.0], "
+           "\"scale\": [1.0, 1.0, 1.0]",
+           i, (double)(i % 100) * 2.5, (double)(i / 100 % 100) * 2.5,
+           (double)(i / 10000) * 2.5);
+    if (i % 4 == 0) {
+      Append(&doc, ", \"mesh\": %zu", i / 4);
+    }
+    Append(&doc, i + 1 < nodes ? "},\n" : "}\n");
+  }
+
+  Append(&doc, "  ],\n  \"meshes\": [\n");
+  for (size_t i = 0; i < meshes; i++) {
+    size_t a = i * BENCH_MESH_ACCESSORS;
+    Append(&doc,
+           "    {\"name\": \"mesh %zu\", \"primitives\": [{\"attributes\": "
+           "{\"POSITION\": %zu, \"NORMAL\": %zu}, \"indices\": %zu}]}%s\n",
+           i, a, a + 1, a + 2, i + 1 < meshes ? "," : "");
+  }
+
+  Append(&doc, "  ],\n  \"accessors\": [\n");
+  for (size_t i = 0; i < accessors; i++) {
+    if (i % BENCH_MESH_ACCESSORS == 2) {
+      Append(&doc,
+             "    {\"bufferView\": %zu, \"componentType\": 5123, "
+             "\"count\": 36, \"type\": \"SCALAR\"}",
+             i);
+    } else {
+      Append(&doc,
+             "    {\"bufferView\": %zu, \"componentType\": 5126, "
+             "\"count\": 24, \"type\": \"VEC3\", \"min\": [-1.0, -1.0, "
+             "-1.0], \"max\": [1.0, 1.0, 1.0]}",
+             i);
+    }
+    Append(&doc, i + 1 < accessors ? ",\n" : "\n");
+  }
+
+  // Views of the positions and normals of 24 vertices and of 36 indices
+  Append(&doc, "  ],\n  \"bufferViews\": [\n");
+  size_t offset = 0;
+  for (size_t i = 0; i < accessors; i++) {
+    size_t length = i % BENCH_MESH_ACCESSORS == 2 ? 72 : 288;
+    Append(&doc,
+           "    {\"buffer\": 0, \"byteOffset\": %zu, \"byteLength\": %zu}%s\n",
+           offset, length, i + 1 < accessors ? "," : "");
+    offset += length;
+  }
+
+  Append(&doc, "  ],\n  \"buffers\": [{\"byteLength\": %zu}]\n}\n", offset);
+  return doc;
+}
+
+// Parse with the given token count, 0 lets cgltf count them
+static cgltf_result Parse(const Document *doc, size_t tokens,
+                          cgltf_data **data) {
+  cgltf_options options = {0};
+  options.json_token_count = tokens;
+  return cgltf_parse(&options, doc->data, doc->size, data);
+}
+
+static bool SameModels(const cgltf_data *a, const cgltf_data *b) {
+  return a->nodes_count == b->nodes_count &&
+         a->meshes_count == b->meshes_count &&
+         a->accessors_count == b->accessors_count &&
+         a->buffer_views_count == b->buffer_views_count;
+}
+
+static void PrintUsage(const char *program) {
+  fprintf(stderr, "usage: %s [-s nodes] [-n rounds]\n", program);
+}
+
+int main(int argc, char **argv) {
+  int nodes = BENCH_DEFAULT_NODES;
+  int rounds = BENCH_DEFAULT_ROUNDS;
+  for (int i = 1; i < argc; i++) {
+    if (i + 1 >= argc) {
+      PrintUsage(argv[0]);
+      return 1;
+    }
+
+    if (strcmp(argv[i], "-s") == 0) {
+      nodes = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-n") == 0) {
+      rounds = atoi(argv[++i]);
+    } else {
+      PrintUsage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (nodes <= 0 || rounds <= 0) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  Document doc = MakeDocument((size_t)nodes);
+  if (doc.failed) {
+    Log(LOG_ERROR, "cannot setup benchmark (out of memory)");
+    return 1;
+  }
+
+  double count = 1e30;
+  double stock = 1e30;
+  double counted = 1e30;
+  size_t tokens = 0;
+  cgltf_data *expected = NULL;
+  cgltf_data *data = NULL;
+  bool failed = false;
+  for (int round = 0; round < rounds && !failed; round++) {
+    cgltf_free(expected);
+    cgltf_free(data);
+    expected = data = NULL;
+
+    double start = GetTime();
+    failed = Parse(&doc, 0, &expected) != cgltf_result_success;
+    double middle = GetTime();
+    tokens = CountJsonTokens(doc.data, doc.size);
+    double counting = GetTime();
+    failed = failed || tokens == 0 ||
+             Parse(&doc, tokens, &data) != cgltf_result_success;
+    double end = GetTime();
+
+    stock = fmin(stock, middle - start);
+    count = fmin(count, counting - middle);
+    counted = fmin(counted, end - middle);
+  }
+
+  // One token less does not fit, so the count is not just an upper bound
+  cgltf_data *fewer = NULL;
+  bool exact = !failed && Parse(&doc, tokens - 1, &fewer) ==
+                              cgltf_result_invalid_json;
+  bool same = !failed && SameModels(expected, data);
+  failed = failed || !exact || !same;
+
+  printf("document:  %.2f MB, %zu tokens, %d nodes\n", (double)doc.size * 1e-6,
+         tokens, nodes);
+  printf("count      %8.2f ms %6.2f GB/s\n", count * 1000.0,
+         (double)doc.size / count * 1e-9);
+  printf("stock      %8.2f ms %6.1f MB/s\n", stock * 1000.0,
+         (double)doc.size / stock * 1e-6);
+  printf("counted    %8.2f ms %6.1f MB/s (%.2fx)\n", counted * 1000.0,
+         (double)doc.size / counted * 1e-6, stock / counted);
+  printf("checks:    %s models, %s count%s\n",
+         same ? "same" : "DIFFERENT",
+         exact ? "exact" : "WRONG", failed ? ", FAILED" : "");
+
+  cgltf_free(fewer);
+  cgltf_free(expected);
+  cgltf_free(data);
+  free(doc.data);
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,386 @@
+// Loader benchmark: loads every model given (see tools/gltfgen.c to make
+// them) a number of times and reports the time and bytes allocated by each
+// stage of DecodeModel and UploadModel, with their throughput in MB and
+// vertices of the model per second, and the transient allocations made
+// while decoding with the most bytes they held. Uploads use a headless GL
+// context, with -c or without a driver only the CPU stages run. Embedded and
+// compressed buffers are decoded and missing attributes generated on a pool
+// of -j threads, as the viewer loads them. Models made with gltfgen -e embed
+// their buffer as base64, decoded within the loadBuffers stage.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glad/glad.h>
+
+#include "core.h"
+#include "jobs.h"
+#include "model.h"
+#include "stats.h"
+
+#define BENCH_DEFAULT_ITERATIONS 10
+#define BENCH_DEFAULT_WARMUP 1
+
+typedef enum {
+  REPORT_FORMAT_CSV,
+  REPORT_FORMAT_JSON,
+} ReportFormat;
+
+typedef struct {
+  char **paths;
+  size_t pathsCount;
+  int iterations;
+  int warmup;
+  int threads;
+  bool cpuOnly;
+  ReportFormat format;
+  const char *reportPath;
+} LoaderOptions;
+
+// Every iteration of a model, seconds are kept per stage for the summaries
+typedef struct {
+  const char *path;
+  bool failed;
+  size_t meshes;
+  size_t vertices;
+  size_t indices;
+  size_t inputBytes;
+  size_t allocatedBytes[LOAD_STAGE_COUNT];
+  size_t transientAllocations;
+  size_t transientPeakBytes;
+  double *seconds[LOAD_STAGE_COUNT];
+  double *totalSeconds;
+  size_t iterations;
+} ModelResult;
+
+static void PrintUsage(const char *program) {
+  fprintf(stderr,
+          "usage: %s [-n iterations] [-w warmup] [-j threads] [-c] "
+          "[-f csv|json] [-o report] <model>...\n"
+          "  -n n      measured loads of every model (default: %d)\n"
+          "  -w n      loads before measuring (default: %d)\n"
+          "  -j n      worker threads of the load pool, 0 decodes on the "
+          "main thread\n"
+          "            (default: processors - 1)\n"
+          "  -c        decode only, skip the GL uploads\n"
+          "  -f fmt    report format, csv or json (default: csv)\n"
+          "  -o path   write the report to a file instead of stdout\n",
+          program, BENCH_DEFAULT_ITERATIONS, BENCH_DEFAULT_WARMUP);
+}
+
+static bool ParseOptions(int argc, char **argv, LoaderOptions *options) {
+  options->iterations = BENCH_DEFAULT_ITERATIONS;
+  options->warmup = BENCH_DEFAULT_WARMUP;
+  options->threads = (int)GetProcessorsCount() - 1;
+  options->format = REPORT_FORMAT_CSV;
+  options->paths = argv + argc;
+
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (strcmp(arg, "-n") == 0 && hasValue) {
+      options->iterations = atoi(argv[++i]);
+    } else if (strcmp(arg, "-w") == 0 && hasValue) {
+      options->warmup = atoi(argv[++i]);
+    } else if (strcmp(arg, "-j") == 0 && hasValue) {
+      options->threads = atoi(argv[++i]);
+    } else if (strcmp(arg, "-c") == 0) {
+      options->cpuOnly = true;
+    } else if (strcmp(arg, "-f") == 0 && hasValue) {
+      const char *format = argv[++i];
+      if (strcmp(format, "csv") == 0) {
+        options->format = REPORT_FORMAT_CSV;
+      } else if (strcmp(format, "json") == 0) {
+        options->format = REPORT_FORMAT_JSON;
+      } else {
+        return false;
+      }
+    } else if (strcmp(arg, "-o") == 0 && hasValue) {
+      options->reportPath = argv[++i];
+    } else if (arg[0] == '-' && arg[1] != '\0') {
+      return false;
+    } else {
+      // Models come last, every remaining argument is one
+      options->paths = argv + i;
+      options->pathsCount = (size_t)(argc - i);
+      break;
+    }
+  }
+
+  return options->pathsCount > 0 && options->iterations > 0 &&
+         options->warmup >= 0 && options->threads >= 0;
+}
+
+// Load a model once, returns false when it cannot be decoded or uploaded
+static bool LoadOnce(const char *path, bool upload, LoadStats *stats,
+                     ModelResult *result) {
+  memset(stats, 0, sizeof(LoadStats));
+  SetLoadStats(stats);
+  Model model = DecodeModel(path);
+  if (model.status == SUCCESS && upload) {
+    model.status = UploadModel(&model);
+  }
+  SetLoadStats(NULL);
+
+  if (model.status != SUCCESS) {
+    DestroyModel(model);
+    return false;
+  }
+
+  result->meshes = model.meshesCount;
+  result->vertices = 0;
+  result->indices = 0;
+  for (size_t i = 0; i < model.meshesCount; i++) {
+    result->vertices += model.meshes[i].verticesCount;
+    result->indices += model.meshes[i].indicesCount;
+  }
+
+  // Let the transfers finish outside of the measured stages
+  if (upload) {
+    glFinish();
+  }
+  DestroyModel(model);
+  return true;
+}
+
+static void BenchModel(const LoaderOptions *options, bool upload,
+                       ModelResult *result) {
+  LoadStats stats;
+  for (int i = 0; i < options->warmup; i++) {
+    if (!LoadOnce(result->path, upload, &stats, result)) {
+      result->failed = true;
+      return;
+    }
+  }
+
+  for (int i = 0; i < options->iterations; i++) {
+    if (!LoadOnce(result->path, upload, &stats, result)) {
+      result->failed = true;
+      return;
+    }
+
+    double total = 0.0;
+    for (int s = 0; s < LOAD_STAGE_COUNT; s++) {
+      result->seconds[s][i] = stats.seconds[s];
+      total += stats.seconds[s];
+    }
+    result->totalSeconds[i] = total;
+    result->iterations++;
+
+    // Allocations do not change between iterations, keep the last ones
+    memcpy(result->allocatedBytes, stats.allocatedBytes,
+           sizeof(result->allocatedBytes));
+    result->inputBytes = stats.inputBytes;
+    result->transientAllocations = stats.transientAllocations;
+    result->transientPeakBytes = stats.transientPeakBytes;
+  }
+}
+
+// Median time of a stage in ms and its throughput, zero when not measured
+typedef struct {
+  FrameStatSummary ms;
+  double mbPerSecond;
+  double verticesPerSecond;
+} StageSummary;
+
+static StageSummary SummarizeStage(const ModelResult *result,
+                                   double *seconds) {
+  StageSummary summary = {0};
+  for (size_t i = 0; i < result->iterations; i++) {
+    seconds[i] *= 1000.0;
+  }
+  summary.ms = MakeFrameStatSummary(seconds, result->iterations);
+  if (summary.ms.p50 > 0.0) {
+    double perSecond = 1000.0 / summary.ms.p50;
+    summary.mbPerSecond =
+        (double)result->inputBytes / (1024.0 * 1024.0) * perSecond;
+    summary.verticesPerSecond = (double)result->vertices * perSecond;
+  }
+  return summary;
+}
+
+static void WriteJsonString(FILE *file, const char *text) {
+  fputc('"', file);
+  for (const char *c = text; *c != '\0'; c++) {
+    if (*c == '"' || *c == '\\') {
+      fputc('\\', file);
+    }
+
+    if ((unsigned char)*c >= 0x20) {
+      fputc(*c, file);
+    }
+  }
+  fputc('"', file);
+}
+
+static void WriteCsvRow(FILE *file, const ModelResult *result,
+                        const char *stage, StageSummary summary,
+                        size_t allocatedBytes) {
+  fprintf(file,
+          "\"%s\",%s,%zu,%zu,%zu,%.4f,%.4f,%.4f,%zu,%.2f,%.0f,%zu,%zu\n",
+          result->path, stage, result->iterations, result->vertices,
+          result->inputBytes, summary.ms.p50, summary.ms.min, summary.ms.max,
+          allocatedBytes, summary.mbPerSecond, summary.verticesPerSecond,
+          result->transientAllocations, result->transientPeakBytes);
+}
+
+static void WriteJsonStage(FILE *file, const char *stage,
+                           StageSummary summary, size_t allocatedBytes,
+                           bool last) {
+  fprintf(file,
+          "        {\"stage\": \"%s\", \"medianMs\": %.4f, \"minMs\": %.4f, "
+          "\"maxMs\": %.4f, \"allocatedBytes\": %zu, \"mbPerSecond\": %.2f, "
+          "\"verticesPerSecond\": %.0f}%s\n",
+          stage, summary.ms.p50, summary.ms.min, summary.ms.max,
+          allocatedBytes, summary.mbPerSecond, summary.verticesPerSecond,
+          last ? "" : ",");
+}
+
+static bool WriteReport(const LoaderOptions *options, ModelResult *results,
+                        bool upload) {
+  FILE *file = stdout;
+  if (options->reportPath != NULL) {
+    file = fopen(options->reportPath, "w");
+    if (file == NULL) {
+      Log(LOG_ERROR, "cannot write report: %s", options->reportPath);
+      return false;
+    }
+  }
+
+  if (options->format == REPORT_FORMAT_CSV) {
+    fprintf(file, "model,stage,iterations,vertices,inputBytes,medianMs,"
+                  "minMs,maxMs,allocatedBytes,mbPerSecond,"
+                  "verticesPerSecond,transientAllocations,"
+                  "transientPeakBytes\n");
+  } else {
+    fprintf(file, "{\n  \"iterations\": %d,\n  \"warmup\": %d,\n",
+            options->iterations, options->warmup);
+    fprintf(file, "  \"threads\": %d,\n", options->threads);
+    fprintf(file, "  \"upload\": %s,\n  \"models\": [\n",
+            upload ? "true" : "false");
+  }
+
+  for (size_t m = 0; m < options->pathsCount; m++) {
+    ModelResult *result = results + m;
+    if (options->format == REPORT_FORMAT_JSON) {
+      fprintf(file, "    {\"path\": ");
+      WriteJsonString(file, result->path);
+      fprintf(file,
+              ", \"failed\": %s, \"meshes\": %zu, \"vertices\": %zu, "
+              "\"indices\": %zu, \"inputBytes\": %zu, "
+              "\"transientAllocations\": %zu, \"transientPeakBytes\": %zu, "
+              "\"stages\": [\n",
+              result->failed ? "true" : "false", result->meshes,
+              result->vertices, result->indices, result->inputBytes,
+              result->transientAllocations, result->transientPeakBytes);
+    }
+
+    size_t allocatedTotal = 0;
+    for (int s = 0; s < LOAD_STAGE_COUNT && !result->failed; s++) {
+      StageSummary summary = SummarizeStage(result, result->seconds[s]);
+      allocatedTotal += result->allocatedBytes[s];
+      if (options->format == REPORT_FORMAT_CSV) {
+        WriteCsvRow(file, result, GetLoadStageName((LoadStage)s), summary,
+                    result->allocatedBytes[s]);
+      } else {
+        WriteJsonStage(file, GetLoadStageName((LoadStage)s), summary,
+                       result->allocatedBytes[s], false);
+      }
+    }
+
+    if (!result->failed) {
+      StageSummary total = SummarizeStage(result, result->totalSeconds);
+      if (options->format == REPORT_FORMAT_CSV) {
+        WriteCsvRow(file, result, "total", total, allocatedTotal);
+      } else {
+        WriteJsonStage(file, "total", total, allocatedTotal, true);
+      }
+    }
+
+    if (options->format == REPORT_FORMAT_JSON) {
+      fprintf(file, "      ]}%s\n", m + 1 < options->pathsCount ? "," : "");
+    }
+  }
+
+  if (options->format == REPORT_FORMAT_JSON) {
+    fprintf(file, "  ]\n}\n");
+  }
+
+  if (file != stdout) {
+    return fclose(file) == 0;
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  LoaderOptions options = {0};
+  if (!ParseOptions(argc, argv, &options)) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  bool upload = false;
+  if (!options.cpuOnly) {
+    upload = AppInitHeadless(64, 64) == SUCCESS;
+    if (!upload) {
+      Log(LOG_WARN, "cannot create a headless GL context, skipping uploads");
+    }
+  }
+
+  ModelResult *results = calloc(options.pathsCount, sizeof(ModelResult));
+  JobPool *pool = options.threads > 0
+                      ? MakeJobPool((size_t)options.threads)
+                      : NULL;
+  if (results == NULL || (pool == NULL && options.threads > 0)) {
+    free(results);
+    return AppClose(E_OUT_OF_MEMORY);
+  }
+  SetLoadJobPool(pool);
+
+  // A model that cannot be loaded fails the run, the others still run
+  StatusCode status = SUCCESS;
+  for (size_t m = 0; m < options.pathsCount && status != E_OUT_OF_MEMORY;
+       m++) {
+    ModelResult *result = results + m;
+    result->path = options.paths[m];
+    for (int s = 0; s < LOAD_STAGE_COUNT + 1; s++) {
+      double *seconds = calloc((size_t)options.iterations, sizeof(double));
+      if (seconds == NULL) {
+        status = E_OUT_OF_MEMORY;
+        break;
+      }
+
+      if (s < LOAD_STAGE_COUNT) {
+        result->seconds[s] = seconds;
+      } else {
+        result->totalSeconds = seconds;
+      }
+    }
+
+    if (status != E_OUT_OF_MEMORY) {
+      BenchModel(&options, upload, result);
+      if (result->failed) {
+        Log(LOG_ERROR, "cannot load model: %s", result->path);
+        status = E_CANNOT_LOAD_FILE;
+      }
+    }
+  }
+
+  if (status != E_OUT_OF_MEMORY && !WriteReport(&options, results, upload)) {
+    status = E_CANNOT_LOAD_FILE;
+  }
+
+  for (size_t m = 0; m < options.pathsCount; m++) {
+    for (int s = 0; s < LOAD_STAGE_COUNT; s++) {
+      free(results[m].seconds[s]);
+    }
+    free(results[m].totalSeconds);
+  }
+  free(results);
+  SetLoadJobPool(NULL);
+  DestroyJobPool(pool);
+
+  // AppClose only fails on system errors, failed loads fail the run too
+  int code = AppClose(status);
+  return status == SUCCESS ? code : 1;
+}
@@ -0,0 +1,425 @@
+// xmath Mat4 benchmark: checks that the vector kernels give the same bits
+// as the scalar formulas on random matrices and that inverses give back the
+// identity, then times both. Exits with an error on any mismatch.
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <xmath/mat4.h>
+
+#include "core.h"
+
+#define BENCH_DEFAULT_COUNT 4096
+#define BENCH_DEFAULT_ROUNDS 200
+#define BENCH_CHECK_CASES 100000
+#define BENCH_MAX_INVERSE_ERROR 1e-4f
+
+// Interleaved vertex, points are read with a stride like model meshes
+typedef struct {
+  Vec3 pos;
+  Vec3 nor;
+  Vec2 uvs;
+  Vec4 col;
+} BenchVertex;
+
+static uint32_t rngState = 0x12345678u;
+
+static float RandomFloat() {
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 17;
+  rngState ^= rngState << 5;
+
+  // Mixed magnitudes so that rounding differences would show
+  float unit = (float)(rngState >> 8) * (1.0f / 16777216.0f) * 2.0f - 1.0f;
+  float scales[4] = {1.0f, 1e-3f, 1e3f, 7.0f};
+  return unit * scales[rngState & 3];
+}
+
+static Mat4 RandomMat4() {
+  Mat4 m = Mat4Zero;
+  float *raw = Mat4Raw(&m);
+  for (int i = 0; i < 16; i++) {
+    raw[i] = RandomFloat();
+  }
+  return m;
+}
+
+// The scalar formulas the kernels replace
+static Mat4 RefMul(const Mat4 a, const Mat4 b) {
+  Mat4 r;
+  const float *x = &a.xx;
+  const float *y = &b.xx;
+  float *out = &r.xx;
+  for (int i = 0; i < 16; i += 4) {
+    for (int j = 0; j < 4; j++) {
+      out[i + j] = x[i] * y[j] + x[i + 1] * y[4 + j] + x[i + 2] * y[8 + j] +
+                   x[i + 3] * y[12 + j];
+    }
+  }
+  return r;
+}
+
+static Vec4 RefMulVec4(const Mat4 a, const Vec4 b) {
+  Vec4 r;
+  r.x = a.xx * b.x + a.xy * b.y + a.xz * b.z + a.xw * b.w;
+  r.y = a.yx * b.x + a.yy * b.y + a.yz * b.z + a.yw * b.w;
+  r.z = a.zx * b.x + a.zy * b.y + a.zz * b.z + a.zw * b.w;
+  r.w = a.wx * b.x + a.wy * b.y + a.wz * b.z + a.ww * b.w;
+  return r;
+}
+
+static Mat4 RefTranspose(const Mat4 m) {
+  Mat4 r;
+  const float *x = &m.xx;
+  float *out = &r.xx;
+  for (int i = 0; i < 4; i++) {
+    for (int j = 0; j < 4; j++) {
+      out[j * 4 + i] = x[i * 4 + j];
+    }
+  }
+  return r;
+}
+
+static Vec4 RefTransformPoint(const Mat4 m, Vec3 p) {
+  Vec4 r;
+  r.x = m.xx * p.x + m.yx * p.y + m.zx * p.z + m.wx;
+  r.y = m.xy * p.x + m.yy * p.y + m.zy * p.z + m.wy;
+  r.z = m.xz * p.x + m.yz * p.y + m.zz * p.z + m.wz;
+  r.w = m.xw * p.x + m.yw * p.y + m.zw * p.z + m.ww;
+  return r;
+}
+
+static Mat4 RefInverse(const Mat4 m) {
+  const float *a = &m.xx;
+  float s0 = a[0] * a[5] - a[4] * a[1];
+  float s1 = a[0] * a[6] - a[4] * a[2];
+  float s2 = a[0] * a[7] - a[4] * a[3];
+  float s3 = a[1] * a[6] - a[5] * a[2];
+  float s4 = a[1] * a[7] - a[5] * a[3];
+  float s5 = a[2] * a[7] - a[6] * a[3];
+  float c5 = a[10] * a[15] - a[14] * a[11];
+  float c4 = a[9] * a[15] - a[13] * a[11];
+  float c3 = a[9] * a[14] - a[13] * a[10];
+  float c2 = a[8] * a[15] - a[12] * a[11];
+  float c1 = a[8] * a[14] - a[12] * a[10];
+  float c0 = a[8] * a[13] - a[12] * a[9];
+  float inv =
+      1.0f / (s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0);
+
+  Mat4 r;
+  float *o = &r.xx;
+  o[0] = (a[5] * c5 - a[6] * c4 + a[7] * c3) * inv;
+  o[1] = (-a[1] * c5 + a[2] * c4 - a[3] * c3) * inv;
+  o[2] = (a[13] * s5 - a[14] * s4 + a[15] * s3) * inv;
+  o[3] = (-a[9] * s5 + a[10] * s4 - a[11] * s3) * inv;
+  o[4] = (-a[4] * c5 + a[6] * c2 - a[7] * c1) * inv;
+  o[5] = (a[0] * c5 - a[2] * c2 + a[3] * c1) * inv;
+  o[6] = (-a[12] * s5 + a[14] * s2 - a[15] * s1) * inv;
+  o[7] = (a[8] * s5 - a[10] * s2 + a[11] * s1) * inv;
+  o[8] = (a[4] * c4 - a[5] * c2 + a[7] * c0) * inv;
+  o[9] = (-a[0] * c4 + a[1] * c2 - a[3] * c0) * inv;
+  o[10] = (a[12] * s4 - a[13] * s2 + a[15] * s0) * inv;
+  o[11] = (-a[8] * s4 + a[9] * s2 - a[11] * s0) * inv;
+  o[12] = (-a[4] * c3 + a[5] * c1 - a[6] * c0) * inv;
+  o[13] = (a[0] * c3 - a[1] * c1 + a[2] * c0) * inv;
+  o[14] = (-a[12] * s3 + a[13] * s1 - a[14] * s0) * inv;
+  o[15] = (a[8] * s3 - a[9] * s1 + a[10] * s0) * inv;
+  return r;
+}
+
+// Random matrix far from singular, with a dominant diagonal
+static Mat4 RandomInvertible() {
+  Mat4 m = RandomMat4();
+  float *raw = Mat4Raw(&m);
+  for (int i = 0; i < 16; i++) {
+    raw[i] = fmodf(raw[i], 1.0f);
+  }
+  m.xx += 4.0f;
+  m.yy += 4.0f;
+  m.zz += 4.0f;
+  m.ww += 4.0f;
+  return m;
+}
+
+// Largest difference of m * inverse to the identity
+static float InverseError(const Mat4 m, const Mat4 inverse) {
+  Mat4 identity = Mat4Mul(m, inverse);
+  const float *x = Mat4Raw(&identity);
+  const float *y = Mat4Raw(&Mat4Identity);
+  float maxError = 0.0f;
+  for (int i = 0; i < 16; i++) {
+    maxError = fmaxf(maxError, fabsf(x[i] - y[i]));
+  }
+  return maxError;
+}
+
+static size_t mismatches = 0;
+
+static void Expect(const void *a, const void *b, size_t size,
+                   const char *what) {
+  if (memcmp(a, b, size) != 0) {
+    if (mismatches < 10) {
+      Log(LOG_ERROR, "%s differs from the scalar result", what);
+    }
+    mismatches++;
+  }
+}
+
+static void CheckExact() {
+  for (int i = 0; i < BENCH_CHECK_CASES; i++) {
+    Mat4 a = RandomMat4();
+    Mat4 b = RandomMat4();
+    Vec4 v = {RandomFloat(), RandomFloat(), RandomFloat(), RandomFloat()};
+    Vec3 p = {v.x, v.y, v.z};
+
+    Mat4 expected = RefMul(a, b);
+    Mat4 r = Mat4Mul(a, b);
+    Expect(&r, &expected, sizeof(Mat4), "Mat4Mul");
+
+    Mat4MulInto(&r, &a, &b);
+    Expect(&r, &expected, sizeof(Mat4), "Mat4MulInto");
+
+    // Results written over either operand
+    Mat4 left = a;
+    Mat4MulInto(&left, &left, &b);
+    Expect(&left, &expected, sizeof(Mat4), "Mat4MulInto (r = a)");
+    Mat4 right = b;
+    Mat4MulInto(&right, &a, &right);
+    Expect(&right, &expected, sizeof(Mat4), "Mat4MulInto (r = b)");
+
+    Mat4MulArray(&r, &a, &b, 1);
+    Expect(&r, &expected, sizeof(Mat4), "Mat4MulArray");
+
+    Vec4 mv = Mat4MulVec4(a, v);
+    Vec4 mvExpected = RefMulVec4(a, v);
+    Expect(&mv, &mvExpected, sizeof(Vec4), "Mat4MulVec4");
+
+    Mat4 t = Mat4Transpose(a);
+    Mat4 tExpected = RefTranspose(a);
+    Expect(&t, &tExpected, sizeof(Mat4), "Mat4Transpose");
+
+    BenchVertex vertex = {.pos = p};
+    Vec4 tp;
+    Mat4TransformPoints(&tp, &a, &vertex.pos, sizeof(BenchVertex), 1);
+    Vec4 tpExpected = RefTransformPoint(a, p);
+    Expect(&tp, &tpExpected, sizeof(Vec4), "Mat4TransformPoints");
+  }
+}
+
+// Inverses are not exact, they are checked against the identity instead
+static float CheckInverse() {
+  float maxError = 0.0f;
+  for (int i = 0; i < BENCH_CHECK_CASES; i++) {
+    Mat4 m = RandomInvertible();
+    maxError = fmaxf(maxError, InverseError(m, Mat4Inverse(m)));
+
+    Vec3 axis = {RandomFloat(), RandomFloat(), RandomFloat()};
+    Vec3 origin = {RandomFloat(), RandomFloat(), RandomFloat()};
+    Mat4 rigid = Mat4Mul(Mat4MakeRotation(axis, RandomFloat()),
+                         Mat4MakeTranslation(origin));
+
+    // Translations reach 1e3, errors grow with them
+    float scale = fmaxf(1.0f, Vec3Len(origin));
+    maxError =
+        fmaxf(maxError, InverseError(rigid, Mat4InverseRigid(rigid)) / scale);
+  }
+
+  if (maxError > BENCH_MAX_INVERSE_ERROR) {
+    Log(LOG_ERROR, "inverses are off by %g", maxError);
+  }
+  return maxError;
+}
+
+// Keeps the results alive so that no loop is optimized away
+static volatile float sink;
+
+// The references are called through pointers so that, like the xmath
+// functions, they are not inlined into the timed loops
+static Mat4 (*volatile refMul)(const Mat4, const Mat4) = RefMul;
+static Vec4 (*volatile refMulVec4)(const Mat4, const Vec4) = RefMulVec4;
+static Mat4 (*volatile refTranspose)(const Mat4) = RefTranspose;
+static Mat4 (*volatile refInverse)(const Mat4) = RefInverse;
+
+static void PrintTime(const char *name, double scalarSeconds,
+                      double vectorSeconds, double ops) {
+  printf("%-22s %8.2f ns %8.2f ns %6.2fx\n", name, scalarSeconds * 1e9 / ops,
+         vectorSeconds * 1e9 / ops, scalarSeconds / vectorSeconds);
+}
+
+static void PrintUsage(const char *program) {
+  fprintf(stderr, "usage: %s [-n count] [-r rounds]\n", program);
+}
+
+int main(int argc, char **argv) {
+  size_t count = BENCH_DEFAULT_COUNT;
+  int rounds = BENCH_DEFAULT_ROUNDS;
+  for (int i = 1; i < argc; i++) {
+    if (i + 1 >= argc) {
+      PrintUsage(argv[0]);
+      return 1;
+    }
+
+    if (strcmp(argv[i], "-n") == 0) {
+      count = (size_t)atol(argv[++i]);
+    } else if (strcmp(argv[i], "-r") == 0) {
+      rounds = atoi(argv[++i]);
+    } else {
+      PrintUsage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (count == 0 || rounds <= 0) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  CheckExact();
+  printf("exactness: %d cases, %zu mismatches\n", BENCH_CHECK_CASES,
+         mismatches);
+  float inverseError = CheckInverse();
+  printf("inverses:  %d cases, max error %g (limit %g)\n", BENCH_CHECK_CASES,
+         inverseError, BENCH_MAX_INVERSE_ERROR);
+
+  Mat4 *a = malloc(count * sizeof(Mat4));
+  Mat4 *b = malloc(count * sizeof(Mat4));
+  Mat4 *r = malloc(count * sizeof(Mat4));
+  BenchVertex *vertices = malloc(count * sizeof(BenchVertex));
+  Vec4 *points = malloc(count * sizeof(Vec4));
+  if (a == NULL || b == NULL || r == NULL || vertices == NULL ||
+      points == NULL) {
+    Log(LOG_ERROR, "cannot setup benchmark (out of memory)");
+    return 1;
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    a[i] = RandomInvertible();
+    b[i] = RandomMat4();
+    vertices[i] = (BenchVertex){.pos = {RandomFloat(), RandomFloat(),
+                                        RandomFloat()}};
+  }
+
+  double ops = (double)count * rounds;
+  printf("%-22s %11s %11s %7s\n", "per operation", "scalar", "xmath",
+         "speedup");
+
+  double start = GetTime();
+  for (int k = 0; k < rounds; k++) {
+    for (size_t i = 0; i < count; i++) {
+      r[i] = refMul(a[i], b[i]);
+    }
+    sink = r[k % count].xx;
+  }
+  double scalar = GetTime() - start;
+  start = GetTime();
+  for (int k = 0; k < rounds; k++) {
+    for (size_t i = 0; i < count; i++) {
+      r[i] = Mat4Mul(a[i], b[i]);
+    }
+    sink = r[k % count].xx;
+  }
+  PrintTime("Mat4Mul", scalar, GetTime() - start, ops);
+
+  start = GetTime();
+  for (int k = 0; k < rounds; k++) {
+    for (size_t i = 0; i < count; i++) {
+      Mat4MulInto(r + i, a + i, b + i);
+    }
+    sink = r[k % count].xx;
+  }
+  PrintTime("Mat4MulInto", scalar, GetTime() - start, ops);
+
+  start = GetTime();
+  for (int k = 0; k < rounds; k++) {
+    Mat4MulArray(r, a, b, count);
+    sink = r[k % count].xx;
+  }
+  PrintTime("Mat4MulArray", scalar, GetTime() - start, ops);
+
+  start = GetTime();
+  for (int k = 0; k < rounds; k++) {
+    for (size_t i = 0; i < count; i++) {
+      Vec4 v = {vertices[i].pos.x, vertices[i].pos.y, vertices[i].pos.z, 1};
+      points[i] = refMulVec4(a[i], v);
+    }
+    sink = points[k % count].x;
+  }
+  scalar = GetTime() - start;
+  start = GetTime();
+  for (int k = 0; k < rounds; k++) {
+    for (size_t i = 0; i < count; i++) {
+      Vec4 v = {vertices[i].pos.x, vertices[i].pos.y, vertices[i].pos.z, 1};
+      points[i] = Mat4MulVec4(a[i], v);
+    }
+    sink = points[k % count].x;
+  }
+  PrintTime("Mat4MulVec4", scalar, GetTime() - start, ops);
+
+  start = GetTime();
+  for (int k = 0; k < rounds; k++) {
+    for (size_t i = 0; i < count; i++) {
+      r[i] = refTranspose(a[i]);
+    }
+    sink = r[k % count].xy;
+  }
+  scalar = GetTime() - start;
+  start = GetTime();
+  for (int k = 0; k < rounds; k++) {
+    for (size_t i = 0; i < count; i++) {
+      r[i] = Mat4Transpose(a[i]);
+    }
+    sink = r[k % count].xy;
+  }
+  PrintTime("Mat4Transpose", scalar, GetTime() - start, ops);
+
+  start = GetTime();
+  for (int k = 0; k < rounds; k++) {
+    for (size_t i = 0; i < count; i++) {
+      r[i] = refInverse(a[i]);
+    }
+    sink = r[k % count].xy;
+  }
+  scalar = GetTime() - start;
+  start = GetTime();
+  for (int k = 0; k < rounds; k++) {
+    for (size_t i = 0; i < count; i++) {
+      r[i] = Mat4Inverse(a[i]);
+    }
+    sink = r[k % count].xy;
+  }
+  PrintTime("Mat4Inverse", scalar, GetTime() - start, ops);
+
+  start = GetTime();
+  for (int k = 0; k < rounds; k++) {
+    for (size_t i = 0; i < count; i++) {
+      r[i] = Mat4InverseRigid(a[i]);
+    }
+    sink = r[k % count].xy;
+  }
+  PrintTime("Mat4InverseRigid", scalar, GetTime() - start, ops);
+
+  // Points of interleaved vertices through a single matrix
+  start = GetTime();
+  for (int k = 0; k < rounds; k++) {
+    for (size_t i = 0; i < count; i++) {
+      points[i] = RefTransformPoint(a[k % count], vertices[i].pos);
+    }
+    sink = points[k % count].x;
+  }
+  scalar = GetTime() - start;
+  start = GetTime();
+  for (int k = 0; k < rounds; k++) {
+    Mat4TransformPoints(points, a + k % count, &vertices[0].pos,
+                        sizeof(BenchVertex), count);
+    sink = points[k % count].x;
+  }
+  PrintTime("Mat4TransformPoints", scalar, GetTime() - start, ops);
+
+  free(a);
+  free(b);
+  free(r);
+  free(vertices);
+  free(points);
+  return mismatches == 0 && inverseError <= BENCH_MAX_INVERSE_ERROR ? 0 : 1;
+}
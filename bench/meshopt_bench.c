@@ -0,0 +1,764 @@
+// Meshopt decoding benchmark: encodes the vertices and triangles of a UV
+// sphere with the EXT_meshopt_compression codecs, as full vertices and as
+// quantized ones, split in views of tens of thousands of vertices like the
+// meshes of a file. Decodes every kind of view on the calling thread and all
+// the views across a pool, and reports the decoded bytes per second. Checks
+// that lossless views give back the same vertices and triangles and that the
+// filters stay within the error of their quantization. Exits with an error
+// when a check fails.
+#include <math.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "core.h"
+#include "jobs.h"
+#include "meshopt.h"
+#include "shapes.h"
+
+#define BENCH_DEFAULT_SEGMENTS 1000
+#define BENCH_DEFAULT_ROUNDS 5
+#define BENCH_DEFAULT_VIEW_VERTICES 65536
+
+// Largest errors allowed for the lossy filters, normals are 8 bit
+#define BENCH_MAX_NORMAL_DEGREES 2.0f
+#define BENCH_MAX_EXPONENTIAL_ERROR 1e-6f
+#define BENCH_MIN_QUATERNION_DOT 0.9999f
+
+// Quantized vertex of the sphere, normals go through the octahedral filter
+typedef struct {
+  int16_t pos[4];
+  int8_t nor[4];
+  uint16_t uvs[2];
+} QuantizedVertex;
+
+typedef enum {
+  VIEW_KIND_VERTICES,
+  VIEW_KIND_QUANTIZED,
+  VIEW_KIND_TRIANGLES,
+  VIEW_KIND_INDICES,
+  VIEW_KIND_COUNT,
+} ViewKind;
+
+static const char *viewKindNames[VIEW_KIND_COUNT] = {
+    [VIEW_KIND_VERTICES] = "vertices",
+    [VIEW_KIND_QUANTIZED] = "quantized",
+    [VIEW_KIND_TRIANGLES] = "triangles",
+    [VIEW_KIND_INDICES] = "indices",
+};
+
+typedef struct {
+  ViewKind kind;
+  const uint8_t *expected;
+  uint8_t *encoded;
+  size_t size;
+  uint8_t *decoded;
+  size_t count;
+  size_t stride;
+  MeshoptMode mode;
+  MeshoptFilter filter;
+} BenchView;
+
+typedef struct {
+  BenchView *views;
+  atomic_bool failed;
+} BenchViews;
+
+// Encoders, written after the reference ones so that the decoder is fed the
+// same streams real files have. Only the benchmark needs them.
+
+static size_t GetBlockVertices(size_t stride) {
+  size_t count = (8192 / stride) & ~(size_t)15;
+  return count < 256 ? count : 256;
+}
+
+static uint8_t Zigzag8(uint8_t v) {
+  return (uint8_t)(((int8_t)v >> 7) ^ (v << 1));
+}
+
+// Bytes a group of 16 values takes packed with bits each, SIZE_MAX when it
+// cannot be
+static size_t MeasureGroup(const uint8_t *group, int bits) {
+  if (bits == 0) {
+    for (int i = 0; i < 16; i++) {
+      if (group[i] != 0) {
+        return SIZE_MAX;
+      }
+    }
+    return 0;
+  }
+
+  if (bits == 8) {
+    return 16;
+  }
+
+  unsigned sentinel = (1u << bits) - 1;
+  size_t size = (size_t)bits * 2;
+  for (int i = 0; i < 16; i++) {
+    size += group[i] >= sentinel;
+  }
+  return size;
+}
+
+static uint8_t *EncodeGroup(uint8_t *dst, const uint8_t *group, int bits) {
+  if (bits == 0) {
+    return dst;
+  }
+
+  if (bits == 8) {
+    memcpy(dst, group, 16);
+    return dst + 16;
+  }
+
+  unsigned sentinel = (1u << bits) - 1;
+  uint8_t *escapes = dst + bits * 2;
+  memset(dst, 0, (size_t)bits * 2);
+  for (int i = 0; i < 16; i++) {
+    unsigned v = group[i] >= sentinel ? sentinel : group[i];
+    dst[i * bits / 8] |= (uint8_t)(v << (8 - bits - (i * bits) % 8));
+    if (group[i] >= sentinel) {
+      *escapes++ = group[i];
+    }
+  }
+  return escapes;
+}
+
+static uint8_t *EncodeBytes(uint8_t *dst, const uint8_t *values, size_t size) {
+  static const int groupBits[4] = {0, 2, 4, 8};
+  size_t groups = size / 16;
+  uint8_t *header = dst;
+  memset(header, 0, (groups + 3) / 4);
+  dst += (groups + 3) / 4;
+  for (size_t g = 0; g < groups; g++) {
+    const uint8_t *group = values + g * 16;
+    int best = 3;
+    size_t bestSize = MeasureGroup(group, 8);
+    for (int b = 0; b < 3; b++) {
+      size_t size = MeasureGroup(group, groupBits[b]);
+      if (size < bestSize) {
+        best = b;
+        bestSize = size;
+      }
+    }
+
+    header[g / 4] |= (uint8_t)(best << ((g % 4) * 2));
+    dst = EncodeGroup(dst, group, groupBits[best]);
+  }
+  return dst;
+}
+
+static size_t GetVerticesBound(size_t count, size_t stride) {
+  size_t block = GetBlockVertices(stride);
+  size_t blocks = (count + block - 1) / block;
+  return 1 + blocks * stride * (block + block / 64 + 1) +
+         (stride < 32 ? 32 : stride);
+}
+
+static size_t EncodeVertices(uint8_t *dst, const uint8_t *vertices,
+                             size_t count, size_t stride) {
+  uint8_t *out = dst;
+  *out++ = 0xA0;
+
+  uint8_t first[256] = {0};
+  uint8_t last[256];
+  if (count > 0) {
+    memcpy(first, vertices, stride);
+  }
+  memcpy(last, first, stride);
+
+  size_t block = GetBlockVertices(stride);
+  uint8_t deltas[256];
+  for (size_t start = 0; start < count; start += block) {
+    size_t n = count - start < block ? count - start : block;
+    size_t aligned = (n + 15) & ~(size_t)15;
+    const uint8_t *v = vertices + start * stride;
+    for (size_t k = 0; k < stride; k++) {
+      memset(deltas, 0, aligned);
+      uint8_t p = last[k];
+      for (size_t i = 0; i < n; i++) {
+        deltas[i] = Zigzag8((uint8_t)(v[i * stride + k] - p));
+        p = v[i * stride + k];
+      }
+      out = EncodeBytes(out, deltas, aligned);
+    }
+    memcpy(last, v + (n - 1) * stride, stride);
+  }
+
+  size_t tail = stride < 32 ? 32 : stride;
+  memset(out, 0, tail - stride);
+  out += tail - stride;
+  memcpy(out, first, stride);
+  return (size_t)(out + stride - dst);
+}
+
+static void EncodeVByte(uint8_t **dst, uint32_t v) {
+  do {
+    *(*dst)++ = (uint8_t)((v & 127) | (v > 127 ? 128 : 0));
+    v >>= 7;
+  } while (v != 0);
+}
+
+static void EncodeIndex(uint8_t **dst, uint32_t index, uint32_t last) {
+  uint32_t d = index - last;
+  EncodeVByte(dst, (d << 1) ^ (uint32_t)((int32_t)d >> 31));
+}
+
+static int FindEdge(uint32_t (*edges)[2], size_t offset, uint32_t a,
+                    uint32_t b, uint32_t c) {
+  for (int i = 0; i < 16; i++) {
+    size_t e = (offset - 1 - (size_t)i) & 15;
+    if (edges[e][0] == a && edges[e][1] == b) {
+      return i << 2;
+    }
+    if (edges[e][0] == b && edges[e][1] == c) {
+      return (i << 2) | 1;
+    }
+    if (edges[e][0] == c && edges[e][1] == a) {
+      return (i << 2) | 2;
+    }
+  }
+  return -1;
+}
+
+static int FindVertex(const uint32_t *vertices, size_t offset, uint32_t v) {
+  for (int i = 0; i < 16; i++) {
+    if (vertices[(offset - 1 - (size_t)i) & 15] == v) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static void PushEdge(uint32_t (*edges)[2], size_t *offset, uint32_t a,
+                     uint32_t b) {
+  edges[*offset][0] = a;
+  edges[*offset][1] = b;
+  *offset = (*offset + 1) & 15;
+}
+
+static void PushVertex(uint32_t *vertices, size_t *offset, uint32_t v) {
+  vertices[*offset] = v;
+  *offset = (*offset + 1) & 15;
+}
+
+static size_t GetTrianglesBound(size_t count) {
+  return 1 + count / 3 * 17 + 16;
+}
+
+static size_t EncodeTriangles(uint8_t *dst, const uint32_t *indices,
+                              size_t count) {
+  static const uint8_t codeTable[16] = {0x00, 0x76, 0x87, 0x56, 0x67, 0x78,
+                                        0xA9, 0x86, 0x65, 0x89, 0x68, 0x98,
+                                        0x01, 0x69, 0x00, 0x00};
+  static const int rotations[3][3] = {{0, 1, 2}, {1, 2, 0}, {2, 0, 1}};
+  uint32_t edges[16][2];
+  uint32_t vertices[16];
+  memset(edges, 0xFF, sizeof(edges));
+  memset(vertices, 0xFF, sizeof(vertices));
+  size_t edgesOffset = 0;
+  size_t verticesOffset = 0;
+  uint32_t next = 0;
+  uint32_t last = 0;
+
+  dst[0] = 0xE1;
+  uint8_t *code = dst + 1;
+  uint8_t *data = code + count / 3;
+  for (size_t i = 0; i < count; i += 3) {
+    const uint32_t *t = indices + i;
+    int edge = FindEdge(edges, edgesOffset, t[0], t[1], t[2]);
+    if (edge >= 0 && (edge >> 2) < 15) {
+      const int *order = rotations[edge & 3];
+      uint32_t a = t[order[0]];
+      uint32_t b = t[order[1]];
+      uint32_t c = t[order[2]];
+      int fc = FindVertex(vertices, verticesOffset, c);
+      int fec = fc >= 1 && fc < 13 ? fc : c == next ? (next++, 0) : 15;
+      if (fec == 15 && c + 1 == last) {
+        fec = 13;
+        last = c;
+      }
+      if (fec == 15 && c == last + 1) {
+        fec = 14;
+        last = c;
+      }
+
+      *code++ = (uint8_t)(((edge >> 2) << 4) | fec);
+      if (fec == 15) {
+        EncodeIndex(&data, c, last);
+        last = c;
+      }
+      if (fec == 0 || fec >= 13) {
+        PushVertex(vertices, &verticesOffset, c);
+      }
+      PushEdge(edges, &edgesOffset, c, b);
+      PushEdge(edges, &edgesOffset, a, c);
+      continue;
+    }
+
+    int rotation = t[1] == next ? 1 : t[2] == next ? 2 : 0;
+    const int *order = rotations[rotation];
+    uint32_t a = t[order[0]];
+    uint32_t b = t[order[1]];
+    uint32_t c = t[order[2]];
+    bool reset = a == 0 && b == 1 && c == 2 && next > 0;
+    if (reset) {
+      next = 0;
+      memset(vertices, 0xFF, sizeof(vertices));
+    }
+
+    int fb = FindVertex(vertices, verticesOffset, b);
+    int fc = FindVertex(vertices, verticesOffset, c);
+    int fea = a == next ? (next++, 0) : 15;
+    int feb = fb >= 0 && fb < 14 ? fb + 1 : b == next ? (next++, 0) : 15;
+    int fec = fc >= 0 && fc < 14 ? fc + 1 : c == next ? (next++, 0) : 15;
+    uint8_t codeAux = (uint8_t)((feb << 4) | fec);
+    int tableIndex = -1;
+    for (int k = 0; k < 14 && tableIndex < 0; k++) {
+      tableIndex = codeTable[k] == codeAux ? k : -1;
+    }
+
+    if (fea == 0 && tableIndex >= 0 && !reset) {
+      *code++ = (uint8_t)(0xF0 | tableIndex);
+    } else {
+      *code++ = (uint8_t)(0xF0 | 14 | (fea == 15));
+      *data++ = codeAux;
+    }
+
+    if (fea == 15) {
+      EncodeIndex(&data, a, last);
+      last = a;
+    }
+    if (feb == 15) {
+      EncodeIndex(&data, b, last);
+      last = b;
+    }
+    if (fec == 15) {
+      EncodeIndex(&data, c, last);
+      last = c;
+    }
+
+    if (fea == 0 || fea == 15) {
+      PushVertex(vertices, &verticesOffset, a);
+    }
+    if (feb == 0 || feb == 15) {
+      PushVertex(vertices, &verticesOffset, b);
+    }
+    if (fec == 0 || fec == 15) {
+      PushVertex(vertices, &verticesOffset, c);
+    }
+    PushEdge(edges, &edgesOffset, b, a);
+    PushEdge(edges, &edgesOffset, c, b);
+    PushEdge(edges, &edgesOffset, a, c);
+  }
+
+  memcpy(data, codeTable, 16);
+  return (size_t)(data + 16 - dst);
+}
+
+static size_t GetIndicesBound(size_t count) { return 1 + count * 5 + 4; }
+
+static size_t EncodeIndices(uint8_t *dst, const uint32_t *indices,
+                            size_t count) {
+  uint8_t *data = dst;
+  *data++ = 0xD1;
+  uint32_t last[2] = {0, 0};
+  uint32_t baseline = 0;
+  for (size_t i = 0; i < count; i++) {
+    int32_t delta = (int32_t)(indices[i] - last[baseline]);
+    baseline ^= (delta < 0 ? -delta : delta) >= 30;
+    uint32_t d = indices[i] - last[baseline];
+    uint32_t v = (d << 1) ^ (uint32_t)((int32_t)d >> 31);
+    EncodeVByte(&data, (v << 1) | baseline);
+    last[baseline] = indices[i];
+  }
+
+  memset(data, 0, 4);
+  return (size_t)(data + 4 - dst);
+}
+
+static int QuantizeSnorm(float v, int bits) {
+  float scale = (float)((1 << (bits - 1)) - 1);
+  v = fmaxf(-1.0f, fminf(1.0f, v));
+  return (int)(v * scale + (v >= 0.0f ? 0.5f : -0.5f));
+}
+
+// Unit vector folded onto the octahedron, z holds the value of one
+static void EncodeOctahedral(int8_t *dst, Vec3 n) {
+  float l = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+  float s = l > 0.0f ? 1.0f / l : 0.0f;
+  float x = n.x * s;
+  float y = n.y * s;
+  float u = n.z >= 0.0f ? x : (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+  float v = n.z >= 0.0f ? y : (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+  dst[0] = (int8_t)QuantizeSnorm(u, 8);
+  dst[1] = (int8_t)QuantizeSnorm(v, 8);
+  dst[2] = (int8_t)QuantizeSnorm(1.0f, 8);
+  dst[3] = 0;
+}
+
+static void EncodeQuaternion(int16_t *dst, const float *q) {
+  int largest = 0;
+  for (int k = 1; k < 4; k++) {
+    largest = fabsf(q[k]) > fabsf(q[largest]) ? k : largest;
+  }
+
+  float scale = sqrtf(2.0f) * (q[largest] < 0.0f ? -1.0f : 1.0f);
+  for (int k = 0; k < 3; k++) {
+    dst[k] = (int16_t)QuantizeSnorm(q[(largest + 1 + k) & 3] * scale, 16);
+  }
+  dst[3] = (int16_t)((QuantizeSnorm(1.0f, 16) & ~3) | largest);
+}
+
+static uint32_t EncodeExponential(float v) {
+  int exponent;
+  float fraction = frexpf(v, &exponent);
+  int32_t mantissa = (int32_t)lrintf(ldexpf(fraction, 22));
+  return ((uint32_t)(exponent - 22) << 24) | ((uint32_t)mantissa & 0xFFFFFF);
+}
+
+static float AngleDegrees(Vec3 a, Vec3 b) {
+  float c = Vec3Dot(Vec3Norm(a), Vec3Norm(b));
+  return acosf(fmaxf(-1.0f, fminf(1.0f, c))) * (180.0f / 3.14159265f);
+}
+
+// The triangle codec keeps the winding of every triangle but may rotate it
+static bool SameTriangles(const uint32_t *expected, const uint32_t *decoded,
+                          size_t count) {
+  for (size_t i = 0; i < count; i += 3) {
+    const uint32_t *e = expected + i;
+    const uint32_t *d = decoded + i;
+    int r = d[0] == e[0] ? 0 : d[0] == e[1] ? 1 : 2;
+    if (d[0] != e[r] || d[1] != e[(r + 1) % 3] || d[2] != e[(r + 2) % 3]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void DecodeViewJob(void *data, size_t index) {
+  BenchViews *views = data;
+  BenchView *view = views->views + index;
+  if (MeshoptDecode(view->decoded, view->count, view->stride, view->encoded,
+                    view->size, view->mode, view->filter) != SUCCESS) {
+    atomic_store(&views->failed, true);
+  }
+}
+
+static void PrintUsage(const char *program) {
+  fprintf(stderr,
+          "usage: %s [-s segments] [-n rounds] [-j threads] "
+          "[-v vertices per view]\n",
+          program);
+}
+
+int main(int argc, char **argv) {
+  int segments = BENCH_DEFAULT_SEGMENTS;
+  int rounds = BENCH_DEFAULT_ROUNDS;
+  int threads = (int)GetProcessorsCount() - 1;
+  size_t viewVertices = BENCH_DEFAULT_VIEW_VERTICES;
+  for (int i = 1; i < argc; i++) {
+    if (i + 1 >= argc) {
+      PrintUsage(argv[0]);
+      return 1;
+    }
+
+    if (strcmp(argv[i], "-s") == 0) {
+      segments = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-n") == 0) {
+      rounds = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-j") == 0) {
+      threads = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-v") == 0) {
+      viewVertices = (size_t)atol(argv[++i]);
+    } else {
+      PrintUsage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (segments < 4 || rounds <= 0 || threads < 0 || viewVertices == 0) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  JobPool *pool = MakeJobPool((size_t)threads);
+  Model sphere = MakeSphere(segments);
+  if (pool == NULL || sphere.status != SUCCESS) {
+    Log(LOG_ERROR, "cannot setup benchmark (out of memory)");
+    return 1;
+  }
+
+  // Views hold viewVertices vertices, or the triangles of as many quads
+  Mesh *mesh = sphere.meshes;
+  size_t verticesCount = mesh->verticesCount;
+  size_t indicesCount = mesh->indicesCount;
+  size_t vertexViews = (verticesCount + viewVertices - 1) / viewVertices;
+  size_t viewIndices = viewVertices * 6;
+  size_t indexViews = (indicesCount + viewIndices - 1) / viewIndices;
+  size_t viewsCount = vertexViews * 2 + indexViews * 2;
+
+  QuantizedVertex *quantized = calloc(verticesCount, sizeof(QuantizedVertex));
+  BenchView *views = calloc(viewsCount, sizeof(BenchView));
+  if (quantized == NULL || views == NULL) {
+    Log(LOG_ERROR, "cannot setup benchmark (out of memory)");
+    return 1;
+  }
+
+  for (size_t i = 0; i < verticesCount; i++) {
+    Vertex *v = mesh->vertices + i;
+    v->uvs = (Vec2){(float)(i % (size_t)segments) / (float)segments,
+                    (float)(i / (size_t)segments) / (float)segments};
+
+    QuantizedVertex *q = quantized + i;
+    q->pos[0] = (int16_t)QuantizeSnorm(v->pos.x, 16);
+    q->pos[1] = (int16_t)QuantizeSnorm(v->pos.y, 16);
+    q->pos[2] = (int16_t)QuantizeSnorm(v->pos.z, 16);
+    EncodeOctahedral(q->nor, v->nor);
+    q->uvs[0] = (uint16_t)lrintf(v->uvs.x * 65535.0f);
+    q->uvs[1] = (uint16_t)lrintf(v->uvs.y * 65535.0f);
+  }
+
+  size_t n = 0;
+  for (size_t first = 0; first < verticesCount; first += viewVertices) {
+    size_t count = verticesCount - first < viewVertices
+                       ? verticesCount - first
+                       : viewVertices;
+    views[n++] = (BenchView){VIEW_KIND_VERTICES,
+                             (const uint8_t *)(mesh->vertices + first),
+                             NULL,
+                             0,
+                             NULL,
+                             count,
+                             sizeof(Vertex),
+                             MESHOPT_MODE_ATTRIBUTES,
+                             MESHOPT_FILTER_NONE};
+    views[n++] = (BenchView){VIEW_KIND_QUANTIZED,
+                             (const uint8_t *)(quantized + first),
+                             NULL,
+                             0,
+                             NULL,
+                             count,
+                             sizeof(QuantizedVertex),
+                             MESHOPT_MODE_ATTRIBUTES,
+                             MESHOPT_FILTER_NONE};
+  }
+
+  const uint32_t *indices = mesh->indices;
+  for (size_t first = 0; first < indicesCount; first += viewIndices) {
+    size_t count = indicesCount - first < viewIndices ? indicesCount - first
+                                                      : viewIndices;
+    views[n++] = (BenchView){VIEW_KIND_TRIANGLES,
+                             (const uint8_t *)(indices + first),
+                             NULL,
+                             0,
+                             NULL,
+                             count,
+                             sizeof(uint32_t),
+                             MESHOPT_MODE_TRIANGLES,
+                             MESHOPT_FILTER_NONE};
+    views[n++] = (BenchView){VIEW_KIND_INDICES,
+                             (const uint8_t *)(indices + first),
+                             NULL,
+                             0,
+                             NULL,
+                             count,
+                             sizeof(uint32_t),
+                             MESHOPT_MODE_INDICES,
+                             MESHOPT_FILTER_NONE};
+  }
+
+  size_t decodedBytes[VIEW_KIND_COUNT] = {0};
+  size_t encodedBytes[VIEW_KIND_COUNT] = {0};
+  for (size_t i = 0; i < viewsCount; i++) {
+    BenchView *view = views + i;
+    size_t bound = view->mode == MESHOPT_MODE_ATTRIBUTES
+                       ? GetVerticesBound(view->count, view->stride)
+                   : view->mode == MESHOPT_MODE_TRIANGLES
+                       ? GetTrianglesBound(view->count)
+                       : GetIndicesBound(view->count);
+    view->encoded = malloc(bound);
+    view->decoded = malloc(view->count * view->stride);
+    if (view->encoded == NULL || view->decoded == NULL) {
+      Log(LOG_ERROR, "cannot setup benchmark (out of memory)");
+      return 1;
+    }
+
+    if (view->mode == MESHOPT_MODE_ATTRIBUTES) {
+      view->size = EncodeVertices(view->encoded, view->expected, view->count,
+                                  view->stride);
+    } else if (view->mode == MESHOPT_MODE_TRIANGLES) {
+      view->size = EncodeTriangles(view->encoded,
+                                   (const uint32_t *)view->expected,
+                                   view->count);
+    } else {
+      view->size = EncodeIndices(view->encoded,
+                                 (const uint32_t *)view->expected,
+                                 view->count);
+    }
+
+    decodedBytes[view->kind] += view->count * view->stride;
+    encodedBytes[view->kind] += view->size;
+  }
+
+  printf("sphere:    %zu vertices, %zu triangles in %zu views\n",
+         verticesCount, indicesCount / 3, viewsCount);
+
+  // Every kind alone on the calling thread
+  bool failed = false;
+  size_t totalBytes = 0;
+  for (int kind = 0; kind < VIEW_KIND_COUNT; kind++) {
+    double best = 1e30;
+    for (int round = 0; round < rounds; round++) {
+      double start = GetTime();
+      for (size_t i = 0; i < viewsCount; i++) {
+        BenchView *view = views + i;
+        if (view->kind == (ViewKind)kind &&
+            MeshoptDecode(view->decoded, view->count, view->stride,
+                          view->encoded, view->size, view->mode,
+                          view->filter) != SUCCESS) {
+          failed = true;
+        }
+      }
+      best = fmin(best, GetTime() - start);
+    }
+
+    totalBytes += decodedBytes[kind];
+    printf("%-10s %6.2f MB to %6.2f MB (%4.1f%%) %8.2f ms %6.2f GB/s\n",
+           viewKindNames[kind], (double)decodedBytes[kind] * 1e-6,
+           (double)encodedBytes[kind] * 1e-6,
+           100.0 * (double)encodedBytes[kind] / (double)decodedBytes[kind],
+           best * 1000.0, (double)decodedBytes[kind] / best * 1e-9);
+  }
+
+  // All the views across the pool, as a loaded file does, from cleared
+  // outputs so that the checks below see what the pool decoded
+  for (size_t i = 0; i < viewsCount; i++) {
+    memset(views[i].decoded, 0, views[i].count * views[i].stride);
+  }
+
+  BenchViews all = {views};
+  atomic_init(&all.failed, false);
+  double best = 1e30;
+  for (int round = 0; round < rounds; round++) {
+    double start = GetTime();
+    JobPoolParallelFor(pool, viewsCount, DecodeViewJob, &all);
+    best = fmin(best, GetTime() - start);
+  }
+  printf("%-10s %zu threads %8.2f ms %6.2f GB/s\n", "all",
+         pool->threadsCount + 1, best * 1000.0,
+         (double)totalBytes / best * 1e-9);
+  failed = failed || atomic_load(&all.failed);
+
+  size_t mismatches = 0;
+  for (size_t i = 0; i < viewsCount; i++) {
+    const BenchView *view = views + i;
+    if (view->kind == VIEW_KIND_TRIANGLES) {
+      mismatches += !SameTriangles((const uint32_t *)view->expected,
+                                   (const uint32_t *)view->decoded,
+                                   view->count);
+    } else {
+      mismatches += memcmp(view->expected, view->decoded,
+                           view->count * view->stride) != 0;
+    }
+  }
+
+  // Filters over copies of the quantized vertices: octahedral normals,
+  // exponential positions and quaternions of random rotations
+  float normalError = 0.0f;
+  float exponentialError = 0.0f;
+  float quaternionDot = 1.0f;
+  size_t count = verticesCount < viewVertices ? verticesCount : viewVertices;
+  int8_t *normals = malloc(count * 4);
+  uint32_t *floats = malloc(count * 3 * sizeof(uint32_t));
+  int16_t *rotations = malloc(count * 4 * sizeof(int16_t));
+  float *expected = malloc(count * 4 * sizeof(float));
+  uint8_t *encoded = malloc(GetVerticesBound(count, 12));
+  if (normals == NULL || floats == NULL || rotations == NULL ||
+      expected == NULL || encoded == NULL) {
+    Log(LOG_ERROR, "cannot setup benchmark (out of memory)");
+    return 1;
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    memcpy(normals + i * 4, quantized[i].nor, 4);
+  }
+  size_t size = EncodeVertices(encoded, (const uint8_t *)normals, count, 4);
+  failed = failed ||
+           MeshoptDecode(normals, count, 4, encoded, size,
+                         MESHOPT_MODE_ATTRIBUTES,
+                         MESHOPT_FILTER_OCTAHEDRAL) != SUCCESS;
+  for (size_t i = 0; i < count; i++) {
+    Vec3 n = {normals[i * 4], normals[i * 4 + 1], normals[i * 4 + 2]};
+    normalError = fmaxf(normalError, AngleDegrees(n, mesh->vertices[i].nor));
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    const Vec3 *p = &mesh->vertices[i].pos;
+    floats[i * 3] = EncodeExponential(p->x * 100.0f);
+    floats[i * 3 + 1] = EncodeExponential(p->y * 100.0f);
+    floats[i * 3 + 2] = EncodeExponential(p->z * 100.0f);
+  }
+  size = EncodeVertices(encoded, (const uint8_t *)floats, count, 12);
+  failed = failed ||
+           MeshoptDecode(floats, count, 12, encoded, size,
+                         MESHOPT_MODE_ATTRIBUTES,
+                         MESHOPT_FILTER_EXPONENTIAL) != SUCCESS;
+  for (size_t i = 0; i < count; i++) {
+    Vec3 p = Vec3Scale(mesh->vertices[i].pos, 100.0f);
+    float decoded[3];
+    memcpy(decoded, floats + i * 3, sizeof(decoded));
+    exponentialError = fmaxf(exponentialError,
+                             Vec3Len(Vec3Sub(p, (Vec3){decoded[0], decoded[1],
+                                                       decoded[2]})) /
+                                 fmaxf(Vec3Len(p), 1e-3f));
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    float *q = expected + i * 4;
+    float angle = (float)i * 0.001f;
+    Vec3 axis = Vec3Norm(Vec3Add(mesh->vertices[i].pos,
+                                 (Vec3){0.1f, 0.2f, 0.3f}));
+    q[0] = axis.x * sinf(angle);
+    q[1] = axis.y * sinf(angle);
+    q[2] = axis.z * sinf(angle);
+    q[3] = cosf(angle);
+    EncodeQuaternion(rotations + i * 4, q);
+  }
+  size = EncodeVertices(encoded, (const uint8_t *)rotations, count, 8);
+  failed = failed ||
+           MeshoptDecode(rotations, count, 8, encoded, size,
+                         MESHOPT_MODE_ATTRIBUTES,
+                         MESHOPT_FILTER_QUATERNION) != SUCCESS;
+  for (size_t i = 0; i < count; i++) {
+    float dot = 0.0f;
+    for (int k = 0; k < 4; k++) {
+      dot += expected[i * 4 + k] * (float)rotations[i * 4 + k] / 32767.0f;
+    }
+    quaternionDot = fminf(quaternionDot, fabsf(dot));
+  }
+
+  failed = failed || mismatches > 0 ||
+           normalError > BENCH_MAX_NORMAL_DEGREES ||
+           exponentialError > BENCH_MAX_EXPONENTIAL_ERROR ||
+           quaternionDot < BENCH_MIN_QUATERNION_DOT;
+  printf("checks:    %zu views differ, octahedral %.3f degrees, exponential "
+         "%.2g, quaternion dot %.6f%s\n",
+         mismatches, normalError, exponentialError, quaternionDot,
+         failed ? ", FAILED" : "");
+
+  for (size_t i = 0; i < viewsCount; i++) {
+    free(views[i].encoded);
+    free(views[i].decoded);
+  }
+  free(views);
+  free(quantized);
+  free(normals);
+  free(floats);
+  free(rotations);
+  free(expected);
+  free(encoded);
+  DestroyModel(sphere);
+  DestroyJobPool(pool);
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,239 @@
+// Normal and tangent generation benchmark: regenerates the normals and
+// tangents of a UV sphere of millions of triangles on the calling thread and
+// across a pool, and reports the throughput in triangles per second. Checks
+// the hard edges of a box, that the sphere comes out smooth and close to
+// its analytic frame, and that the pool gives the same bits as the calling
+// thread. Exits with an error when a check fails.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "core.h"
+#include "jobs.h"
+#include "model.h"
+#include "normals.h"
+#include "shapes.h"
+
+#define BENCH_DEFAULT_SEGMENTS 1500
+#define BENCH_DEFAULT_ROUNDS 3
+
+// Largest angle allowed between a generated and an analytic vector
+#define BENCH_MAX_ERROR_DEGREES 1.0f
+
+static float AngleDegrees(Vec3 a, Vec3 b) {
+  float c = Vec3Dot(Vec3Norm(a), Vec3Norm(b));
+  return acosf(fmaxf(-1.0f, fminf(1.0f, c))) * (180.0f / 3.14159265f);
+}
+
+// The shapes wind their faces clockwise seen from outside, flip them so that
+// the generated normals point out
+static void FlipWinding(Mesh *mesh) {
+  uint32_t *indices = mesh->indices;
+  for (size_t i = 0; i + 2 < mesh->indicesCount; i += 3) {
+    uint32_t swap = indices[i + 1];
+    indices[i + 1] = indices[i + 2];
+    indices[i + 2] = swap;
+  }
+}
+
+// A box keeps a normal per face with the default split and shares its
+// corners when nothing splits, their normals pointing out of all three faces
+// (not along the diagonal, a corner weighs one or two triangles per face)
+static bool CheckBox() {
+  Model box = MakeBox(Vec4Make(1.0f, 1.0f, 1.0f, 1.0f));
+  Model smooth = MakeBox(Vec4Make(1.0f, 1.0f, 1.0f, 1.0f));
+  if (box.status != SUCCESS || smooth.status != SUCCESS) {
+    return false;
+  }
+
+  FlipWinding(box.meshes);
+  FlipWinding(smooth.meshes);
+  if (GenerateNormals(box.meshes, NORMALS_DEFAULT_SPLIT_ANGLE, NULL) !=
+          SUCCESS ||
+      GenerateNormals(smooth.meshes, 180.0f, NULL) != SUCCESS) {
+    return false;
+  }
+
+  bool ok = box.meshes->verticesCount == 24 &&
+            smooth.meshes->verticesCount == 8;
+  const Mesh *mesh = box.meshes;
+  const uint32_t *indices = mesh->indices;
+  for (size_t c = 0; c < mesh->indicesCount && ok; c++) {
+    const Vertex *v = mesh->vertices + indices[c];
+    const Vertex *v0 = mesh->vertices + indices[c - c % 3];
+    const Vertex *v1 = mesh->vertices + indices[c - c % 3 + 1];
+    const Vertex *v2 = mesh->vertices + indices[c - c % 3 + 2];
+    Vec3 face = Vec3Cross(Vec3Sub(v1->pos, v0->pos), Vec3Sub(v2->pos, v0->pos));
+    ok = AngleDegrees(v->nor, face) < 1e-3f;
+  }
+
+  for (size_t i = 0; i < smooth.meshes->verticesCount && ok; i++) {
+    const Vertex *v = smooth.meshes->vertices + i;
+    ok = v->nor.x * v->pos.x > 0.0f && v->nor.y * v->pos.y > 0.0f &&
+         v->nor.z * v->pos.z > 0.0f;
+  }
+
+  printf("box:       %zu vertices split, %zu smooth, %s\n",
+         box.meshes->verticesCount, smooth.meshes->verticesCount,
+         ok ? "ok" : "wrong normals");
+  DestroyModel(box);
+  DestroyModel(smooth);
+  return ok;
+}
+
+// Regenerate both attributes rounds times, returning the best time of each
+static bool Generate(Mesh *mesh, JobPool *pool, int rounds, double *normals,
+                     double *tangents) {
+  *normals = *tangents = 1e30;
+  for (int round = 0; round < rounds; round++) {
+    for (size_t i = 0; i < mesh->verticesCount; i++) {
+      mesh->vertices[i].nor = Vec3Zero;
+      mesh->vertices[i].tan = (Vec4){0};
+    }
+
+    double start = GetTime();
+    if (GenerateNormals(mesh, NORMALS_DEFAULT_SPLIT_ANGLE, pool) != SUCCESS) {
+      return false;
+    }
+    double middle = GetTime();
+    if (GenerateTangents(mesh, pool) != SUCCESS) {
+      return false;
+    }
+    double end = GetTime();
+
+    *normals = fmin(*normals, middle - start);
+    *tangents = fmin(*tangents, end - middle);
+  }
+  return true;
+}
+
+static void PrintTime(const char *name, double normals, double tangents,
+                      size_t triangles) {
+  printf("%-10s normals %8.2f ms %6.1f Mtri/s  tangents %8.2f ms %6.1f "
+         "Mtri/s\n",
+         name, normals * 1000.0, (double)triangles / normals * 1e-6,
+         tangents * 1000.0, (double)triangles / tangents * 1e-6);
+}
+
+static void PrintUsage(const char *program) {
+  fprintf(stderr, "usage: %s [-s segments] [-n rounds] [-j threads]\n",
+          program);
+}
+
+int main(int argc, char **argv) {
+  int segments = BENCH_DEFAULT_SEGMENTS;
+  int rounds = BENCH_DEFAULT_ROUNDS;
+  int threads = (int)GetProcessorsCount() - 1;
+  for (int i = 1; i < argc; i++) {
+    if (i + 1 >= argc) {
+      PrintUsage(argv[0]);
+      return 1;
+    }
+
+    if (strcmp(argv[i], "-s") == 0) {
+      segments = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-n") == 0) {
+      rounds = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-j") == 0) {
+      threads = atoi(argv[++i]);
+    } else {
+      PrintUsage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (segments < 16 || rounds <= 0 || threads < 0) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  bool failed = !CheckBox();
+
+  JobPool *pool = MakeJobPool((size_t)threads);
+  Model sphere = MakeSphere(segments);
+  Vertex *serial = NULL;
+  if (pool == NULL || sphere.status != SUCCESS) {
+    Log(LOG_ERROR, "cannot setup benchmark (out of memory)");
+    return 1;
+  }
+
+  // U around the axis and V from pole to pole, by vertex index as the seam
+  // shares the first column
+  Mesh *mesh = sphere.meshes;
+  FlipWinding(mesh);
+  size_t columns = (size_t)segments;
+  for (size_t i = 0; i < mesh->verticesCount; i++) {
+    mesh->vertices[i].uvs = (Vec2){(float)(i % columns) / (float)segments,
+                                   (float)(i / columns) / (float)segments};
+  }
+
+  size_t verticesCount = mesh->verticesCount;
+  size_t triangles = mesh->indicesCount / 3;
+  printf("sphere:    %zu triangles, %zu vertices\n", triangles,
+         verticesCount);
+
+  double normals;
+  double tangents;
+  if (!Generate(mesh, NULL, rounds, &normals, &tangents)) {
+    return 1;
+  }
+  PrintTime("1 thread", normals, tangents, triangles);
+
+  serial = malloc(mesh->verticesCount * sizeof(Vertex));
+  if (serial == NULL) {
+    Log(LOG_ERROR, "cannot setup benchmark (out of memory)");
+    return 1;
+  }
+  memcpy(serial, mesh->vertices, mesh->verticesCount * sizeof(Vertex));
+
+  if (!Generate(mesh, pool, rounds, &normals, &tangents)) {
+    return 1;
+  }
+  char name[32];
+  snprintf(name, sizeof(name), "%zu threads", pool->threadsCount + 1);
+  PrintTime(name, normals, tangents, triangles);
+
+  bool same = mesh->verticesCount == verticesCount &&
+              memcmp(serial, mesh->vertices,
+                     mesh->verticesCount * sizeof(Vertex)) == 0;
+  failed = failed || !same;
+
+  // Away from the poles and the seam columns, where the UVs wrap, normals
+  // point out and tangents along increasing U, with the bitangent towards
+  // increasing V
+  float normalError = 0.0f;
+  float tangentError = 0.0f;
+  size_t wrongHandedness = 0;
+  for (size_t i = 0; i < mesh->verticesCount; i++) {
+    const Vertex *v = mesh->vertices + i;
+    size_t ring = i / columns;
+    size_t column = i % columns;
+    if (ring == 0 || ring == (size_t)segments || column == 0 ||
+        column == columns - 1) {
+      continue;
+    }
+
+    Vec3 u = {-v->pos.z, 0.0f, v->pos.x};
+    Vec3 bitangent = Vec3Scale(Vec3Cross(v->nor, (Vec3){v->tan.x, v->tan.y,
+                                                        v->tan.z}),
+                               v->tan.w);
+    normalError = fmaxf(normalError, AngleDegrees(v->nor, v->pos));
+    tangentError = fmaxf(tangentError,
+                         AngleDegrees((Vec3){v->tan.x, v->tan.y, v->tan.z},
+                                      u));
+    wrongHandedness += bitangent.y > 0.0f;
+  }
+
+  failed = failed || mesh->verticesCount != verticesCount ||
+           normalError > BENCH_MAX_ERROR_DEGREES ||
+           tangentError > BENCH_MAX_ERROR_DEGREES || wrongHandedness > 0;
+  printf("sphere:    %s threads, %zu vertices after, max error normals "
+         "%.4f tangents %.4f degrees, %zu wrong handedness\n",
+         same ? "same bits across" : "DIFFERENT bits across",
+         mesh->verticesCount, normalError, tangentError, wrongHandedness);
+
+  free(serial);
+  DestroyModel(sphere);
+  DestroyJobPool(pool);
+  return failed ? 1 : 0;
+}
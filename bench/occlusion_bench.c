@@ -0,0 +1,256 @@
+// Occlusion culling benchmark: a dense interior of walls with doorways and a
+// few thousand small props behind them. Walls are the occluders, every prop
+// is tested against the occlusion buffer as the render queue would do. With
+// -v the frame is also drawn by the software rasterizer with and without the
+// culled props, both images must be the same.
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "camera.h"
+#include "core.h"
+#include "jobs.h"
+#include "model.h"
+#include "occlusion.h"
+#include "raster.h"
+#include "shapes.h"
+
+#define BENCH_DEFAULT_FRAMES 100
+#define BENCH_WALL_LAYERS 4
+#define BENCH_WALLS_PER_LAYER 6
+#define BENCH_PROPS_X 24
+#define BENCH_PROPS_Y 6
+#define BENCH_PROPS_Z 16
+#define BENCH_PROPS (BENCH_PROPS_X * BENCH_PROPS_Y * BENCH_PROPS_Z)
+#define BENCH_WALLS (BENCH_WALL_LAYERS * BENCH_WALLS_PER_LAYER)
+
+// Rows of walls with a doorway at a different place on every layer
+static void PlaceWalls(Model *walls, Model box) {
+  for (int layer = 0; layer < BENCH_WALL_LAYERS; layer++) {
+    float z = 4.0f - (float)layer * 6.0f;
+    int doorway = BENCH_WALLS_PER_LAYER / 2 - 1 + layer % 2;
+    for (int i = 0; i < BENCH_WALLS_PER_LAYER; i++) {
+      Model *wall = walls + layer * BENCH_WALLS_PER_LAYER + i;
+      *wall = box;
+      wall->transform.origin = (Vec3){((float)i - 2.5f) * 4.0f, 0.0f, z};
+      wall->transform.scale = (Vec3){2.0f, 4.0f, 0.2f};
+
+      // Doorways are narrower walls leaving a gap on both sides
+      if (i == doorway) {
+        wall->transform.scale.x = 0.6f;
+      }
+    }
+  }
+}
+
+static void PlaceProps(Model *props, Model sphere) {
+  for (int i = 0; i < BENCH_PROPS; i++) {
+    int x = i % BENCH_PROPS_X;
+    int y = (i / BENCH_PROPS_X) % BENCH_PROPS_Y;
+    int z = i / (BENCH_PROPS_X * BENCH_PROPS_Y);
+    props[i] = sphere;
+    props[i].transform.origin =
+        (Vec3){(float)x - 11.5f, ((float)y - 2.5f) * 1.2f,
+               2.5f - (float)z * 1.4f};
+    props[i].transform.scale = Vec3Scale(Vec3One, 0.3f);
+  }
+}
+
+// Draw the walls and the visible props with the software rasterizer
+static void DrawScene(Raster *raster, Camera camera, const Model *walls,
+                      const Model *props, const bool *visible) {
+  RasterClear(raster, (Vec4){0.2f, 0.3f, 0.3f, 1.0f});
+  RasterBegin(raster, camera);
+  for (int i = 0; i < BENCH_WALLS; i++) {
+    RasterSubmit(raster, walls + i);
+  }
+
+  for (int i = 0; i < BENCH_PROPS; i++) {
+    if (visible == NULL || visible[i]) {
+      RasterSubmit(raster, props + i);
+    }
+  }
+  RasterFlush(raster);
+}
+
+static void WritePpm(const char *path, const Raster *raster) {
+  FILE *file = fopen(path, "wb");
+  if (file == NULL) {
+    Log(LOG_ERROR, "cannot write image: %s", path);
+    return;
+  }
+
+  fprintf(file, "P6\n%d %d\n255\n", raster->width, raster->height);
+  size_t pixels = (size_t)raster->width * raster->height;
+  for (size_t i = 0; i < pixels; i++) {
+    uint32_t c = raster->color[i];
+    uint8_t rgb[3] = {(uint8_t)c, (uint8_t)(c >> 8), (uint8_t)(c >> 16)};
+    fwrite(rgb, 1, 3, file);
+  }
+  fclose(file);
+}
+
+static void PrintUsage(const char *program) {
+  fprintf(stderr,
+          "usage: %s [-w width] [-h height] [-n frames] [-j threads] [-v] "
+          "[-o image.ppm]\n",
+          program);
+}
+
+int main(int argc, char **argv) {
+  int width = OCCLUSION_DEFAULT_WIDTH;
+  int height = OCCLUSION_DEFAULT_HEIGHT;
+  int frames = BENCH_DEFAULT_FRAMES;
+  int threads = (int)GetProcessorsCount() - 1;
+  bool verify = false;
+  const char *output = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-v") == 0) {
+      verify = true;
+      continue;
+    }
+
+    if (i + 1 >= argc) {
+      PrintUsage(argv[0]);
+      return 1;
+    }
+
+    if (strcmp(argv[i], "-w") == 0) {
+      width = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-h") == 0) {
+      height = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-n") == 0) {
+      frames = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-j") == 0) {
+      threads = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-o") == 0) {
+      output = argv[++i];
+    } else {
+      PrintUsage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (width <= 0 || height <= 0 || frames <= 0 || threads < 0) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  JobPool *pool = MakeJobPool((size_t)threads);
+  OcclusionBuffer occlusion = MakeOcclusionBuffer(width, height, pool);
+  Model box = MakeBox((Vec4){0.6f, 0.6f, 0.6f, 1.0f});
+  Model sphere = MakeSphere(12);
+  Model *walls = calloc(BENCH_WALLS, sizeof(Model));
+  Model *props = calloc(BENCH_PROPS, sizeof(Model));
+  bool *visible = calloc(BENCH_PROPS, sizeof(bool));
+  if (pool == NULL || occlusion.status != SUCCESS || box.status != SUCCESS ||
+      sphere.status != SUCCESS || walls == NULL || props == NULL ||
+      visible == NULL) {
+    Log(LOG_ERROR, "cannot setup benchmark (out of memory)");
+    return 1;
+  }
+
+  PlaceWalls(walls, box);
+  PlaceProps(props, sphere);
+
+  Camera camera = MakeDefaultCamera();
+  camera.width = (float)width;
+  camera.height = (float)height;
+  camera.aspect = camera.width / camera.height;
+  Vec3 origin = camera.transform.origin;
+
+  OcclusionStats total = {0};
+  double testMs = 0.0;
+  size_t visibleTotal = 0;
+  double start = GetTime();
+  for (int frame = 0; frame < frames; frame++) {
+    // Sway sideways so the props behind the doorways change every frame
+    camera.transform.origin.x = origin.x - sinf((float)frame * 0.05f) * 3.0f;
+
+    OcclusionBegin(&occlusion, camera);
+    for (int i = 0; i < BENCH_WALLS; i++) {
+      OcclusionSubmit(&occlusion, walls + i);
+    }
+    OcclusionFlush(&occlusion);
+
+    // Every test of the frame timed at once
+    double testStart = GetTime();
+    for (int i = 0; i < BENCH_PROPS; i++) {
+      const Mesh *mesh = props[i].meshes;
+      Mat4 modelMat = TransformGetModelMatrix(props[i].transform);
+      visible[i] = OcclusionTestBox(&occlusion, modelMat, mesh->boundsMin,
+                                    mesh->boundsMax);
+      visibleTotal += visible[i];
+    }
+    testMs += (GetTime() - testStart) * 1000.0;
+
+    OcclusionStats *stats = &occlusion.stats;
+    total.trianglesRasterized += stats->trianglesRasterized;
+    total.trianglesSkipped += stats->trianglesSkipped;
+    total.meshesTested += stats->meshesTested;
+    total.meshesOccluded += stats->meshesOccluded;
+    total.meshesOutside += stats->meshesOutside;
+    total.rasterMs += stats->rasterMs;
+  }
+  double elapsed = GetTime() - start;
+
+  printf("resolution:     %dx%d, %zu threads\n", width, height,
+         pool->threadsCount + 1);
+  printf("frames:         %d (%.3f ms/frame)\n", frames,
+         elapsed * 1000.0 / frames);
+  printf("occluders:      %d meshes, %zu triangles (%zu skipped)\n",
+         BENCH_WALLS, total.trianglesRasterized / frames,
+         total.trianglesSkipped / frames);
+  printf("props:          %zu tested, %zu visible per frame\n",
+         total.meshesTested / frames, visibleTotal / frames);
+  printf("culled:         %zu occluded, %zu outside per frame (%.1f%%)\n",
+         total.meshesOccluded / frames, total.meshesOutside / frames,
+         100.0 * (double)(total.meshesOccluded + total.meshesOutside) /
+             (double)total.meshesTested);
+  printf("raster:         %.3f ms/frame\n", total.rasterMs / frames);
+  printf("test:           %.3f ms/frame (%.1f ns/mesh)\n",
+         testMs / frames, testMs * 1e6 / (double)total.meshesTested);
+
+  int status = 0;
+  if (verify || output != NULL) {
+    // Same resolution as the occlusion buffer so that both sample the same
+    // pixel centers
+    Raster full = MakeRaster(width, height, pool);
+    Raster culled = MakeRaster(width, height, pool);
+    if (full.status != SUCCESS || culled.status != SUCCESS) {
+      Log(LOG_ERROR, "cannot setup verification (out of memory)");
+      return 1;
+    }
+
+    DrawScene(&full, camera, walls, props, NULL);
+    DrawScene(&culled, camera, walls, props, visible);
+
+    size_t differ = 0;
+    size_t pixels = (size_t)width * height;
+    for (size_t i = 0; i < pixels; i++) {
+      differ += full.color[i] != culled.color[i];
+    }
+
+    printf("verify:         %zu of %zu pixels differ\n", differ, pixels);
+    if (verify && differ > 0) {
+      status = 1;
+    }
+
+    if (output != NULL) {
+      WritePpm(output, &culled);
+    }
+    DestroyRaster(full);
+    DestroyRaster(culled);
+  }
+
+  free(visible);
+  free(props);
+  free(walls);
+  DestroyModel(sphere);
+  DestroyModel(box);
+  DestroyOcclusionBuffer(occlusion);
+  DestroyJobPool(pool);
+  return status;
+}
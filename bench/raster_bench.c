@@ -0,0 +1,144 @@
+// Software rasterizer benchmark: renders a grid of procedural spheres at
+// 1080p and reports the throughput in triangles per second.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "camera.h"
+#include "core.h"
+#include "jobs.h"
+#include "model.h"
+#include "raster.h"
+#include "shapes.h"
+
+#define BENCH_DEFAULT_WIDTH 1920
+#define BENCH_DEFAULT_HEIGHT 1080
+#define BENCH_DEFAULT_FRAMES 30
+#define BENCH_DEFAULT_SEGMENTS 128
+#define BENCH_GRID 8
+
+static void WritePpm(const char *path, const Raster *raster) {
+  FILE *file = fopen(path, "wb");
+  if (file == NULL) {
+    Log(LOG_ERROR, "cannot write image: %s", path);
+    return;
+  }
+
+  fprintf(file, "P6\n%d %d\n255\n", raster->width, raster->height);
+  size_t pixels = (size_t)raster->width * raster->height;
+  for (size_t i = 0; i < pixels; i++) {
+    uint32_t c = raster->color[i];
+    uint8_t rgb[3] = {(uint8_t)c, (uint8_t)(c >> 8), (uint8_t)(c >> 16)};
+    fwrite(rgb, 1, 3, file);
+  }
+  fclose(file);
+}
+
+static void PrintUsage(const char *program) {
+  fprintf(stderr,
+          "usage: %s [-w width] [-h height] [-n frames] [-s segments] "
+          "[-j threads] [-o image.ppm]\n",
+          program);
+}
+
+int main(int argc, char **argv) {
+  int width = BENCH_DEFAULT_WIDTH;
+  int height = BENCH_DEFAULT_HEIGHT;
+  int frames = BENCH_DEFAULT_FRAMES;
+  int segments = BENCH_DEFAULT_SEGMENTS;
+  int threads = (int)GetProcessorsCount() - 1;
+  const char *output = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    if (i + 1 >= argc) {
+      PrintUsage(argv[0]);
+      return 1;
+    }
+
+    if (strcmp(argv[i], "-w") == 0) {
+      width = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-h") == 0) {
+      height = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-n") == 0) {
+      frames = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-s") == 0) {
+      segments = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-j") == 0) {
+      threads = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-o") == 0) {
+      output = argv[++i];
+    } else {
+      PrintUsage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (width <= 0 || height <= 0 || frames <= 0 || segments < 3 ||
+      threads < 0) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  JobPool *pool = MakeJobPool((size_t)threads);
+  Raster raster = MakeRaster(width, height, pool);
+  Model sphere = MakeSphere(segments);
+  if (pool == NULL || raster.status != SUCCESS || sphere.status != SUCCESS) {
+    Log(LOG_ERROR, "cannot setup benchmark (out of memory)");
+    return 1;
+  }
+
+  Camera camera = MakeDefaultCamera();
+  camera.width = (float)width;
+  camera.height = (float)height;
+  camera.aspect = camera.width / camera.height;
+
+  // A grid of spheres sharing the same mesh, overlapping in depth
+  Model models[BENCH_GRID * BENCH_GRID];
+  for (int i = 0; i < BENCH_GRID * BENCH_GRID; i++) {
+    models[i] = sphere;
+    models[i].transform.scale = Vec3Scale(Vec3One, 0.6f);
+    models[i].transform.origin =
+        (Vec3){((float)(i % BENCH_GRID) - 3.5f) * 0.9f,
+               ((float)(i / BENCH_GRID) - 3.5f) * 0.5f, (float)(i % 3)};
+  }
+
+  RasterStats total = {0};
+  double start = GetTime();
+  for (int frame = 0; frame < frames; frame++) {
+    RasterClear(&raster, (Vec4){0.2f, 0.3f, 0.3f, 1.0f});
+    RasterBegin(&raster, camera);
+    for (int i = 0; i < BENCH_GRID * BENCH_GRID; i++) {
+      models[i].transform.angles.y = (float)frame * 0.05f;
+      RasterSubmit(&raster, &models[i]);
+    }
+    RasterFlush(&raster);
+
+    total.trianglesSubmitted += raster.stats.trianglesSubmitted;
+    total.trianglesBinned += raster.stats.trianglesBinned;
+    total.transformMs += raster.stats.transformMs;
+    total.binMs += raster.stats.binMs;
+    total.rasterMs += raster.stats.rasterMs;
+  }
+  double elapsed = GetTime() - start;
+
+  printf("resolution:     %dx%d, %zu threads\n", width, height,
+         pool->threadsCount + 1);
+  printf("frames:         %d (%.2f ms/frame, %.1f fps)\n", frames,
+         elapsed * 1000.0 / frames, frames / elapsed);
+  printf("triangles:      %zu submitted, %zu binned per frame\n",
+         total.trianglesSubmitted / frames, total.trianglesBinned / frames);
+  printf("throughput:     %.2f Mtris/s\n",
+         (double)total.trianglesSubmitted / elapsed / 1e6);
+  printf("transform:      %.2f ms/frame\n", total.transformMs / frames);
+  printf("bin:            %.2f ms/frame\n", total.binMs / frames);
+  printf("raster:         %.2f ms/frame\n", total.rasterMs / frames);
+
+  if (output != NULL) {
+    WritePpm(output, &raster);
+  }
+
+  DestroyModel(sphere);
+  DestroyRaster(raster);
+  DestroyJobPool(pool);
+  return 0;
+}
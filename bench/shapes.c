@@ -0,0 +1,111 @@
+#include "shapes.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <glad/glad.h>
+
+// Allocate a model with a single mesh of the given size
+static Model MakeShape(size_t verticesCount, size_t indicesCount) {
+  Model model = {0};
+  model.meshes = calloc(1, sizeof(Mesh));
+  if (model.meshes == NULL) {
+    model.status = E_OUT_OF_MEMORY;
+    return model;
+  }
+  model.meshesCount = 1;
+
+  Mesh *mesh = model.meshes;
+  mesh->verticesCount = verticesCount;
+  mesh->indicesCount = indicesCount;
+  mesh->indexType = GL_UNSIGNED_INT;
+  mesh->vertices = calloc(verticesCount, sizeof(Vertex));
+  mesh->indices = malloc(indicesCount * sizeof(uint32_t));
+  if (mesh->vertices == NULL || mesh->indices == NULL) {
+    model.status = E_OUT_OF_MEMORY;
+    return model;
+  }
+
+  model.shader.variant = SHADER_VARIANT_VERTEX_COLORS;
+  model.transform = MakeTransform();
+  model.status = SUCCESS;
+  return model;
+}
+
+Model MakeSphere(int segments) {
+  size_t rings = (size_t)segments + 1;
+  size_t columns = (size_t)segments;
+  Model model = MakeShape(rings * columns, (size_t)segments * segments * 6);
+  if (model.status != SUCCESS) {
+    return model;
+  }
+
+  Mesh *mesh = model.meshes;
+  for (size_t i = 0; i < rings; i++) {
+    float theta = (float)i / (float)segments * 3.14159265f;
+    for (size_t j = 0; j < columns; j++) {
+      float phi = (float)j / (float)segments * 6.28318531f;
+      Vertex *v = mesh->vertices + i * columns + j;
+      v->pos = (Vec3){sinf(theta) * cosf(phi), cosf(theta),
+                      sinf(theta) * sinf(phi)};
+      v->nor = v->pos;
+      v->col = (Vec4){v->pos.x * 0.5f + 0.5f, v->pos.y * 0.5f + 0.5f,
+                      v->pos.z * 0.5f + 0.5f, 1.0f};
+    }
+  }
+
+  uint32_t *indices = mesh->indices;
+  for (size_t i = 0; i < (size_t)segments; i++) {
+    for (size_t j = 0; j < (size_t)segments; j++) {
+      uint32_t a = (uint32_t)(i * columns + j);
+      uint32_t b = a + (uint32_t)columns;
+      uint32_t next = (uint32_t)(i * columns + (j + 1) % columns);
+      *indices++ = a;
+      *indices++ = b;
+      *indices++ = next;
+      *indices++ = next;
+      *indices++ = b;
+      *indices++ = next + (uint32_t)columns;
+    }
+  }
+
+  mesh->boundsMin = model.boundsMin = Vec3Scale(Vec3One, -1.0f);
+  mesh->boundsMax = model.boundsMax = Vec3One;
+  return model;
+}
+
+Model MakeBox(Vec4 color) {
+  // clang-format off
+  static const uint32_t boxIndices[] = {
+    0, 1, 3, 0, 3, 2,
+    4, 6, 7, 4, 7, 5,
+    0, 4, 5, 0, 5, 1,
+    2, 3, 7, 2, 7, 6,
+    0, 2, 6, 0, 6, 4,
+    1, 5, 7, 1, 7, 3,
+  };
+  // clang-format on
+
+  Model model = MakeShape(8, 36);
+  if (model.status != SUCCESS) {
+    return model;
+  }
+
+  Mesh *mesh = model.meshes;
+  for (int i = 0; i < 8; i++) {
+    Vertex *v = mesh->vertices + i;
+    v->pos = (Vec3){i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f,
+                    i & 4 ? 1.0f : -1.0f};
+    v->nor = v->pos;
+    v->col = color;
+  }
+
+  uint32_t *indices = mesh->indices;
+  for (int i = 0; i < 36; i++) {
+    indices[i] = boxIndices[i];
+  }
+
+  mesh->boundsMin = model.boundsMin = Vec3Scale(Vec3One, -1.0f);
+  mesh->boundsMax = model.boundsMax = Vec3One;
+  return model;
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include <xmath/vec4.h>
+
+#include "model.h"
+
+// Procedural CPU only meshes shared by the benchmarks. Models have a single
+// mesh with colored vertices, bounds and a SHADER_VARIANT_VERTEX_COLORS
+// variant, they are not uploaded.
+
+// Make a unit UV sphere with 2 * segments^2 triangles. The seam reuses the
+// first column so the surface stays watertight.
+Model MakeSphere(int segments);
+
+// Make a box from -1 to 1 on every axis with a single color.
+Model MakeBox(Vec4 color);
@@ -0,0 +1,240 @@
+// Stream benchmark: runs the bulk vector operations over the interleaved
+// vertices of a mesh one at a time and over SoA streams of the same data.
+// Checks that both give the same bits, exits with an error otherwise.
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <xmath/stream.h>
+
+#include "core.h"
+#include "model.h"
+
+#define BENCH_DEFAULT_VERTICES 1000000
+#define BENCH_DEFAULT_ROUNDS 20
+
+static uint32_t rngState = 0x9E3779B9u;
+
+static float RandomRange(float min, float max) {
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 17;
+  rngState ^= rngState << 5;
+  return min + (max - min) * (float)(rngState >> 8) * (1.0f / 16777216.0f);
+}
+
+static Vec3 RandomVec3(float min, float max) {
+  return (Vec3){RandomRange(min, max), RandomRange(min, max),
+                RandomRange(min, max)};
+}
+
+// Vectors of the stream differing from the expected ones
+static size_t CountMismatches(const Vec3 *expected, const Vec3Stream *s) {
+  size_t mismatches = 0;
+  for (size_t i = 0; i < s->count; i++) {
+    Vec3 v = {s->x[i], s->y[i], s->z[i]};
+    mismatches += v.x != expected[i].x || v.y != expected[i].y ||
+                  v.z != expected[i].z;
+  }
+  return mismatches;
+}
+
+static void PrintTime(const char *name, double aos, double soa, int rounds,
+                      size_t count) {
+  double scale = 1e9 / ((double)rounds * (double)count);
+  printf("%-12s %8.3f ns/vector AoS %8.3f ns/vector SoA %6.2fx\n", name,
+         aos * scale, soa * scale, aos / soa);
+}
+
+static void PrintUsage(const char *program) {
+  fprintf(stderr, "usage: %s [-n vertices] [-r rounds]\n", program);
+}
+
+int main(int argc, char **argv) {
+  size_t count = BENCH_DEFAULT_VERTICES;
+  int rounds = BENCH_DEFAULT_ROUNDS;
+  for (int i = 1; i < argc; i++) {
+    if (i + 1 >= argc) {
+      PrintUsage(argv[0]);
+      return 1;
+    }
+
+    if (strcmp(argv[i], "-n") == 0) {
+      count = (size_t)atol(argv[++i]);
+    } else if (strcmp(argv[i], "-r") == 0) {
+      rounds = atoi(argv[++i]);
+    } else {
+      PrintUsage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (count == 0 || rounds <= 0) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  Vertex *vertices = malloc(count * sizeof(Vertex));
+  Vec3 *expected = malloc(count * sizeof(Vec3));
+  Vec4 *points = malloc(count * sizeof(Vec4));
+  float *dots = malloc(count * sizeof(float));
+  float *streamDots = malloc(count * sizeof(float));
+  Vec3Stream pos = {0};
+  Vec3Stream nor = {0};
+  Vec3Stream out = {0};
+  if (vertices == NULL || expected == NULL || points == NULL ||
+      dots == NULL || streamDots == NULL || !Vec3StreamAlloc(&out, count)) {
+    Log(LOG_ERROR, "cannot setup benchmark (out of memory)");
+    return 1;
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    Vertex *v = vertices + i;
+    memset(v, 0, sizeof(Vertex));
+    v->pos = RandomVec3(-100.0f, 100.0f);
+    v->nor = RandomVec3(-1.0f, 1.0f);
+  }
+
+  if (VerticesToStreams(vertices, count, &pos, &nor) != SUCCESS) {
+    return 1;
+  }
+
+  // Converted again into the same streams, allocation left out
+  double start = GetTime();
+  for (int round = 0; round < rounds; round++) {
+    Vec3StreamGather(&pos, &vertices->pos, sizeof(Vertex));
+    Vec3StreamGather(&nor, &vertices->nor, sizeof(Vertex));
+  }
+  double gather = GetTime() - start;
+
+  start = GetTime();
+  for (int round = 0; round < rounds; round++) {
+    StreamsToVertices(vertices, &pos, &nor);
+  }
+  double scatter = GetTime() - start;
+  double scale = 1e9 / ((double)rounds * (double)count);
+  printf("%-12s %8.3f ns/vertex to streams %8.3f ns/vertex back\n",
+         "convert", gather * scale, scatter * scale);
+
+  size_t mismatches = 0;
+  double aos;
+  double soa;
+
+  start = GetTime();
+  for (int round = 0; round < rounds; round++) {
+    for (size_t i = 0; i < count; i++) {
+      expected[i] = Vec3Add(vertices[i].pos, vertices[i].nor);
+    }
+  }
+  aos = GetTime() - start;
+  start = GetTime();
+  for (int round = 0; round < rounds; round++) {
+    Vec3StreamAdd(&out, &pos, &nor);
+  }
+  soa = GetTime() - start;
+  PrintTime("add", aos, soa, rounds, count);
+  mismatches += CountMismatches(expected, &out);
+
+  start = GetTime();
+  for (int round = 0; round < rounds; round++) {
+    for (size_t i = 0; i < count; i++) {
+      expected[i] = Vec3Scale(vertices[i].pos, 0.5f);
+    }
+  }
+  aos = GetTime() - start;
+  start = GetTime();
+  for (int round = 0; round < rounds; round++) {
+    Vec3StreamScale(&out, &pos, 0.5f);
+  }
+  soa = GetTime() - start;
+  PrintTime("scale", aos, soa, rounds, count);
+  mismatches += CountMismatches(expected, &out);
+
+  start = GetTime();
+  for (int round = 0; round < rounds; round++) {
+    for (size_t i = 0; i < count; i++) {
+      dots[i] = Vec3Dot(vertices[i].pos, vertices[i].nor);
+    }
+  }
+  aos = GetTime() - start;
+  start = GetTime();
+  for (int round = 0; round < rounds; round++) {
+    Vec3StreamDot(streamDots, &pos, &nor);
+  }
+  soa = GetTime() - start;
+  PrintTime("dot", aos, soa, rounds, count);
+  for (size_t i = 0; i < count; i++) {
+    mismatches += dots[i] != streamDots[i];
+  }
+
+  start = GetTime();
+  for (int round = 0; round < rounds; round++) {
+    for (size_t i = 0; i < count; i++) {
+      expected[i] = Vec3Norm(vertices[i].nor);
+    }
+  }
+  aos = GetTime() - start;
+  start = GetTime();
+  for (int round = 0; round < rounds; round++) {
+    Vec3StreamNorm(&out, &nor);
+  }
+  soa = GetTime() - start;
+  PrintTime("normalize", aos, soa, rounds, count);
+  mismatches += CountMismatches(expected, &out);
+
+  Vec3 min = vertices[0].pos;
+  Vec3 max = vertices[0].pos;
+  start = GetTime();
+  for (int round = 0; round < rounds; round++) {
+    min = vertices[0].pos;
+    max = vertices[0].pos;
+    for (size_t i = 1; i < count; i++) {
+      min = Vec3Min(min, vertices[i].pos);
+      max = Vec3Max(max, vertices[i].pos);
+    }
+  }
+  aos = GetTime() - start;
+  Vec3 streamMin;
+  Vec3 streamMax;
+  start = GetTime();
+  for (int round = 0; round < rounds; round++) {
+    Vec3StreamMinMax(&pos, &streamMin, &streamMax);
+  }
+  soa = GetTime() - start;
+  PrintTime("min/max", aos, soa, rounds, count);
+  mismatches += memcmp(&min, &streamMin, sizeof(Vec3)) != 0;
+  mismatches += memcmp(&max, &streamMax, sizeof(Vec3)) != 0;
+
+  Transform transform = MakeTransform();
+  transform.origin = (Vec3){1.0f, -2.0f, 3.0f};
+  transform.angles = (Vec3){0.3f, -1.2f, 2.1f};
+  transform.scale = (Vec3){2.0f, 0.5f, 1.5f};
+  Mat4 m = TransformGetModelMatrix(transform);
+  start = GetTime();
+  for (int round = 0; round < rounds; round++) {
+    Mat4TransformPoints(points, &m, &vertices->pos, sizeof(Vertex), count);
+  }
+  aos = GetTime() - start;
+  start = GetTime();
+  for (int round = 0; round < rounds; round++) {
+    Vec3StreamTransform(&out, &m, &pos, 1.0f);
+  }
+  soa = GetTime() - start;
+  PrintTime("transform", aos, soa, rounds, count);
+  for (size_t i = 0; i < count; i++) {
+    expected[i] = (Vec3){points[i].x, points[i].y, points[i].z};
+  }
+  mismatches += CountMismatches(expected, &out);
+
+  printf("%zu results differ\n", mismatches);
+
+  Vec3StreamFree(&pos);
+  Vec3StreamFree(&nor);
+  Vec3StreamFree(&out);
+  free(vertices);
+  free(expected);
+  free(points);
+  free(dots);
+  free(streamDots);
+  return mismatches > 0 ? 1 : 0;
+}
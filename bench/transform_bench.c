@@ -0,0 +1,154 @@
+// Transform benchmark: builds the model matrices of many transforms per
+// frame with the full matrix products, the closed form and the batch.
+// Checks that the closed form matches the products and that the batch stays
+// within its error bound, exits with an error otherwise.
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <xmath/transform.h>
+
+#include "core.h"
+
+#define BENCH_DEFAULT_TRANSFORMS 100000
+#define BENCH_DEFAULT_FRAMES 50
+#define BENCH_MAX_ERROR 1e-5f
+
+static uint32_t rngState = 0x9E3779B9u;
+
+static float RandomRange(float min, float max) {
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 17;
+  rngState ^= rngState << 5;
+  return min + (max - min) * (float)(rngState >> 8) * (1.0f / 16777216.0f);
+}
+
+// The composition TransformGetModelMatrix replaces
+static Mat4 RefModelMatrix(Transform transform) {
+  Mat4 m = Mat4MakeScale(transform.scale);
+  m = Mat4Mul(m, Mat4MakeRotationX(transform.angles.x));
+  m = Mat4Mul(m, Mat4MakeRotationY(transform.angles.y));
+  m = Mat4Mul(m, Mat4MakeRotationZ(transform.angles.z));
+  return Mat4Mul(m, Mat4MakeTranslation(transform.origin));
+}
+
+// Largest difference to the reference, relative to the scale of the object
+static float MaxError(const Mat4 *a, const Mat4 *b, const Transform *t,
+                      size_t n, size_t *mismatches) {
+  float maxError = 0.0f;
+  for (size_t i = 0; i < n; i++) {
+    const float *x = Mat4Raw(a + i);
+    const float *y = Mat4Raw(b + i);
+    float scale = fmaxf(fmaxf(fabsf(t[i].scale.x), fabsf(t[i].scale.y)),
+                        fmaxf(fabsf(t[i].scale.z), 1.0f));
+    bool same = true;
+    for (int e = 0; e < 16; e++) {
+      float error = fabsf(x[e] - y[e]) / scale;
+      maxError = fmaxf(maxError, error);
+      same = same && x[e] == y[e];
+    }
+    *mismatches += !same;
+  }
+  return maxError;
+}
+
+static void PrintTime(const char *name, double seconds, int frames,
+                      size_t count) {
+  double ms = seconds * 1000.0 / frames;
+  printf("%-16s %8.3f ms/frame %8.2f ns/transform\n", name, ms,
+         ms * 1e6 / (double)count);
+}
+
+static void PrintUsage(const char *program) {
+  fprintf(stderr, "usage: %s [-n transforms] [-f frames]\n", program);
+}
+
+int main(int argc, char **argv) {
+  size_t count = BENCH_DEFAULT_TRANSFORMS;
+  int frames = BENCH_DEFAULT_FRAMES;
+  for (int i = 1; i < argc; i++) {
+    if (i + 1 >= argc) {
+      PrintUsage(argv[0]);
+      return 1;
+    }
+
+    if (strcmp(argv[i], "-n") == 0) {
+      count = (size_t)atol(argv[++i]);
+    } else if (strcmp(argv[i], "-f") == 0) {
+      frames = atoi(argv[++i]);
+    } else {
+      PrintUsage(argv[0]);
+      return 1;
+    }
+  }
+
+  if (count == 0 || frames <= 0) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  Transform *transforms = malloc(count * sizeof(Transform));
+  Mat4 *expected = malloc(count * sizeof(Mat4));
+  Mat4 *matrices = malloc(count * sizeof(Mat4));
+  if (transforms == NULL || expected == NULL || matrices == NULL) {
+    Log(LOG_ERROR, "cannot setup benchmark (out of memory)");
+    return 1;
+  }
+
+  // A few turns either way, as animated objects would accumulate
+  const float turns = 3.0f * 2.0f * 3.14159265f;
+  for (size_t i = 0; i < count; i++) {
+    Transform *t = transforms + i;
+    *t = MakeTransform();
+    t->scale = (Vec3){RandomRange(0.1f, 10.0f), RandomRange(0.1f, 10.0f),
+                      RandomRange(0.1f, 10.0f)};
+    t->origin = (Vec3){RandomRange(-100.0f, 100.0f),
+                       RandomRange(-100.0f, 100.0f),
+                       RandomRange(-100.0f, 100.0f)};
+    t->angles = (Vec3){RandomRange(-turns, turns), RandomRange(-turns, turns),
+                       RandomRange(-turns, turns)};
+  }
+
+  double start = GetTime();
+  for (int frame = 0; frame < frames; frame++) {
+    for (size_t i = 0; i < count; i++) {
+      expected[i] = RefModelMatrix(transforms[i]);
+    }
+  }
+  PrintTime("products", GetTime() - start, frames, count);
+
+  start = GetTime();
+  for (int frame = 0; frame < frames; frame++) {
+    for (size_t i = 0; i < count; i++) {
+      matrices[i] = TransformGetModelMatrix(transforms[i]);
+    }
+  }
+  PrintTime("closed form", GetTime() - start, frames, count);
+
+  size_t mismatches = 0;
+  float closedError = MaxError(matrices, expected, transforms, count,
+                               &mismatches);
+  bool failed = closedError != 0.0f;
+
+  start = GetTime();
+  for (int frame = 0; frame < frames; frame++) {
+    TransformGetModelMatrices(transforms, matrices, count);
+  }
+  PrintTime("batch", GetTime() - start, frames, count);
+
+  size_t batchMismatches = 0;
+  float batchError = MaxError(matrices, expected, transforms, count,
+                              &batchMismatches);
+  failed = failed || batchError > BENCH_MAX_ERROR;
+
+  printf("closed form:     %zu differ, max error %g\n", mismatches,
+         closedError);
+  printf("batch:           %zu differ, max error %g (limit %g)\n",
+         batchMismatches, batchError, BENCH_MAX_ERROR);
+
+  free(transforms);
+  free(expected);
+  free(matrices);
+  return failed ? 1 : 0;
+}
@@ -1,31 +1,103 @@
 #include "camera.h"
 
+#include <string.h>
+
 #include "core.h"
 
-Mat4 CameraGetProjMatrix(Camera camera) {
-  assert((camera.mode == CAMERA_MODE_PERSPECTIVE_PROJ ||
-          camera.mode == CAMERA_MODE_ORTHO_PROJ) &&
+static void GetProjParams(const Camera *camera,
+                          float params[CAMERA_PROJ_PARAMS]) {
+  params[0] = (float)camera->mode;
+  params[1] = camera->fov;
+  params[2] = camera->width;
+  params[3] = camera->height;
+  params[4] = camera->aspect;
+  params[5] = camera->near;
+  params[6] = camera->far;
+}
+
+static Mat4 MakeProjMatrix(const Camera *camera) {
+  assert((camera->mode == CAMERA_MODE_PERSPECTIVE_PROJ ||
+          camera->mode == CAMERA_MODE_ORTHO_PROJ) &&
          "invalid state: unknown camera mode");
-  if (camera.mode == CAMERA_MODE_PERSPECTIVE_PROJ) {
-    return Mat4MakePerspective(camera.fov, camera.aspect, camera.near,
-                               camera.far);
+  if (camera->mode == CAMERA_MODE_PERSPECTIVE_PROJ) {
+    return Mat4MakePerspective(camera->fov, camera->aspect, camera->near,
+                               camera->far);
   }
 
   // FIXME(cedmundo): we might need to use -camera.width/2 and camera.width/2
-  return Mat4MakeOrtho(0, camera.width, 0, camera.height, camera.near,
-                       camera.far);
+  return Mat4MakeOrtho(0, camera->width, 0, camera->height, camera->near,
+                       camera->far);
+}
+
+static Mat4 MakeViewMatrix(const Camera *camera) {
+  Mat4 model = TransformGetModelMatrix(camera->transform);
+  Vec3 scale = camera->transform.scale;
+  if (scale.x == 1.0f && scale.y == 1.0f && scale.z == 1.0f) {
+    return Mat4InverseRigid(model);
+  }
+  return Mat4Inverse(model);
+}
+
+// Recompute the matrices out of date, viewProj follows any of the others
+static void RefreshMatrices(Camera *camera) {
+  assert(camera != NULL && "invalid arg camera: cannot be NULL");
+  if (memcmp(&camera->viewTransform, &camera->transform,
+             sizeof(Transform)) != 0) {
+    camera->viewDirty = true;
+  }
+
+  float params[CAMERA_PROJ_PARAMS];
+  GetProjParams(camera, params);
+  if (memcmp(camera->projParams, params, sizeof(params)) != 0) {
+    camera->projDirty = true;
+  }
+
+  if (!camera->viewDirty && !camera->projDirty) {
+    return;
+  }
+
+  if (camera->viewDirty) {
+    camera->view = MakeViewMatrix(camera);
+    camera->viewTransform = camera->transform;
+  }
+
+  if (camera->projDirty) {
+    camera->proj = MakeProjMatrix(camera);
+    memcpy(camera->projParams, params, sizeof(params));
+  }
+
+  camera->viewProj = Mat4Mul(camera->view, camera->proj);
+  camera->viewDirty = false;
+  camera->projDirty = false;
+}
+
+Mat4 CameraGetViewMatrix(Camera *camera) {
+  RefreshMatrices(camera);
+  return camera->view;
+}
+
+Mat4 CameraGetProjMatrix(Camera *camera) {
+  RefreshMatrices(camera);
+  return camera->proj;
+}
+
+Mat4 CameraGetViewProjMatrix(Camera *camera) {
+  RefreshMatrices(camera);
+  return camera->viewProj;
 }
 
 Camera MakeDefaultCamera() {
   Camera camera = {0};
   camera.mode = CAMERA_MODE_PERSPECTIVE_PROJ;
   camera.transform = MakeTransform();
-  camera.transform.origin = (Vec3){0.0f, 0.0f, -10.0f};
+  camera.transform.origin = (Vec3){0.0f, 0.0f, 10.0f};
   camera.front = Vec3Forward;
   camera.up = Vec3Up;
   camera.fov = CAMERA_DEFAULT_FOV;
   camera.near = CAMERA_DEFAULT_NEAR;
   camera.far = CAMERA_DEFAULT_FAR;
+  camera.viewDirty = true;
+  camera.projDirty = true;
   return camera;
 }
 
@@ -34,4 +106,5 @@ void UpdateCamera(Camera *camera) {
   camera->aspect = viewportSize.x / viewportSize.y;
   camera->width = viewportSize.x;
   camera->height = viewportSize.y;
+  RefreshMatrices(camera);
 }
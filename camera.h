@@ -1,4 +1,5 @@
 #pragma once
+#include <stdbool.h>
 #include <xmath/transform.h>
 #include <xmath/vec3.h>
 
@@ -6,6 +7,10 @@
 #define CAMERA_DEFAULT_FAR 100.0f
 #define CAMERA_DEFAULT_FOV 45.0f
 
+// Fields the projection matrix is made from: mode, fov, width, height,
+// aspect, near and far
+#define CAMERA_PROJ_PARAMS 7
+
 // Camera represents an usable view for the render
 typedef struct {
   enum {
@@ -25,13 +30,32 @@ typedef struct {
   float far;
 
   Transform transform;
+
+  // Matrices cached by the getters below. Fields are set directly, so the
+  // getters also raise the flags when the transform or the projection
+  // parameters differ from the ones the matrices were made from.
+  bool viewDirty;
+  bool projDirty;
+  Transform viewTransform;
+  float projParams[CAMERA_PROJ_PARAMS];
+  Mat4 view;
+  Mat4 proj;
+  Mat4 viewProj;
 } Camera;
 
 // Return a perspective camera looking at origin offset a little bit
 Camera MakeDefaultCamera();
 
+// Return the view matrix, the inverse of the camera transform.
+Mat4 CameraGetViewMatrix(Camera *camera);
+
 // Return the *updated* projection matrix of a camera.
-Mat4 CameraGetProjMatrix(Camera camera);
+Mat4 CameraGetProjMatrix(Camera *camera);
+
+// Return the view matrix times the projection matrix, as shaders apply them.
+Mat4 CameraGetViewProjMatrix(Camera *camera);
 
-// Updates the current camera using core state
+// Updates the current camera using core state and refreshes its matrices.
+// Call after moving the camera so that copies passed to the renderers carry
+// matrices already up to date.
 void UpdateCamera(Camera *camera);
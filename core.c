@@ -7,14 +7,28 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 // GLAD / GLFW
 #include <glad/glad.h>
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
 
+// EGL, used for headless contexts
+#ifdef SIMPLEGLTF_HAS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include "glstate.h"
+#include "profile.h"
+#include "stats.h"
+
 typedef struct {
   bool didInitGLFW;
+  bool headless;
+  bool shouldClose;
+  double startTime;
   float deltaTime;
   double curFrame;
   double lstFrame;
@@ -25,12 +39,77 @@ typedef struct {
   float windowHeight;
   GLFWwindow *window;
   LogLevel logLevel;
+
+  // Highest version requested and version of the context created, both as
+  // major * 10 + minor
+  int maxGLVersion;
+  int glVersion;
+
+  // Headless context and the framebuffer it renders into
+#ifdef SIMPLEGLTF_HAS_EGL
+  EGLDisplay eglDisplay;
+  EGLContext eglContext;
+  EGLSurface eglSurface;
+#endif
+  unsigned fbo;
+  unsigned colorRbo;
+  unsigned depthRbo;
 } App;
 
 static App app = {0};
 
+uint64_t GetMonotonicNanoseconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static double GetMonotonicTime() {
+  return (double)GetMonotonicNanoseconds() * 1e-9;
+}
+
+static int GetMaxGLVersion() {
+  return app.maxGLVersion != 0 ? app.maxGLVersion : APP_DEFAULT_GL_VERSION;
+}
+
+// Versions tried when creating a context: the highest requested, then the
+// minimum. Drivers usually return their newest compatible version for either.
+static int GetGLVersionAttempt(int attempt) {
+  if (attempt == 0) {
+    return GetMaxGLVersion();
+  }
+
+  bool fallback = attempt == 1 && GetMaxGLVersion() != APP_MIN_GL_VERSION;
+  return fallback ? APP_MIN_GL_VERSION : 0;
+}
+
+static void SetupGLState() {
+  // Capped so that lowering the maximum also disables the newer paths
+  int major = 0;
+  int minor = 0;
+  glGetIntegerv(GL_MAJOR_VERSION, &major);
+  glGetIntegerv(GL_MINOR_VERSION, &minor);
+  app.glVersion = major * 10 + minor;
+  if (app.glVersion > GetMaxGLVersion()) {
+    app.glVersion = GetMaxGLVersion();
+  }
+
+  GLStateReset();
+#ifdef SIMPLEGLTF_PROFILE
+  ProfileSetThreadName("main");
+  if (ProfileInitGpu() != SUCCESS) {
+    Log(LOG_WARN, "cannot profile the GPU (out of memory)");
+  }
+#endif
+  glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+  GLStateSetCapability(GL_DEPTH_TEST, true);
+  GLStateDepthFunc(GL_LESS);
+}
+
 StatusCode AppInit(int window_width, int window_height,
                    const char *window_title) {
+  app.startTime = GetMonotonicTime();
+
   // Init GLFW.
   if (!glfwInit()) {
     return E_CANNOT_INIT_GLFW;
@@ -39,14 +118,19 @@ StatusCode AppInit(int window_width, int window_height,
   // Allow GLFW termination
   app.didInitGLFW = true;
 
-  // Window hints for OpenGL.
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+  // Create window, asking for the newest context first.
   glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+  int version = 0;
+  for (int i = 0; (version = GetGLVersionAttempt(i)) != 0; i++) {
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, version / 10);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, version % 10);
+    app.window = glfwCreateWindow(window_width, window_height, window_title,
+                                  NULL, NULL);
+    if (app.window != NULL) {
+      break;
+    }
+  }
 
-  // Create window.
-  app.window =
-      glfwCreateWindow(window_width, window_height, window_title, NULL, NULL);
   if (app.window == NULL) {
     return E_CANNOT_CREATE_WINDOW;
   }
@@ -57,14 +141,201 @@ StatusCode AppInit(int window_width, int window_height,
     return E_CANNOT_LOAD_GL;
   }
 
-  glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-  glEnable(GL_DEPTH_TEST);
-  glDepthFunc(GL_LESS);
+  SetupGLState();
+  return SUCCESS;
+}
+
+#ifdef SIMPLEGLTF_HAS_EGL
+static bool HasEGLExtension(const char *extensions, const char *name) {
+  size_t length = strlen(name);
+  const char *found = extensions;
+  while (found != NULL && (found = strstr(found, name)) != NULL) {
+    if (found[length] == ' ' || found[length] == '\0') {
+      return true;
+    }
+    found += length;
+  }
+
+  return false;
+}
+
+// Prefer a display that needs no window system: Mesa surfaceless platform,
+// then the first EGL device and finally the default display.
+static EGLDisplay GetHeadlessDisplay() {
+  const char *extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+  PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+      (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress(
+          "eglGetPlatformDisplayEXT");
+
+  if (extensions != NULL && getPlatformDisplay != NULL) {
+    if (HasEGLExtension(extensions, "EGL_MESA_platform_surfaceless")) {
+      EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA,
+                                              EGL_DEFAULT_DISPLAY, NULL);
+      if (display != EGL_NO_DISPLAY) {
+        return display;
+      }
+    }
+
+    PFNEGLQUERYDEVICESEXTPROC queryDevices =
+        (PFNEGLQUERYDEVICESEXTPROC)eglGetProcAddress("eglQueryDevicesEXT");
+    if (HasEGLExtension(extensions, "EGL_EXT_platform_device") &&
+        queryDevices != NULL) {
+      EGLDeviceEXT device = NULL;
+      EGLint devicesCount = 0;
+      if (queryDevices(1, &device, &devicesCount) && devicesCount > 0) {
+        EGLDisplay display =
+            getPlatformDisplay(EGL_PLATFORM_DEVICE_EXT, device, NULL);
+        if (display != EGL_NO_DISPLAY) {
+          return display;
+        }
+      }
+    }
+  }
+
+  return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+static StatusCode CreateHeadlessContext() {
+  app.eglDisplay = GetHeadlessDisplay();
+  if (app.eglDisplay == EGL_NO_DISPLAY ||
+      !eglInitialize(app.eglDisplay, NULL, NULL) ||
+      !eglBindAPI(EGL_OPENGL_API)) {
+    Log(LOG_ERROR, "cannot initialize EGL display (error %#x)",
+        eglGetError());
+    return E_CANNOT_INIT_EGL;
+  }
+
+  // Without surfaceless contexts fall back to a tiny pbuffer surface, the
+  // frame itself is always rendered into our own framebuffer.
+  const char *extensions = eglQueryString(app.eglDisplay, EGL_EXTENSIONS);
+  bool surfaceless = extensions != NULL &&
+                     HasEGLExtension(extensions, "EGL_KHR_surfaceless_context");
+
+  EGLint configAttribs[] = {
+      EGL_SURFACE_TYPE, surfaceless ? 0 : EGL_PBUFFER_BIT,
+      EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+      EGL_RED_SIZE, 8,
+      EGL_GREEN_SIZE, 8,
+      EGL_BLUE_SIZE, 8,
+      EGL_NONE,
+  };
+  EGLConfig config = NULL;
+  EGLint configsCount = 0;
+  if (!eglChooseConfig(app.eglDisplay, configAttribs, &config, 1,
+                       &configsCount) ||
+      configsCount == 0) {
+    Log(LOG_ERROR, "cannot find an EGL config for desktop GL");
+    return E_CANNOT_INIT_EGL;
+  }
+
+  app.eglContext = EGL_NO_CONTEXT;
+  int version = 0;
+  for (int i = 0; (version = GetGLVersionAttempt(i)) != 0; i++) {
+    EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, version / 10,
+        EGL_CONTEXT_MINOR_VERSION, version % 10,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE,
+    };
+    app.eglContext = eglCreateContext(app.eglDisplay, config, EGL_NO_CONTEXT,
+                                      contextAttribs);
+    if (app.eglContext != EGL_NO_CONTEXT) {
+      break;
+    }
+  }
+
+  if (app.eglContext == EGL_NO_CONTEXT) {
+    Log(LOG_ERROR, "cannot create EGL context (error %#x)", eglGetError());
+    return E_CANNOT_INIT_EGL;
+  }
+
+  app.eglSurface = EGL_NO_SURFACE;
+  if (!surfaceless) {
+    EGLint surfaceAttribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+    app.eglSurface =
+        eglCreatePbufferSurface(app.eglDisplay, config, surfaceAttribs);
+    if (app.eglSurface == EGL_NO_SURFACE) {
+      Log(LOG_ERROR, "cannot create EGL pbuffer (error %#x)", eglGetError());
+      return E_CANNOT_INIT_EGL;
+    }
+  }
+
+  if (!eglMakeCurrent(app.eglDisplay, app.eglSurface, app.eglSurface,
+                      app.eglContext)) {
+    Log(LOG_ERROR, "cannot make EGL context current (error %#x)",
+        eglGetError());
+    return E_CANNOT_INIT_EGL;
+  }
+
+  if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress)) {
+    return E_CANNOT_LOAD_GL;
+  }
+
+  return SUCCESS;
+}
+#endif
+
+static StatusCode CreateHeadlessFramebuffer(int width, int height) {
+  glGenRenderbuffers(1, &app.colorRbo);
+  glBindRenderbuffer(GL_RENDERBUFFER, app.colorRbo);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+  glGenRenderbuffers(1, &app.depthRbo);
+  glBindRenderbuffer(GL_RENDERBUFFER, app.depthRbo);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  glGenFramebuffers(1, &app.fbo);
+  glBindFramebuffer(GL_FRAMEBUFFER, app.fbo);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                            GL_RENDERBUFFER, app.colorRbo);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                            GL_RENDERBUFFER, app.depthRbo);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    return E_CANNOT_CREATE_FRAMEBUFFER;
+  }
+
+  return SUCCESS;
+}
+
+StatusCode AppInitHeadless(int width, int height) {
+  assert(width > 0 && height > 0 && "invalid arg: size must be positive");
+  app.startTime = GetMonotonicTime();
+  app.headless = true;
+  app.windowWidth = (float)width;
+  app.windowHeight = (float)height;
+
+#ifdef SIMPLEGLTF_HAS_EGL
+  StatusCode status = CreateHeadlessContext();
+  if (status != SUCCESS) {
+    return status;
+  }
+#else
+  Log(LOG_ERROR, "headless mode unavailable: built without EGL");
+  return E_CANNOT_INIT_EGL;
+#endif
+
+  StatusCode fboStatus = CreateHeadlessFramebuffer(width, height);
+  if (fboStatus != SUCCESS) {
+    return fboStatus;
+  }
+
+  Log(LOG_INFO, "headless context: %s, %s", glGetString(GL_RENDERER),
+      glGetString(GL_VERSION));
+  SetupGLState();
   return SUCCESS;
 }
 
 void AppSetLogLevel(LogLevel level) { app.logLevel = level; }
 
+void AppSetMaxGLVersion(int version) {
+  assert(version >= APP_MIN_GL_VERSION && version <= 46 &&
+         "invalid arg version: outside range");
+  app.maxGLVersion = version;
+}
+
+int AppGetGLVersion() { return app.glVersion; }
+
 void Log(LogLevel level, const char *fmt, ...) {
   assert(level >= LOG_TRACE && level < LOG_LEVEL_COUNT &&
          "invalid arg: level must be in LogLevel range");
@@ -98,6 +369,39 @@ int AppClose(StatusCode status) {
   assert(status >= SUCCESS && status < E_ERROR_COUNT &&
          "invalid arg status: outside range");
 
+#ifdef SIMPLEGLTF_PROFILE
+  // Pending GPU zones need the context, the trace is written after them
+  ProfileDestroyGpu();
+  if (ProfileGetTracePath() != NULL) {
+    ProfileWriteTrace(ProfileGetTracePath());
+  }
+  ProfileShutdown();
+#endif
+
+  DestroyFrameStats();
+
+  if (app.fbo != 0) {
+    glDeleteFramebuffers(1, &app.fbo);
+    glDeleteRenderbuffers(1, &app.colorRbo);
+    glDeleteRenderbuffers(1, &app.depthRbo);
+  }
+
+#ifdef SIMPLEGLTF_HAS_EGL
+  if (app.eglDisplay != NULL && app.eglDisplay != EGL_NO_DISPLAY) {
+    eglMakeCurrent(app.eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                   EGL_NO_CONTEXT);
+    if (app.eglSurface != EGL_NO_SURFACE) {
+      eglDestroySurface(app.eglDisplay, app.eglSurface);
+    }
+
+    if (app.eglContext != EGL_NO_CONTEXT) {
+      eglDestroyContext(app.eglDisplay, app.eglContext);
+    }
+
+    eglTerminate(app.eglDisplay);
+  }
+#endif
+
   if (app.window != NULL) {
     glfwDestroyWindow(app.window);
   }
@@ -115,24 +419,40 @@ int AppClose(StatusCode status) {
 }
 
 bool AppShouldClose() {
+  if (app.headless) {
+    return app.shouldClose;
+  }
+
   assert(app.window != NULL && "invalid state: app.window is not initialized");
-  return glfwWindowShouldClose(app.window);
+  return app.shouldClose || glfwWindowShouldClose(app.window);
 }
 
+void AppRequestClose() { app.shouldClose = true; }
+
+bool AppIsHeadless() { return app.headless; }
+
 float GetDeltaTime() { return app.deltaTime; }
 
-void BeginFrame() {
-  assert(app.window != NULL && "invalid state: app.window is not initialized");
-  int width = 0;
-  int height = 0;
+double GetTime() { return GetMonotonicTime() - app.startTime; }
 
-  // Framebuffer resize and aspect ratio
-  glfwGetFramebufferSize(app.window, &width, &height);
-  app.windowWidth = (float)width;
-  app.windowHeight = (float)height;
+void BeginFrame() {
+  assert((app.window != NULL || app.headless) &&
+         "invalid state: app is not initialized");
+  PROFILE_ZONE("BeginFrame");
+  int width = (int)app.windowWidth;
+  int height = (int)app.windowHeight;
+
+  // Framebuffer resize and aspect ratio, headless framebuffers never resize
+  if (!app.headless) {
+    glfwGetFramebufferSize(app.window, &width, &height);
+    app.windowWidth = (float)width;
+    app.windowHeight = (float)height;
+  } else {
+    glBindFramebuffer(GL_FRAMEBUFFER, app.fbo);
+  }
 
   // Uptime and delta time
-  app.curFrame = glfwGetTime();
+  app.curFrame = GetTime();
   app.deltaTime = (float)(app.curFrame - app.lstFrame);
   app.lstFrame = app.curFrame;
 
@@ -146,14 +466,37 @@ void BeginFrame() {
   }
 
   // Clear buffer and start frame
+  PROFILE_GPU_ZONE("Clear");
+  FrameStatsBeginFrame();
+  GLStateBeginFrame();
   glViewport(0, 0, width, height);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 }
 
 void EndFrame() {
-  assert(app.window != NULL && "invalid state: app.window is not initialized");
-  glfwPollEvents();
-  glfwSwapBuffers(app.window);
+  assert((app.window != NULL || app.headless) &&
+         "invalid state: app is not initialized");
+  FrameStatsEndFrame();
+  {
+    PROFILE_ZONE("EndFrame");
+    if (app.headless) {
+      glFlush();
+    } else {
+      glfwPollEvents();
+      glfwSwapBuffers(app.window);
+    }
+  }
+  PROFILE_FRAME();
+}
+
+int GetFPS() { return app.curFPS; }
+
+void AppSetVSync(bool enabled) {
+  assert((app.window != NULL || app.headless) &&
+         "invalid state: app is not initialized");
+  if (app.window != NULL) {
+    glfwSwapInterval(enabled ? 1 : 0);
+  }
 }
 
 Vec2 GetViewportSize() {
@@ -172,10 +515,16 @@ char *LoadFileContents(const char *name) {
   file_size = ftell(file);
   assert(fseek(file, 0, SEEK_SET) == 0);
 
-  char *data = calloc(sizeof(char), file_size);
+  // Keep a terminator so text files can be used as C strings
+  char *data = calloc(sizeof(char), file_size + 1);
+  if (data == NULL) {
+    fclose(file);
+    return NULL;
+  }
+
   size_t read_size = fread(data, sizeof(char), file_size, file);
+  fclose(file);
   if (read_size == 0) {
-    assert(fclose(file) == 0);
     free(data);
     return NULL;
   }
@@ -3,6 +3,13 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+
+// Context versions as major * 10 + minor. Contexts ask for the default
+// version first, for compute shaders and indirect draws, and fall back to the
+// minimum when the driver cannot create it.
+#define APP_DEFAULT_GL_VERSION 43
+#define APP_MIN_GL_VERSION 41
 
 typedef enum {
   SUCCESS,
@@ -15,6 +22,8 @@ typedef enum {
   E_CANNOT_CREATE_TEXTURE,
   E_CANNOT_UPLOAD_TEXTURE,
   E_OUT_OF_MEMORY,
+  E_CANNOT_INIT_EGL,
+  E_CANNOT_CREATE_FRAMEBUFFER,
   E_ERROR_COUNT,
 } StatusCode;
 
@@ -36,6 +45,29 @@ void Log(LogLevel level, const char *fmt, ...);
 StatusCode AppInit(int window_width, int window_height,
                    const char *window_title);
 
+// Startup without a window or display: creates a GL core context through
+// EGL (surfaceless platform, device platform or pbuffer) and renders every
+// frame into an offscreen framebuffer of the given size.
+StatusCode AppInitHeadless(int width, int height);
+
+// Set the highest GL version requested by AppInit and AppInitHeadless,
+// between APP_MIN_GL_VERSION and 46. Call before initializing.
+void AppSetMaxGLVersion(int version);
+
+// Return the GL version the app may rely on as major * 10 + minor: the
+// version of the current context capped to the highest requested.
+int AppGetGLVersion();
+
+// Return true when the app renders into an offscreen framebuffer.
+bool AppIsHeadless();
+
+// Wait for the display refresh when swapping buffers, or swap as soon as
+// the frame is done. Headless apps never wait.
+void AppSetVSync(bool enabled);
+
+// Ask the main loop to stop, the only way to close a headless app.
+void AppRequestClose();
+
 // Convert a status code into a message and exists the app returning the
 // system status code (E_CODE).
 int AppClose(StatusCode status);
@@ -46,6 +78,15 @@ bool AppShouldClose();
 // Return current delta time.
 float GetDeltaTime();
 
+// Return the frames counted during the last full second.
+int GetFPS();
+
+// Return the time in seconds elapsed since the app started.
+double GetTime();
+
+// Return a monotonic clock in nanoseconds, from an unspecified origin.
+uint64_t GetMonotonicNanoseconds();
+
 // Start a frame
 void BeginFrame();
 
@@ -55,7 +96,8 @@ void EndFrame();
 // Return the size of the main viewport in pixels
 Vec2 GetViewportSize();
 
-// Load the entire file by name into memory
+// Load the entire file by name into memory, the contents are always followed
+// by a null terminator.
 char *LoadFileContents(const char *name);
 
 // Release the contents of a file loaded into memory
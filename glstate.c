@@ -0,0 +1,281 @@
+#include "glstate.h"
+
+#include <assert.h>
+#include <limits.h>
+#include <string.h>
+
+#include <glad/glad.h>
+
+// Marks a shadowed value as unknown so the next call always reaches GL
+#define UNKNOWN UINT_MAX
+
+typedef enum {
+  BUFFER_SLOT_ARRAY,
+  BUFFER_SLOT_ELEMENT_ARRAY,
+  BUFFER_SLOT_UNIFORM,
+  BUFFER_SLOT_PIXEL_PACK,
+  BUFFER_SLOT_PIXEL_UNPACK,
+  BUFFER_SLOT_COPY_READ,
+  BUFFER_SLOT_COPY_WRITE,
+  BUFFER_SLOT_SHADER_STORAGE,
+  BUFFER_SLOT_DRAW_INDIRECT,
+  BUFFER_SLOT_DISPATCH_INDIRECT,
+  BUFFER_SLOT_COUNT,
+} BufferSlot;
+
+typedef enum {
+  CAPABILITY_DEPTH_TEST,
+  CAPABILITY_BLEND,
+  CAPABILITY_CULL_FACE,
+  CAPABILITY_COUNT,
+} CapabilitySlot;
+
+typedef struct {
+  unsigned program;
+  unsigned vao;
+  unsigned buffers[BUFFER_SLOT_COUNT];
+  unsigned activeTexture;
+  unsigned textures2D[GL_STATE_MAX_TEXTURE_UNITS];
+  unsigned texturesCube[GL_STATE_MAX_TEXTURE_UNITS];
+  unsigned capabilities[CAPABILITY_COUNT];
+  unsigned depthFunc;
+  unsigned depthMask;
+  unsigned blendSrc;
+  unsigned blendDst;
+
+  GLStateCounters frame;
+  GLStateCounters last;
+} GLState;
+
+static GLState state = {0};
+
+static int GetBufferSlot(unsigned target) {
+  switch (target) {
+  case GL_ARRAY_BUFFER:
+    return BUFFER_SLOT_ARRAY;
+  case GL_ELEMENT_ARRAY_BUFFER:
+    return BUFFER_SLOT_ELEMENT_ARRAY;
+  case GL_UNIFORM_BUFFER:
+    return BUFFER_SLOT_UNIFORM;
+  case GL_PIXEL_PACK_BUFFER:
+    return BUFFER_SLOT_PIXEL_PACK;
+  case GL_PIXEL_UNPACK_BUFFER:
+    return BUFFER_SLOT_PIXEL_UNPACK;
+  case GL_COPY_READ_BUFFER:
+    return BUFFER_SLOT_COPY_READ;
+  case GL_COPY_WRITE_BUFFER:
+    return BUFFER_SLOT_COPY_WRITE;
+  case GL_SHADER_STORAGE_BUFFER:
+    return BUFFER_SLOT_SHADER_STORAGE;
+  case GL_DRAW_INDIRECT_BUFFER:
+    return BUFFER_SLOT_DRAW_INDIRECT;
+  case GL_DISPATCH_INDIRECT_BUFFER:
+    return BUFFER_SLOT_DISPATCH_INDIRECT;
+  default:
+    return -1;
+  }
+}
+
+static int GetCapabilitySlot(unsigned cap) {
+  switch (cap) {
+  case GL_DEPTH_TEST:
+    return CAPABILITY_DEPTH_TEST;
+  case GL_BLEND:
+    return CAPABILITY_BLEND;
+  case GL_CULL_FACE:
+    return CAPABILITY_CULL_FACE;
+  default:
+    return -1;
+  }
+}
+
+// Update a shadowed value, returns true when the call has to be issued.
+static bool Shadow(unsigned *slot, unsigned value, GLStateCall call) {
+  if (*slot == value) {
+    state.frame.elided[call]++;
+    state.frame.totalElided++;
+    return false;
+  }
+
+  *slot = value;
+  state.frame.issued[call]++;
+  state.frame.totalIssued++;
+  return true;
+}
+
+void GLStateReset() {
+  state.program = UNKNOWN;
+  state.vao = UNKNOWN;
+  for (int i = 0; i < BUFFER_SLOT_COUNT; i++) {
+    state.buffers[i] = UNKNOWN;
+  }
+
+  state.activeTexture = UNKNOWN;
+  for (int i = 0; i < GL_STATE_MAX_TEXTURE_UNITS; i++) {
+    state.textures2D[i] = UNKNOWN;
+    state.texturesCube[i] = UNKNOWN;
+  }
+
+  for (int i = 0; i < CAPABILITY_COUNT; i++) {
+    state.capabilities[i] = UNKNOWN;
+  }
+
+  state.depthFunc = UNKNOWN;
+  state.depthMask = UNKNOWN;
+  state.blendSrc = UNKNOWN;
+  state.blendDst = UNKNOWN;
+}
+
+void GLStateBeginFrame() {
+  state.last = state.frame;
+  memset(&state.frame, 0, sizeof(GLStateCounters));
+}
+
+GLStateCounters GLStateGetCounters() { return state.last; }
+
+GLStateCounters GLStateGetFrameCounters() { return state.frame; }
+
+void GLStateUseProgram(unsigned program) {
+  if (Shadow(&state.program, program, GL_STATE_PROGRAM)) {
+    glUseProgram(program);
+  }
+}
+
+void GLStateBindVertexArray(unsigned vao) {
+  if (Shadow(&state.vao, vao, GL_STATE_VERTEX_ARRAY)) {
+    glBindVertexArray(vao);
+    state.buffers[BUFFER_SLOT_ELEMENT_ARRAY] = UNKNOWN;
+  }
+}
+
+void GLStateBindBuffer(unsigned target, unsigned buffer) {
+  int slot = GetBufferSlot(target);
+  if (slot < 0) {
+    state.frame.issued[GL_STATE_BUFFER]++;
+    state.frame.totalIssued++;
+    glBindBuffer(target, buffer);
+    return;
+  }
+
+  if (Shadow(&state.buffers[slot], buffer, GL_STATE_BUFFER)) {
+    glBindBuffer(target, buffer);
+  }
+}
+
+void GLStateBindTexture(unsigned unit, unsigned target, unsigned texture) {
+  assert(unit < GL_STATE_MAX_TEXTURE_UNITS &&
+         "invalid arg unit: outside range");
+  assert((target == GL_TEXTURE_2D || target == GL_TEXTURE_CUBE_MAP) &&
+         "invalid arg target: unsupported texture target");
+
+  unsigned *slot = target == GL_TEXTURE_2D ? &state.textures2D[unit]
+                                           : &state.texturesCube[unit];
+  if (*slot == texture) {
+    state.frame.elided[GL_STATE_TEXTURE]++;
+    state.frame.totalElided++;
+    return;
+  }
+
+  if (Shadow(&state.activeTexture, GL_TEXTURE0 + unit, GL_STATE_TEXTURE)) {
+    glActiveTexture(GL_TEXTURE0 + unit);
+  }
+
+  Shadow(slot, texture, GL_STATE_TEXTURE);
+  glBindTexture(target, texture);
+}
+
+void GLStateSetCapability(unsigned cap, bool enabled) {
+  int slot = GetCapabilitySlot(cap);
+  if (slot >= 0 && !Shadow(&state.capabilities[slot], enabled,
+                           GL_STATE_CAPABILITY)) {
+    return;
+  }
+
+  if (slot < 0) {
+    state.frame.issued[GL_STATE_CAPABILITY]++;
+    state.frame.totalIssued++;
+  }
+
+  if (enabled) {
+    glEnable(cap);
+  } else {
+    glDisable(cap);
+  }
+}
+
+void GLStateDepthFunc(unsigned func) {
+  if (Shadow(&state.depthFunc, func, GL_STATE_DEPTH)) {
+    glDepthFunc(func);
+  }
+}
+
+void GLStateDepthMask(bool mask) {
+  if (Shadow(&state.depthMask, mask, GL_STATE_DEPTH)) {
+    glDepthMask(mask ? GL_TRUE : GL_FALSE);
+  }
+}
+
+void GLStateBlendFunc(unsigned src, unsigned dst) {
+  if (state.blendSrc == src && state.blendDst == dst) {
+    state.frame.elided[GL_STATE_BLEND]++;
+    state.frame.totalElided++;
+    return;
+  }
+
+  state.blendSrc = src;
+  state.blendDst = dst;
+  state.frame.issued[GL_STATE_BLEND]++;
+  state.frame.totalIssued++;
+  glBlendFunc(src, dst);
+}
+
+void GLStateDeleteProgram(unsigned program) {
+  if (program == 0) {
+    return;
+  }
+
+  // Deleting the program in use only flags it, keep it shadowed as bound
+  glDeleteProgram(program);
+}
+
+void GLStateDeleteVertexArray(unsigned vao) {
+  if (vao == 0) {
+    return;
+  }
+
+  if (state.vao == vao) {
+    state.vao = 0;
+    state.buffers[BUFFER_SLOT_ELEMENT_ARRAY] = UNKNOWN;
+  }
+  glDeleteVertexArrays(1, &vao);
+}
+
+void GLStateDeleteBuffer(unsigned buffer) {
+  if (buffer == 0) {
+    return;
+  }
+
+  for (int i = 0; i < BUFFER_SLOT_COUNT; i++) {
+    if (state.buffers[i] == buffer) {
+      state.buffers[i] = 0;
+    }
+  }
+  glDeleteBuffers(1, &buffer);
+}
+
+void GLStateDeleteTexture(unsigned texture) {
+  if (texture == 0) {
+    return;
+  }
+
+  for (int i = 0; i < GL_STATE_MAX_TEXTURE_UNITS; i++) {
+    if (state.textures2D[i] == texture) {
+      state.textures2D[i] = 0;
+    }
+
+    if (state.texturesCube[i] == texture) {
+      state.texturesCube[i] = 0;
+    }
+  }
+  glDeleteTextures(1, &texture);
+}
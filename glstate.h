@@ -0,0 +1,69 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+
+#define GL_STATE_MAX_TEXTURE_UNITS 16
+
+// Kinds of state changes tracked by the cache
+typedef enum {
+  GL_STATE_PROGRAM,
+  GL_STATE_VERTEX_ARRAY,
+  GL_STATE_BUFFER,
+  GL_STATE_TEXTURE,
+  GL_STATE_CAPABILITY,
+  GL_STATE_DEPTH,
+  GL_STATE_BLEND,
+  GL_STATE_CALL_COUNT,
+} GLStateCall;
+
+// Number of GL calls issued to the driver and elided by the cache
+typedef struct {
+  size_t issued[GL_STATE_CALL_COUNT];
+  size_t elided[GL_STATE_CALL_COUNT];
+  size_t totalIssued;
+  size_t totalElided;
+} GLStateCounters;
+
+// Forget all the shadowed state, the next call of each kind always reaches
+// GL. Use after creating a context or after calling GL directly.
+void GLStateReset();
+
+// Start counting calls for a new frame.
+void GLStateBeginFrame();
+
+// Return the counters of the last finished frame.
+GLStateCounters GLStateGetCounters();
+
+// Return the counters of the frame in progress.
+GLStateCounters GLStateGetFrameCounters();
+
+// Cached glUseProgram.
+void GLStateUseProgram(unsigned program);
+
+// Cached glBindVertexArray, element array bindings belong to the vertex array
+// so they are forgotten every time it changes.
+void GLStateBindVertexArray(unsigned vao);
+
+// Cached glBindBuffer, unknown targets are always issued.
+void GLStateBindBuffer(unsigned target, unsigned buffer);
+
+// Cached glActiveTexture + glBindTexture for 2D and cube map targets.
+void GLStateBindTexture(unsigned unit, unsigned target, unsigned texture);
+
+// Cached glEnable/glDisable for depth test, blend and face culling.
+void GLStateSetCapability(unsigned cap, bool enabled);
+
+// Cached glDepthFunc.
+void GLStateDepthFunc(unsigned func);
+
+// Cached glDepthMask.
+void GLStateDepthMask(bool mask);
+
+// Cached glBlendFunc.
+void GLStateBlendFunc(unsigned src, unsigned dst);
+
+// Delete GL objects forgetting them from the cache if they are bound.
+void GLStateDeleteProgram(unsigned program);
+void GLStateDeleteVertexArray(unsigned vao);
+void GLStateDeleteBuffer(unsigned buffer);
+void GLStateDeleteTexture(unsigned texture);
@@ -0,0 +1,373 @@
+#include "gpuscene.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glad/glad.h>
+
+#include "glstate.h"
+#include "profile.h"
+#include "render.h"
+#include "stats.h"
+#include "util.h"
+
+bool GpuSceneIsSupported() {
+  return AppGetGLVersion() >= 43 && GLAD_GL_ARB_compute_shader &&
+         GLAD_GL_ARB_shader_storage_buffer_object &&
+         GLAD_GL_ARB_multi_draw_indirect && GLAD_GL_ARB_shader_image_load_store;
+}
+
+GpuScene MakeGpuScene(const char *cullPath) {
+  assert(cullPath != NULL && "invalid arg cullPath: cannot be NULL");
+  GpuScene scene = {0};
+  if (!GpuSceneIsSupported()) {
+    Log(LOG_ERROR, "GPU culling needs GL 4.3, context is %d.%d",
+        AppGetGLVersion() / 10, AppGetGLVersion() % 10);
+    scene.status = E_CANNOT_LOAD_GL;
+    return scene;
+  }
+
+  scene.cull = LoadComputeShader(cullPath);
+  if (scene.cull.status != SUCCESS) {
+    scene.status = scene.cull.status;
+    return scene;
+  }
+
+  scene.planesLoc = ShaderGetUniformLocation(scene.cull, "planes[0]");
+  scene.instancesCountLoc =
+      ShaderGetUniformLocation(scene.cull, "instancesCount");
+
+  glGenBuffers(1, &scene.instancesBuffer);
+  glGenBuffers(1, &scene.commandsBuffer);
+
+  // Binding once creates the buffer objects, vertex arrays can refer to them
+  GLStateBindBuffer(GL_SHADER_STORAGE_BUFFER, scene.instancesBuffer);
+  GLStateBindBuffer(GL_SHADER_STORAGE_BUFFER, scene.commandsBuffer);
+  scene.status = SUCCESS;
+  return scene;
+}
+
+void DestroyGpuScene(GpuScene scene) {
+  GLStateDeleteBuffer(scene.instancesBuffer);
+  GLStateDeleteBuffer(scene.commandsBuffer);
+  if (scene.cull.spId != 0) {
+    DestroyShader(scene.cull);
+  }
+
+  free(scene.instances);
+  free(scene.instanceBatches);
+  free(scene.objects);
+  free(scene.batches);
+}
+
+// Feed the model matrix of the instances buffer to a vertex array, one
+// column per location advancing once per instance
+static void AttachInstanceAttributes(const GpuScene *scene, unsigned vao) {
+  GLStateBindVertexArray(vao);
+  GLStateBindBuffer(GL_ARRAY_BUFFER, scene->instancesBuffer);
+  for (unsigned i = 0; i < 4; i++) {
+    unsigned location = GPU_SCENE_MODEL_LOCATION + i;
+    glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(GpuInstance),
+                          (void *)(offsetof(GpuInstance, model) +
+                                   i * 4 * sizeof(float)));
+    glVertexAttribDivisor(location, 1);
+    glEnableVertexAttribArray(location);
+  }
+}
+
+static size_t GetBatch(GpuScene *scene, const Mesh *mesh, unsigned program) {
+  for (size_t i = 0; i < scene->batchesCount; i++) {
+    GpuBatch *batch = scene->batches + i;
+    if (batch->mesh == mesh && batch->program == program) {
+      return i;
+    }
+  }
+
+  if (!Grow((void **)&scene->batches, &scene->batchesCapacity,
+            scene->batchesCount + 1, sizeof(GpuBatch))) {
+    return SIZE_MAX;
+  }
+
+  GpuBatch *batch = scene->batches + scene->batchesCount;
+  memset(batch, 0, sizeof(GpuBatch));
+  batch->mesh = mesh;
+  batch->program = program;
+  AttachInstanceAttributes(scene, mesh->vao);
+  return scene->batchesCount++;
+}
+
+static bool ReserveInstances(GpuScene *scene, size_t count) {
+  size_t capacity = scene->instancesCapacity;
+  if (!Grow((void **)&scene->instances, &capacity, count,
+            sizeof(GpuInstance))) {
+    return false;
+  }
+
+  capacity = scene->instancesCapacity;
+  if (!Grow((void **)&scene->instanceBatches, &capacity, count,
+            sizeof(size_t))) {
+    return false;
+  }
+
+  scene->instancesCapacity = capacity;
+  return true;
+}
+
+size_t GpuSceneAdd(GpuScene *scene, const Model *model) {
+  assert(scene != NULL && "invalid arg scene: cannot be NULL");
+  assert(model != NULL && "invalid arg model: cannot be NULL");
+  assert((model->shader.variant & SHADER_VARIANT_INDIRECT) &&
+         "invalid arg model: shader must be an indirect variant");
+  if (scene->status != SUCCESS) {
+    return SIZE_MAX;
+  }
+
+  size_t count = scene->instancesCount + model->meshesCount;
+  if (!ReserveInstances(scene, count) ||
+      !Grow((void **)&scene->objects, &scene->objectsCapacity,
+            scene->objectsCount + 1, sizeof(GpuObject))) {
+    Log(LOG_ERROR, "cannot grow GPU scene (out of memory)");
+    scene->status = E_OUT_OF_MEMORY;
+    return SIZE_MAX;
+  }
+
+  GpuObject *object = scene->objects + scene->objectsCount;
+  object->firstInstance = scene->instancesCount;
+  object->instancesCount = 0;
+
+  Mat4 modelMat = TransformGetModelMatrix(model->transform);
+  for (size_t i = 0; i < model->meshesCount; i++) {
+    const Mesh *mesh = model->meshes + i;
+    size_t batch = GetBatch(scene, mesh, model->shader.spId);
+    if (batch == SIZE_MAX) {
+      Log(LOG_ERROR, "cannot grow GPU scene batches (out of memory)");
+      scene->status = E_OUT_OF_MEMORY;
+      return SIZE_MAX;
+    }
+
+    size_t index = scene->instancesCount++;
+    GpuInstance *instance = scene->instances + index;
+    memset(instance, 0, sizeof(GpuInstance));
+    instance->model = modelMat;
+    instance->boundsMin = mesh->boundsMin;
+    instance->boundsMax = mesh->boundsMax;
+    scene->instanceBatches[index] = batch;
+    object->instancesCount++;
+  }
+
+  scene->layoutDirty = true;
+  return scene->objectsCount++;
+}
+
+void GpuSceneSetTransform(GpuScene *scene, size_t object, Mat4 modelMat) {
+  assert(scene != NULL && "invalid arg scene: cannot be NULL");
+  assert(object < scene->objectsCount && "invalid arg object: outside range");
+
+  GpuObject *obj = scene->objects + object;
+  if (obj->instancesCount == 0) {
+    return;
+  }
+
+  for (size_t i = 0; i < obj->instancesCount; i++) {
+    scene->instances[obj->firstInstance + i].model = modelMat;
+  }
+
+  size_t first = obj->firstInstance;
+  size_t last = first + obj->instancesCount;
+  if (scene->dirtyMax == 0) {
+    scene->dirtyMin = first;
+    scene->dirtyMax = last;
+  } else {
+    scene->dirtyMin = first < scene->dirtyMin ? first : scene->dirtyMin;
+    scene->dirtyMax = last > scene->dirtyMax ? last : scene->dirtyMax;
+  }
+}
+
+// Sort the draw commands by batch and upload every instance and command.
+// Only needed after adding instances.
+static bool RebuildCommands(GpuScene *scene) {
+  size_t count = scene->instancesCount;
+  GpuDrawCommand *commands = malloc(count * sizeof(GpuDrawCommand));
+  if (commands == NULL) {
+    return false;
+  }
+
+  for (size_t b = 0; b < scene->batchesCount; b++) {
+    scene->batches[b].commandsCount = 0;
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    size_t b = scene->instanceBatches[i];
+    scene->batches[b].commandsCount++;
+  }
+
+  for (size_t b = 0, first = 0; b < scene->batchesCount; b++) {
+    scene->batches[b].firstCommand = first;
+    first += scene->batches[b].commandsCount;
+    scene->batches[b].commandsCount = 0;
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    GpuBatch *batch = scene->batches + scene->instanceBatches[i];
+    size_t index = batch->firstCommand + batch->commandsCount++;
+    scene->instances[i].command = (uint32_t)index;
+
+    GpuDrawCommand *command = commands + index;
+    command->count = (uint32_t)batch->mesh->indicesCount;
+    command->instanceCount = 1;
+    command->firstIndex = 0;
+    command->baseVertex = 0;
+    command->baseInstance = (uint32_t)i;
+  }
+
+  // Storage only grows, vertex arrays keep referring to the same buffers
+  if (count > scene->buffersCapacity) {
+    size_t capacity = scene->buffersCapacity > 0 ? scene->buffersCapacity : 64;
+    while (capacity < count) {
+      capacity *= 2;
+    }
+
+    GLStateBindBuffer(GL_SHADER_STORAGE_BUFFER, scene->instancesBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER,
+                 (GLsizeiptr)(capacity * sizeof(GpuInstance)), NULL,
+                 GL_DYNAMIC_DRAW);
+    GLStateBindBuffer(GL_SHADER_STORAGE_BUFFER, scene->commandsBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER,
+                 (GLsizeiptr)(capacity * sizeof(GpuDrawCommand)), NULL,
+                 GL_DYNAMIC_DRAW);
+    scene->buffersCapacity = capacity;
+  }
+
+  GLStateBindBuffer(GL_SHADER_STORAGE_BUFFER, scene->instancesBuffer);
+  glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0,
+                  (GLsizeiptr)(count * sizeof(GpuInstance)), scene->instances);
+  GLStateBindBuffer(GL_SHADER_STORAGE_BUFFER, scene->commandsBuffer);
+  glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0,
+                  (GLsizeiptr)(count * sizeof(GpuDrawCommand)), commands);
+  scene->stats.uploadedBytes +=
+      count * (sizeof(GpuInstance) + sizeof(GpuDrawCommand));
+
+  free(commands);
+  return true;
+}
+
+// Frustum planes (a, b, c, d) of a view projection matrix, points with
+// a * x + b * y + c * z + d < 0 are outside. Not normalized.
+static void GetFrustumPlanes(Mat4 m, float planes[6][4]) {
+  float rows[4][4] = {
+      {m.xx, m.yx, m.zx, m.wx},
+      {m.xy, m.yy, m.zy, m.wy},
+      {m.xz, m.yz, m.zz, m.wz},
+      {m.xw, m.yw, m.zw, m.ww},
+  };
+
+  for (int p = 0; p < 6; p++) {
+    float sign = p % 2 == 0 ? 1.0f : -1.0f;
+    for (int i = 0; i < 4; i++) {
+      planes[p][i] = rows[3][i] + sign * rows[p / 2][i];
+    }
+  }
+}
+
+void GpuSceneDraw(GpuScene *scene, Camera camera) {
+  assert(scene != NULL && "invalid arg scene: cannot be NULL");
+  memset(&scene->stats, 0, sizeof(GpuSceneStats));
+  if (scene->status != SUCCESS || scene->instancesCount == 0) {
+    return;
+  }
+
+  PROFILE_ZONE("GpuSceneDraw");
+  PROFILE_GPU_ZONE("GpuSceneDraw");
+  double start = GetTime();
+  CameraUniforms uniforms = UploadCameraUniforms(camera);
+
+  if (scene->layoutDirty) {
+    if (!RebuildCommands(scene)) {
+      Log(LOG_ERROR, "cannot build GPU scene commands (out of memory)");
+      scene->status = E_OUT_OF_MEMORY;
+      return;
+    }
+    scene->layoutDirty = false;
+  } else if (scene->dirtyMax > 0) {
+    size_t offset = scene->dirtyMin * sizeof(GpuInstance);
+    size_t size = (scene->dirtyMax - scene->dirtyMin) * sizeof(GpuInstance);
+    GLStateBindBuffer(GL_SHADER_STORAGE_BUFFER, scene->instancesBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, (GLintptr)offset,
+                    (GLsizeiptr)size, scene->instances + scene->dirtyMin);
+    scene->stats.uploadedBytes += size;
+  }
+  scene->dirtyMin = 0;
+  scene->dirtyMax = 0;
+
+  // One invocation per instance writes the instance count of its command
+  float planes[6][4];
+  GetFrustumPlanes(uniforms.viewProj, planes);
+  GLStateUseProgram(scene->cull.spId);
+  glUniform4fv(scene->planesLoc, 6, &planes[0][0]);
+  glUniform1ui(scene->instancesCountLoc, (unsigned)scene->instancesCount);
+  FrameStatsAdd(FRAME_STAT_UNIFORM_UPLOADS, 2.0);
+
+  GLStateBindBuffer(GL_SHADER_STORAGE_BUFFER, scene->instancesBuffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GPU_SCENE_INSTANCES_BINDING,
+                   scene->instancesBuffer);
+  GLStateBindBuffer(GL_SHADER_STORAGE_BUFFER, scene->commandsBuffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GPU_SCENE_COMMANDS_BINDING,
+                   scene->commandsBuffer);
+
+  size_t groups =
+      (scene->instancesCount + GPU_SCENE_GROUP_SIZE - 1) / GPU_SCENE_GROUP_SIZE;
+  glDispatchCompute((unsigned)groups, 1, 1);
+  glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+
+  // Every batch is a single multi draw, culled commands draw nothing
+  GLStateSetCapability(GL_BLEND, false);
+  GLStateDepthMask(true);
+  GLStateBindBuffer(GL_DRAW_INDIRECT_BUFFER, scene->commandsBuffer);
+  for (size_t i = 0; i < scene->batchesCount; i++) {
+    GpuBatch *batch = scene->batches + i;
+    GLStateUseProgram(batch->program);
+    GLStateBindVertexArray(batch->mesh->vao);
+    glMultiDrawElementsIndirect(
+        GL_TRIANGLES, batch->mesh->indexType,
+        (const void *)(batch->firstCommand * sizeof(GpuDrawCommand)),
+        (GLsizei)batch->commandsCount, 0);
+
+    // Culled on the GPU, counts every instance submitted
+    size_t count = batch->commandsCount;
+    FrameStatsAddDraw(count * batch->mesh->verticesCount,
+                      count * batch->mesh->indicesCount / 3);
+  }
+
+  scene->stats.instances = scene->instancesCount;
+  scene->stats.batches = scene->batchesCount;
+  scene->stats.drawCalls = scene->batchesCount;
+  scene->stats.cpuMs = (GetTime() - start) * 1000.0;
+  FrameStatsAdd(FRAME_STAT_UPLOADED_BYTES, (double)scene->stats.uploadedBytes);
+}
+
+size_t GpuSceneGetVisibleCount(GpuScene *scene) {
+  assert(scene != NULL && "invalid arg scene: cannot be NULL");
+  if (scene->status != SUCCESS || scene->instancesCount == 0) {
+    return 0;
+  }
+
+  size_t count = scene->instancesCount;
+  GpuDrawCommand *commands = malloc(count * sizeof(GpuDrawCommand));
+  if (commands == NULL) {
+    return 0;
+  }
+
+  glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+  GLStateBindBuffer(GL_SHADER_STORAGE_BUFFER, scene->commandsBuffer);
+  glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0,
+                     (GLsizeiptr)(count * sizeof(GpuDrawCommand)), commands);
+
+  size_t visible = 0;
+  for (size_t i = 0; i < count; i++) {
+    visible += commands[i].instanceCount;
+  }
+
+  free(commands);
+  return visible;
+}
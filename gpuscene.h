@@ -0,0 +1,127 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <xmath/mat4.h>
+#include <xmath/vec3.h>
+
+#include "camera.h"
+#include "core.h"
+#include "model.h"
+
+// Invocations per workgroup of the culling compute shader (cull_cs.glsl)
+#define GPU_SCENE_GROUP_SIZE 64
+
+// Buffer bindings of the culling compute shader
+#define GPU_SCENE_INSTANCES_BINDING 0
+#define GPU_SCENE_COMMANDS_BINDING 1
+
+// First vertex attribute of the per instance model matrix, it takes four
+// locations (see HAS_INDIRECT in def_vs.glsl)
+#define GPU_SCENE_MODEL_LOCATION 6
+
+// A mesh instance as laid out (std430) in the instances buffer. The model
+// matrix is also read as an instanced vertex attribute by indirect variants.
+typedef struct {
+  Mat4 model;
+  Vec3 boundsMin;
+  uint32_t command;
+  Vec3 boundsMax;
+  uint32_t padding;
+} GpuInstance;
+
+// Arguments of glMultiDrawElementsIndirect, one command per instance
+typedef struct {
+  uint32_t count;
+  uint32_t instanceCount;
+  uint32_t firstIndex;
+  int32_t baseVertex;
+  uint32_t baseInstance;
+} GpuDrawCommand;
+
+// Instances sharing a program and a mesh, drawn by a single multi draw from
+// consecutive commands
+typedef struct {
+  const Mesh *mesh;
+  unsigned program;
+  size_t firstCommand;
+  size_t commandsCount;
+} GpuBatch;
+
+// A model added to the scene, its meshes are consecutive instances
+typedef struct {
+  size_t firstInstance;
+  size_t instancesCount;
+} GpuObject;
+
+// Counters and CPU time of the last draw
+typedef struct {
+  size_t instances;
+  size_t batches;
+  size_t drawCalls;
+  size_t uploadedBytes;
+  double cpuMs;
+} GpuSceneStats;
+
+// GpuScene keeps mesh instances on the GPU and culls them there: a compute
+// shader tests every instance against the camera frustum and writes the
+// instance count of its draw command, which the batches then consume with
+// glMultiDrawElementsIndirect. The CPU cost of a frame depends on the number
+// of batches and of the instances changed, not on the number of instances.
+typedef struct {
+  Shader cull;
+  int planesLoc;
+  int instancesCountLoc;
+
+  unsigned instancesBuffer;
+  unsigned commandsBuffer;
+  size_t buffersCapacity;
+
+  // CPU copies of the instances, uploaded when they change
+  GpuInstance *instances;
+  size_t *instanceBatches;
+  size_t instancesCount;
+  size_t instancesCapacity;
+
+  GpuObject *objects;
+  size_t objectsCount;
+  size_t objectsCapacity;
+
+  GpuBatch *batches;
+  size_t batchesCount;
+  size_t batchesCapacity;
+
+  // Instances changed since the last draw and whether commands are stale
+  size_t dirtyMin;
+  size_t dirtyMax;
+  bool layoutDirty;
+
+  GpuSceneStats stats;
+  StatusCode status;
+} GpuScene;
+
+// Return true when the context supports compute shaders, storage buffers and
+// indirect multi draws (GL 4.3). Without them use a RenderQueue instead.
+bool GpuSceneIsSupported();
+
+// Make an empty scene loading the culling compute shader.
+GpuScene MakeGpuScene(const char *cullPath);
+
+// Release the buffers and the compute program of a scene.
+void DestroyGpuScene(GpuScene scene);
+
+// Add every mesh of an uploaded model as an instance, drawn with the model
+// shader which must be a SHADER_VARIANT_INDIRECT variant. The vertex arrays
+// of the meshes get the per instance attributes of this scene, so a mesh can
+// only belong to one scene. Returns the object handle of the model.
+size_t GpuSceneAdd(GpuScene *scene, const Model *model);
+
+// Change the model matrix of an object, uploaded on the next draw.
+void GpuSceneSetTransform(GpuScene *scene, size_t object, Mat4 modelMat);
+
+// Upload the camera uniforms and the changed instances, cull every instance
+// on the GPU and draw the visible ones.
+void GpuSceneDraw(GpuScene *scene, Camera camera);
+
+// Read back how many instances passed the culling in the last draw. Waits
+// for the GPU, meant for tests and benchmarks only.
+size_t GpuSceneGetVisibleCount(GpuScene *scene);
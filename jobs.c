@@ -0,0 +1,135 @@
+#include "jobs.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "profile.h"
+
+size_t GetProcessorsCount() {
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+  return count > 0 ? (size_t)count : 1;
+}
+
+static void RunJobs(JobPool *pool) {
+  PROFILE_ZONE("Jobs");
+  size_t index;
+  while ((index = atomic_fetch_add(&pool->next, 1)) < pool->count) {
+    pool->func(pool->data, index);
+  }
+}
+
+static void *JobWorker(void *arg) {
+  JobPool *pool = arg;
+  unsigned long seen = 0;
+  ProfileSetThreadName("jobs");
+
+  pthread_mutex_lock(&pool->mutex);
+  for (;;) {
+    while (!pool->quit && pool->generation == seen) {
+      pthread_cond_wait(&pool->wake, &pool->mutex);
+    }
+
+    if (pool->quit) {
+      break;
+    }
+
+    seen = pool->generation;
+    pthread_mutex_unlock(&pool->mutex);
+
+    RunJobs(pool);
+
+    pthread_mutex_lock(&pool->mutex);
+    if (--pool->active == 0) {
+      pthread_cond_signal(&pool->done);
+    }
+  }
+  pthread_mutex_unlock(&pool->mutex);
+  return NULL;
+}
+
+JobPool *MakeJobPool(size_t threadsCount) {
+  if (threadsCount > JOBS_MAX_THREADS) {
+    threadsCount = JOBS_MAX_THREADS;
+  }
+
+  JobPool *pool = calloc(1, sizeof(JobPool));
+  if (pool == NULL) {
+    return NULL;
+  }
+
+  pthread_mutex_init(&pool->mutex, NULL);
+  pthread_cond_init(&pool->wake, NULL);
+  pthread_cond_init(&pool->done, NULL);
+  atomic_init(&pool->next, 0);
+
+  for (size_t i = 0; i < threadsCount; i++) {
+    if (pthread_create(&pool->threads[i], NULL, JobWorker, pool) != 0) {
+      break;
+    }
+    pool->threadsCount++;
+  }
+  return pool;
+}
+
+void DestroyJobPool(JobPool *pool) {
+  if (pool == NULL) {
+    return;
+  }
+
+  pthread_mutex_lock(&pool->mutex);
+  pool->quit = true;
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->mutex);
+
+  for (size_t i = 0; i < pool->threadsCount; i++) {
+    pthread_join(pool->threads[i], NULL);
+  }
+
+  pthread_cond_destroy(&pool->done);
+  pthread_cond_destroy(&pool->wake);
+  pthread_mutex_destroy(&pool->mutex);
+  free(pool);
+}
+
+void JobPoolParallelFor(JobPool *pool, size_t count, JobFunc func,
+                        void *data) {
+  assert(func != NULL && "invalid arg func: cannot be NULL");
+
+  // Not worth waking the workers for a single job
+  if (pool == NULL || pool->threadsCount == 0 || count <= 1) {
+    for (size_t i = 0; i < count; i++) {
+      func(data, i);
+    }
+    return;
+  }
+
+  // A pool holds a single loop, others run on their own thread meanwhile
+  pthread_mutex_lock(&pool->mutex);
+  if (pool->busy) {
+    pthread_mutex_unlock(&pool->mutex);
+    for (size_t i = 0; i < count; i++) {
+      func(data, i);
+    }
+    return;
+  }
+
+  pool->busy = true;
+  pool->func = func;
+  pool->data = data;
+  pool->count = count;
+  atomic_store(&pool->next, 0);
+  pool->active = pool->threadsCount;
+  pool->generation++;
+  pthread_cond_broadcast(&pool->wake);
+  pthread_mutex_unlock(&pool->mutex);
+
+  RunJobs(pool);
+
+  pthread_mutex_lock(&pool->mutex);
+  while (pool->active > 0) {
+    pthread_cond_wait(&pool->done, &pool->mutex);
+  }
+  pool->busy = false;
+  pthread_mutex_unlock(&pool->mutex);
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define JOBS_MAX_THREADS 64
+
+// Work done for a single index of a parallel for
+typedef void (*JobFunc)(void *data, size_t index);
+
+// JobPool keeps worker threads waiting for parallel for loops, the calling
+// thread takes part in every loop too.
+typedef struct {
+  pthread_t threads[JOBS_MAX_THREADS];
+  size_t threadsCount;
+
+  pthread_mutex_t mutex;
+  pthread_cond_t wake;
+  pthread_cond_t done;
+  unsigned long generation;
+  size_t active;
+  bool busy;
+  bool quit;
+
+  JobFunc func;
+  void *data;
+  size_t count;
+  atomic_size_t next;
+} JobPool;
+
+// Return the number of processors available to this process.
+size_t GetProcessorsCount();
+
+// Start a pool with the given number of worker threads, zero runs every loop
+// on the calling thread. Returns NULL when out of memory.
+JobPool *MakeJobPool(size_t threadsCount);
+
+// Stop the workers and release the pool.
+void DestroyJobPool(JobPool *pool);
+
+// Call func for every index in [0, count) across the pool and wait for all of
+// them to finish. Indices are handed out one at a time, in increasing order.
+// A NULL pool runs the loop on the calling thread, and so does a pool already
+// running a loop for another thread or for the job calling it.
+void JobPoolParallelFor(JobPool *pool, size_t count, JobFunc func, void *data);
@@ -0,0 +1,163 @@
+#include "json.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "profile.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define JSON_USE_SSE
+#endif
+
+// Bytes classified together, one bit of a mask each
+#define JSON_BLOCK_SIZE 64
+
+// Characters of a block by class, bit i standing for byte i
+typedef struct {
+  uint64_t quotes;
+  uint64_t backslashes;
+  uint64_t opens;
+  uint64_t structurals;
+  uint64_t whitespaces;
+} JsonBlock;
+
+// What a block leaves to the next one
+typedef struct {
+  bool escaped;
+  uint64_t inString;
+  uint64_t inPrimitive;
+} JsonCarry;
+
+#if defined(JSON_USE_SSE)
+static uint64_t GetMask(__m128i chunks[4], __m128i c) {
+  uint64_t mask = 0;
+  for (int i = 0; i < 4; i++) {
+    uint64_t bits = (uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunks[i], c));
+    mask |= bits << (i * 16);
+  }
+  return mask;
+}
+#endif
+
+// Objects and arrays open with { and [, which only differ in the 0x20 bit,
+// and so do the } and ] closing them. Whitespace is anything up to a space,
+// the only such characters valid outside strings.
+static void ClassifyBlock(const uint8_t *src, JsonBlock *block) {
+#if defined(JSON_USE_SSE)
+  __m128i chunks[4];
+  __m128i folded[4];
+  __m128i bit = _mm_set1_epi8(0x20);
+  for (int i = 0; i < 4; i++) {
+    chunks[i] = _mm_loadu_si128((const __m128i *)(src + i * 16));
+    folded[i] = _mm_or_si128(chunks[i], bit);
+  }
+
+  // Whitespace where the unsigned maximum with a space is a space
+  __m128i spaces[4];
+  for (int i = 0; i < 4; i++) {
+    spaces[i] = _mm_max_epu8(chunks[i], bit);
+  }
+
+  block->quotes = GetMask(chunks, _mm_set1_epi8('"'));
+  block->backslashes = GetMask(chunks, _mm_set1_epi8('\\'));
+  block->opens = GetMask(folded, _mm_set1_epi8('{'));
+  block->structurals = block->opens | GetMask(folded, _mm_set1_epi8('}')) |
+                       GetMask(chunks, _mm_set1_epi8(':')) |
+                       GetMask(chunks, _mm_set1_epi8(','));
+  block->whitespaces = GetMask(spaces, bit);
+#else
+  memset(block, 0, sizeof(*block));
+  for (int i = 0; i < JSON_BLOCK_SIZE; i++) {
+    uint64_t bit = (uint64_t)1 << i;
+    uint8_t c = src[i];
+    uint8_t folded = c | 0x20;
+    block->quotes |= c == '"' ? bit : 0;
+    block->backslashes |= c == '\\' ? bit : 0;
+    block->opens |= folded == '{' ? bit : 0;
+    block->structurals |= folded == '{' || folded == '}' || c == ':' ||
+                                  c == ','
+                              ? bit
+                              : 0;
+    block->whitespaces |= c <= ' ' ? bit : 0;
+  }
+#endif
+}
+
+static size_t CountBits(uint64_t v) {
+  v = v - ((v >> 1) & 0x5555555555555555ull);
+  v = (v & 0x3333333333333333ull) + ((v >> 2) & 0x3333333333333333ull);
+  v = (v + (v >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+  return (size_t)((v * 0x0101010101010101ull) >> 56);
+}
+
+// Bits set from every set bit of v up to the next one, excluded
+static uint64_t PrefixXor(uint64_t v) {
+  v ^= v << 1;
+  v ^= v << 2;
+  v ^= v << 4;
+  v ^= v << 8;
+  v ^= v << 16;
+  v ^= v << 32;
+  return v;
+}
+
+// Characters escaped by a backslash, which is not escaped itself. Only
+// strings have backslashes, they are rare enough to go one by one.
+static uint64_t GetEscaped(uint64_t backslashes, JsonCarry *carry) {
+  uint64_t escaped = carry->escaped ? 1 : 0;
+  backslashes &= ~escaped;
+  carry->escaped = false;
+  while (backslashes != 0) {
+    uint64_t lowest = backslashes & (~backslashes + 1);
+    escaped |= lowest << 1;
+    carry->escaped = lowest >> 63;
+    backslashes &= ~(lowest | lowest << 1);
+  }
+  return escaped;
+}
+
+// Tokens starting in a block: the quotes opening strings, the characters
+// opening objects and arrays and the first characters of primitives
+static size_t CountBlockTokens(const JsonBlock *block, JsonCarry *carry) {
+  uint64_t quotes = block->quotes &
+                    ~GetEscaped(block->backslashes, carry);
+
+  // Strings from their opening quote up to their closing one, excluded
+  uint64_t inString = PrefixXor(quotes) ^ carry->inString;
+  carry->inString = (uint64_t)((int64_t)inString >> 63);
+
+  uint64_t primitives = ~(block->structurals | block->whitespaces | quotes |
+                          inString);
+  uint64_t starts = primitives & ~(primitives << 1 | carry->inPrimitive);
+  carry->inPrimitive = primitives >> 63;
+
+  return CountBits(quotes & inString) +
+         CountBits(block->opens & ~inString) + CountBits(starts);
+}
+
+size_t CountJsonTokens(const char *json, size_t size) {
+  assert((json != NULL || size == 0) && "invalid arg json: cannot be NULL");
+  PROFILE_ZONE("CountJsonTokens");
+  const uint8_t *src = (const uint8_t *)json;
+  JsonCarry carry = {0};
+  JsonBlock block;
+  size_t count = 0;
+  size_t i = 0;
+  for (; i + JSON_BLOCK_SIZE <= size; i += JSON_BLOCK_SIZE) {
+    ClassifyBlock(src + i, &block);
+    count += CountBlockTokens(&block, &carry);
+  }
+
+  // The last bytes padded with whitespace
+  if (i < size) {
+    uint8_t last[JSON_BLOCK_SIZE];
+    memset(last, ' ', sizeof(last));
+    memcpy(last, src + i, size - i);
+    ClassifyBlock(last, &block);
+    count += CountBlockTokens(&block, &carry);
+  }
+  return carry.inString != 0 ? 0 : count;
+}
@@ -0,0 +1,10 @@
+#pragma once
+#include <stddef.h>
+
+// Count the tokens jsmn, the tokenizer of cgltf, splits a JSON document of
+// size bytes into: objects, arrays, strings (keys included) and primitives.
+// Quotes and structural characters are classified in blocks of 64 bytes.
+// Given to cgltf as options.json_token_count it saves the pass jsmn makes
+// only to count them. Returns 0 when a string is not closed, other errors
+// are left for jsmn to report and may give any count.
+size_t CountJsonTokens(const char *json, size_t size);
@@ -1,48 +1,435 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glad/glad.h>
+
 #include "camera.h"
 #include "core.h"
+#include "jobs.h"
 #include "model.h"
+#include "profile.h"
+#include "render.h"
+#include "stats.h"
 
 #define WINDOW_WIDTH 500
 #define WINDOW_HEIGTH 500
 #define WINDOW_TITLE "SimpleGLTF"
+#define DEFAULT_MODEL "assets/uwu.gltf"
 
-int main() {
-  StatusCode status;
+// Benchmark mode steps the scene by a fixed time and skips a few frames
+// before measuring, so that runs on the same machine are comparable
+#define BENCH_TIMESTEP (1.0 / 60.0)
+#define BENCH_WARMUP_FRAMES 10
+
+typedef struct {
+  const char **modelPaths;
+  size_t modelsCount;
+  int benchFrames;
+  bool headless;
+  int width;
+  int height;
+  const char *reportPath;
+} ViewerOptions;
+
+typedef struct {
+  Model *models;
+  double *loadMs;
+  size_t count;
+  Vec3 cameraOrigin;
+} Scene;
+
+static void PrintUsage(const char *program) {
+  fprintf(stderr,
+          "usage: %s [-b frames] [-H] [-w width] [-h height] [-o report.json]"
+          " [model.gltf ...]\n"
+          "  -b n      benchmark: replay n frames with a fixed timestep and\n"
+          "            report the timings as JSON, vsync off\n"
+          "  -H        render headless (offscreen, needs EGL and -b)\n"
+          "  -w, -h    size of the window or framebuffer (default: %dx%d)\n"
+          "  -o path   write the benchmark report to a file (default: "
+          "stdout)\n"
+          "  models    glTF files to show (default: %s)\n",
+          program, WINDOW_WIDTH, WINDOW_HEIGTH, DEFAULT_MODEL);
+}
+
+static bool ParseOptions(int argc, char **argv, ViewerOptions *options) {
+  options->width = WINDOW_WIDTH;
+  options->height = WINDOW_HEIGTH;
+  options->modelPaths = (const char **)argv + 1;
+
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (strcmp(arg, "-b") == 0 && hasValue) {
+      options->benchFrames = atoi(argv[++i]);
+      if (options->benchFrames <= 0) {
+        return false;
+      }
+    } else if (strcmp(arg, "-H") == 0) {
+      options->headless = true;
+    } else if (strcmp(arg, "-w") == 0 && hasValue) {
+      options->width = atoi(argv[++i]);
+    } else if (strcmp(arg, "-h") == 0 && hasValue) {
+      options->height = atoi(argv[++i]);
+    } else if (strcmp(arg, "-o") == 0 && hasValue) {
+      options->reportPath = argv[++i];
+    } else if (arg[0] == '-') {
+      return false;
+    } else {
+      // Paths are packed at the start of argv, options are not needed again
+      options->modelPaths[options->modelsCount++] = arg;
+    }
+  }
+
+  if (options->modelsCount == 0) {
+    static const char *defaultPaths[] = {DEFAULT_MODEL};
+    options->modelPaths = defaultPaths;
+    options->modelsCount = 1;
+  }
 
-  status = AppInit(WINDOW_WIDTH, WINDOW_HEIGTH, WINDOW_TITLE);
+  // A headless viewer would never stop
+  if (options->headless && options->benchFrames == 0) {
+    return false;
+  }
+
+  return options->width > 0 && options->height > 0;
+}
+
+// Load every model and lay them out on a grid facing the camera, a single
+// model stays at the origin
+static StatusCode LoadScene(Scene *scene, const ViewerOptions *options) {
+  scene->models = calloc(options->modelsCount, sizeof(Model));
+  scene->loadMs = calloc(options->modelsCount, sizeof(double));
+  if (scene->models == NULL || scene->loadMs == NULL) {
+    return E_OUT_OF_MEMORY;
+  }
+
+  // Decode the buffers and generate the missing attributes of every model
+  // on all the processors, the pool only lives while loading
+  JobPool *pool = MakeJobPool(GetProcessorsCount() - 1);
+  SetLoadJobPool(pool);
+
+  StatusCode status = SUCCESS;
+  float maxRadius = 0.0f;
+  for (size_t i = 0; i < options->modelsCount; i++) {
+    double start = GetTime();
+    Model model = LoadModel(options->modelPaths[i]);
+    scene->loadMs[i] = (GetTime() - start) * 1000.0;
+    if (model.status != SUCCESS) {
+      status = model.status;
+      break;
+    }
+
+    model.transform = MakeTransform();
+    scene->models[scene->count++] = model;
+
+    float radius = Vec3Len(Vec3Sub(model.boundsMax, model.boundsMin)) * 0.5f;
+    maxRadius = radius > maxRadius ? radius : maxRadius;
+  }
+
+  SetLoadJobPool(NULL);
+  DestroyJobPool(pool);
   if (status != SUCCESS) {
-    return AppClose(status);
+    return status;
   }
 
-  Shader shader = LoadShader("assets/def_vs.glsl", "assets/def_fs.glsl");
-  if (shader.status != SUCCESS) {
-    return AppClose(shader.status);
+  Camera camera = MakeDefaultCamera();
+  scene->cameraOrigin = camera.transform.origin;
+  if (scene->count == 1) {
+    return SUCCESS;
+  }
+
+  int columns = (int)ceilf(sqrtf((float)scene->count));
+  float spacing = maxRadius * 2.5f;
+  for (size_t i = 0; i < scene->count; i++) {
+    Model *model = scene->models + i;
+    Vec3 center = Vec3Scale(Vec3Add(model->boundsMin, model->boundsMax), 0.5f);
+    Vec3 cell = {((float)(i % columns) - (float)(columns - 1) * 0.5f) * spacing,
+                 ((float)(i / columns) - (float)(columns - 1) * 0.5f) * spacing,
+                 0.0f};
+    model->transform.origin = Vec3Sub(cell, center);
+  }
+
+  // Move back along the default view direction until the grid fits
+  float extent = (float)columns * spacing;
+  float distance = Vec3Len(scene->cameraOrigin);
+  float fit = extent / tanf(CAMERA_DEFAULT_FOV * DEG2RAD * 0.5f);
+  if (fit > distance) {
+    scene->cameraOrigin = Vec3Scale(scene->cameraOrigin, fit / distance);
+  }
+  return SUCCESS;
+}
+
+static void DestroyScene(Scene scene) {
+  for (size_t i = 0; i < scene.count; i++) {
+    DestroyModel(scene.models[i]);
+  }
+  free(scene.models);
+  free(scene.loadMs);
+}
+
+// Pose the scene at the given time, only depends on the time so that the
+// benchmark replays the same frames on every run
+static void AnimateScene(Scene *scene, Camera *camera, double time) {
+  float t = (float)time;
+  for (size_t i = 0; i < scene->count; i++) {
+    scene->models[i].transform.angles.x = t;
+    scene->models[i].transform.angles.y = t;
+  }
+
+  float distance = Vec3Len(scene->cameraOrigin);
+  camera->transform.origin = scene->cameraOrigin;
+  camera->transform.origin.x -= sinf(t * 0.5f) * distance * 0.1f;
+  camera->far = distance * 2.0f + CAMERA_DEFAULT_FAR;
+}
+
+static void DrawScene(RenderQueue *queue, Scene *scene, Camera camera) {
+  RenderQueueBegin(queue, camera);
+  for (size_t i = 0; i < scene->count; i++) {
+    RenderQueueSubmit(queue, scene->models + i, RENDER_PASS_OPAQUE);
+  }
+  RenderQueueFlush(queue);
+}
+
+static void WriteJsonString(FILE *file, const char *text) {
+  fputc('"', file);
+  for (const char *c = text; *c != '\0'; c++) {
+    if (*c == '"' || *c == '\\') {
+      fprintf(file, "\\%c", *c);
+    } else if ((unsigned char)*c < 0x20) {
+      fprintf(file, "\\u%04x", (unsigned char)*c);
+    } else {
+      fputc(*c, file);
+    }
+  }
+  fputc('"', file);
+}
+
+static void WriteJsonSummary(FILE *file, const char *name,
+                             FrameStatSummary summary) {
+  fprintf(file,
+          "  \"%s\": {\"min\": %.4f, \"avg\": %.4f, \"p50\": %.4f, "
+          "\"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f},\n",
+          name, summary.min, summary.avg, summary.p50, summary.p95,
+          summary.p99, summary.max);
+}
+
+// Samples of every measured frame, summarized once the run is done
+typedef struct {
+  double *frameMs;
+  double *cpuMs;
+  double *gpuMs;
+  size_t count;
+  size_t gpuCount;
+  double drawCalls;
+  double triangles;
+} BenchSamples;
+
+static bool WriteReport(const ViewerOptions *options, const Scene *scene,
+                        BenchSamples *samples, double startupMs) {
+  FILE *file = stdout;
+  if (options->reportPath != NULL) {
+    file = fopen(options->reportPath, "w");
+    if (file == NULL) {
+      Log(LOG_ERROR, "cannot write report: %s", options->reportPath);
+      return false;
+    }
+  }
+
+  size_t frames = samples->count;
+  double loadMs = 0.0;
+  for (size_t i = 0; i < scene->count; i++) {
+    loadMs += scene->loadMs[i];
   }
 
-  Model model = LoadModel("assets/uwu.gltf");
-  if (model.status != SUCCESS) {
-    return AppClose(model.status);
+  fprintf(file, "{\n");
+  fprintf(file, "  \"frames\": %zu,\n", frames);
+  fprintf(file, "  \"warmupFrames\": %d,\n", BENCH_WARMUP_FRAMES);
+  fprintf(file, "  \"timestep\": %.6f,\n", BENCH_TIMESTEP);
+  fprintf(file, "  \"width\": %d,\n", options->width);
+  fprintf(file, "  \"height\": %d,\n", options->height);
+  fprintf(file, "  \"headless\": %s,\n", options->headless ? "true" : "false");
+  fprintf(file, "  \"glVersion\": \"%d.%d\",\n", AppGetGLVersion() / 10,
+          AppGetGLVersion() % 10);
+  fprintf(file, "  \"renderer\": ");
+  WriteJsonString(file, (const char *)glGetString(GL_RENDERER));
+  fprintf(file, ",\n");
+  fprintf(file, "  \"startupMs\": %.4f,\n", startupMs);
+  fprintf(file, "  \"loadMs\": %.4f,\n", loadMs);
+
+  fprintf(file, "  \"models\": [\n");
+  for (size_t i = 0; i < scene->count; i++) {
+    const Model *model = scene->models + i;
+    size_t vertices = 0;
+    size_t triangles = 0;
+    for (size_t m = 0; m < model->meshesCount; m++) {
+      vertices += model->meshes[m].verticesCount;
+      triangles += model->meshes[m].indicesCount / 3;
+    }
+
+    fprintf(file, "    {\"path\": ");
+    WriteJsonString(file, options->modelPaths[i]);
+    fprintf(file,
+            ", \"loadMs\": %.4f, \"meshes\": %zu, \"vertices\": %zu, "
+            "\"triangles\": %zu}%s\n",
+            scene->loadMs[i], model->meshesCount, vertices, triangles,
+            i + 1 < scene->count ? "," : "");
   }
+  fprintf(file, "  ],\n");
 
-  model.transform = MakeTransform();
-  model.shader = shader;
+  WriteJsonSummary(file, "frameMs",
+                   MakeFrameStatSummary(samples->frameMs, frames));
+  WriteJsonSummary(file, "cpuMs", MakeFrameStatSummary(samples->cpuMs, frames));
+  WriteJsonSummary(file, "gpuMs",
+                   MakeFrameStatSummary(samples->gpuMs, samples->gpuCount));
+  double measured = frames > 0 ? (double)frames : 1.0;
+  fprintf(file, "  \"drawCalls\": %.1f,\n", samples->drawCalls / measured);
+  fprintf(file, "  \"triangles\": %.1f\n", samples->triangles / measured);
+  fprintf(file, "}\n");
+
+  bool ok = ferror(file) == 0;
+  if (file != stdout) {
+    ok = fclose(file) == 0 && ok;
+  }
+  return ok;
+}
+
+// Replay a fixed number of frames and report their timings
+static StatusCode RunBenchmark(const ViewerOptions *options, Scene *scene,
+                               RenderQueue *queue, double startupMs) {
+  size_t frames = (size_t)options->benchFrames;
+  BenchSamples samples = {0};
+  samples.frameMs = calloc(frames, sizeof(double));
+  samples.cpuMs = calloc(frames, sizeof(double));
+  samples.gpuMs = calloc(frames, sizeof(double));
+  if (samples.frameMs == NULL || samples.cpuMs == NULL ||
+      samples.gpuMs == NULL) {
+    free(samples.frameMs);
+    free(samples.cpuMs);
+    free(samples.gpuMs);
+    return E_OUT_OF_MEMORY;
+  }
 
   Camera camera = MakeDefaultCamera();
-  while (!AppShouldClose()) {
+  size_t total = frames + BENCH_WARMUP_FRAMES;
+  for (size_t frame = 0; frame < total && !AppShouldClose(); frame++) {
     BeginFrame();
     {
-      // Update
+      AnimateScene(scene, &camera, (double)frame * BENCH_TIMESTEP);
       UpdateCamera(&camera);
-      model.transform.angles.y += 1.0f * GetDeltaTime();
-      model.transform.angles.x += 1.0f * GetDeltaTime();
-
-      // Render
-      RenderModel(model, camera);
+      DrawScene(queue, scene, camera);
     }
     EndFrame();
+
+    if (frame < BENCH_WARMUP_FRAMES) {
+      continue;
+    }
+
+    // GPU times arrive a few frames late, the first ones are still zero
+    FrameStats stats = GetFrameStats();
+    size_t sample = samples.count++;
+    samples.frameMs[sample] = stats.values[FRAME_STAT_FRAME_MS];
+    samples.cpuMs[sample] = stats.values[FRAME_STAT_CPU_MS];
+    if (stats.values[FRAME_STAT_GPU_MS] > 0.0) {
+      samples.gpuMs[samples.gpuCount++] = stats.values[FRAME_STAT_GPU_MS];
+    }
+    samples.drawCalls += stats.values[FRAME_STAT_DRAW_CALLS];
+    samples.triangles += stats.values[FRAME_STAT_TRIANGLES];
+  }
+
+  bool written = WriteReport(options, scene, &samples, startupMs);
+  free(samples.frameMs);
+  free(samples.cpuMs);
+  free(samples.gpuMs);
+  return written ? SUCCESS : E_CANNOT_LOAD_FILE;
+}
+
+int main(int argc, char **argv) {
+  StatusCode status;
+  ViewerOptions options = {0};
+  if (!ParseOptions(argc, argv, &options)) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  // SIMPLEGLTF_TRACE=trace.json writes a timeline of the run on close
+  ProfileSetTracePath(getenv("SIMPLEGLTF_TRACE"));
+
+  // SIMPLEGLTF_STATS=seconds logs the frame statistics periodically
+  const char *statsInterval = getenv("SIMPLEGLTF_STATS");
+  if (statsInterval != NULL && atof(statsInterval) > 0.0) {
+    SetFrameStatsLogInterval(atof(statsInterval));
+  }
+
+  if (options.headless) {
+    status = AppInitHeadless(options.width, options.height);
+  } else {
+    status = AppInit(options.width, options.height, WINDOW_TITLE);
+  }
+  if (status != SUCCESS) {
+    return AppClose(status);
+  }
+
+  // Frames are only bounded by the GPU while benchmarking
+  if (options.benchFrames > 0) {
+    AppSetVSync(false);
+  }
+
+  // Compile in the background while the models load
+  Shader shader = BeginLoadShader("assets/def_vs.glsl", "assets/def_fs.glsl",
+                                  SHADER_VARIANT_VERTEX_COLORS);
+  if (shader.status != SUCCESS) {
+    return AppClose(shader.status);
+  }
+
+  Scene scene = {0};
+  status = LoadScene(&scene, &options);
+  if (status != SUCCESS) {
+    return AppClose(status);
+  }
+
+  if (FinishLoadShader(&shader) != SUCCESS) {
+    return AppClose(shader.status);
+  }
+
+  for (size_t i = 0; i < scene.count; i++) {
+    scene.models[i].shader = shader;
+  }
+
+  RenderQueue queue = MakeRenderQueue(64);
+  if (queue.status != SUCCESS) {
+    return AppClose(queue.status);
+  }
+
+  // Compare runs with a cold and a warm shader cache
+  double startupMs = GetTime() * 1000.0;
+  Log(LOG_INFO, "startup done in %.2f ms", startupMs);
+
+  if (options.benchFrames > 0) {
+    status = RunBenchmark(&options, &scene, &queue, startupMs);
+  } else {
+    Camera camera = MakeDefaultCamera();
+    double time = 0.0;
+    while (!AppShouldClose()) {
+      BeginFrame();
+      {
+        // Update
+        time += GetDeltaTime();
+        AnimateScene(&scene, &camera, time);
+        UpdateCamera(&camera);
+
+        // Render
+        DrawScene(&queue, &scene, camera);
+      }
+      EndFrame();
+    }
   }
 
+  DestroyRenderQueue(queue);
+  DestroyCameraUniforms();
   DestroyShader(shader);
-  DestroyModel(model);
-  return AppClose(SUCCESS);
+  DestroyScene(scene);
+  return AppClose(status);
 }
@@ -0,0 +1,555 @@
+#include "meshopt.h"
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+#include "profile.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define MESHOPT_USE_SSE
+#endif
+
+// Headers of the codecs, the low nibble holds the version
+#define MESHOPT_VERTEX_HEADER 0xA0
+#define MESHOPT_TRIANGLES_HEADER 0xE0
+#define MESHOPT_INDICES_HEADER 0xD0
+
+// Vertices are coded in blocks of at most 8 KB and 256 vertices, each byte
+// of a vertex as its own stream of groups of 16 deltas
+#define MESHOPT_BLOCK_BYTES 8192
+#define MESHOPT_BLOCK_MAX_VERTICES 256
+#define MESHOPT_GROUP_SIZE 16
+
+// Bytes a group may read past its start, the stream ends with a tail of at
+// least this many bytes so decoding a group never checks its own reads
+#define MESHOPT_GROUP_MAX_BYTES 24
+#define MESHOPT_TAIL_MIN_BYTES 32
+
+// Triangles keep the last 16 edges and vertices seen to refer to them by
+// position, a triangle reads at most 16 bytes past its start and the stream
+// ends with a 16 byte table of the common vertex codes which pads it
+#define MESHOPT_FIFO_SIZE 16
+#define MESHOPT_CODE_TABLE_SIZE 16
+
+// Indices of the last baseline, a sequence reads at most 5 bytes per index
+// and ends with a 4 byte tail
+#define MESHOPT_SEQUENCE_TAIL_BYTES 4
+
+static size_t GetBlockVertices(size_t stride) {
+  size_t count = (MESHOPT_BLOCK_BYTES / stride) &
+                 ~(size_t)(MESHOPT_GROUP_SIZE - 1);
+  return count < MESHOPT_BLOCK_MAX_VERTICES ? count
+                                            : MESHOPT_BLOCK_MAX_VERTICES;
+}
+
+// Unpack a group of 16 values of 0, 2, 4 or 8 bits (bitsLog2 0 to 3), most
+// significant bits first. Values with all their bits set are escapes, their
+// bytes follow the packed ones in order. Returns the end of the group.
+static const uint8_t *DecodeGroup(const uint8_t *src, uint8_t *dst,
+                                  int bitsLog2) {
+  if (bitsLog2 == 0) {
+    memset(dst, 0, MESHOPT_GROUP_SIZE);
+    return src;
+  }
+
+  if (bitsLog2 == 3) {
+    memcpy(dst, src, MESHOPT_GROUP_SIZE);
+    return src + MESHOPT_GROUP_SIZE;
+  }
+
+  int bits = 1 << bitsLog2;
+  const uint8_t *escapes = src + bits * 2;
+#if defined(MESHOPT_USE_SSE)
+  // Split every packed byte into its values with shifts and masks, then
+  // interleave them back in order
+  __m128i values;
+  if (bits == 2) {
+    uint32_t packed;
+    memcpy(&packed, src, sizeof(packed));
+    __m128i p = _mm_cvtsi32_si128((int)packed);
+    __m128i mask = _mm_set1_epi8(3);
+    __m128i v6 = _mm_and_si128(_mm_srli_epi16(p, 6), mask);
+    __m128i v4 = _mm_and_si128(_mm_srli_epi16(p, 4), mask);
+    __m128i v2 = _mm_and_si128(_mm_srli_epi16(p, 2), mask);
+    __m128i v0 = _mm_and_si128(p, mask);
+    values = _mm_unpacklo_epi16(_mm_unpacklo_epi8(v6, v4),
+                                _mm_unpacklo_epi8(v2, v0));
+  } else {
+    __m128i p = _mm_loadl_epi64((const __m128i *)src);
+    __m128i mask = _mm_set1_epi8(15);
+    __m128i high = _mm_and_si128(_mm_srli_epi16(p, 4), mask);
+    values = _mm_unpacklo_epi8(high, _mm_and_si128(p, mask));
+  }
+  _mm_storeu_si128((__m128i *)dst, values);
+
+  // Escapes are rare, patch them one by one
+  __m128i sentinel = _mm_set1_epi8((char)((1 << bits) - 1));
+  int escaped = _mm_movemask_epi8(_mm_cmpeq_epi8(values, sentinel));
+  for (int i = 0; escaped != 0; i++, escaped >>= 1) {
+    if (escaped & 1) {
+      dst[i] = *escapes++;
+    }
+  }
+#else
+  unsigned sentinel = (1u << bits) - 1;
+  for (int i = 0; i < MESHOPT_GROUP_SIZE; i++) {
+    int shift = 8 - bits - (i * bits) % 8;
+    unsigned v = ((unsigned)src[i * bits / 8] >> shift) & sentinel;
+    dst[i] = v == sentinel ? *escapes++ : (uint8_t)v;
+  }
+#endif
+  return escapes;
+}
+
+// Decode a stream of size values, a multiple of the group size, preceded by
+// the 2 bit sizes of its groups. Returns NULL when src ends too soon.
+static const uint8_t *DecodeBytes(const uint8_t *src, const uint8_t *end,
+                                  uint8_t *dst, size_t size) {
+  size_t groups = size / MESHOPT_GROUP_SIZE;
+  size_t headerSize = (groups + 3) / 4;
+  if ((size_t)(end - src) < headerSize) {
+    return NULL;
+  }
+
+  const uint8_t *header = src;
+  src += headerSize;
+  for (size_t g = 0; g < groups; g++) {
+    if ((size_t)(end - src) < MESHOPT_GROUP_MAX_BYTES) {
+      return NULL;
+    }
+
+    int bitsLog2 = (header[g / 4] >> ((g % 4) * 2)) & 3;
+    src = DecodeGroup(src, dst + g * MESHOPT_GROUP_SIZE, bitsLog2);
+  }
+  return src;
+}
+
+// Add up the zigzag deltas of 4 bytes of count vertices, starting from the
+// same bytes of the last vertex of the previous block, and store them at
+// their place in the vertices
+static void DecodeDeltas(uint8_t (*deltas)[MESHOPT_BLOCK_MAX_VERTICES],
+                         size_t count, uint8_t *dst, size_t stride,
+                         const uint8_t *last) {
+#if defined(MESHOPT_USE_SSE)
+  // Transposed to a lane of 4 bytes per vertex, a prefix sum over the lanes
+  // adds every byte to the ones of the vertices before it
+  uint32_t lastBytes;
+  memcpy(&lastBytes, last, sizeof(lastBytes));
+  __m128i previous = _mm_set1_epi32((int)lastBytes);
+  __m128i one = _mm_set1_epi8(1);
+  __m128i low = _mm_set1_epi8(0x7F);
+  for (size_t i = 0; i < count; i += MESHOPT_GROUP_SIZE) {
+    __m128i d[4];
+    for (int c = 0; c < 4; c++) {
+      __m128i v = _mm_loadu_si128((const __m128i *)(deltas[c] + i));
+      __m128i sign = _mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(v, one));
+      d[c] = _mm_xor_si128(_mm_and_si128(_mm_srli_epi16(v, 1), low), sign);
+    }
+
+    __m128i d01lo = _mm_unpacklo_epi8(d[0], d[1]);
+    __m128i d01hi = _mm_unpackhi_epi8(d[0], d[1]);
+    __m128i d23lo = _mm_unpacklo_epi8(d[2], d[3]);
+    __m128i d23hi = _mm_unpackhi_epi8(d[2], d[3]);
+    __m128i rows[4] = {
+        _mm_unpacklo_epi16(d01lo, d23lo), _mm_unpackhi_epi16(d01lo, d23lo),
+        _mm_unpacklo_epi16(d01hi, d23hi), _mm_unpackhi_epi16(d01hi, d23hi)};
+    for (int r = 0; r < 4; r++) {
+      __m128i x = rows[r];
+      x = _mm_add_epi8(x, _mm_slli_si128(x, 4));
+      x = _mm_add_epi8(x, _mm_slli_si128(x, 8));
+      x = _mm_add_epi8(x, previous);
+      previous = _mm_shuffle_epi32(x, 0xFF);
+
+      uint32_t lanes[4];
+      _mm_storeu_si128((__m128i *)lanes, x);
+      for (size_t l = 0; l < 4; l++) {
+        size_t v = i + (size_t)r * 4 + l;
+        if (v < count) {
+          memcpy(dst + v * stride, lanes + l, sizeof(uint32_t));
+        }
+      }
+    }
+  }
+#else
+  for (int c = 0; c < 4; c++) {
+    uint8_t p = last[c];
+    for (size_t v = 0; v < count; v++) {
+      uint8_t d = deltas[c][v];
+      p = (uint8_t)(p + ((d >> 1) ^ -(d & 1)));
+      dst[v * stride + c] = p;
+    }
+  }
+#endif
+}
+
+static const uint8_t *DecodeVertexBlock(const uint8_t *src,
+                                        const uint8_t *end, uint8_t *dst,
+                                        size_t count, size_t stride,
+                                        uint8_t *last) {
+  _Alignas(16) uint8_t deltas[4][MESHOPT_BLOCK_MAX_VERTICES];
+  size_t aligned = (count + MESHOPT_GROUP_SIZE - 1) &
+                   ~(size_t)(MESHOPT_GROUP_SIZE - 1);
+  for (size_t k = 0; k < stride; k += 4) {
+    for (int c = 0; c < 4; c++) {
+      src = DecodeBytes(src, end, deltas[c], aligned);
+      if (src == NULL) {
+        return NULL;
+      }
+    }
+    DecodeDeltas(deltas, count, dst + k, stride, last + k);
+  }
+
+  memcpy(last, dst + (count - 1) * stride, stride);
+  return src;
+}
+
+static StatusCode DecodeVertices(uint8_t *dst, size_t count, size_t stride,
+                                 const uint8_t *src, size_t size) {
+  if (stride == 0 || stride > 256 || stride % 4 != 0 || size < 1 + stride ||
+      (src[0] & 0xF0) != MESHOPT_VERTEX_HEADER || (src[0] & 0x0F) > 0) {
+    return E_CANNOT_LOAD_FILE;
+  }
+
+  // The tail ends with the first vertex, the base of the first block
+  const uint8_t *end = src + size;
+  uint8_t last[256];
+  memcpy(last, end - stride, stride);
+
+  src++;
+  size_t blockVertices = GetBlockVertices(stride);
+  for (size_t first = 0; first < count; first += blockVertices) {
+    size_t block = count - first < blockVertices ? count - first
+                                                 : blockVertices;
+    src = DecodeVertexBlock(src, end, dst + first * stride, block, stride,
+                            last);
+    if (src == NULL) {
+      return E_CANNOT_LOAD_FILE;
+    }
+  }
+
+  size_t tail = stride < MESHOPT_TAIL_MIN_BYTES ? MESHOPT_TAIL_MIN_BYTES
+                                                : stride;
+  return (size_t)(end - src) == tail ? SUCCESS : E_CANNOT_LOAD_FILE;
+}
+
+// Variable length integer of 7 bits per byte, low bits first. Reads at most
+// 5 bytes, whatever the data.
+static uint32_t DecodeVByte(const uint8_t **src) {
+  const uint8_t *p = *src;
+  uint32_t result = *p & 127;
+  if (*p++ < 128) {
+    *src = p;
+    return result;
+  }
+
+  for (int shift = 7; shift <= 28; shift += 7) {
+    uint8_t group = *p++;
+    result |= (uint32_t)(group & 127) << shift;
+    if (group < 128) {
+      break;
+    }
+  }
+  *src = p;
+  return result;
+}
+
+// Index stored as the zigzag delta from the last one stored
+static uint32_t DecodeIndex(const uint8_t **src, uint32_t last) {
+  uint32_t v = DecodeVByte(src);
+  return last + ((v >> 1) ^ -(v & 1));
+}
+
+static void WriteIndex(void *dst, size_t i, size_t indexSize, uint32_t index) {
+  if (indexSize == 2) {
+    ((uint16_t *)dst)[i] = (uint16_t)index;
+  } else {
+    ((uint32_t *)dst)[i] = index;
+  }
+}
+
+static void WriteTriangle(void *dst, size_t i, size_t indexSize, uint32_t a,
+                          uint32_t b, uint32_t c) {
+  WriteIndex(dst, i, indexSize, a);
+  WriteIndex(dst, i + 1, indexSize, b);
+  WriteIndex(dst, i + 2, indexSize, c);
+}
+
+typedef struct {
+  uint32_t edges[MESHOPT_FIFO_SIZE][2];
+  uint32_t vertices[MESHOPT_FIFO_SIZE];
+  size_t edgesOffset;
+  size_t verticesOffset;
+} TriangleFifos;
+
+static void PushEdge(TriangleFifos *fifos, uint32_t a, uint32_t b) {
+  fifos->edges[fifos->edgesOffset][0] = a;
+  fifos->edges[fifos->edgesOffset][1] = b;
+  fifos->edgesOffset = (fifos->edgesOffset + 1) & (MESHOPT_FIFO_SIZE - 1);
+}
+
+static void PushVertex(TriangleFifos *fifos, uint32_t v, bool push) {
+  fifos->vertices[fifos->verticesOffset] = v;
+  fifos->verticesOffset = (fifos->verticesOffset + push) &
+                          (MESHOPT_FIFO_SIZE - 1);
+}
+
+// Vertex pushed age entries ago, 1 being the last one
+static uint32_t GetVertex(const TriangleFifos *fifos, size_t age) {
+  return fifos->vertices[(fifos->verticesOffset - age) &
+                         (MESHOPT_FIFO_SIZE - 1)];
+}
+
+// Each triangle is a code byte, in order after the header, and its extra
+// bytes, after the codes. Codes below 0xF0 reuse edge fe of the fifo and
+// take the third vertex from the next new one (0), the vertex fifo (1 to
+// 12) or the last free index -1, +1 or stored (13 to 15). 0xF0 to 0xFD start
+// from the next new vertex and look the codes of the other two up in the
+// table, 0xFE and 0xFF store them in an extra byte.
+static StatusCode DecodeTriangles(void *dst, size_t count, size_t indexSize,
+                                  const uint8_t *src, size_t size) {
+  if (count % 3 != 0 || (indexSize != 2 && indexSize != 4) ||
+      size < 1 + count / 3 + MESHOPT_CODE_TABLE_SIZE ||
+      (src[0] & 0xF0) != MESHOPT_TRIANGLES_HEADER || (src[0] & 0x0F) > 1) {
+    return E_CANNOT_LOAD_FILE;
+  }
+
+  TriangleFifos fifos = {0};
+  memset(fifos.edges, 0xFF, sizeof(fifos.edges));
+  memset(fifos.vertices, 0xFF, sizeof(fifos.vertices));
+
+  // Version 0 has no codes for the neighbors of the last free index
+  int fecMax = (src[0] & 0x0F) >= 1 ? 13 : 15;
+  uint32_t next = 0;
+  uint32_t last = 0;
+  const uint8_t *code = src + 1;
+  const uint8_t *data = code + count / 3;
+  const uint8_t *safeEnd = src + size - MESHOPT_CODE_TABLE_SIZE;
+  const uint8_t *table = safeEnd;
+  for (size_t i = 0; i < count; i += 3) {
+    if (data > safeEnd) {
+      return E_CANNOT_LOAD_FILE;
+    }
+
+    uint8_t codeTri = *code++;
+    if (codeTri < 0xF0) {
+      int fe = codeTri >> 4;
+      const uint32_t *edge =
+          fifos.edges[(fifos.edgesOffset - 1 - fe) & (MESHOPT_FIFO_SIZE - 1)];
+      uint32_t a = edge[0];
+      uint32_t b = edge[1];
+      int fec = codeTri & 15;
+      uint32_t c;
+      bool push = true;
+      if (fec == 0) {
+        c = next++;
+      } else if (fec < fecMax) {
+        c = GetVertex(&fifos, (size_t)fec + 1);
+        push = false;
+      } else if (fec == 15) {
+        c = last = DecodeIndex(&data, last);
+      } else {
+        c = last = fec == 13 ? last - 1 : last + 1;
+      }
+
+      WriteTriangle(dst, i, indexSize, a, b, c);
+      PushVertex(&fifos, c, push);
+      PushEdge(&fifos, c, b);
+      PushEdge(&fifos, a, c);
+      continue;
+    }
+
+    // The first vertex is the next new one or a free index, the others new
+    // ones (0), from the fifo (1 to 14) or free indices (15)
+    uint8_t codeAux;
+    bool freeA = codeTri == 0xFF;
+    if (codeTri < 0xFE) {
+      codeAux = table[codeTri & 15];
+    } else {
+      codeAux = *data++;
+      if (codeAux == 0) {
+        next = 0;
+      }
+    }
+
+    int feb = codeAux >> 4;
+    int fec = codeAux & 15;
+    uint32_t a = freeA ? 0 : next++;
+    uint32_t b = feb == 0 ? next++ : GetVertex(&fifos, (size_t)feb);
+    uint32_t c = fec == 0 ? next++ : GetVertex(&fifos, (size_t)fec);
+    if (freeA) {
+      a = last = DecodeIndex(&data, last);
+    }
+    if (feb == 15) {
+      b = last = DecodeIndex(&data, last);
+    }
+    if (fec == 15) {
+      c = last = DecodeIndex(&data, last);
+    }
+
+    WriteTriangle(dst, i, indexSize, a, b, c);
+    PushVertex(&fifos, a, true);
+    PushVertex(&fifos, b, feb == 0 || feb == 15);
+    PushVertex(&fifos, c, fec == 0 || fec == 15);
+    PushEdge(&fifos, b, a);
+    PushEdge(&fifos, c, b);
+    PushEdge(&fifos, a, c);
+  }
+
+  return data == safeEnd ? SUCCESS : E_CANNOT_LOAD_FILE;
+}
+
+// Every index is a zigzag delta from one of two baselines, the low bit of
+// its value picking the baseline
+static StatusCode DecodeIndices(void *dst, size_t count, size_t indexSize,
+                                const uint8_t *src, size_t size) {
+  if ((indexSize != 2 && indexSize != 4) ||
+      size < 1 + count + MESHOPT_SEQUENCE_TAIL_BYTES ||
+      (src[0] & 0xF0) != MESHOPT_INDICES_HEADER || (src[0] & 0x0F) > 1) {
+    return E_CANNOT_LOAD_FILE;
+  }
+
+  const uint8_t *data = src + 1;
+  const uint8_t *safeEnd = src + size - MESHOPT_SEQUENCE_TAIL_BYTES;
+  uint32_t last[2] = {0, 0};
+  for (size_t i = 0; i < count; i++) {
+    if (data >= safeEnd) {
+      return E_CANNOT_LOAD_FILE;
+    }
+
+    uint32_t v = DecodeVByte(&data);
+    uint32_t baseline = v & 1;
+    v >>= 1;
+    last[baseline] += (v >> 1) ^ -(v & 1);
+    WriteIndex(dst, i, indexSize, last[baseline]);
+  }
+
+  return data == safeEnd ? SUCCESS : E_CANNOT_LOAD_FILE;
+}
+
+// Signed float to the nearest integer, half away from zero
+static int RoundToInt(float v) { return (int)(v + (v >= 0.0f ? 0.5f : -0.5f)); }
+
+// Rebuild unit vectors from x and y on the octahedron, z holds the value of
+// one and w is kept
+static void DecodeOctahedral(void *data, size_t count, size_t stride) {
+  float one = stride == 4 ? 127.0f : 32767.0f;
+  for (size_t i = 0; i < count; i++) {
+    int v[3];
+    for (int k = 0; k < 3; k++) {
+      v[k] = stride == 4 ? ((int8_t *)data)[i * 4 + k]
+                         : ((int16_t *)data)[i * 4 + k];
+    }
+
+    float x = (float)v[0];
+    float y = (float)v[1];
+    float z = (float)v[2] - fabsf(x) - fabsf(y);
+
+    // The lower half of the sphere is folded over the upper one
+    float t = z < 0.0f ? z : 0.0f;
+    x += x >= 0.0f ? t : -t;
+    y += y >= 0.0f ? t : -t;
+
+    float s = one / sqrtf(x * x + y * y + z * z);
+    v[0] = RoundToInt(x * s);
+    v[1] = RoundToInt(y * s);
+    v[2] = RoundToInt(z * s);
+    for (int k = 0; k < 3; k++) {
+      if (stride == 4) {
+        ((int8_t *)data)[i * 4 + k] = (int8_t)v[k];
+      } else {
+        ((int16_t *)data)[i * 4 + k] = (int16_t)v[k];
+      }
+    }
+  }
+}
+
+// Rebuild quaternions from their three smallest components, the low 2 bits
+// of the fourth one give the index of the largest and the rest the scale
+static void DecodeQuaternion(int16_t *data, size_t count) {
+  const float scale = 1.0f / sqrtf(2.0f);
+  for (size_t i = 0; i < count; i++) {
+    int16_t *q = data + i * 4;
+    float s = scale / (float)(q[3] | 3);
+    float x = (float)q[0] * s;
+    float y = (float)q[1] * s;
+    float z = (float)q[2] * s;
+    float ww = 1.0f - x * x - y * y - z * z;
+    float w = sqrtf(ww >= 0.0f ? ww : 0.0f);
+
+    int largest = q[3] & 3;
+    q[(largest + 1) & 3] = (int16_t)RoundToInt(x * 32767.0f);
+    q[(largest + 2) & 3] = (int16_t)RoundToInt(y * 32767.0f);
+    q[(largest + 3) & 3] = (int16_t)RoundToInt(z * 32767.0f);
+    q[largest] = (int16_t)RoundToInt(w * 32767.0f);
+  }
+}
+
+// Rebuild floats stored as a signed 24 bit mantissa and an 8 bit exponent
+static void DecodeExponential(uint32_t *data, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    int32_t mantissa = (int32_t)(data[i] << 8) >> 8;
+    int32_t exponent = (int32_t)data[i] >> 24;
+
+    // 2^exponent built from its bits, exact where ldexpf would be slower
+    uint32_t bits = (uint32_t)(exponent + 127) << 23;
+    float power;
+    memcpy(&power, &bits, sizeof(power));
+    float value = power * (float)mantissa;
+    memcpy(data + i, &value, sizeof(value));
+  }
+}
+
+static StatusCode ApplyFilter(void *data, size_t count, size_t stride,
+                              MeshoptFilter filter) {
+  switch (filter) {
+  case MESHOPT_FILTER_NONE:
+    return SUCCESS;
+  case MESHOPT_FILTER_OCTAHEDRAL:
+    if (stride != 4 && stride != 8) {
+      return E_CANNOT_LOAD_FILE;
+    }
+    DecodeOctahedral(data, count, stride);
+    return SUCCESS;
+  case MESHOPT_FILTER_QUATERNION:
+    if (stride != 8) {
+      return E_CANNOT_LOAD_FILE;
+    }
+    DecodeQuaternion(data, count);
+    return SUCCESS;
+  case MESHOPT_FILTER_EXPONENTIAL:
+    if (stride % 4 != 0) {
+      return E_CANNOT_LOAD_FILE;
+    }
+    DecodeExponential(data, count * stride / 4);
+    return SUCCESS;
+  default:
+    return E_CANNOT_LOAD_FILE;
+  }
+}
+
+StatusCode MeshoptDecode(void *dst, size_t count, size_t stride,
+                         const uint8_t *src, size_t size, MeshoptMode mode,
+                         MeshoptFilter filter) {
+  assert((dst != NULL || count == 0) && "invalid arg dst: cannot be NULL");
+  assert(src != NULL && "invalid arg src: cannot be NULL");
+  PROFILE_ZONE("MeshoptDecode");
+  switch (mode) {
+  case MESHOPT_MODE_ATTRIBUTES: {
+    StatusCode status = DecodeVertices(dst, count, stride, src, size);
+    return status == SUCCESS ? ApplyFilter(dst, count, stride, filter)
+                             : status;
+  }
+  case MESHOPT_MODE_TRIANGLES:
+    return filter == MESHOPT_FILTER_NONE
+               ? DecodeTriangles(dst, count, stride, src, size)
+               : E_CANNOT_LOAD_FILE;
+  case MESHOPT_MODE_INDICES:
+    return filter == MESHOPT_FILTER_NONE
+               ? DecodeIndices(dst, count, stride, src, size)
+               : E_CANNOT_LOAD_FILE;
+  default:
+    return E_CANNOT_LOAD_FILE;
+  }
+}
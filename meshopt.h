@@ -0,0 +1,32 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core.h"
+
+// What a buffer view compressed with EXT_meshopt_compression holds, each one
+// has its own codec: vertex attributes, triangle lists or any other indices
+typedef enum {
+  MESHOPT_MODE_ATTRIBUTES,
+  MESHOPT_MODE_TRIANGLES,
+  MESHOPT_MODE_INDICES,
+} MeshoptMode;
+
+// Transforms undone after decoding attributes: octahedral unit vectors of 4
+// or 8 bytes, quaternions of 8 bytes and floats split into a 24 bit mantissa
+// and an 8 bit exponent
+typedef enum {
+  MESHOPT_FILTER_NONE,
+  MESHOPT_FILTER_OCTAHEDRAL,
+  MESHOPT_FILTER_QUATERNION,
+  MESHOPT_FILTER_EXPONENTIAL,
+} MeshoptFilter;
+
+// Decode count elements of stride bytes from size bytes of src into dst,
+// which holds count * stride bytes, and undo the filter. Attributes take a
+// stride multiple of 4 up to 256, indices a stride of 2 or 4 and triangles a
+// count multiple of 3. Returns E_CANNOT_LOAD_FILE when src is malformed or
+// does not match the parameters, dst is left undefined then.
+StatusCode MeshoptDecode(void *dst, size_t count, size_t stride,
+                         const uint8_t *src, size_t size, MeshoptMode mode,
+                         MeshoptFilter filter);
@@ -1,86 +1,448 @@
 #include "model.h"
 
+#include <assert.h>
+#include <errno.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
 #include <glad/glad.h>
 #define CGLTF_IMPLEMENTATION
 #include "cgltf.h"
 
-StatusCode UploadIndices(Mesh *mesh, cgltf_accessor *indices_accessor);
+#include "arena.h"
+#include "base64.h"
+#include "glstate.h"
+#include "json.h"
+#include "meshopt.h"
+#include "normals.h"
+#include "profile.h"
+#include "stats.h"
+
+// Program binary cache files start with this header followed by the binary
+#define SHADER_CACHE_MAGIC 0x42504753u // "SGPB"
+#define SHADER_CACHE_VERSION 1u
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t format;
+  uint32_t length;
+  uint64_t key;
+} ShaderCacheHeader;
+
+static const char *shaderCacheDir = SHADER_CACHE_DEFAULT_DIR;
+static bool shaderCacheDirMade = false;
+
+void SetShaderCacheDir(const char *dir) {
+  shaderCacheDir = dir;
+  shaderCacheDirMade = false;
+}
 
-Shader LoadShader(const char *vsPath, const char *fsPath) {
-  Shader shader = {0};
-  int glStatus = 0;
-  char *vsSource = NULL;
-  char *fsSource = NULL;
-  unsigned vsId = 0;
-  unsigned fsId = 0;
-  char shaderLog[512] = {0};
+// Create the cache directory the first time a program is saved, the cache
+// is disabled when it cannot be made
+static bool MakeShaderCacheDir() {
+  if (shaderCacheDirMade) {
+    return true;
+  }
 
-  vsSource = LoadFileContents(vsPath);
-  if (vsSource == NULL) {
-    Log(LOG_ERROR, "cannot load shader file: %s", vsPath);
-    shader.status = E_CANNOT_LOAD_FILE;
-    goto terminate;
+  if (mkdir(shaderCacheDir, 0755) != 0 && errno != EEXIST) {
+    Log(LOG_WARN, "cannot create shader cache directory %s: %s",
+        shaderCacheDir, strerror(errno));
+    shaderCacheDir = NULL;
+    return false;
   }
 
-  fsSource = LoadFileContents(fsPath);
-  if (fsSource == NULL) {
-    Log(LOG_ERROR, "cannot load shader file: %s", fsPath);
-    shader.status = E_CANNOT_LOAD_FILE;
-    goto terminate;
+  shaderCacheDirMade = true;
+  return true;
+}
+
+static uint64_t HashString(uint64_t hash, const char *str) {
+  // FNV-1a, including the terminator so concatenations do not collide
+  const unsigned char *c = (const unsigned char *)(str != NULL ? str : "");
+  do {
+    hash ^= *c;
+    hash *= UINT64_C(0x100000001b3);
+  } while (*c++ != '\0');
+  return hash;
+}
+
+// Key a program by its sources, defines and the driver that compiled it
+static uint64_t MakeShaderCacheKey(const char *vsSource, const char *fsSource,
+                                   const char *defines) {
+  uint64_t hash = UINT64_C(0xcbf29ce484222325);
+  hash = HashString(hash, vsSource);
+  hash = HashString(hash, fsSource);
+  hash = HashString(hash, defines);
+  hash = HashString(hash, (const char *)glGetString(GL_VENDOR));
+  hash = HashString(hash, (const char *)glGetString(GL_RENDERER));
+  hash = HashString(hash, (const char *)glGetString(GL_VERSION));
+  return hash;
+}
+
+static bool GetShaderCachePath(char *path, size_t size, uint64_t key) {
+  if (shaderCacheDir == NULL) {
+    return false;
   }
 
-  glStatus = 0;
-  vsId = glCreateShader(GL_VERTEX_SHADER);
-  glShaderSource(vsId, 1, (const char **)&vsSource, NULL);
-  glCompileShader(vsId);
-  glGetShaderiv(vsId, GL_COMPILE_STATUS, &glStatus);
-  if (!glStatus) {
-    shader.status = E_SHADER_COMPILE_ERROR;
-    glGetShaderInfoLog(vsId, 512, NULL, shaderLog);
-    Log(LOG_ERROR, "cannot compile vertex shader: %s: %s", vsPath, shaderLog);
+  int written = snprintf(path, size, "%s/%016llx.bin", shaderCacheDir,
+                         (unsigned long long)key);
+  return written > 0 && (size_t)written < size;
+}
+
+// Restore a linked program from the cache, false when missing or rejected
+static bool LoadProgramBinary(Shader *shader, uint64_t key) {
+  char path[512] = {0};
+  if (!GetShaderCachePath(path, sizeof(path), key)) {
+    return false;
+  }
+
+  FILE *file = fopen(path, "rb");
+  if (file == NULL) {
+    return false;
+  }
+
+  bool loaded = false;
+  void *binary = NULL;
+  ShaderCacheHeader header = {0};
+  if (fread(&header, sizeof(header), 1, file) != 1 ||
+      header.magic != SHADER_CACHE_MAGIC ||
+      header.version != SHADER_CACHE_VERSION || header.key != key ||
+      header.length == 0) {
     goto terminate;
   }
 
-  glStatus = 0;
-  fsId = glCreateShader(GL_FRAGMENT_SHADER);
-  glShaderSource(fsId, 1, (const char **)&fsSource, NULL);
-  glCompileShader(fsId);
-  glGetShaderiv(fsId, GL_COMPILE_STATUS, &glStatus);
-  if (!glStatus) {
-    shader.status = E_SHADER_COMPILE_ERROR;
-    glGetShaderInfoLog(fsId, 512, NULL, shaderLog);
-    Log(LOG_ERROR, "cannot compile fragment shader: %s: %s", fsPath, shaderLog);
+  binary = malloc(header.length);
+  if (binary == NULL || fread(binary, header.length, 1, file) != 1) {
     goto terminate;
   }
 
-  shader.spId = glCreateProgram();
-  glAttachShader(shader.spId, vsId);
-  glAttachShader(shader.spId, fsId);
-  glLinkProgram(shader.spId);
-  glGetShaderiv(shader.spId, GL_LINK_STATUS, &glStatus);
+  // Drivers reject binaries from other versions, fall back to compiling
+  int glStatus = 0;
+  unsigned spId = glCreateProgram();
+  glProgramBinary(spId, header.format, binary, (GLsizei)header.length);
+  glGetProgramiv(spId, GL_LINK_STATUS, &glStatus);
   if (!glStatus) {
-    shader.status = E_SHADER_LINK_ERROR;
-    glGetShaderInfoLog(shader.spId, 512, NULL, shaderLog);
-    Log(LOG_ERROR, "cannot link shader program: %s", shaderLog);
+    Log(LOG_WARN, "stale program binary rejected: %s", path);
+    glDeleteProgram(spId);
     goto terminate;
   }
-  shader.status = SUCCESS;
+
+  shader->spId = spId;
+  shader->fromCache = true;
+  loaded = true;
 
 terminate:
-  if (vsId != 0) {
-    glDetachShader(shader.spId, vsId);
-    glDeleteShader(vsId);
+  if (binary != NULL) {
+    free(binary);
   }
 
-  if (fsId != 0) {
-    glDetachShader(shader.spId, fsId);
-    glDeleteShader(fsId);
+  fclose(file);
+  return loaded;
+}
+
+// Store a linked program in the cache, failures only cost a recompile
+static void SaveProgramBinary(Shader shader, uint64_t key) {
+  char path[512] = {0};
+  char tmpPath[520] = {0};
+  if (!GetShaderCachePath(path, sizeof(path), key) || !MakeShaderCacheDir()) {
+    return;
   }
 
-  if (shader.status != SUCCESS) {
-    DestroyShader(shader);
+  int length = 0;
+  glGetProgramiv(shader.spId, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) {
+    return;
+  }
+
+  void *binary = malloc((size_t)length);
+  if (binary == NULL) {
+    return;
+  }
+
+  ShaderCacheHeader header = {
+      .magic = SHADER_CACHE_MAGIC,
+      .version = SHADER_CACHE_VERSION,
+      .key = key,
+  };
+  GLenum format = 0;
+  GLsizei written = 0;
+  glGetProgramBinary(shader.spId, length, &written, &format, binary);
+  header.format = format;
+  header.length = (uint32_t)written;
+
+  // Write to a temporary file first so readers never see partial binaries
+  snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+  FILE *file = fopen(tmpPath, "wb");
+  if (file != NULL) {
+    bool ok = written > 0 && fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(binary, (size_t)written, 1, file) == 1;
+    ok = fclose(file) == 0 && ok;
+    if (!ok || rename(tmpPath, path) != 0) {
+      Log(LOG_WARN, "cannot write program binary: %s", path);
+      remove(tmpPath);
+    }
+  }
+
+  free(binary);
+}
+
+// Cache all active uniforms and uniform blocks of a linked program, binding
+// the camera block to its fixed slot.
+static StatusCode ReflectShader(Shader *shader) {
+  unsigned spId = shader->spId;
+  int uniformsCount = 0;
+  int blocksCount = 0;
+  glGetProgramiv(spId, GL_ACTIVE_UNIFORMS, &uniformsCount);
+  glGetProgramiv(spId, GL_ACTIVE_UNIFORM_BLOCKS, &blocksCount);
+
+  if (uniformsCount > 0) {
+    shader->uniforms = calloc(uniformsCount, sizeof(ShaderUniform));
+    if (shader->uniforms == NULL) {
+      return E_OUT_OF_MEMORY;
+    }
+  }
+
+  for (int i = 0; i < uniformsCount; i++) {
+    ShaderUniform *uniform = shader->uniforms + shader->uniformsCount;
+    glGetActiveUniform(spId, (unsigned)i, SHADER_MAX_NAME, NULL,
+                       &uniform->size, &uniform->type, uniform->name);
+
+    // Members of uniform blocks have no location, skip them
+    uniform->location = glGetUniformLocation(spId, uniform->name);
+    if (uniform->location >= 0) {
+      shader->uniformsCount++;
+    }
+  }
+
+  if (blocksCount > 0) {
+    shader->blocks = calloc(blocksCount, sizeof(ShaderUniformBlock));
+    if (shader->blocks == NULL) {
+      return E_OUT_OF_MEMORY;
+    }
+  }
+
+  for (int i = 0; i < blocksCount; i++) {
+    ShaderUniformBlock *block = shader->blocks + i;
+    block->index = (unsigned)i;
+    block->binding = -1;
+    glGetActiveUniformBlockName(spId, block->index, SHADER_MAX_NAME, NULL,
+                                block->name);
+    glGetActiveUniformBlockiv(spId, block->index, GL_UNIFORM_BLOCK_DATA_SIZE,
+                              &block->dataSize);
+
+    if (strcmp(block->name, SHADER_CAMERA_BLOCK) == 0) {
+      glUniformBlockBinding(spId, block->index, SHADER_CAMERA_BINDING);
+      block->binding = SHADER_CAMERA_BINDING;
+    }
+  }
+  shader->blocksCount = (size_t)blocksCount;
+
+  shader->modelLoc = ShaderGetUniformLocation(*shader, "model");
+  return SUCCESS;
+}
+
+// Growable buffer holding a preprocessed shader source
+typedef struct {
+  char *data;
+  size_t length;
+  size_t capacity;
+} ShaderSource;
+
+static bool AppendShaderSource(ShaderSource *source, const char *str,
+                               size_t length) {
+  if (source->length + length + 1 > source->capacity) {
+    size_t capacity = source->capacity > 0 ? source->capacity : 1024;
+    while (source->length + length + 1 > capacity) {
+      capacity *= 2;
+    }
+
+    char *data = realloc(source->data, capacity);
+    if (data == NULL) {
+      return false;
+    }
+
+    source->data = data;
+    source->capacity = capacity;
+  }
+
+  memcpy(source->data + source->length, str, length);
+  source->length += length;
+  source->data[source->length] = '\0';
+  return true;
+}
+
+// Append the contents of a shader file resolving #include "file" directives
+// relative to it. Defines are injected right after the #version directive.
+static bool PreprocessShaderFile(ShaderSource *out, const char *path,
+                                 const char *defines, int depth) {
+  if (depth > SHADER_MAX_INCLUDE_DEPTH) {
+    Log(LOG_ERROR, "too many nested includes in shader file: %s", path);
+    return false;
+  }
+
+  char *source = LoadFileContents(path);
+  if (source == NULL) {
+    Log(LOG_ERROR, "cannot load shader file: %s", path);
+    return false;
+  }
+
+  bool ok = true;
+  if (defines != NULL && strstr(source, "#version") == NULL) {
+    ok = AppendShaderSource(out, defines, strlen(defines));
+    defines = NULL;
+  }
+
+  const char *line = source;
+  while (ok && *line != '\0') {
+    const char *end = strchr(line, '\n');
+    size_t length = end != NULL ? (size_t)(end - line) + 1 : strlen(line);
+    const char *directive = line + strspn(line, " \t");
+
+    if (strncmp(directive, "#include", 8) == 0) {
+      const char *nameStart = strchr(directive, '"');
+      const char *nameEnd = nameStart != NULL && nameStart < line + length
+                                ? strchr(nameStart + 1, '"')
+                                : NULL;
+      if (nameEnd == NULL || nameEnd >= line + length) {
+        Log(LOG_ERROR, "malformed include in shader file: %s", path);
+        ok = false;
+        break;
+      }
+
+      // Includes are relative to the directory of the including file
+      char includePath[512] = {0};
+      const char *slash = strrchr(path, '/');
+      int dirLength = slash != NULL ? (int)(slash - path) + 1 : 0;
+      int nameLength = (int)(nameEnd - nameStart - 1);
+      int written = snprintf(includePath, sizeof(includePath), "%.*s%.*s",
+                             dirLength, path, nameLength, nameStart + 1);
+      if (written < 0 || (size_t)written >= sizeof(includePath)) {
+        Log(LOG_ERROR, "include path too long in shader file: %s", path);
+        ok = false;
+        break;
+      }
+
+      ok = PreprocessShaderFile(out, includePath, NULL, depth + 1) &&
+           AppendShaderSource(out, "\n", 1);
+    } else {
+      ok = AppendShaderSource(out, line, length);
+      if (ok && defines != NULL && strncmp(directive, "#version", 8) == 0) {
+        if (end == NULL) {
+          ok = AppendShaderSource(out, "\n", 1);
+        }
+        ok = ok && AppendShaderSource(out, defines, strlen(defines));
+        defines = NULL;
+      }
+    }
+
+    line += length;
+  }
+
+  free(source);
+  return ok;
+}
+
+static char *PreprocessShader(const char *path, const char *defines) {
+  ShaderSource source = {0};
+  if (!PreprocessShaderFile(&source, path, defines, 0)) {
+    if (source.data != NULL) {
+      free(source.data);
+    }
+    return NULL;
+  }
+
+  return source.data;
+}
+
+// Build the #define block of a variant, each flag maps to one define
+static void MakeShaderDefines(unsigned variant, char *defines, size_t size) {
+  static const char *names[] = {
+      "HAS_SKINNING",
+      "HAS_VERTEX_COLORS",
+      "HAS_TEXTURE",
+      "HAS_INDIRECT",
+  };
+
+  size_t length = 0;
+  defines[0] = '\0';
+  for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+    if ((variant & (1u << i)) == 0) {
+      continue;
+    }
+
+    int written =
+        snprintf(defines + length, size - length, "#define %s\n", names[i]);
+    assert(written > 0 && (size_t)written < size - length &&
+           "invalid state: shader defines do not fit");
+    length += (size_t)written;
+  }
+}
+
+// Let the driver compile on as many threads as it wants, once per context
+static void EnableParallelShaderCompile() {
+  static bool enabled = false;
+  if (enabled) {
+    return;
   }
 
+  if (GLAD_GL_KHR_parallel_shader_compile) {
+    glMaxShaderCompilerThreadsKHR(0xFFFFFFFFu);
+  } else if (GLAD_GL_ARB_parallel_shader_compile) {
+    glMaxShaderCompilerThreadsARB(0xFFFFFFFFu);
+  }
+  enabled = true;
+}
+
+static unsigned StartCompileShader(unsigned type, const char *source) {
+  unsigned id = glCreateShader(type);
+  glShaderSource(id, 1, &source, NULL);
+  glCompileShader(id);
+  return id;
+}
+
+Shader BeginLoadShader(const char *vsPath, const char *fsPath,
+                       unsigned variant) {
+  Shader shader = {0};
+  char defines[256] = {0};
+  char *vsSource = NULL;
+  char *fsSource = NULL;
+
+  shader.variant = variant;
+  shader.startTime = GetTime();
+  shader.status = SUCCESS;
+  EnableParallelShaderCompile();
+
+  MakeShaderDefines(variant, defines, sizeof(defines));
+  vsSource = PreprocessShader(vsPath, defines);
+  fsSource = PreprocessShader(fsPath, defines);
+  if (vsSource == NULL || fsSource == NULL) {
+    shader.status = E_CANNOT_LOAD_FILE;
+    goto terminate;
+  }
+
+  shader.cacheKey = MakeShaderCacheKey(vsSource, fsSource, defines);
+  if (LoadProgramBinary(&shader, shader.cacheKey)) {
+    shader.pending = true;
+    goto terminate;
+  }
+
+  // Nothing here waits for the driver, statuses are queried when finishing
+  shader.vsId = StartCompileShader(GL_VERTEX_SHADER, vsSource);
+  shader.fsId = StartCompileShader(GL_FRAGMENT_SHADER, fsSource);
+  shader.spId = glCreateProgram();
+  glProgramParameteri(shader.spId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+                      GL_TRUE);
+  glAttachShader(shader.spId, shader.vsId);
+  glAttachShader(shader.spId, shader.fsId);
+  glLinkProgram(shader.spId);
+  shader.pending = true;
+
+terminate:
   if (vsSource != NULL) {
     free(vsSource);
   }
@@ -92,12 +454,170 @@ terminate:
   return shader;
 }
 
+bool ShaderIsReady(Shader shader) {
+  if (!shader.pending || shader.spId == 0) {
+    return true;
+  }
+
+  if (GLAD_GL_KHR_parallel_shader_compile ||
+      GLAD_GL_ARB_parallel_shader_compile) {
+    int completed = 0;
+    glGetProgramiv(shader.spId, GL_COMPLETION_STATUS_KHR, &completed);
+    return completed != 0;
+  }
+
+  // Without the extension asking for the status blocks anyway
+  return true;
+}
+
+// Log why a stage failed to compile, only called after a failed link
+static bool CheckShaderCompiled(unsigned id, const char *stage,
+                                unsigned variant) {
+  int glStatus = 0;
+  char shaderLog[512] = {0};
+  glGetShaderiv(id, GL_COMPILE_STATUS, &glStatus);
+  if (!glStatus) {
+    glGetShaderInfoLog(id, sizeof(shaderLog), NULL, shaderLog);
+    Log(LOG_ERROR, "cannot compile %s shader (variant %#x): %s", stage,
+        variant, shaderLog);
+  }
+
+  return glStatus != 0;
+}
+
+StatusCode FinishLoadShader(Shader *shader) {
+  assert(shader != NULL && "invalid arg shader: cannot be NULL");
+  PROFILE_ZONE("FinishLoadShader");
+  if (!shader->pending) {
+    return shader->status;
+  }
+  shader->pending = false;
+
+  if (!shader->fromCache) {
+    int glStatus = 0;
+    char shaderLog[512] = {0};
+    glGetProgramiv(shader->spId, GL_LINK_STATUS, &glStatus);
+    if (!glStatus) {
+      if (!CheckShaderCompiled(shader->vsId, "vertex", shader->variant) ||
+          !CheckShaderCompiled(shader->fsId, "fragment", shader->variant)) {
+        shader->status = E_SHADER_COMPILE_ERROR;
+      } else {
+        glGetProgramInfoLog(shader->spId, sizeof(shaderLog), NULL, shaderLog);
+        Log(LOG_ERROR, "cannot link shader program (variant %#x): %s",
+            shader->variant, shaderLog);
+        shader->status = E_SHADER_LINK_ERROR;
+      }
+    } else {
+      SaveProgramBinary(*shader, shader->cacheKey);
+    }
+
+    glDetachShader(shader->spId, shader->vsId);
+    glDeleteShader(shader->vsId);
+    glDetachShader(shader->spId, shader->fsId);
+    glDeleteShader(shader->fsId);
+    shader->vsId = 0;
+    shader->fsId = 0;
+  }
+
+  if (shader->status == SUCCESS) {
+    shader->status = ReflectShader(shader);
+    if (shader->status != SUCCESS) {
+      Log(LOG_ERROR, "cannot reflect shader program (out of memory)");
+    }
+  }
+
+  if (shader->status != SUCCESS) {
+    DestroyShader(*shader);
+    shader->spId = 0;
+    return shader->status;
+  }
+
+  Log(LOG_INFO, "loaded shader variant %#x in %.2f ms (cache %s)",
+      shader->variant, (GetTime() - shader->startTime) * 1000.0,
+      shader->fromCache ? "warm" : "cold");
+  return SUCCESS;
+}
+
+Shader LoadShader(const char *vsPath, const char *fsPath) {
+  Shader shader = BeginLoadShader(vsPath, fsPath,
+                                  SHADER_VARIANT_VERTEX_COLORS);
+  FinishLoadShader(&shader);
+  return shader;
+}
+
+Shader LoadComputeShader(const char *csPath) {
+  Shader shader = {0};
+  shader.startTime = GetTime();
+  char *csSource = PreprocessShader(csPath, NULL);
+  if (csSource == NULL) {
+    shader.status = E_CANNOT_LOAD_FILE;
+    return shader;
+  }
+
+  unsigned csId = StartCompileShader(GL_COMPUTE_SHADER, csSource);
+  free(csSource);
+
+  shader.spId = glCreateProgram();
+  glAttachShader(shader.spId, csId);
+  glLinkProgram(shader.spId);
+
+  int glStatus = 0;
+  char shaderLog[512] = {0};
+  glGetProgramiv(shader.spId, GL_LINK_STATUS, &glStatus);
+  if (!glStatus) {
+    if (!CheckShaderCompiled(csId, "compute", 0)) {
+      shader.status = E_SHADER_COMPILE_ERROR;
+    } else {
+      glGetProgramInfoLog(shader.spId, sizeof(shaderLog), NULL, shaderLog);
+      Log(LOG_ERROR, "cannot link compute program: %s", shaderLog);
+      shader.status = E_SHADER_LINK_ERROR;
+    }
+  }
+
+  glDetachShader(shader.spId, csId);
+  glDeleteShader(csId);
+
+  if (shader.status == SUCCESS) {
+    shader.status = ReflectShader(&shader);
+    if (shader.status != SUCCESS) {
+      Log(LOG_ERROR, "cannot reflect compute program (out of memory)");
+    }
+  }
+
+  if (shader.status != SUCCESS) {
+    DestroyShader(shader);
+    shader.spId = 0;
+    return shader;
+  }
+
+  Log(LOG_INFO, "loaded compute program %s in %.2f ms", csPath,
+      (GetTime() - shader.startTime) * 1000.0);
+  return shader;
+}
+
 void DestroyShader(Shader shader) {
-  if (shader.spId != 0) {
-    glDeleteProgram(shader.spId);
+  GLStateDeleteProgram(shader.spId);
+
+  if (shader.uniforms != NULL) {
+    free(shader.uniforms);
+  }
+
+  if (shader.blocks != NULL) {
+    free(shader.blocks);
   }
 }
 
+int ShaderGetUniformLocation(Shader shader, const char *name) {
+  assert(name != NULL && "invalid arg name: cannot be NULL");
+  for (size_t i = 0; i < shader.uniformsCount; i++) {
+    if (strcmp(shader.uniforms[i].name, name) == 0) {
+      return shader.uniforms[i].location;
+    }
+  }
+
+  return -1;
+}
+
 Model MakeCube(float dim) {
   Model model = {0};
   model.meshesCount = 1;
@@ -144,262 +664,912 @@ Model MakeCube(float dim) {
   };
   // clang-format on
   mesh->indicesCount = 36;
+  mesh->indexType = GL_UNSIGNED_INT;
+  mesh->boundsMin = (Vec3){-dim, -dim, -dim};
+  mesh->boundsMax = (Vec3){dim, dim, dim};
+  model.boundsMin = mesh->boundsMin;
+  model.boundsMax = mesh->boundsMax;
 
   // upload model
-  glGenVertexArrays(1, &model.vao);
+  glGenVertexArrays(1, &mesh->vao);
   glGenBuffers(1, &mesh->vbo);
   glGenBuffers(1, &mesh->ebo);
 
-  glBindVertexArray(model.vao);
-  glBindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
+  GLStateBindVertexArray(mesh->vao);
+  GLStateBindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
   glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->ebo);
+  GLStateBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->ebo);
   glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices,
                GL_STATIC_DRAW);
+  FrameStatsAdd(FRAME_STAT_UPLOADED_BYTES, sizeof(vertices) + sizeof(indices));
 
   // position attribute
   glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void *)0);
   glEnableVertexAttribArray(0);
 
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
-  glBindVertexArray(0);
+  GLStateBindBuffer(GL_ARRAY_BUFFER, 0);
+  GLStateBindVertexArray(0);
   return model;
 }
 
-Model LoadModel(const char *path) {
+// Stages measured on the calling thread, NULL when not measured
+static _Thread_local LoadStats *loadStats = NULL;
+
+// Pool decoding the embedded buffers and compressed buffer views and
+// generating the attributes missing from the files, NULL when none
+static _Thread_local JobPool *loadPool = NULL;
+
+static const char *loadStageNames[LOAD_STAGE_COUNT] = {
+    [LOAD_STAGE_PARSE] = "parse",
+    [LOAD_STAGE_VALIDATE] = "validate",
+    [LOAD_STAGE_LOAD_BUFFERS] = "loadBuffers",
+    [LOAD_STAGE_DECODE_MESHOPT] = "decodeMeshopt",
+    [LOAD_STAGE_REPACK_ATTRIBUTES] = "repackAttributes",
+    [LOAD_STAGE_REPACK_INDICES] = "repackIndices",
+    [LOAD_STAGE_GENERATE_NORMALS] = "generateNormals",
+    [LOAD_STAGE_GENERATE_TANGENTS] = "generateTangents",
+    [LOAD_STAGE_UPLOAD_VERTICES] = "uploadVertices",
+    [LOAD_STAGE_UPLOAD_INDICES] = "uploadIndices",
+};
+
+void SetLoadStats(LoadStats *stats) { loadStats = stats; }
+
+void SetLoadJobPool(JobPool *pool) { loadPool = pool; }
+
+const char *GetLoadStageName(LoadStage stage) {
+  assert(stage >= 0 && stage < LOAD_STAGE_COUNT &&
+         "invalid arg stage: outside range");
+  return loadStageNames[stage];
+}
+
+static double BeginLoadStage() { return loadStats != NULL ? GetTime() : 0.0; }
+
+static void EndLoadStage(LoadStage stage, double start, size_t bytes) {
+  if (loadStats != NULL) {
+    loadStats->seconds[stage] += GetTime() - start;
+    loadStats->allocatedBytes[stage] += bytes;
+  }
+}
+
+// Allocator given to cgltf, everything decoded from the file comes from its
+// arena and is released at once with it. Adds to the current stage while
+// measuring.
+typedef struct {
+  Arena arena;
+  LoadStats *stats;
+  LoadStage stage;
+} LoadAllocator;
+
+static void *LoadAllocatorAlloc(void *user, cgltf_size size) {
+  LoadAllocator *allocator = user;
+  if (allocator->stats != NULL) {
+    allocator->stats->allocatedBytes[allocator->stage] += size;
+  }
+  return ArenaAlloc(&allocator->arena, size);
+}
+
+// Single allocations stay until the arena is released
+static void LoadAllocatorFree(void *user, void *ptr) {
+  (void)user;
+  (void)ptr;
+}
+
+// Release everything cgltf and the decoding allocated, which makes
+// cgltf_free needless, and report the allocations made
+static void ReleaseLoadAllocator(LoadAllocator *allocator) {
+  LoadStats *stats = allocator->stats;
+  if (stats != NULL) {
+    stats->transientAllocations += allocator->arena.allocations;
+    if (allocator->arena.blockBytes > stats->transientPeakBytes) {
+      stats->transientPeakBytes = allocator->arena.blockBytes;
+    }
+  }
+  DestroyArena(&allocator->arena);
+}
+
+// Decode the buffers embedded as base64 data: URIs straight into their data,
+// allocated as cgltf does so that it is released with the model.
+// cgltf_load_buffers skips the buffers already loaded.
+static StatusCode LoadDataUris(cgltf_data *data) {
+  static const char base64[] = ";base64";
+  size_t base64Length = sizeof(base64) - 1;
+  for (size_t i = 0; i < data->buffers_count; i++) {
+    cgltf_buffer *buffer = data->buffers + i;
+    const char *uri = buffer->uri;
+    if (buffer->data != NULL || uri == NULL || buffer->size == 0 ||
+        strncmp(uri, "data:", 5) != 0) {
+      continue;
+    }
+
+    const char *comma = strchr(uri, ',');
+    if (comma == NULL || (size_t)(comma - uri) < base64Length ||
+        strncmp(comma - base64Length, base64, base64Length) != 0) {
+      continue;
+    }
+
+    uint8_t *dst = data->memory.alloc_func(data->memory.user_data,
+                                           buffer->size);
+    if (dst == NULL) {
+      return E_OUT_OF_MEMORY;
+    }
+
+    const char *src = comma + 1;
+    if (DecodeBase64(dst, buffer->size, src, strlen(src), loadPool) !=
+        SUCCESS) {
+      Log(LOG_ERROR, "invalid base64 data of buffer #%zu", i);
+      data->memory.free_func(data->memory.user_data, dst);
+      return E_CANNOT_LOAD_FILE;
+    }
+
+    buffer->data = dst;
+    buffer->data_free_method = cgltf_data_free_method_memory_free;
+  }
+  return SUCCESS;
+}
+
+// Buffer views compressed with EXT_meshopt_compression, decoded by jobs
+typedef struct {
+  cgltf_buffer_view *first;
+  cgltf_buffer_view **views;
+  atomic_bool failed;
+} MeshoptViews;
+
+static MeshoptMode GetMeshoptMode(cgltf_meshopt_compression_mode mode) {
+  switch (mode) {
+  case cgltf_meshopt_compression_mode_triangles:
+    return MESHOPT_MODE_TRIANGLES;
+  case cgltf_meshopt_compression_mode_indices:
+    return MESHOPT_MODE_INDICES;
+  default:
+    return MESHOPT_MODE_ATTRIBUTES;
+  }
+}
+
+static MeshoptFilter GetMeshoptFilter(cgltf_meshopt_compression_filter filter) {
+  switch (filter) {
+  case cgltf_meshopt_compression_filter_octahedral:
+    return MESHOPT_FILTER_OCTAHEDRAL;
+  case cgltf_meshopt_compression_filter_quaternion:
+    return MESHOPT_FILTER_QUATERNION;
+  case cgltf_meshopt_compression_filter_exponential:
+    return MESHOPT_FILTER_EXPONENTIAL;
+  default:
+    return MESHOPT_FILTER_NONE;
+  }
+}
+
+static void DecodeMeshoptView(void *data, size_t index) {
+  MeshoptViews *views = data;
+  cgltf_buffer_view *view = views->views[index];
+  cgltf_meshopt_compression *compression = &view->meshopt_compression;
+  const uint8_t *src = (const uint8_t *)compression->buffer->data +
+                       compression->offset;
+  StatusCode status = MeshoptDecode(
+      view->data, compression->count, compression->stride, src,
+      compression->size, GetMeshoptMode(compression->mode),
+      GetMeshoptFilter(compression->filter));
+  if (status != SUCCESS) {
+    Log(LOG_ERROR, "invalid compressed buffer view #%zu",
+        (size_t)(view - views->first));
+    atomic_store(&views->failed, true);
+  }
+}
+
+// Largest views first, so the last jobs of the pool are the short ones
+static int CompareViewSizes(const void *a, const void *b) {
+  size_t sizeA = (*(cgltf_buffer_view *const *)a)->size;
+  size_t sizeB = (*(cgltf_buffer_view *const *)b)->size;
+  return (sizeA < sizeB) - (sizeA > sizeB);
+}
+
+// Decode every view compressed with EXT_meshopt_compression into its own
+// data, allocated as cgltf does so that it is released with the model
+static StatusCode DecodeMeshoptViews(cgltf_data *data) {
+  StatusCode status = SUCCESS;
+  MeshoptViews decoding = {data->buffer_views, NULL};
+  atomic_init(&decoding.failed, false);
+
+  size_t count = 0;
+  for (size_t i = 0; i < data->buffer_views_count; i++) {
+    count += data->buffer_views[i].has_meshopt_compression;
+  }
+  if (count == 0) {
+    return SUCCESS;
+  }
+
+  cgltf_memory_options *memory = &data->memory;
+  decoding.views = memory->alloc_func(memory->user_data,
+                                      count * sizeof(cgltf_buffer_view *));
+  if (decoding.views == NULL) {
+    return E_OUT_OF_MEMORY;
+  }
+
+  // The compressed data needs a loaded buffer and must decode to the size of
+  // the view, the buffer of the view itself is usually a fallback without one
+  count = 0;
+  for (size_t i = 0; i < data->buffer_views_count; i++) {
+    cgltf_buffer_view *view = data->buffer_views + i;
+    cgltf_meshopt_compression *compression = &view->meshopt_compression;
+    if (!view->has_meshopt_compression) {
+      continue;
+    }
+
+    if (compression->buffer->data == NULL ||
+        compression->offset + compression->size > compression->buffer->size ||
+        compression->mode == cgltf_meshopt_compression_mode_invalid ||
+        compression->count * compression->stride != view->size) {
+      Log(LOG_ERROR, "invalid compressed buffer view #%zu", i);
+      status = E_CANNOT_LOAD_FILE;
+      goto terminate;
+    }
+
+    view->data = memory->alloc_func(memory->user_data, view->size + 1);
+    if (view->data == NULL) {
+      status = E_OUT_OF_MEMORY;
+      goto terminate;
+    }
+    decoding.views[count++] = view;
+  }
+
+  qsort(decoding.views, count, sizeof(cgltf_buffer_view *), CompareViewSizes);
+  JobPoolParallelFor(loadPool, count, DecodeMeshoptView, &decoding);
+  if (atomic_load(&decoding.failed)) {
+    status = E_CANNOT_LOAD_FILE;
+  }
+
+terminate:
+  memory->free_func(memory->user_data, decoding.views);
+  return status;
+}
+
+// Return a pointer to the first element of an accessor and its stride, NULL
+// when its buffer was not loaded. Compressed views point to their decoded
+// data.
+static char *GetAccessorData(cgltf_accessor *accessor, size_t *stride) {
+  cgltf_buffer_view *view = accessor->buffer_view;
+  *stride = accessor->stride;
+  if (view->data != NULL) {
+    return (char *)view->data + accessor->offset;
+  }
+
+  if (view->buffer->data == NULL) {
+    return NULL;
+  }
+  return (char *)view->buffer->data + view->offset + accessor->offset;
+}
+
+// Encodings of the components an attribute accepts, KHR_mesh_quantization
+// adds the integer ones to the floats of the core spec
+enum {
+  ATTRIBUTE_FLOAT = 1,
+  ATTRIBUTE_SNORM = 2,
+  ATTRIBUTE_UNORM = 4,
+  ATTRIBUTE_INTEGER = 8,
+};
+
+// Accessor of an attribute read as floats, data is NULL when absent
+typedef struct {
+  const char *data;
+  size_t stride;
+  cgltf_component_type type;
+  bool normalized;
+  size_t components;
+} AttributeReader;
+
+// Make a reader of an accessor of the given type, returns false when its
+// components are not one of the accepted encodings or were not loaded
+static bool MakeAttributeReader(cgltf_accessor *accessor, cgltf_type type,
+                                int accepted, AttributeReader *reader) {
+  int encoding = 0;
+  switch (accessor->component_type) {
+  case cgltf_component_type_r_32f:
+    encoding = ATTRIBUTE_FLOAT;
+    break;
+  case cgltf_component_type_r_8:
+  case cgltf_component_type_r_16:
+    encoding = accessor->normalized ? ATTRIBUTE_SNORM : ATTRIBUTE_INTEGER;
+    break;
+  case cgltf_component_type_r_8u:
+  case cgltf_component_type_r_16u:
+    encoding = accessor->normalized ? ATTRIBUTE_UNORM : ATTRIBUTE_INTEGER;
+    break;
+  default:
+    break;
+  }
+
+  if (accessor->type != type || (encoding & accepted) == 0) {
+    return false;
+  }
+
+  reader->data = GetAccessorData(accessor, &reader->stride);
+  reader->type = accessor->component_type;
+  reader->normalized = accessor->normalized;
+  reader->components = cgltf_num_components(type);
+  return reader->data != NULL;
+}
+
+// Read a component as KHR_mesh_quantization converts it, normalized
+// integers map to 0 to 1 or -1 to 1 and the others keep their value
+static float ReadComponent(const char *src, cgltf_component_type type,
+                           bool normalized) {
+  switch (type) {
+  case cgltf_component_type_r_8: {
+    int8_t v = *(const int8_t *)src;
+    return normalized ? fmaxf((float)v / 127.0f, -1.0f) : (float)v;
+  }
+  case cgltf_component_type_r_8u: {
+    uint8_t v = *(const uint8_t *)src;
+    return normalized ? (float)v / 255.0f : (float)v;
+  }
+  case cgltf_component_type_r_16: {
+    int16_t v;
+    memcpy(&v, src, sizeof(v));
+    return normalized ? fmaxf((float)v / 32767.0f, -1.0f) : (float)v;
+  }
+  case cgltf_component_type_r_16u: {
+    uint16_t v;
+    memcpy(&v, src, sizeof(v));
+    return normalized ? (float)v / 65535.0f : (float)v;
+  }
+  default: {
+    float v;
+    memcpy(&v, src, sizeof(v));
+    return v;
+  }
+  }
+}
+
+// Read the components of element i into dst, floats are copied as they are
+static void ReadAttribute(const AttributeReader *reader, size_t i,
+                          float *dst) {
+  const char *src = reader->data + reader->stride * i;
+  if (reader->type == cgltf_component_type_r_32f) {
+    memcpy(dst, src, reader->components * sizeof(float));
+    return;
+  }
+
+  size_t size = reader->type == cgltf_component_type_r_8 ||
+                        reader->type == cgltf_component_type_r_8u
+                    ? 1
+                    : 2;
+  for (size_t k = 0; k < reader->components; k++) {
+    dst[k] = ReadComponent(src + k * size, reader->type, reader->normalized);
+  }
+}
+
+static size_t GetIndexSize(unsigned indexType) {
+  switch (indexType) {
+  case GL_UNSIGNED_BYTE:
+    return 1;
+  case GL_UNSIGNED_SHORT:
+    return 2;
+  default:
+    return 4;
+  }
+}
+
+static StatusCode DecodeIndices(Mesh *mesh, cgltf_accessor *indices_accessor) {
+  if (indices_accessor == NULL ||
+      indices_accessor->type != cgltf_type_scalar) {
+    return E_CANNOT_LOAD_FILE;
+  }
+
+  size_t indexSize = 0;
+  switch (indices_accessor->component_type) {
+  case cgltf_component_type_r_8u:
+    mesh->indexType = GL_UNSIGNED_BYTE;
+    indexSize = 1;
+    break;
+  case cgltf_component_type_r_16u:
+    mesh->indexType = GL_UNSIGNED_SHORT;
+    indexSize = 2;
+    break;
+  case cgltf_component_type_r_32u:
+    mesh->indexType = GL_UNSIGNED_INT;
+    indexSize = 4;
+    break;
+  default:
+    return E_CANNOT_LOAD_FILE;
+  }
+
+  size_t stride = 0;
+  char *src = GetAccessorData(indices_accessor, &stride);
+  if (src == NULL) {
+    return E_CANNOT_LOAD_FILE;
+  }
+
+  mesh->indicesCount = indices_accessor->count;
+  mesh->indices = malloc(mesh->indicesCount * indexSize + 1);
+  if (mesh->indices == NULL) {
+    return E_OUT_OF_MEMORY;
+  }
+
+  // Pack the indices, a byte stride larger than the index is allowed
+  char *dst = mesh->indices;
+  if (stride == indexSize) {
+    memcpy(dst, src, mesh->indicesCount * indexSize);
+  } else {
+    for (size_t i = 0; i < mesh->indicesCount; i++) {
+      memcpy(dst + i * indexSize, src + i * stride, indexSize);
+    }
+  }
+
+  // Validation runs before the buffers are loaded and cannot check the
+  // range of the indices, every later pass reads vertices through them
+  for (size_t i = 0; i < mesh->indicesCount; i++) {
+    uint32_t index = 0;
+    if (indexSize == 1) {
+      index = ((const uint8_t *)dst)[i];
+    } else if (indexSize == 2) {
+      uint16_t value;
+      memcpy(&value, dst + i * 2, 2);
+      index = value;
+    } else {
+      memcpy(&index, dst + i * 4, 4);
+    }
+
+    if (index >= mesh->verticesCount) {
+      return E_CANNOT_LOAD_FILE;
+    }
+  }
+  return SUCCESS;
+}
+
+static StatusCode DecodeMesh(Mesh *mesh, cgltf_data *data,
+                             cgltf_primitive primitive, const char *path) {
+  double start = BeginLoadStage();
+  AttributeReader pos = {0};
+  AttributeReader nor = {0};
+  AttributeReader uvs = {0};
+  AttributeReader col = {0};
+  AttributeReader tan = {0};
+  const int quantized = ATTRIBUTE_FLOAT | ATTRIBUTE_SNORM | ATTRIBUTE_UNORM |
+                        ATTRIBUTE_INTEGER;
+
+  // Load model attributes (position, normals, color, uvs, etc)
+  for (size_t ai = 0; ai < primitive.attributes_count; ai++) {
+    cgltf_attribute attribute = primitive.attributes[ai];
+    cgltf_accessor *attr_accessor = attribute.data;
+
+    if (attribute.type == cgltf_attribute_type_position) {
+      if (!MakeAttributeReader(attr_accessor, cgltf_type_vec3, quantized,
+                               &pos)) {
+        Log(LOG_WARN,
+            "error loading pos attribute #%d, type %d in file %s (not "
+            "a vec3 of floats or integers)",
+            ai, attribute.type, path);
+        return E_CANNOT_LOAD_FILE;
+      }
+
+      // Important: positions are the same as vertex count, so do not
+      // remove from here.
+      mesh->verticesCount = attr_accessor->count;
+    } else if (attribute.type == cgltf_attribute_type_color) {
+      cgltf_type type = attr_accessor->type == cgltf_type_vec3
+                            ? cgltf_type_vec3
+                            : cgltf_type_vec4;
+      if (!MakeAttributeReader(attr_accessor, type,
+                               ATTRIBUTE_FLOAT | ATTRIBUTE_UNORM, &col)) {
+        Log(LOG_WARN,
+            "error loading color attribute #%d, type %d in file %s (not "
+            "a vec3 or vec4 of floats or normalized unsigned integers)",
+            ai, attribute.type, path);
+        return E_CANNOT_LOAD_FILE;
+      }
+    } else if (attribute.type == cgltf_attribute_type_texcoord) {
+      if (!MakeAttributeReader(attr_accessor, cgltf_type_vec2, quantized,
+                               &uvs)) {
+        Log(LOG_WARN,
+            "error loading texcoord attribute #%d, type %d in file %s (not "
+            "a vec2 of floats or integers)",
+            ai, attribute.type, path);
+        return E_CANNOT_LOAD_FILE;
+      }
+    } else if (attribute.type == cgltf_attribute_type_normal) {
+      if (!MakeAttributeReader(attr_accessor, cgltf_type_vec3,
+                               ATTRIBUTE_FLOAT | ATTRIBUTE_SNORM, &nor)) {
+        Log(LOG_WARN,
+            "error loading normal attribute #%d, type %d in file %s (not a "
+            "vec3 of floats or normalized signed integers)",
+            ai, attribute.type, path);
+        return E_CANNOT_LOAD_FILE;
+      }
+    } else if (attribute.type == cgltf_attribute_type_tangent) {
+      if (!MakeAttributeReader(attr_accessor, cgltf_type_vec4,
+                               ATTRIBUTE_FLOAT | ATTRIBUTE_SNORM, &tan)) {
+        Log(LOG_WARN,
+            "error loading tangent attribute #%d, type %d in file %s (not a "
+            "vec4 of floats or normalized signed integers)",
+            ai, attribute.type, path);
+        return E_CANNOT_LOAD_FILE;
+      }
+    } else {
+      Log(LOG_WARN,
+          "ignoring attribute #%d ,type %d in file %s (not supported)", ai,
+          attribute.type, path);
+      continue;
+    }
+  }
+
+  if (pos.data == NULL) {
+    Log(LOG_ERROR, "There is no positions for the vertices");
+    return E_CANNOT_LOAD_FILE;
+  }
+
+  // Allocate space for all vertices in the mesh
+  mesh->vertices = calloc(mesh->verticesCount, sizeof(Vertex));
+  if (mesh->vertices == NULL) {
+    return E_OUT_OF_MEMORY;
+  }
+
+  // Quantized attributes are converted to floats, colors without alpha are
+  // opaque
+  for (size_t vi = 0; vi < mesh->verticesCount; vi++) {
+    Vertex *vertex = mesh->vertices + vi;
+    ReadAttribute(&pos, vi, (float *)&vertex->pos);
+
+    if (nor.data != NULL) {
+      ReadAttribute(&nor, vi, (float *)&vertex->nor);
+    }
+
+    if (uvs.data != NULL) {
+      ReadAttribute(&uvs, vi, (float *)&vertex->uvs);
+    }
+
+    if (col.data != NULL) {
+      vertex->col.w = 1.0f;
+      ReadAttribute(&col, vi, (float *)&vertex->col);
+    }
+
+    if (tan.data != NULL) {
+      ReadAttribute(&tan, vi, (float *)&vertex->tan);
+    }
+  }
+
+  // Materials are identified by their index plus one, zero means none
+  if (primitive.material != NULL) {
+    mesh->material = (unsigned)(primitive.material - data->materials) + 1;
+  }
+
+  EndLoadStage(LOAD_STAGE_REPACK_ATTRIBUTES, start,
+               mesh->verticesCount * sizeof(Vertex));
+
+  // Load model indices
+  start = BeginLoadStage();
+  StatusCode status = DecodeIndices(mesh, primitive.indices);
+  EndLoadStage(LOAD_STAGE_REPACK_INDICES, start,
+               status == SUCCESS
+                   ? mesh->indicesCount * GetIndexSize(mesh->indexType)
+                   : 0);
+  if (status != SUCCESS) {
+    Log(LOG_ERROR,
+        "invalid index array in file %s (not a buffer view of scalars "
+        "below the vertices count)",
+        path);
+    return status;
+  }
+
+  // Lighting needs normals, files without them get smooth ones. Tangents
+  // are only needed by normal maps, which also need UVs.
+  if (nor.data == NULL) {
+    start = BeginLoadStage();
+    status = GenerateNormals(mesh, NORMALS_DEFAULT_SPLIT_ANGLE, loadPool);
+    EndLoadStage(LOAD_STAGE_GENERATE_NORMALS, start, 0);
+  }
+
+  bool normalMapped = primitive.material != NULL &&
+                      primitive.material->normal_texture.texture != NULL;
+  if (status == SUCCESS && tan.data == NULL && uvs.data != NULL &&
+      normalMapped) {
+    start = BeginLoadStage();
+    status = GenerateTangents(mesh, loadPool);
+    EndLoadStage(LOAD_STAGE_GENERATE_TANGENTS, start, 0);
+  }
+  return status;
+}
+
+// Header of a binary glTF and of its first chunk, which holds the JSON
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t length;
+  uint32_t jsonLength;
+  uint32_t jsonType;
+} GlbHeader;
+
+#define GLB_MAGIC 0x46546C67
+#define GLB_CHUNK_JSON 0x4E4F534A
+
+// Read and parse a .gltf or .glb file as cgltf_parse_file does, giving cgltf
+// the count of JSON tokens so that jsmn tokenizes the document once instead
+// of twice. Should the count be off, the file is parsed again letting jsmn
+// count. The file is allocated with the memory options and released with the
+// model.
+static cgltf_result ParseModelFile(cgltf_options *options, const char *path,
+                                   cgltf_data **data) {
+  FILE *file = fopen(path, "rb");
+  if (file == NULL) {
+    return cgltf_result_file_not_found;
+  }
+
+  long size = -1;
+  if (fseek(file, 0, SEEK_END) == 0) {
+    size = ftell(file);
+  }
+  if (size <= 0 || fseek(file, 0, SEEK_SET) != 0) {
+    fclose(file);
+    return cgltf_result_io_error;
+  }
+
+  char *contents = options->memory.alloc_func != NULL
+                       ? options->memory.alloc_func(options->memory.user_data,
+                                                    (size_t)size)
+                       : malloc((size_t)size);
+  if (contents == NULL) {
+    fclose(file);
+    return cgltf_result_out_of_memory;
+  }
+
+  size_t readSize = fread(contents, 1, (size_t)size, file);
+  fclose(file);
+
+  // Binary files hold the JSON in their first chunk, cgltf checks the rest
+  const char *json = contents;
+  size_t jsonSize = readSize;
+  GlbHeader header = {0};
+  if (readSize >= sizeof(header)) {
+    memcpy(&header, contents, sizeof(header));
+  }
+  if (header.magic == GLB_MAGIC && header.jsonType == GLB_CHUNK_JSON) {
+    json = contents + sizeof(header);
+    jsonSize = header.jsonLength < readSize - sizeof(header)
+                   ? header.jsonLength
+                   : readSize - sizeof(header);
+  }
+
+  cgltf_result result = cgltf_result_io_error;
+  if (readSize == (size_t)size) {
+    options->json_token_count = CountJsonTokens(json, jsonSize);
+    result = cgltf_parse(options, contents, readSize, data);
+    if (result != cgltf_result_success && options->json_token_count != 0) {
+      options->json_token_count = 0;
+      result = cgltf_parse(options, contents, readSize, data);
+    }
+  }
+
+  if (result != cgltf_result_success) {
+    if (options->memory.free_func != NULL) {
+      options->memory.free_func(options->memory.user_data, contents);
+    } else {
+      free(contents);
+    }
+    return result;
+  }
+
+  (*data)->file_data = contents;
+  return cgltf_result_success;
+}
+
+Model DecodeModel(const char *path) {
+  PROFILE_ZONE("DecodeModel");
   Model model = {0};
 
   cgltf_options options = {0};
   cgltf_data *data = NULL;
   cgltf_result result;
 
+  // What cgltf allocates and the buffers decoded for it only live until the
+  // meshes are repacked, the meshes themselves are kept on the heap
+  LoadAllocator allocator = {MakeArena(ARENA_DEFAULT_BLOCK_SIZE), loadStats,
+                             LOAD_STAGE_PARSE};
+  options.memory.alloc_func = LoadAllocatorAlloc;
+  options.memory.free_func = LoadAllocatorFree;
+  options.memory.user_data = &allocator;
+
   // Open file, validate its contents and load external buffers if needed
-  result = cgltf_parse_file(&options, path, &data);
+  double start = BeginLoadStage();
+  result = ParseModelFile(&options, path, &data);
+  EndLoadStage(LOAD_STAGE_PARSE, start, 0);
   if (result != cgltf_result_success) {
     model.status = E_CANNOT_LOAD_FILE;
     Log(LOG_ERROR, "could not load model: %s, result: %d", path, result);
+    ReleaseLoadAllocator(&allocator);
     return model;
   }
 
+  allocator.stage = LOAD_STAGE_VALIDATE;
+  start = BeginLoadStage();
   result = cgltf_validate(data);
+  EndLoadStage(LOAD_STAGE_VALIDATE, start, 0);
   if (result != cgltf_result_success) {
     model.status = E_CANNOT_LOAD_FILE;
     Log(LOG_ERROR, "invalid model: %s, result: %d", path, result);
+    ReleaseLoadAllocator(&allocator);
     return model;
   }
 
-  result = cgltf_load_buffers(&options, data, path);
-  if (result != cgltf_result_success) {
-    model.status = E_CANNOT_LOAD_FILE;
+  allocator.stage = LOAD_STAGE_LOAD_BUFFERS;
+  start = BeginLoadStage();
+  StatusCode status = LoadDataUris(data);
+  if (status == SUCCESS) {
+    result = cgltf_load_buffers(&options, data, path);
+  }
+  EndLoadStage(LOAD_STAGE_LOAD_BUFFERS, start, 0);
+  if (status != SUCCESS || result != cgltf_result_success) {
+    model.status = status != SUCCESS ? status : E_CANNOT_LOAD_FILE;
     Log(LOG_ERROR, "error loading buffers of file: %s, result: %d", path,
         result);
+    ReleaseLoadAllocator(&allocator);
     return model;
   }
 
-  // Bind each accessor as VertexAttrib
-  unsigned vao = 0;
-  glGenVertexArrays(1, &vao);
-  glBindVertexArray(vao);
+  // Fallback buffers of compressed views are not loaded
+  if (loadStats != NULL) {
+    loadStats->inputBytes += data->json_size;
+    for (size_t i = 0; i < data->buffers_count; i++) {
+      if (data->buffers[i].data != NULL) {
+        loadStats->inputBytes += data->buffers[i].size;
+      }
+    }
+  }
+
+  allocator.stage = LOAD_STAGE_DECODE_MESHOPT;
+  start = BeginLoadStage();
+  status = DecodeMeshoptViews(data);
+  EndLoadStage(LOAD_STAGE_DECODE_MESHOPT, start, 0);
+  if (status != SUCCESS) {
+    model.status = status;
+    Log(LOG_ERROR, "error decoding compressed buffers of file: %s", path);
+    ReleaseLoadAllocator(&allocator);
+    return model;
+  }
 
   size_t meshesCount = 0;
   for (size_t i = 0; i < data->meshes_count; i++) {
     meshesCount += data->meshes[i].primitives_count;
   }
 
-  Mesh *meshes = calloc(meshesCount, sizeof(Mesh));
-  if (meshes == NULL) {
+  model.meshes = calloc(meshesCount, sizeof(Mesh));
+  if (model.meshes == NULL && meshesCount > 0) {
     model.status = E_OUT_OF_MEMORY;
-    Log(LOG_ERROR, "error loading file: %s (out of memory), result: %d", path,
-        result);
+    Log(LOG_ERROR, "error loading file: %s (out of memory)", path);
+    ReleaseLoadAllocator(&allocator);
     return model;
   }
 
-  size_t meshIndex = 0;
+  model.status = SUCCESS;
   for (size_t mi = 0; mi < data->meshes_count; mi++) {
     for (size_t pi = 0; pi < data->meshes[mi].primitives_count; pi++) {
-      Mesh *mesh = meshes + meshIndex;
-      cgltf_primitive primitive = data->meshes[mi].primitives[pi];
-
-      char *pos_buffer = NULL;
-      size_t pos_stride = 0;
-
-      char *nor_buffer = NULL;
-      size_t nor_stride = 0;
-
-      char *uvs_buffer = NULL;
-      size_t uvs_stride = 0;
-
-      char *col_buffer = NULL;
-      size_t col_stride = 0;
-
-      // Load model attributes (position, normals, color, uvs, etc)
-      for (size_t ai = 0; ai < primitive.attributes_count; ai++) {
-        cgltf_attribute attribute = primitive.attributes[ai];
-        cgltf_accessor *attr_accessor = attribute.data;
-        cgltf_buffer_view *attr_view = attr_accessor->buffer_view;
-        cgltf_buffer *attr_buf = attr_view->buffer;
-
-        if (attribute.type == cgltf_attribute_type_position) {
-          if (attr_accessor->component_type != cgltf_component_type_r_32f ||
-              attr_accessor->type != cgltf_type_vec3) {
-            Log(LOG_WARN,
-                "error loading pos attribute #%d, type %d in file %s (not "
-                "a vec3 of floats)",
-                ai, attribute.type, path);
-            model.status = E_CANNOT_LOAD_FILE;
-            return model;
-          }
-
-          pos_buffer = attr_buf->data + attr_view->offset;
-          pos_stride = attr_accessor->stride;
-          // Important: positions are the same as vertex count, so do not
-          // remove from here.
-          mesh->verticesCount = attr_accessor->count;
-        } else if (attribute.type == cgltf_attribute_type_color) {
-          cgltf_accessor *attr_accessor = attribute.data;
-          if (attr_accessor->component_type != cgltf_component_type_r_32f ||
-              attr_accessor->type != cgltf_type_vec4) {
-            Log(LOG_WARN,
-                "error loading color attribute #%d, type %d in file %s (not "
-                "a vec4 of floats)",
-                ai, attribute.type, path);
-            model.status = E_CANNOT_LOAD_FILE;
-            return model;
-          }
-
-          col_buffer = attr_buf->data + attr_view->offset;
-          col_stride = attr_accessor->stride;
-        } else if (attribute.type == cgltf_attribute_type_texcoord) {
-          cgltf_accessor *attr_accessor = attribute.data;
-          if (attr_accessor->component_type != cgltf_component_type_r_32f ||
-              attr_accessor->type != cgltf_type_vec2) {
-            Log(LOG_WARN,
-                "error loading texcoord attribute #%d, type %d in file %s (not "
-                "a vec2 of floats)",
-                ai, attribute.type, path);
-            model.status = E_CANNOT_LOAD_FILE;
-            return model;
-          }
-
-          uvs_buffer = attr_buf->data + attr_view->offset;
-          uvs_stride = attr_accessor->stride;
-        } else if (attribute.type == cgltf_attribute_type_normal) {
-          cgltf_accessor *attr_accessor = attribute.data;
-          if (attr_accessor->component_type != cgltf_component_type_r_32f ||
-              attr_accessor->type != cgltf_type_vec3) {
-            Log(LOG_WARN,
-                "error loading normal attribute #%d, type %d in file %s (not a "
-                "vec3 of floats)",
-                ai, attribute.type, path);
-            model.status = E_CANNOT_LOAD_FILE;
-            return model;
-          }
-
-          nor_buffer = attr_buf->data + attr_view->offset;
-          nor_stride = attr_accessor->stride;
-        } else {
-          Log(LOG_WARN,
-              "ignoring attribute #%d ,type %d in file %s (not supported)", ai,
-              attribute.type, path);
-          continue;
-        }
-      }
-
-      if (pos_buffer == NULL) {
-        Log(LOG_ERROR, "There is no positions for the vertices");
-        return model;
+      Mesh *mesh = model.meshes + model.meshesCount++;
+      model.status = DecodeMesh(mesh, data, data->meshes[mi].primitives[pi],
+                                path);
+      if (model.status != SUCCESS) {
+        break;
       }
+    }
 
-      // Allocate space for all vertices in the mesh
-      mesh->vertices = calloc(mesh->verticesCount, sizeof(Vertex));
-      for (size_t vi = 0; vi < mesh->verticesCount; vi++) {
-        mesh->vertices[vi].pos = *((Vec3 *)(pos_buffer + pos_stride * vi));
-
-        if (nor_buffer != NULL) {
-          mesh->vertices[vi].nor = *((Vec3 *)(nor_buffer + nor_stride * vi));
-        }
+    if (model.status != SUCCESS) {
+      break;
+    }
+  }
 
-        if (uvs_buffer != NULL) {
-          mesh->vertices[vi].uvs = *((Vec2 *)(uvs_buffer + uvs_stride * vi));
-        }
+  ReleaseLoadAllocator(&allocator);
+  if (model.status != SUCCESS) {
+    status = model.status;
+    DestroyModel(model);
+    return (Model){.status = status};
+  }
 
-        if (col_buffer != NULL) {
-          mesh->vertices[vi].col = *((Vec4 *)(col_buffer + col_stride * vi));
-        }
-      }
+  // Bounds of every mesh and of all the vertices in model space, a pass
+  // over the repacked attributes
+  start = BeginLoadStage();
+  bool seeded = false;
+  for (size_t i = 0; i < model.meshesCount; i++) {
+    Mesh *mesh = model.meshes + i;
+    if (mesh->verticesCount == 0) {
+      continue;
+    }
 
-      // Gen buffers for mesh main buffer
-      glGenBuffers(1, &mesh->vbo);
-      glBindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
-      glBufferData(GL_ARRAY_BUFFER,
-                   (GLsizeiptr)(mesh->verticesCount * sizeof(Vertex)),
-                   mesh->vertices, GL_STATIC_DRAW);
-
-      // Position attribute
-      glEnableVertexAttribArray(0);
-      glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                            (void *)offsetof(Vertex, pos));
-
-      // Normal attribute
-      glEnableVertexAttribArray(1);
-      glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                            (void *)offsetof(Vertex, nor));
-
-      // TexCoord attribute
-      glEnableVertexAttribArray(2);
-      glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                            (void *)offsetof(Vertex, uvs));
-
-      // Color attribute
-      glEnableVertexAttribArray(3);
-      glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-                            (void *)offsetof(Vertex, col));
-
-      // Load model indices
-      cgltf_accessor *indices_accessor = primitive.indices;
-      model.status = UploadIndices(mesh, indices_accessor);
-      if (model.status != SUCCESS) {
-        Log(LOG_ERROR,
-            "invalid index array in file %s (not a buffer view of scalars)",
-            path);
-        return model;
-      }
+    mesh->boundsMin = mesh->boundsMax = mesh->vertices[0].pos;
+    for (size_t vi = 1; vi < mesh->verticesCount; vi++) {
+      mesh->boundsMin = Vec3Min(mesh->boundsMin, mesh->vertices[vi].pos);
+      mesh->boundsMax = Vec3Max(mesh->boundsMax, mesh->vertices[vi].pos);
+    }
 
-      // Next mesh
-      meshIndex++;
+    // Empty meshes have no bounds, seed from the first one with vertices
+    if (!seeded) {
+      model.boundsMin = mesh->boundsMin;
+      model.boundsMax = mesh->boundsMax;
+      seeded = true;
     }
+    model.boundsMin = Vec3Min(model.boundsMin, mesh->boundsMin);
+    model.boundsMax = Vec3Max(model.boundsMax, mesh->boundsMax);
   }
+  EndLoadStage(LOAD_STAGE_REPACK_ATTRIBUTES, start, 0);
 
-  // Collect evereything and return it so we can release it when destroying
-  model.meshesCount = meshesCount;
-  model.meshes = meshes;
-  model.vao = vao;
-
-  glBindVertexArray(0);
-  cgltf_free(data);
+  model.transform = MakeTransform();
   return model;
 }
 
-StatusCode UploadIndices(Mesh *mesh, cgltf_accessor *indices_accessor) {
-  unsigned ebo = 0;
-  glGenBuffers(1, &ebo);
-  if (indices_accessor->type != cgltf_type_scalar) {
-    return E_CANNOT_LOAD_FILE;
+StatusCode UploadModel(Model *model) {
+  assert(model != NULL && "invalid arg model: cannot be NULL");
+  PROFILE_ZONE("UploadModel");
+  for (size_t i = 0; i < model->meshesCount; i++) {
+    Mesh *mesh = model->meshes + i;
+
+    // Bind each accessor as VertexAttrib, each mesh owns its vertex array
+    // so the attribute pointers and element buffer are not shared
+    double start = BeginLoadStage();
+    glGenVertexArrays(1, &mesh->vao);
+    GLStateBindVertexArray(mesh->vao);
+
+    // Gen buffers for mesh main buffer
+    glGenBuffers(1, &mesh->vbo);
+    GLStateBindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
+    glBufferData(GL_ARRAY_BUFFER,
+                 (GLsizeiptr)(mesh->verticesCount * sizeof(Vertex)),
+                 mesh->vertices, GL_STATIC_DRAW);
+
+    // Position attribute
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                          (void *)offsetof(Vertex, pos));
+
+    // Normal attribute
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                          (void *)offsetof(Vertex, nor));
+
+    // TexCoord attribute
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                          (void *)offsetof(Vertex, uvs));
+
+    // Color attribute
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                          (void *)offsetof(Vertex, col));
+
+    // Tangent attribute, after the locations of skinning (4 and 5) and of
+    // the instance matrix (6 to 9)
+    glEnableVertexAttribArray(10);
+    glVertexAttribPointer(10, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                          (void *)offsetof(Vertex, tan));
+
+    EndLoadStage(LOAD_STAGE_UPLOAD_VERTICES, start,
+                 mesh->verticesCount * sizeof(Vertex));
+
+    // Indices
+    start = BeginLoadStage();
+    glGenBuffers(1, &mesh->ebo);
+    GLStateBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                 (GLsizeiptr)(mesh->indicesCount *
+                              GetIndexSize(mesh->indexType)),
+                 mesh->indices, GL_STATIC_DRAW);
+    EndLoadStage(LOAD_STAGE_UPLOAD_INDICES, start,
+                 mesh->indicesCount * GetIndexSize(mesh->indexType));
+    FrameStatsAdd(FRAME_STAT_UPLOADED_BYTES,
+                  (double)(mesh->verticesCount * sizeof(Vertex) +
+                           mesh->indicesCount * GetIndexSize(mesh->indexType)));
   }
 
-  // TODO(cedmundo): copy indices
-  cgltf_buffer_view *indices_view = indices_accessor->buffer_view;
-  cgltf_buffer *indices_buffer = indices_view->buffer;
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)indices_view->size,
-               indices_buffer->data + indices_view->offset, GL_STATIC_DRAW);
-
-  mesh->ebo = ebo;
-  mesh->indicesCount = indices_accessor->count;
+  GLStateBindVertexArray(0);
   return SUCCESS;
 }
 
+Model LoadModel(const char *path) {
+  PROFILE_ZONE("LoadModel");
+  Model model = DecodeModel(path);
+  if (model.status != SUCCESS) {
+    return model;
+  }
+
+  model.status = UploadModel(&model);
+  return model;
+}
+
 void DestroyModel(Model model) {
   if (model.meshes != NULL) {
     for (int i = 0; i < model.meshesCount; i++) {
@@ -408,44 +1578,70 @@ void DestroyModel(Model model) {
 
     free(model.meshes);
   }
+}
+
+void DestroyMesh(Mesh mesh) {
+  GLStateDeleteBuffer(mesh.ebo);
+  GLStateDeleteBuffer(mesh.vbo);
+  GLStateDeleteVertexArray(mesh.vao);
+
+  if (mesh.vertices != NULL) {
+    free(mesh.vertices);
+  }
 
-  if (model.vao != 0) {
-    glDeleteVertexArrays(1, &model.vao);
+  if (mesh.indices != NULL) {
+    free(mesh.indices);
   }
 }
 
-void DestroyMesh(Mesh mesh) {
-  if (mesh.ebo != 0) {
-    glDeleteBuffers(1, &mesh.ebo);
+StatusCode VerticesToStreams(const Vertex *vertices, size_t count,
+                             Vec3Stream *pos, Vec3Stream *nor) {
+  assert(vertices != NULL || count == 0);
+  if (pos != NULL) {
+    if (!Vec3StreamAlloc(pos, count)) {
+      Log(LOG_ERROR, "cannot gather %zu positions (out of memory)", count);
+      return E_OUT_OF_MEMORY;
+    }
+    Vec3StreamGather(pos, &vertices->pos, sizeof(Vertex));
   }
 
-  if (mesh.vbo != 0) {
-    glDeleteBuffers(1, &mesh.vbo);
+  if (nor != NULL) {
+    if (!Vec3StreamAlloc(nor, count)) {
+      Log(LOG_ERROR, "cannot gather %zu normals (out of memory)", count);
+      if (pos != NULL) {
+        Vec3StreamFree(pos);
+      }
+      return E_OUT_OF_MEMORY;
+    }
+    Vec3StreamGather(nor, &vertices->nor, sizeof(Vertex));
   }
+  return SUCCESS;
 }
 
-void RenderModel(Model model, Camera camera) {
-  unsigned spid = model.shader.spId;
-  glUseProgram(spid);
-  glBindVertexArray(model.vao);
+void StreamsToVertices(Vertex *vertices, const Vec3Stream *pos,
+                       const Vec3Stream *nor) {
+  if (pos != NULL) {
+    Vec3StreamScatter(pos, &vertices->pos, sizeof(Vertex));
+  }
 
-  Mat4 viewMat = TransformGetModelMatrix(camera.transform);
-  Mat4 projMat = CameraGetProjMatrix(camera);
-  Mat4 modelMat = TransformGetModelMatrix(model.transform);
+  if (nor != NULL) {
+    Vec3StreamScatter(nor, &vertices->nor, sizeof(Vertex));
+  }
+}
 
-  int modelMat4Loc = glGetUniformLocation(spid, "model");
-  int viewMat4Loc = glGetUniformLocation(spid, "view");
-  int projMat4Loc = glGetUniformLocation(spid, "proj");
+void RenderModel(Model model) {
+  PROFILE_ZONE("RenderModel");
+  PROFILE_GPU_ZONE("RenderModel");
+  GLStateUseProgram(model.shader.spId);
 
-  glUniformMatrix4fv(modelMat4Loc, 1, GL_FALSE, Mat4Raw(&modelMat));
-  glUniformMatrix4fv(viewMat4Loc, 1, GL_FALSE, Mat4Raw(&viewMat));
-  glUniformMatrix4fv(projMat4Loc, 1, GL_FALSE, Mat4Raw(&projMat));
+  Mat4 modelMat = TransformGetModelMatrix(model.transform);
+  glUniformMatrix4fv(model.shader.modelLoc, 1, GL_FALSE, Mat4Raw(&modelMat));
+  FrameStatsAdd(FRAME_STAT_UNIFORM_UPLOADS, 1.0);
   for (int i = 0; i < model.meshesCount; i++) {
-    // IMPORTANT NOTE: Maybe assign a type GL_UNSIGNED_SHORT | GL_UNSIGNED_INT
-    // in case of getting a larger type at reading model.
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, model.meshes[i].ebo);
-    glDrawElements(GL_TRIANGLES, (GLsizei)model.meshes[i].indicesCount,
-                   GL_UNSIGNED_SHORT, 0);
+    Mesh mesh = model.meshes[i];
+    GLStateBindVertexArray(mesh.vao);
+    glDrawElements(GL_TRIANGLES, (GLsizei)mesh.indicesCount, mesh.indexType,
+                   0);
+    FrameStatsAddDraw(mesh.verticesCount, mesh.indicesCount / 3);
   }
-  glBindVertexArray(0);
 }
@@ -1,13 +1,73 @@
 #pragma once
 #include <stddef.h>
+#include <stdint.h>
+#include <xmath/stream.h>
 #include <xmath/transform.h>
 
 #include "camera.h"
 #include "core.h"
+#include "jobs.h"
 
-// Shader holds the program id after loading
+#define SHADER_MAX_NAME 64
+
+// Default directory where linked program binaries are cached
+#define SHADER_CACHE_DEFAULT_DIR "shadercache"
+
+// Maximum depth of nested #include directives in shader files
+#define SHADER_MAX_INCLUDE_DEPTH 16
+
+// Shader permutation flags, each one injects a define into both stages:
+// HAS_SKINNING, HAS_VERTEX_COLORS, HAS_TEXTURE and HAS_INDIRECT. Indirect
+// variants read the model matrix from per instance attributes (see
+// gpuscene.h) instead of the model uniform.
+typedef enum {
+  SHADER_VARIANT_SKINNING = 1 << 0,
+  SHADER_VARIANT_VERTEX_COLORS = 1 << 1,
+  SHADER_VARIANT_TEXTURED = 1 << 2,
+  SHADER_VARIANT_INDIRECT = 1 << 3,
+} ShaderVariant;
+
+// Uniform block shared by all programs holding the camera matrices
+#define SHADER_CAMERA_BLOCK "Camera"
+#define SHADER_CAMERA_BINDING 0
+
+// An active uniform of the default block found after linking a program
+typedef struct {
+  char name[SHADER_MAX_NAME];
+  int location;
+  unsigned type;
+  int size;
+} ShaderUniform;
+
+// An active uniform block found after linking a program
+typedef struct {
+  char name[SHADER_MAX_NAME];
+  unsigned index;
+  int binding;
+  int dataSize;
+} ShaderUniformBlock;
+
+// Shader holds the program id and its reflected uniforms after loading
 typedef struct {
   unsigned spId;
+  unsigned variant;
+  ShaderUniform *uniforms;
+  size_t uniformsCount;
+  ShaderUniformBlock *blocks;
+  size_t blocksCount;
+
+  // Per object uniforms looked up once at load, -1 when not present
+  int modelLoc;
+
+  // True when the program was restored from the binary cache
+  bool fromCache;
+
+  // Compile state while the driver links the program in the background
+  bool pending;
+  unsigned vsId;
+  unsigned fsId;
+  uint64_t cacheKey;
+  double startTime;
   StatusCode status;
 } Shader;
 
@@ -17,13 +77,26 @@ typedef struct {
   Vec3 nor;
   Vec2 uvs;
   Vec4 col;
+
+  // Tangent along increasing U, w is the handedness of the bitangent:
+  // cross(nor, tan.xyz) * w
+  Vec4 tan;
 } Vertex;
 
 // Primitive reflects a single mesh instance of a model
 typedef struct {
   Vertex *vertices;
   size_t verticesCount;
+  void *indices;
   size_t indicesCount;
+  unsigned indexType;
+  unsigned material;
+
+  // Axis aligned bounds of the vertices in model space
+  Vec3 boundsMin;
+  Vec3 boundsMax;
+
+  unsigned vao;
   unsigned vbo;
   unsigned ebo;
 } Mesh;
@@ -32,30 +105,129 @@ typedef struct {
 typedef struct {
   Mesh *meshes;
   size_t meshesCount;
-  unsigned vao;
+
+  // Axis aligned bounds of all the vertices in model space
+  Vec3 boundsMin;
+  Vec3 boundsMax;
 
   Shader shader;
   Transform transform;
   StatusCode status;
 } Model;
 
-// Load, compile and link a shader program using a fragment and vertex shaders.
+// Set the directory of the program binary cache, NULL disables the cache.
+void SetShaderCacheDir(const char *dir);
+
+// Start compiling and linking a variant (a mask of ShaderVariant flags) of a
+// program without waiting for the driver. Sources go through #include
+// resolution and define injection. Kick off every variant first and finish
+// them later so that drivers with GL_KHR_parallel_shader_compile build them
+// concurrently. Linked programs are stored in the binary cache and restored
+// from it when the sources, defines and GL driver did not change.
+Shader BeginLoadShader(const char *vsPath, const char *fsPath,
+                       unsigned variant);
+
+// Return true when finishing a shader will not block on the driver.
+bool ShaderIsReady(Shader shader);
+
+// Wait for a shader started with BeginLoadShader, check its link status and
+// reflect its uniforms. Failed shaders are destroyed.
+StatusCode FinishLoadShader(Shader *shader);
+
+// Load, compile and link the vertex colored variant of a shader program
+// using a fragment and vertex shaders, which draws the colors of the meshes
+// as programs did before variants.
 Shader LoadShader(const char *vsPath, const char *fsPath);
 
+// Load, compile and link a compute program, needs a GL 4.3 context. Compute
+// programs are not stored in the binary cache.
+Shader LoadComputeShader(const char *csPath);
+
 // Destroy a shader if needed.
 void DestroyShader(Shader shader);
 
+// Return the cached location of an active uniform, -1 if not present.
+int ShaderGetUniformLocation(Shader shader, const char *name);
+
+// Stages of loading a model, in order
+typedef enum {
+  LOAD_STAGE_PARSE,
+  LOAD_STAGE_VALIDATE,
+  LOAD_STAGE_LOAD_BUFFERS,
+  LOAD_STAGE_DECODE_MESHOPT,
+  LOAD_STAGE_REPACK_ATTRIBUTES,
+  LOAD_STAGE_REPACK_INDICES,
+  LOAD_STAGE_GENERATE_NORMALS,
+  LOAD_STAGE_GENERATE_TANGENTS,
+  LOAD_STAGE_UPLOAD_VERTICES,
+  LOAD_STAGE_UPLOAD_INDICES,
+  LOAD_STAGE_COUNT,
+} LoadStage;
+
+// Time and bytes allocated by each stage, added by DecodeModel and
+// UploadModel. Parsing and loading buffers count the allocations made by
+// cgltf, decoding the buffer views compressed with EXT_meshopt_compression,
+// repacking the CPU copies of the meshes and uploads the bytes given to the
+// GL buffers. Upload times only cover the calls, not the transfers the
+// driver defers.
+typedef struct {
+  double seconds[LOAD_STAGE_COUNT];
+  size_t allocatedBytes[LOAD_STAGE_COUNT];
+
+  // Bytes of the JSON and of every buffer loaded from the files decoded
+  size_t inputBytes;
+
+  // Allocations made for cgltf and the buffers it decodes, released at once
+  // after every model, and the most bytes they took for a single model
+  size_t transientAllocations;
+  size_t transientPeakBytes;
+} LoadStats;
+
+// Set where the models loaded by the calling thread add their stages, NULL
+// (default) stops measuring.
+void SetLoadStats(LoadStats *stats);
+
+// Set the pool the models loaded by the calling thread decode their embedded
+// buffers and compressed buffer views and generate their missing normals and
+// tangents with, NULL (default) runs it on the thread. Use one pool per
+// loading thread: a pool runs a single loop at a time, threads loading
+// together on a shared pool decode on their own while it is busy.
+void SetLoadJobPool(JobPool *pool);
+
+// Return a short name of a stage, such as "loadBuffers".
+const char *GetLoadStageName(LoadStage stage);
+
 // Make a single plane
 Model MakeCube(float dim);
 
 // Load a GLTF model into memory decoding its data and uploading to the GPU.
 Model LoadModel(const char *path);
 
+// Parse and decode a GLTF model into CPU memory only. Does not touch GL so it
+// can run on any thread, upload the result with UploadModel.
+Model DecodeModel(const char *path);
+
+// Create the GPU buffers of a decoded model. Must be called on the thread
+// owning the GL context, the CPU copies are kept until the model is destroyed.
+StatusCode UploadModel(Model *model);
+
 // Destroy all contents of a model.
 void DestroyModel(Model model);
 
 // Delete all related buffer arrays of mesh
 void DestroyMesh(Mesh mesh);
 
-// Render a model from the point of view of given camera
-void RenderModel(Model model, Camera camera);
+// Copy the positions and normals of vertices into newly allocated streams,
+// for bulk work over them. Either stream may be NULL to skip it, release them
+// with Vec3StreamFree.
+StatusCode VerticesToStreams(const Vertex *vertices, size_t count,
+                             Vec3Stream *pos, Vec3Stream *nor);
+
+// Copy streams back into the positions and normals of vertices, which hold
+// as many vertices as the streams. Either stream may be NULL to keep it.
+void StreamsToVertices(Vertex *vertices, const Vec3Stream *pos,
+                       const Vec3Stream *nor);
+
+// Render a model using the camera uniforms uploaded for the current frame
+// (see UploadCameraUniforms).
+void RenderModel(Model model);
@@ -0,0 +1,715 @@
+#include "normals.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glad/glad.h>
+#include <xmath/stream.h>
+
+#include "profile.h"
+
+// Triangles and vertices handed to a job at once. Triangle blocks are a
+// multiple of STREAM_LANES so views over a block never pad into the next one.
+#define NORMALS_BLOCK_TRIANGLES 1024
+#define NORMALS_BLOCK_VERTICES 4096
+
+// Empty slot of the positions table
+#define NORMALS_EMPTY UINT32_MAX
+
+// Faces smaller than this fraction of the largest face around a position are
+// slivers, too thin for their direction to mean anything: they never split
+#define NORMALS_SLIVER_RATIO 1e-3f
+
+// Corners are the entries of the index array, corner c belongs to face c / 3.
+// The corners around each key (a vertex or a welded position) are listed in
+// corner order, which keeps every sum in the same order whatever the thread
+// doing it.
+typedef struct {
+  uint32_t *offsets;
+  uint32_t *corners;
+} CornerLists;
+
+typedef struct {
+  Mesh *mesh;
+  uint32_t *indices;
+  size_t trianglesCount;
+  size_t verticesCount;
+  CornerLists lists;
+
+  // Per face: area weighted normals and their lengths, or unit tangents and
+  // their handedness
+  Vec3Stream faces;
+  float *facesLen;
+
+  // Normals only: first vertex at the same position of every vertex, the
+  // split threshold and the copies of each position. Copies are counted by a
+  // first pass and turned into the index of the first copy for the second.
+  uint32_t *welded;
+  bool split;
+  float cosSplit;
+  uint32_t *copies;
+
+  // Tangents only: angle of the face at every corner
+  float *angles;
+
+  atomic_bool failed;
+} Generator;
+
+// Corner normals and slots of a position, grown by the jobs as needed
+typedef struct {
+  Vec3 *normals;
+  uint32_t *slots;
+  size_t capacity;
+} Scratch;
+
+static size_t BlocksCount(size_t count, size_t block) {
+  return (count + block - 1) / block;
+}
+
+static Vec3 NormOrZero(Vec3 v) {
+  float len = Vec3Len(v);
+  return len > 0.0f ? Vec3Scale(v, 1.0f / len) : Vec3Zero;
+}
+
+static Vec3 FaceAt(const Generator *gen, size_t face) {
+  return (Vec3){gen->faces.x[face], gen->faces.y[face], gen->faces.z[face]};
+}
+
+// Stream over count floats of arrays it does not own, padded by the caller
+static Vec3Stream StreamView(float *x, float *y, float *z, size_t count) {
+  size_t padded = (count + STREAM_LANES - 1) & ~(size_t)(STREAM_LANES - 1);
+  return (Vec3Stream){x, y, z, count, padded, NULL};
+}
+
+// Widen the indices of a mesh to 32 bits, checking they are in range
+static StatusCode ReadIndices(const Mesh *mesh, uint32_t *dst) {
+  size_t count = mesh->indicesCount;
+  if (mesh->indexType == GL_UNSIGNED_BYTE) {
+    const uint8_t *src = mesh->indices;
+    for (size_t i = 0; i < count; i++) {
+      dst[i] = src[i];
+    }
+  } else if (mesh->indexType == GL_UNSIGNED_SHORT) {
+    const uint16_t *src = mesh->indices;
+    for (size_t i = 0; i < count; i++) {
+      dst[i] = src[i];
+    }
+  } else {
+    memcpy(dst, mesh->indices, count * sizeof(uint32_t));
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    if (dst[i] >= mesh->verticesCount) {
+      Log(LOG_ERROR, "index #%zu is out of range (%u of %zu vertices)", i,
+          dst[i], mesh->verticesCount);
+      return E_CANNOT_LOAD_FILE;
+    }
+  }
+  return SUCCESS;
+}
+
+// Store indices back, with 32 bits when the vertices outgrew the index type
+static bool WriteIndices(Mesh *mesh, const uint32_t *src) {
+  size_t count = mesh->indicesCount;
+  size_t last = mesh->verticesCount - 1;
+  if ((mesh->indexType == GL_UNSIGNED_BYTE && last > UINT8_MAX) ||
+      (mesh->indexType == GL_UNSIGNED_SHORT && last > UINT16_MAX)) {
+    void *indices = realloc(mesh->indices, count * sizeof(uint32_t));
+    if (indices == NULL) {
+      return false;
+    }
+
+    mesh->indices = indices;
+    mesh->indexType = GL_UNSIGNED_INT;
+  }
+
+  if (mesh->indexType == GL_UNSIGNED_BYTE) {
+    uint8_t *dst = mesh->indices;
+    for (size_t i = 0; i < count; i++) {
+      dst[i] = (uint8_t)src[i];
+    }
+  } else if (mesh->indexType == GL_UNSIGNED_SHORT) {
+    uint16_t *dst = mesh->indices;
+    for (size_t i = 0; i < count; i++) {
+      dst[i] = (uint16_t)src[i];
+    }
+  } else {
+    memcpy(mesh->indices, src, count * sizeof(uint32_t));
+  }
+  return true;
+}
+
+static uint32_t HashPosition(Vec3 p) {
+  // Adding zero turns -0 into +0, which compare equal
+  float f[3] = {p.x + 0.0f, p.y + 0.0f, p.z + 0.0f};
+  uint32_t bits[3];
+  memcpy(bits, f, sizeof(bits));
+  uint32_t h = bits[0] * 0x9E3779B1u;
+  h = (h ^ (h >> 15) ^ bits[1]) * 0x85EBCA77u;
+  h = (h ^ (h >> 13) ^ bits[2]) * 0xC2B2AE3Du;
+  return h ^ (h >> 16);
+}
+
+// Map every vertex to the first vertex with the same position
+static bool WeldPositions(const Vertex *vertices, size_t count,
+                          uint32_t *welded) {
+  size_t size = 16;
+  while (size < count * 2) {
+    size <<= 1;
+  }
+
+  uint32_t *table = malloc(size * sizeof(uint32_t));
+  if (table == NULL) {
+    return false;
+  }
+  memset(table, 0xFF, size * sizeof(uint32_t));
+
+  size_t mask = size - 1;
+  for (size_t v = 0; v < count; v++) {
+    Vec3 p = vertices[v].pos;
+    size_t slot = HashPosition(p) & mask;
+    for (;;) {
+      uint32_t other = table[slot];
+      if (other == NORMALS_EMPTY) {
+        table[slot] = (uint32_t)v;
+        welded[v] = (uint32_t)v;
+        break;
+      }
+
+      Vec3 q = vertices[other].pos;
+      if (p.x == q.x && p.y == q.y && p.z == q.z) {
+        welded[v] = other;
+        break;
+      }
+      slot = (slot + 1) & mask;
+    }
+  }
+
+  free(table);
+  return true;
+}
+
+// List the corners around each key, the key of a corner being its vertex
+// mapped through keys (its vertex itself when NULL)
+static bool BuildCornerLists(CornerLists *lists, const uint32_t *indices,
+                             size_t cornersCount, const uint32_t *keys,
+                             size_t keysCount) {
+  lists->offsets = calloc(keysCount + 1, sizeof(uint32_t));
+  lists->corners = malloc(cornersCount * sizeof(uint32_t));
+  uint32_t *cursor = malloc(keysCount * sizeof(uint32_t));
+  if (lists->offsets == NULL || lists->corners == NULL || cursor == NULL) {
+    free(cursor);
+    return false;
+  }
+
+  for (size_t c = 0; c < cornersCount; c++) {
+    uint32_t key = keys != NULL ? keys[indices[c]] : indices[c];
+    lists->offsets[key + 1]++;
+  }
+
+  for (size_t k = 0; k < keysCount; k++) {
+    lists->offsets[k + 1] += lists->offsets[k];
+  }
+
+  memcpy(cursor, lists->offsets, keysCount * sizeof(uint32_t));
+  for (size_t c = 0; c < cornersCount; c++) {
+    uint32_t key = keys != NULL ? keys[indices[c]] : indices[c];
+    lists->corners[cursor[key]++] = (uint32_t)c;
+  }
+
+  free(cursor);
+  return true;
+}
+
+static void FreeGenerator(Generator *gen) {
+  free(gen->indices);
+  free(gen->lists.offsets);
+  free(gen->lists.corners);
+  Vec3StreamFree(&gen->faces);
+  free(gen->facesLen);
+  free(gen->welded);
+  free(gen->copies);
+  free(gen->angles);
+}
+
+// Gather the positions of the corners of a block of faces into one stream
+// per corner, over scratch arrays of NORMALS_BLOCK_TRIANGLES floats
+static void GatherCorners(const Generator *gen, size_t first, size_t count,
+                          float (*scratch)[NORMALS_BLOCK_TRIANGLES],
+                          Vec3Stream *p) {
+  for (int k = 0; k < 3; k++) {
+    p[k] = StreamView(scratch[k * 3], scratch[k * 3 + 1],
+                      scratch[k * 3 + 2], count);
+  }
+
+  const uint32_t *indices = gen->indices + first * 3;
+  const Vertex *vertices = gen->mesh->vertices;
+  for (size_t i = 0; i < count; i++) {
+    for (int k = 0; k < 3; k++) {
+      Vec3 v = vertices[indices[i * 3 + k]].pos;
+      p[k].x[i] = v.x;
+      p[k].y[i] = v.y;
+      p[k].z[i] = v.z;
+    }
+  }
+
+  // Kernels run over the padding of the last block, keep it defined
+  for (size_t i = count; i < p[0].capacity; i++) {
+    for (int a = 0; a < 9; a++) {
+      scratch[a][i] = 0.0f;
+    }
+  }
+}
+
+static void FaceNormalsJob(void *data, size_t block) {
+  Generator *gen = data;
+  size_t first = block * NORMALS_BLOCK_TRIANGLES;
+  size_t count = gen->trianglesCount - first;
+  if (count > NORMALS_BLOCK_TRIANGLES) {
+    count = NORMALS_BLOCK_TRIANGLES;
+  }
+
+  _Alignas(STREAM_ALIGN) float scratch[9][NORMALS_BLOCK_TRIANGLES];
+  Vec3Stream p[3];
+  GatherCorners(gen, first, count, scratch, p);
+
+  // The cross product of two edges is as long as twice the area of the face
+  Vec3Stream faces = StreamView(gen->faces.x + first, gen->faces.y + first,
+                                gen->faces.z + first, count);
+  Vec3StreamSub(&p[1], &p[1], &p[0]);
+  Vec3StreamSub(&p[2], &p[2], &p[0]);
+  Vec3StreamCross(&faces, &p[1], &p[2]);
+
+  float *len = gen->facesLen + first;
+  Vec3StreamDot(len, &faces, &faces);
+  for (size_t i = 0; i < count; i++) {
+    len[i] = sqrtf(len[i]);
+  }
+}
+
+// Sum of the faces around a position within the split angle of a face,
+// slivers being within the angle of any face. Runs for every pair of corners
+// around a position, the arithmetic is spelled out to keep it inline.
+static Vec3 SumFaces(const Generator *gen, const uint32_t *corners, size_t n,
+                     uint32_t face, float sliverLen) {
+  const float *x = gen->faces.x;
+  const float *y = gen->faces.y;
+  const float *z = gen->faces.z;
+  const float *len = gen->facesLen;
+  bool sliver = len[face] <= sliverLen;
+  float limit = gen->cosSplit * len[face];
+  Vec3 sum = Vec3Zero;
+  for (size_t k = 0; k < n; k++) {
+    uint32_t o = corners[k] / 3;
+    float dot = x[face] * x[o] + y[face] * y[o] + z[face] * z[o];
+    if (sliver || len[o] <= sliverLen || dot >= limit * len[o]) {
+      sum.x += x[o];
+      sum.y += y[o];
+      sum.z += z[o];
+    }
+  }
+  return sum;
+}
+
+static bool ReserveScratch(Scratch *scratch, size_t n) {
+  if (n <= scratch->capacity) {
+    return true;
+  }
+
+  free(scratch->normals);
+  free(scratch->slots);
+  scratch->normals = malloc(n * sizeof(Vec3));
+  scratch->slots = malloc(n * sizeof(uint32_t));
+  scratch->capacity = scratch->normals != NULL && scratch->slots != NULL
+                          ? n
+                          : 0;
+  return scratch->capacity > 0;
+}
+
+// Set the normals of the vertices at a welded position and return how many
+// copies its corners need. With emit the copies are made at the index given
+// by copies and the corners moved to them.
+static uint32_t SmoothPosition(Generator *gen, uint32_t key, bool emit,
+                               Scratch *scratch) {
+  const uint32_t *list = gen->lists.corners + gen->lists.offsets[key];
+  size_t n = gen->lists.offsets[key + 1] - gen->lists.offsets[key];
+  Vertex *vertices = gen->mesh->vertices;
+
+  // Without a split all the corners share the sum of every face
+  if (!gen->split) {
+    Vec3 sum = Vec3Zero;
+    for (size_t k = 0; k < n; k++) {
+      sum = Vec3Add(sum, FaceAt(gen, list[k] / 3));
+    }
+
+    Vec3 normal = NormOrZero(sum);
+    for (size_t k = 0; k < n; k++) {
+      vertices[gen->indices[list[k]]].nor = normal;
+    }
+    return 0;
+  }
+
+  if (!ReserveScratch(scratch, n)) {
+    atomic_store(&gen->failed, true);
+    return 0;
+  }
+
+  float maxLen = 0.0f;
+  for (size_t k = 0; k < n; k++) {
+    maxLen = fmaxf(maxLen, gen->facesLen[list[k] / 3]);
+  }
+
+  Vec3 *normals = scratch->normals;
+  float sliverLen = maxLen * NORMALS_SLIVER_RATIO;
+  for (size_t k = 0; k < n; k++) {
+    normals[k] = NormOrZero(SumFaces(gen, list, n, list[k] / 3, sliverLen));
+  }
+
+  // Corners of a vertex with the same normal share a slot: 0 keeps the
+  // vertex, s > 0 takes copy s - 1 of the position
+  uint32_t *slots = scratch->slots;
+  uint32_t copies = 0;
+  for (size_t k = 0; k < n; k++) {
+    uint32_t v = gen->indices[list[k]];
+    bool seen = false;
+    slots[k] = NORMALS_EMPTY;
+    for (size_t j = 0; j < k && slots[k] == NORMALS_EMPTY; j++) {
+      if (gen->indices[list[j]] == v) {
+        seen = true;
+        if (memcmp(normals + j, normals + k, sizeof(Vec3)) == 0) {
+          slots[k] = slots[j];
+        }
+      }
+    }
+
+    if (slots[k] != NORMALS_EMPTY) {
+      continue;
+    }
+
+    if (!seen) {
+      slots[k] = 0;
+      vertices[v].nor = normals[k];
+      continue;
+    }
+
+    slots[k] = ++copies;
+    if (emit) {
+      Vertex *copy = vertices + gen->copies[key] + copies - 1;
+      *copy = vertices[v];
+      copy->nor = normals[k];
+    }
+  }
+
+  // Indices move last, the loop above compares the original ones
+  if (emit) {
+    for (size_t k = 0; k < n; k++) {
+      if (slots[k] > 0) {
+        gen->indices[list[k]] = gen->copies[key] + slots[k] - 1;
+      }
+    }
+  }
+  return copies;
+}
+
+static void CountCopiesJob(void *data, size_t block) {
+  Generator *gen = data;
+  size_t first = block * NORMALS_BLOCK_VERTICES;
+  size_t last = first + NORMALS_BLOCK_VERTICES;
+  if (last > gen->verticesCount) {
+    last = gen->verticesCount;
+  }
+
+  Scratch scratch = {0};
+  for (size_t key = first; key < last; key++) {
+    if (gen->welded[key] == key) {
+      gen->copies[key] = SmoothPosition(gen, (uint32_t)key, false, &scratch);
+    }
+  }
+
+  free(scratch.normals);
+  free(scratch.slots);
+}
+
+static void EmitCopiesJob(void *data, size_t block) {
+  Generator *gen = data;
+  size_t first = block * NORMALS_BLOCK_VERTICES;
+  size_t last = first + NORMALS_BLOCK_VERTICES;
+  if (last > gen->verticesCount) {
+    last = gen->verticesCount;
+  }
+
+  Scratch scratch = {0};
+  for (size_t key = first; key < last; key++) {
+    if (gen->copies[key + 1] > gen->copies[key]) {
+      SmoothPosition(gen, (uint32_t)key, true, &scratch);
+    }
+  }
+
+  free(scratch.normals);
+  free(scratch.slots);
+}
+
+StatusCode GenerateNormals(Mesh *mesh, float splitAngle, JobPool *pool) {
+  assert(mesh != NULL && "invalid arg mesh: cannot be NULL");
+  PROFILE_ZONE("GenerateNormals");
+  size_t cornersCount = mesh->indicesCount - mesh->indicesCount % 3;
+  if (mesh->vertices == NULL || mesh->indices == NULL || cornersCount == 0) {
+    return SUCCESS;
+  }
+
+  if (mesh->verticesCount >= UINT32_MAX || cornersCount >= UINT32_MAX) {
+    Log(LOG_ERROR, "cannot generate normals (mesh too large)");
+    return E_CANNOT_LOAD_FILE;
+  }
+
+  size_t verticesCount = mesh->verticesCount;
+  Generator gen = {0};
+  gen.mesh = mesh;
+  gen.trianglesCount = cornersCount / 3;
+  gen.verticesCount = verticesCount;
+  gen.split = splitAngle < 180.0f;
+  gen.cosSplit = cosf(splitAngle * (3.14159265f / 180.0f));
+  atomic_init(&gen.failed, false);
+
+  StatusCode status = E_OUT_OF_MEMORY;
+  gen.indices = malloc(mesh->indicesCount * sizeof(uint32_t));
+  gen.facesLen = malloc(gen.trianglesCount * sizeof(float));
+  gen.welded = malloc(verticesCount * sizeof(uint32_t));
+  gen.copies = calloc(verticesCount + 1, sizeof(uint32_t));
+  if (gen.indices == NULL || gen.facesLen == NULL || gen.welded == NULL ||
+      gen.copies == NULL || !Vec3StreamAlloc(&gen.faces, gen.trianglesCount)) {
+    goto terminate;
+  }
+
+  status = ReadIndices(mesh, gen.indices);
+  if (status != SUCCESS) {
+    goto terminate;
+  }
+
+  status = E_OUT_OF_MEMORY;
+  if (!WeldPositions(mesh->vertices, verticesCount, gen.welded) ||
+      !BuildCornerLists(&gen.lists, gen.indices, cornersCount, gen.welded,
+                        verticesCount)) {
+    goto terminate;
+  }
+
+  JobPoolParallelFor(pool,
+                     BlocksCount(gen.trianglesCount, NORMALS_BLOCK_TRIANGLES),
+                     FaceNormalsJob, &gen);
+  size_t blocks = BlocksCount(verticesCount, NORMALS_BLOCK_VERTICES);
+  JobPoolParallelFor(pool, blocks, CountCopiesJob, &gen);
+  if (atomic_load(&gen.failed)) {
+    goto terminate;
+  }
+
+  // Copies of every position go after the original vertices, in order
+  size_t total = verticesCount;
+  for (size_t key = 0; key < verticesCount; key++) {
+    size_t copies = gen.copies[key];
+    gen.copies[key] = (uint32_t)total;
+    total += copies;
+    if (total >= UINT32_MAX) {
+      Log(LOG_ERROR, "cannot generate normals (too many split vertices)");
+      status = E_CANNOT_LOAD_FILE;
+      goto terminate;
+    }
+  }
+  gen.copies[verticesCount] = (uint32_t)total;
+
+  if (total > verticesCount) {
+    Vertex *vertices = realloc(mesh->vertices, total * sizeof(Vertex));
+    if (vertices == NULL) {
+      goto terminate;
+    }
+
+    mesh->vertices = vertices;
+    mesh->verticesCount = total;
+    JobPoolParallelFor(pool, blocks, EmitCopiesJob, &gen);
+    if (atomic_load(&gen.failed) || !WriteIndices(mesh, gen.indices)) {
+      goto terminate;
+    }
+  }
+  status = SUCCESS;
+
+terminate:
+  if (status == E_OUT_OF_MEMORY) {
+    Log(LOG_ERROR, "cannot generate normals (out of memory)");
+  }
+
+  FreeGenerator(&gen);
+  return status;
+}
+
+static void FaceTangentsJob(void *data, size_t block) {
+  Generator *gen = data;
+  size_t first = block * NORMALS_BLOCK_TRIANGLES;
+  size_t count = gen->trianglesCount - first;
+  if (count > NORMALS_BLOCK_TRIANGLES) {
+    count = NORMALS_BLOCK_TRIANGLES;
+  }
+
+  _Alignas(STREAM_ALIGN) float scratch[9][NORMALS_BLOCK_TRIANGLES];
+  _Alignas(STREAM_ALIGN) float weights[2][NORMALS_BLOCK_TRIANGLES];
+  _Alignas(STREAM_ALIGN) float dots[3][NORMALS_BLOCK_TRIANGLES];
+  Vec3Stream p[3];
+  GatherCorners(gen, first, count, scratch, p);
+
+  // Tangent along increasing U: solving e = du * T + dv * B for both edges
+  // gives T = (e1 * dv2 - e2 * dv1) / r, r the signed area in UV space.
+  // Only the sign of r matters once normalized, it is the handedness.
+  const uint32_t *indices = gen->indices + first * 3;
+  const Vertex *vertices = gen->mesh->vertices;
+  for (size_t i = 0; i < count; i++) {
+    Vec2 uv0 = vertices[indices[i * 3]].uvs;
+    Vec2 uv1 = vertices[indices[i * 3 + 1]].uvs;
+    Vec2 uv2 = vertices[indices[i * 3 + 2]].uvs;
+    float du1 = uv1.x - uv0.x;
+    float dv1 = uv1.y - uv0.y;
+    float du2 = uv2.x - uv0.x;
+    float dv2 = uv2.y - uv0.y;
+    float sign = du1 * dv2 - du2 * dv1 < 0.0f ? -1.0f : 1.0f;
+    weights[0][i] = sign * dv2;
+    weights[1][i] = -sign * dv1;
+    gen->facesLen[first + i] = sign;
+  }
+
+  Vec3Stream faces = StreamView(gen->faces.x + first, gen->faces.y + first,
+                                gen->faces.z + first, count);
+  Vec3StreamSub(&p[1], &p[1], &p[0]);
+  Vec3StreamSub(&p[2], &p[2], &p[0]);
+  Vec3StreamBlend(&faces, &p[1], weights[0], &p[2], weights[1]);
+  Vec3StreamNorm(&faces, &faces);
+
+  // Corner angles from the edges leaving the first corner, the third edge
+  // being e2 - e1
+  Vec3StreamDot(dots[0], &p[1], &p[1]);
+  Vec3StreamDot(dots[1], &p[2], &p[2]);
+  Vec3StreamDot(dots[2], &p[1], &p[2]);
+  float *angles = gen->angles + first * 3;
+  for (size_t i = 0; i < count; i++) {
+    float l1 = dots[0][i];
+    float l2 = dots[1][i];
+    float d12 = dots[2][i];
+    float l3 = l1 + l2 - 2.0f * d12;
+    float a0 = 0.0f;
+    float a1 = 0.0f;
+    if (l1 > 0.0f && l2 > 0.0f && l3 > 0.0f) {
+      a0 = acosf(fmaxf(-1.0f, fminf(1.0f, d12 / sqrtf(l1 * l2))));
+      a1 = acosf(fmaxf(-1.0f, fminf(1.0f, (l1 - d12) / sqrtf(l1 * l3))));
+    }
+    angles[i * 3] = a0;
+    angles[i * 3 + 1] = a1;
+    angles[i * 3 + 2] = fmaxf(0.0f, 3.14159265f - a0 - a1);
+  }
+}
+
+// Any unit vector perpendicular to n, along X when n has no length
+static Vec3 AnyPerpendicular(Vec3 n) {
+  Vec3 axis = Vec3Right;
+  if (fabsf(n.y) < fabsf(n.x) && fabsf(n.y) <= fabsf(n.z)) {
+    axis = Vec3Up;
+  } else if (fabsf(n.z) < fabsf(n.x)) {
+    axis = Vec3Backward;
+  }
+
+  Vec3 t = NormOrZero(Vec3Cross(n, axis));
+  return Vec3Len(t) > 0.0f ? t : Vec3Right;
+}
+
+static void VertexTangentsJob(void *data, size_t block) {
+  Generator *gen = data;
+  size_t first = block * NORMALS_BLOCK_VERTICES;
+  size_t last = first + NORMALS_BLOCK_VERTICES;
+  if (last > gen->verticesCount) {
+    last = gen->verticesCount;
+  }
+
+  Vertex *vertices = gen->mesh->vertices;
+  for (size_t v = first; v < last; v++) {
+    const uint32_t *list = gen->lists.corners + gen->lists.offsets[v];
+    size_t n = gen->lists.offsets[v + 1] - gen->lists.offsets[v];
+    Vec3 normal = vertices[v].nor;
+
+    // Faces of each handedness summed apart, right handed first
+    Vec3 sums[2] = {Vec3Zero, Vec3Zero};
+    float weights[2] = {0.0f, 0.0f};
+    for (size_t k = 0; k < n; k++) {
+      uint32_t corner = list[k];
+      uint32_t face = corner / 3;
+      Vec3 t = FaceAt(gen, face);
+      t = NormOrZero(Vec3Sub(t, Vec3Scale(normal, Vec3Dot(normal, t))));
+
+      int side = gen->facesLen[face] < 0.0f;
+      float weight = gen->angles[corner];
+      sums[side] = Vec3Add(sums[side], Vec3Scale(t, weight));
+      weights[side] += weight;
+    }
+
+    int side = weights[1] > weights[0];
+    Vec3 t = NormOrZero(sums[side]);
+    if (Vec3Len(t) == 0.0f) {
+      t = AnyPerpendicular(normal);
+    }
+    vertices[v].tan = (Vec4){t.x, t.y, t.z, side ? -1.0f : 1.0f};
+  }
+}
+
+StatusCode GenerateTangents(Mesh *mesh, JobPool *pool) {
+  assert(mesh != NULL && "invalid arg mesh: cannot be NULL");
+  PROFILE_ZONE("GenerateTangents");
+  size_t cornersCount = mesh->indicesCount - mesh->indicesCount % 3;
+  if (mesh->vertices == NULL || mesh->indices == NULL || cornersCount == 0) {
+    return SUCCESS;
+  }
+
+  if (mesh->verticesCount >= UINT32_MAX || cornersCount >= UINT32_MAX) {
+    Log(LOG_ERROR, "cannot generate tangents (mesh too large)");
+    return E_CANNOT_LOAD_FILE;
+  }
+
+  Generator gen = {0};
+  gen.mesh = mesh;
+  gen.trianglesCount = cornersCount / 3;
+  gen.verticesCount = mesh->verticesCount;
+  atomic_init(&gen.failed, false);
+
+  StatusCode status = E_OUT_OF_MEMORY;
+  gen.indices = malloc(mesh->indicesCount * sizeof(uint32_t));
+  gen.facesLen = malloc(gen.trianglesCount * sizeof(float));
+  gen.angles = malloc(cornersCount * sizeof(float));
+  if (gen.indices == NULL || gen.facesLen == NULL || gen.angles == NULL ||
+      !Vec3StreamAlloc(&gen.faces, gen.trianglesCount)) {
+    goto terminate;
+  }
+
+  status = ReadIndices(mesh, gen.indices);
+  if (status != SUCCESS) {
+    goto terminate;
+  }
+
+  status = E_OUT_OF_MEMORY;
+  if (!BuildCornerLists(&gen.lists, gen.indices, cornersCount, NULL,
+                        gen.verticesCount)) {
+    goto terminate;
+  }
+
+  JobPoolParallelFor(pool,
+                     BlocksCount(gen.trianglesCount, NORMALS_BLOCK_TRIANGLES),
+                     FaceTangentsJob, &gen);
+  JobPoolParallelFor(pool,
+                     BlocksCount(gen.verticesCount, NORMALS_BLOCK_VERTICES),
+                     VertexTangentsJob, &gen);
+  status = SUCCESS;
+
+terminate:
+  if (status == E_OUT_OF_MEMORY) {
+    Log(LOG_ERROR, "cannot generate tangents (out of memory)");
+  }
+
+  FreeGenerator(&gen);
+  return status;
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include "core.h"
+#include "jobs.h"
+#include "model.h"
+
+// Faces meeting at a vertex further apart than this angle, in degrees, keep a
+// hard edge between them
+#define NORMALS_DEFAULT_SPLIT_ANGLE 60.0f
+
+// Compute smooth normals for a mesh, each one the sum of the faces around its
+// vertex weighted by their area. Vertices at the same position are summed
+// together so UV seams stay smooth. A face only takes the faces within
+// splitAngle degrees of it (180 takes all of them), the corners of a vertex
+// ending with different normals get their own copy of the vertex and the
+// indices are widened when the copies do not fit them. The pool splits the
+// work, NULL runs it on the calling thread; results are the same either way.
+StatusCode GenerateNormals(Mesh *mesh, float splitAngle, JobPool *pool);
+
+// Compute tangents for normal mapping from the normals and UVs of a mesh,
+// following MikkTSpace: the tangent of each face is projected onto the normal
+// of the vertex and weighted by the angle of the face at that corner. w holds
+// the handedness, bitangent = cross(nor, tan.xyz) * w. Vertices shared by
+// mirrored faces take the side with more weight where MikkTSpace would split
+// them. Same threading as GenerateNormals.
+StatusCode GenerateTangents(Mesh *mesh, JobPool *pool);
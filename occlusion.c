@@ -0,0 +1,464 @@
+#include "occlusion.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glad/glad.h>
+
+#include "profile.h"
+#include "util.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define OCCLUSION_USE_SSE
+#endif
+
+// Coverage bits of a tile, one byte per row with bit x set for column x
+#define MASK_FULL UINT64_MAX
+
+// Rounding without libm, only valid for the small values of the buffer
+static inline int FloorI(float v) {
+  int i = (int)v;
+  return i - (v < (float)i);
+}
+
+static inline int CeilI(float v) {
+  int i = (int)v;
+  return i + (v > (float)i);
+}
+
+// Mask of the columns [x0, x1] of a tile row, both inside [0, 7]
+static inline uint64_t GetRowBits(int x0, int x1) {
+  return (0xFFu >> (7 - x1)) & (0xFFu << x0);
+}
+
+OcclusionBuffer MakeOcclusionBuffer(int width, int height, JobPool *pool) {
+  assert(width > 0 && "invalid arg width: must be positive");
+  assert(height > 0 && "invalid arg height: must be positive");
+
+  OcclusionBuffer buffer = {0};
+  buffer.width = width;
+  buffer.height = height;
+  buffer.tilesX = (width + OCCLUSION_TILE_WIDTH - 1) / OCCLUSION_TILE_WIDTH;
+  buffer.tilesY = (height + OCCLUSION_TILE_HEIGHT - 1) / OCCLUSION_TILE_HEIGHT;
+  buffer.pool = pool;
+
+  size_t tiles = (size_t)buffer.tilesX * (size_t)buffer.tilesY;
+  buffer.zMax0 = malloc(tiles * sizeof(float));
+  buffer.zMax1 = malloc(tiles * sizeof(float));
+  buffer.masks = malloc(tiles * sizeof(uint64_t));
+  if (buffer.zMax0 == NULL || buffer.zMax1 == NULL || buffer.masks == NULL) {
+    Log(LOG_ERROR, "cannot allocate occlusion buffer of %dx%d", width,
+        height);
+    buffer.status = E_OUT_OF_MEMORY;
+    return buffer;
+  }
+
+  buffer.status = SUCCESS;
+  return buffer;
+}
+
+void DestroyOcclusionBuffer(OcclusionBuffer buffer) {
+  free(buffer.zMax0);
+  free(buffer.zMax1);
+  free(buffer.masks);
+  free(buffer.triangles);
+  free(buffer.clip);
+}
+
+// Coverage of an empty tile. Pixels past the right and bottom edges start
+// covered so that the border tiles can fill their masks too.
+static uint64_t GetEmptyMask(const OcclusionBuffer *buffer, int tx, int ty) {
+  int columns = buffer->width - tx * OCCLUSION_TILE_WIDTH;
+  int rows = buffer->height - ty * OCCLUSION_TILE_HEIGHT;
+  if (columns >= OCCLUSION_TILE_WIDTH && rows >= OCCLUSION_TILE_HEIGHT) {
+    return 0;
+  }
+
+  uint64_t inside = 0;
+  int x1 = columns < OCCLUSION_TILE_WIDTH ? columns - 1 : 7;
+  for (int y = 0; y < OCCLUSION_TILE_HEIGHT && y < rows; y++) {
+    inside |= GetRowBits(0, x1) << (y * 8);
+  }
+  return ~inside;
+}
+
+void OcclusionBegin(OcclusionBuffer *buffer, Camera camera) {
+  assert(buffer != NULL && "invalid arg buffer: cannot be NULL");
+  memset(&buffer->stats, 0, sizeof(OcclusionStats));
+  buffer->trianglesCount = 0;
+
+  // Same matrices as the camera uniforms of the GL renderer
+  buffer->viewProj = CameraGetViewProjMatrix(&camera);
+
+  if (buffer->status != SUCCESS) {
+    return;
+  }
+
+  for (int ty = 0; ty < buffer->tilesY; ty++) {
+    for (int tx = 0; tx < buffer->tilesX; tx++) {
+      size_t t = (size_t)ty * buffer->tilesX + tx;
+      buffer->zMax0[t] = 1.0f;
+      buffer->zMax1[t] = 0.0f;
+      buffer->masks[t] = GetEmptyMask(buffer, tx, ty);
+    }
+  }
+}
+
+// Project a triangle and set up its edges and depth plane, returns false when
+// it cannot be used as an occluder
+static bool SetupTriangle(const OcclusionBuffer *buffer, const Vec4 clip[3],
+                          OccluderTriangle *tri) {
+  float x[3];
+  float y[3];
+  float z[3];
+  for (int i = 0; i < 3; i++) {
+    // Only fully in front of the near plane, clipping would add triangles
+    if (!(clip[i].w > 0.0f) || clip[i].z < -clip[i].w) {
+      return false;
+    }
+
+    float invW = 1.0f / clip[i].w;
+    x[i] = (clip[i].x * invW * 0.5f + 0.5f) * (float)buffer->width;
+    y[i] = (0.5f - clip[i].y * invW * 0.5f) * (float)buffer->height;
+    z[i] = clip[i].z * invW * 0.5f + 0.5f;
+  }
+
+  float area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+  if (!(area != 0.0f)) {
+    return false;
+  }
+
+  // Wind every triangle the same way so the inside is always positive
+  if (area < 0.0f) {
+    float t;
+    t = x[1], x[1] = x[2], x[2] = t;
+    t = y[1], y[1] = y[2], y[2] = t;
+    t = z[1], z[1] = z[2], z[2] = t;
+    area = -area;
+  }
+
+  tri->minX = MinF(x[0], MinF(x[1], x[2]));
+  tri->maxX = MaxF(x[0], MaxF(x[1], x[2]));
+  tri->minY = MinF(y[0], MinF(y[1], y[2]));
+  tri->maxY = MaxF(y[0], MaxF(y[1], y[2]));
+  if (tri->maxX < 0.0f || tri->minX > (float)buffer->width ||
+      tri->maxY < 0.0f || tri->minY > (float)buffer->height) {
+    return false;
+  }
+
+  for (int i = 0; i < 3; i++) {
+    int j = (i + 1) % 3;
+    float a = y[i] - y[j];
+    float b = x[j] - x[i];
+    tri->edges[i][0] = a;
+    tri->edges[i][1] = b;
+    tri->edges[i][2] = -(a * x[i] + b * y[i]);
+  }
+
+  float dz1 = z[1] - z[0];
+  float dz2 = z[2] - z[0];
+  tri->dzdx = (dz1 * (y[2] - y[0]) - dz2 * (y[1] - y[0])) / area;
+  tri->dzdy = (dz2 * (x[1] - x[0]) - dz1 * (x[2] - x[0])) / area;
+  tri->z = z[0] - tri->dzdx * x[0] - tri->dzdy * y[0];
+  tri->zMax = MaxF(z[0], MaxF(z[1], z[2]));
+  return true;
+}
+
+void OcclusionSubmit(OcclusionBuffer *buffer, const Model *model) {
+  assert(buffer != NULL && "invalid arg buffer: cannot be NULL");
+  assert(model != NULL && "invalid arg model: cannot be NULL");
+  if (buffer->status != SUCCESS) {
+    return;
+  }
+
+  Mat4 m = Mat4Mul(TransformGetModelMatrix(model->transform),
+                   buffer->viewProj);
+  for (size_t mi = 0; mi < model->meshesCount; mi++) {
+    const Mesh *mesh = model->meshes + mi;
+    if (mesh->vertices == NULL || mesh->indices == NULL) {
+      continue;
+    }
+
+    size_t count = buffer->trianglesCount + mesh->indicesCount / 3;
+    if (!Grow((void **)&buffer->clip, &buffer->clipCapacity,
+              mesh->verticesCount, sizeof(Vec4)) ||
+        !Grow((void **)&buffer->triangles, &buffer->trianglesCapacity, count,
+              sizeof(OccluderTriangle))) {
+      Log(LOG_ERROR, "cannot grow occluder triangles (out of memory)");
+      buffer->status = E_OUT_OF_MEMORY;
+      return;
+    }
+
+    Mat4TransformPoints(buffer->clip, &m, &mesh->vertices[0].pos,
+                        sizeof(Vertex), mesh->verticesCount);
+
+    for (size_t i = 0; i + 2 < mesh->indicesCount; i += 3) {
+      Vec4 clip[3];
+      bool valid = true;
+      for (int k = 0; k < 3 && valid; k++) {
+        uint32_t index = ReadIndex(mesh, i + k);
+        valid = index < mesh->verticesCount;
+        if (valid) {
+          clip[k] = buffer->clip[index];
+        }
+      }
+
+      OccluderTriangle *tri = buffer->triangles + buffer->trianglesCount;
+      if (valid && SetupTriangle(buffer, clip, tri)) {
+        buffer->trianglesCount++;
+      } else {
+        buffer->stats.trianglesSkipped++;
+      }
+    }
+  }
+
+  buffer->stats.occludersSubmitted++;
+}
+
+// Merge the coverage of a triangle into a tile. Triangles behind the tile are
+// dropped, the rest extend the working layer until it covers the whole tile.
+static inline void UpdateTile(OcclusionBuffer *buffer, int tx, int ty,
+                              uint64_t mask, float zMax) {
+  size_t t = (size_t)ty * buffer->tilesX + tx;
+  if (zMax >= buffer->zMax0[t]) {
+    return;
+  }
+
+  float zMax1 = MaxF(buffer->zMax1[t], zMax);
+  uint64_t masks = buffer->masks[t] | mask;
+  if (masks == MASK_FULL) {
+    buffer->zMax0[t] = zMax1;
+    buffer->zMax1[t] = 0.0f;
+    buffer->masks[t] = GetEmptyMask(buffer, tx, ty);
+    return;
+  }
+
+  buffer->zMax1[t] = zMax1;
+  buffer->masks[t] = masks;
+}
+
+static void RasterizeTriangle(OcclusionBuffer *buffer,
+                              const OccluderTriangle *tri, int ty) {
+  int y0 = ty * OCCLUSION_TILE_HEIGHT;
+  int tx0 = FloorI(tri->minX) / OCCLUSION_TILE_WIDTH;
+  int tx1 = FloorI(tri->maxX) / OCCLUSION_TILE_WIDTH;
+  tx0 = tx0 > 0 ? tx0 : 0;
+  tx1 = tx1 < buffer->tilesX - 1 ? tx1 : buffer->tilesX - 1;
+
+  // Covered pixel centers of every row of the tile row
+  int spanX0[OCCLUSION_TILE_HEIGHT];
+  int spanX1[OCCLUSION_TILE_HEIGHT];
+  for (int row = 0; row < OCCLUSION_TILE_HEIGHT; row++) {
+    float yc = (float)(y0 + row) + 0.5f;
+    float left = tri->minX;
+    float right = tri->maxX;
+    for (int e = 0; e < 3; e++) {
+      float a = tri->edges[e][0];
+      float k = tri->edges[e][1] * yc + tri->edges[e][2];
+      if (a > 0.0f) {
+        left = MaxF(left, -k / a);
+      } else if (a < 0.0f) {
+        right = MinF(right, -k / a);
+      } else if (k < 0.0f) {
+        right = left - 1.0f;
+      }
+    }
+
+    if (yc < tri->minY || yc > tri->maxY) {
+      right = left - 1.0f;
+    }
+
+    spanX0[row] = CeilI(left - 0.5f);
+    spanX1[row] = FloorI(right - 0.5f);
+  }
+
+  for (int tx = tx0; tx <= tx1; tx++) {
+    int x0 = tx * OCCLUSION_TILE_WIDTH;
+    uint64_t mask = 0;
+    for (int row = 0; row < OCCLUSION_TILE_HEIGHT; row++) {
+      int c0 = spanX0[row] - x0;
+      int c1 = spanX1[row] - x0;
+      c0 = c0 > 0 ? c0 : 0;
+      c1 = c1 < 7 ? c1 : 7;
+      if (c0 <= c1) {
+        mask |= GetRowBits(c0, c1) << (row * 8);
+      }
+    }
+
+    if (mask == 0) {
+      continue;
+    }
+
+    // Farthest depth of the plane over the tile, never past the vertices
+    float px = tri->dzdx > 0.0f ? (float)(x0 + OCCLUSION_TILE_WIDTH)
+                                : (float)x0;
+    float py = tri->dzdy > 0.0f ? (float)(y0 + OCCLUSION_TILE_HEIGHT)
+                                : (float)y0;
+    float zMax = tri->z + tri->dzdx * px + tri->dzdy * py;
+    zMax = MinF(zMax, tri->zMax);
+    UpdateTile(buffer, tx, ty, mask, zMax);
+  }
+}
+
+static void RasterizeRowJob(void *data, size_t index) {
+  OcclusionBuffer *buffer = data;
+  int ty = (int)index;
+  float y0 = (float)(ty * OCCLUSION_TILE_HEIGHT);
+  float y1 = y0 + (float)OCCLUSION_TILE_HEIGHT;
+  for (size_t i = 0; i < buffer->trianglesCount; i++) {
+    const OccluderTriangle *tri = buffer->triangles + i;
+    if (tri->maxY < y0 || tri->minY > y1) {
+      continue;
+    }
+    RasterizeTriangle(buffer, tri, ty);
+  }
+}
+
+void OcclusionFlush(OcclusionBuffer *buffer) {
+  assert(buffer != NULL && "invalid arg buffer: cannot be NULL");
+  if (buffer->status != SUCCESS) {
+    return;
+  }
+
+  PROFILE_ZONE("OcclusionFlush");
+  double start = GetTime();
+  JobPoolParallelFor(buffer->pool, (size_t)buffer->tilesY, RasterizeRowJob,
+                     buffer);
+  buffer->stats.trianglesRasterized = buffer->trianglesCount;
+  buffer->stats.rasterMs = (GetTime() - start) * 1000.0;
+}
+
+// Return true when the pixels of mask in a tile are all in front of depth
+static inline bool IsTileOccluding(const OcclusionBuffer *buffer, size_t t,
+                                   uint64_t mask, float depth) {
+  if (depth > buffer->zMax0[t]) {
+    return true;
+  }
+  return (mask & ~buffer->masks[t]) == 0 && depth > buffer->zMax1[t];
+}
+
+static bool IsBoxVisible(const OcclusionBuffer *buffer, Mat4 m, Vec3 min,
+                         Vec3 max, bool *outside) {
+  *outside = false;
+  float minX = (float)buffer->width;
+  float maxX = 0.0f;
+  float minY = (float)buffer->height;
+  float maxY = 0.0f;
+  float minZ = 1.0f;
+  int behind = 0;
+  for (int i = 0; i < 8; i++) {
+    Vec3 p = {i & 1 ? max.x : min.x, i & 2 ? max.y : min.y,
+              i & 4 ? max.z : min.z};
+    float x = m.xx * p.x + m.yx * p.y + m.zx * p.z + m.wx;
+    float y = m.xy * p.x + m.yy * p.y + m.zy * p.z + m.wy;
+    float z = m.xz * p.x + m.yz * p.y + m.zz * p.z + m.wz;
+    float w = m.xw * p.x + m.yw * p.y + m.zw * p.z + m.ww;
+    if (!(w > 0.0f) || z < -w) {
+      behind++;
+      continue;
+    }
+
+    float invW = 1.0f / w;
+    float sx = (x * invW * 0.5f + 0.5f) * (float)buffer->width;
+    float sy = (0.5f - y * invW * 0.5f) * (float)buffer->height;
+    minX = MinF(minX, sx);
+    maxX = MaxF(maxX, sx);
+    minY = MinF(minY, sy);
+    maxY = MaxF(maxY, sy);
+    minZ = MinF(minZ, z * invW * 0.5f + 0.5f);
+  }
+
+  if (behind == 8) {
+    *outside = true;
+    return false;
+  }
+
+  // Nothing to compare against when the box crosses the near plane
+  if (behind > 0) {
+    return true;
+  }
+
+  if (maxX < 0.0f || minX >= (float)buffer->width || maxY < 0.0f ||
+      minY >= (float)buffer->height || minZ > 1.0f) {
+    *outside = true;
+    return false;
+  }
+
+  // Every pixel touched by the box, not only the centers it covers
+  int x0 = FloorI(minX);
+  int x1 = FloorI(maxX);
+  int y0 = FloorI(minY);
+  int y1 = FloorI(maxY);
+  x0 = x0 > 0 ? x0 : 0;
+  y0 = y0 > 0 ? y0 : 0;
+  x1 = x1 < buffer->width - 1 ? x1 : buffer->width - 1;
+  y1 = y1 < buffer->height - 1 ? y1 : buffer->height - 1;
+
+  int tx0 = x0 / OCCLUSION_TILE_WIDTH;
+  int tx1 = x1 / OCCLUSION_TILE_WIDTH;
+  int ty0 = y0 / OCCLUSION_TILE_HEIGHT;
+  int ty1 = y1 / OCCLUSION_TILE_HEIGHT;
+  for (int ty = ty0; ty <= ty1; ty++) {
+    int r0 = ty == ty0 ? y0 % OCCLUSION_TILE_HEIGHT : 0;
+    int r1 = ty == ty1 ? y1 % OCCLUSION_TILE_HEIGHT : 7;
+    uint64_t rows = (MASK_FULL << (r0 * 8)) & (MASK_FULL >> ((7 - r1) * 8));
+    const float *zMax0 = buffer->zMax0 + (size_t)ty * buffer->tilesX;
+
+    int tx = tx0;
+#if defined(OCCLUSION_USE_SSE)
+    // Coarse test of four tiles at once against their farthest depth, tiles
+    // on the edges of the box still go through the mask test below
+    __m128 depth = _mm_set1_ps(minZ);
+    for (; tx + 4 <= tx1; tx += 4) {
+      __m128 far = _mm_loadu_ps(zMax0 + tx);
+      if (_mm_movemask_ps(_mm_cmpgt_ps(depth, far)) == 0xF) {
+        continue;
+      }
+
+      for (int i = tx; i < tx + 4; i++) {
+        size_t t = (size_t)ty * buffer->tilesX + i;
+        uint64_t mask = rows & (GetRowBits(i == tx0 ? x0 % 8 : 0, 7) *
+                                UINT64_C(0x0101010101010101));
+        if (!IsTileOccluding(buffer, t, mask, minZ)) {
+          return true;
+        }
+      }
+    }
+#endif
+
+    for (; tx <= tx1; tx++) {
+      int c0 = tx == tx0 ? x0 % OCCLUSION_TILE_WIDTH : 0;
+      int c1 = tx == tx1 ? x1 % OCCLUSION_TILE_WIDTH : 7;
+      uint64_t mask =
+          rows & (GetRowBits(c0, c1) * UINT64_C(0x0101010101010101));
+      size_t t = (size_t)ty * buffer->tilesX + tx;
+      if (!IsTileOccluding(buffer, t, mask, minZ)) {
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+bool OcclusionTestBox(OcclusionBuffer *buffer, Mat4 modelMat, Vec3 boundsMin,
+                      Vec3 boundsMax) {
+  assert(buffer != NULL && "invalid arg buffer: cannot be NULL");
+  if (buffer->status != SUCCESS) {
+    return true;
+  }
+
+  bool outside = false;
+  Mat4 m = Mat4Mul(modelMat, buffer->viewProj);
+  bool visible = IsBoxVisible(buffer, m, boundsMin, boundsMax, &outside);
+
+  buffer->stats.meshesTested++;
+  if (outside) {
+    buffer->stats.meshesOutside++;
+  } else if (!visible) {
+    buffer->stats.meshesOccluded++;
+  }
+  return visible;
+}
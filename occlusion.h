@@ -0,0 +1,104 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <xmath/mat4.h>
+#include <xmath/vec3.h>
+
+#include "camera.h"
+#include "core.h"
+#include "jobs.h"
+#include "model.h"
+
+// Size in pixels of the tiles of the occlusion buffer, every tile keeps one
+// coverage bit per pixel in a 64 bit mask
+#define OCCLUSION_TILE_WIDTH 8
+#define OCCLUSION_TILE_HEIGHT 8
+
+// Default resolution of the occlusion buffer, occluders only need to be
+// roughly right so it is much smaller than the framebuffer
+#define OCCLUSION_DEFAULT_WIDTH 320
+#define OCCLUSION_DEFAULT_HEIGHT 192
+
+// An occluder triangle set up for rasterization: bounds in pixels, edge
+// functions a * x + b * y + c >= 0 inside, and its depth plane
+typedef struct {
+  float minX;
+  float maxX;
+  float minY;
+  float maxY;
+  float edges[3][3];
+  float z;
+  float dzdx;
+  float dzdy;
+  float zMax;
+} OccluderTriangle;
+
+// Counters of the last frame and the time to rasterize its occluders. Tests
+// are only counted, timing every one would cost more than the test itself.
+typedef struct {
+  size_t occludersSubmitted;
+  size_t trianglesRasterized;
+  size_t trianglesSkipped;
+  size_t meshesTested;
+  size_t meshesOccluded;
+  size_t meshesOutside;
+  double rasterMs;
+} OcclusionStats;
+
+// OcclusionBuffer is a low resolution masked depth buffer built on the CPU
+// from a few occluder meshes, used to skip draws hidden behind them.
+//
+// Each tile keeps two depth layers instead of a depth per pixel. zMax0 is the
+// farthest depth of the whole tile, zMax1 the farthest depth of the pixels
+// set in the coverage mask. Once the mask is full the working layer becomes
+// the new zMax0 and is emptied. Tiles are stored as separate arrays so the
+// coarse test can compare several of them at once.
+typedef struct {
+  int width;
+  int height;
+  int tilesX;
+  int tilesY;
+
+  float *zMax0;
+  float *zMax1;
+  uint64_t *masks;
+
+  // Occluder triangles of the frame, kept between frames to reuse memory
+  OccluderTriangle *triangles;
+  size_t trianglesCount;
+  size_t trianglesCapacity;
+
+  // Scratch clip space positions of the occluder being submitted
+  Vec4 *clip;
+  size_t clipCapacity;
+
+  Mat4 viewProj;
+  JobPool *pool;
+  OcclusionStats stats;
+  StatusCode status;
+} OcclusionBuffer;
+
+// Make an occlusion buffer, rows of tiles are rasterized on the given pool
+// (NULL rasterizes them on the calling thread).
+OcclusionBuffer MakeOcclusionBuffer(int width, int height, JobPool *pool);
+
+// Release all the memory held by an occlusion buffer.
+void DestroyOcclusionBuffer(OcclusionBuffer buffer);
+
+// Clear the buffer and reset the stats for a frame seen from the given
+// camera.
+void OcclusionBegin(OcclusionBuffer *buffer, Camera camera);
+
+// Submit every mesh of a model as an occluder, from its CPU vertex and index
+// data. Use simple closed meshes, such as the lowest LOD of walls and large
+// props. Triangles crossing the near plane are skipped.
+void OcclusionSubmit(OcclusionBuffer *buffer, const Model *model);
+
+// Rasterize all the submitted occluders, in parallel rows of tiles.
+void OcclusionFlush(OcclusionBuffer *buffer);
+
+// Test a model space bounding box against the occluders. Returns false when
+// the box is outside the view or certainly hidden, true when it may be
+// visible. Boxes crossing the near plane are always visible.
+bool OcclusionTestBox(OcclusionBuffer *buffer, Mat4 modelMat, Vec3 boundsMin,
+                      Vec3 boundsMax);
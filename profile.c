@@ -0,0 +1,288 @@
+#include "profile.h"
+
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glad/glad.h>
+
+// Ring of the events of a single thread. Only the owner thread writes, the
+// head is published with release order so readers see finished events.
+typedef struct ProfileThread {
+  ProfileEvent events[PROFILE_RING_SIZE];
+  atomic_size_t head;
+  int id;
+  char name[PROFILE_MAX_THREAD_NAME];
+  struct ProfileThread *next;
+} ProfileThread;
+
+// Timer queries of a frame, two timestamps per zone
+typedef struct {
+  unsigned queries[PROFILE_GPU_MAX_ZONES * 2];
+  const char *names[PROFILE_GPU_MAX_ZONES];
+  size_t count;
+} ProfileGpuFrame;
+
+typedef struct {
+  // Every thread that recorded an event, pushed lock free and only removed
+  // by ProfileShutdown
+  _Atomic(ProfileThread *) threads;
+  atomic_int nextThreadId;
+  const char *tracePath;
+  uint64_t frameStart;
+
+  // GPU zones are only recorded from the GL thread, into their own ring
+  bool gpuReady;
+  ProfileThread *gpuThread;
+  ProfileGpuFrame gpuFrames[PROFILE_GPU_FRAMES];
+  size_t gpuFrame;
+  int64_t gpuOffset;
+} Profiler;
+
+static Profiler profiler = {0};
+static _Thread_local ProfileThread *currentThread = NULL;
+
+static ProfileThread *MakeProfileThread(const char *name) {
+  ProfileThread *thread = calloc(1, sizeof(ProfileThread));
+  if (thread == NULL) {
+    return NULL;
+  }
+
+  thread->id = atomic_fetch_add(&profiler.nextThreadId, 1) + 1;
+  if (name != NULL) {
+    snprintf(thread->name, sizeof(thread->name), "%s", name);
+  } else {
+    snprintf(thread->name, sizeof(thread->name), "thread %d", thread->id);
+  }
+
+  ProfileThread *head = atomic_load(&profiler.threads);
+  do {
+    thread->next = head;
+  } while (!atomic_compare_exchange_weak(&profiler.threads, &head, thread));
+  return thread;
+}
+
+static ProfileThread *GetCurrentThread() {
+  if (currentThread == NULL) {
+    currentThread = MakeProfileThread(NULL);
+  }
+  return currentThread;
+}
+
+static void PushEvent(ProfileThread *thread, ProfileEvent event) {
+  size_t head = atomic_load_explicit(&thread->head, memory_order_relaxed);
+  thread->events[head % PROFILE_RING_SIZE] = event;
+  atomic_store_explicit(&thread->head, head + 1, memory_order_release);
+}
+
+ProfileZone ProfileZoneBegin(const char *name) {
+  return (ProfileZone){.name = name, .start = GetMonotonicNanoseconds()};
+}
+
+void ProfileZoneEnd(ProfileZone *zone) {
+  ProfileThread *thread = GetCurrentThread();
+  if (thread == NULL) {
+    return;
+  }
+
+  ProfileEvent event = {zone->name, zone->start, GetMonotonicNanoseconds()};
+  PushEvent(thread, event);
+}
+
+ProfileGpuZone ProfileGpuZoneBegin(const char *name) {
+  ProfileGpuZone zone = {.index = -1};
+  ProfileGpuFrame *frame = profiler.gpuFrames + profiler.gpuFrame;
+  if (!profiler.gpuReady || frame->count >= PROFILE_GPU_MAX_ZONES) {
+    return zone;
+  }
+
+  zone.index = (int)frame->count++;
+  frame->names[zone.index] = name;
+  glQueryCounter(frame->queries[zone.index * 2], GL_TIMESTAMP);
+  return zone;
+}
+
+void ProfileGpuZoneEnd(ProfileGpuZone *zone) {
+  if (zone->index < 0 || !profiler.gpuReady) {
+    return;
+  }
+
+  ProfileGpuFrame *frame = profiler.gpuFrames + profiler.gpuFrame;
+  glQueryCounter(frame->queries[zone->index * 2 + 1], GL_TIMESTAMP);
+}
+
+void ProfileSetThreadName(const char *name) {
+  assert(name != NULL && "invalid arg name: cannot be NULL");
+  if (currentThread == NULL) {
+    currentThread = MakeProfileThread(name);
+  } else {
+    snprintf(currentThread->name, sizeof(currentThread->name), "%s", name);
+  }
+}
+
+StatusCode ProfileInitGpu() {
+  if (profiler.gpuReady) {
+    return SUCCESS;
+  }
+
+  if (profiler.gpuThread == NULL) {
+    profiler.gpuThread = MakeProfileThread("GPU");
+    if (profiler.gpuThread == NULL) {
+      return E_OUT_OF_MEMORY;
+    }
+  }
+
+  for (size_t i = 0; i < PROFILE_GPU_FRAMES; i++) {
+    ProfileGpuFrame *frame = profiler.gpuFrames + i;
+    glGenQueries(PROFILE_GPU_MAX_ZONES * 2, frame->queries);
+    frame->count = 0;
+  }
+
+  // GPU timestamps have their own origin, measured once against the CPU
+  GLint64 gpuNow = 0;
+  glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+  profiler.gpuOffset = (int64_t)GetMonotonicNanoseconds() - (int64_t)gpuNow;
+  profiler.gpuFrame = 0;
+  profiler.gpuReady = true;
+  return SUCCESS;
+}
+
+// Move the zones of a frame into the GPU ring. Without wait the frame is
+// dropped when its last query is not available yet.
+static void CollectGpuFrame(ProfileGpuFrame *frame, bool wait) {
+  if (frame->count == 0) {
+    return;
+  }
+
+  unsigned last = frame->queries[frame->count * 2 - 1];
+  GLint available = GL_TRUE;
+  if (!wait) {
+    glGetQueryObjectiv(last, GL_QUERY_RESULT_AVAILABLE, &available);
+  }
+
+  if (available) {
+    for (size_t i = 0; i < frame->count; i++) {
+      GLuint64 start = 0;
+      GLuint64 end = 0;
+      glGetQueryObjectui64v(frame->queries[i * 2], GL_QUERY_RESULT, &start);
+      glGetQueryObjectui64v(frame->queries[i * 2 + 1], GL_QUERY_RESULT, &end);
+
+      ProfileEvent event = {frame->names[i],
+                            (uint64_t)((int64_t)start + profiler.gpuOffset),
+                            (uint64_t)((int64_t)end + profiler.gpuOffset)};
+      PushEvent(profiler.gpuThread, event);
+    }
+  }
+  frame->count = 0;
+}
+
+void ProfileDestroyGpu() {
+  if (!profiler.gpuReady) {
+    return;
+  }
+
+  // Oldest frame first, the current one included
+  for (size_t i = 1; i <= PROFILE_GPU_FRAMES; i++) {
+    size_t index = (profiler.gpuFrame + i) % PROFILE_GPU_FRAMES;
+    CollectGpuFrame(profiler.gpuFrames + index, true);
+  }
+
+  for (size_t i = 0; i < PROFILE_GPU_FRAMES; i++) {
+    glDeleteQueries(PROFILE_GPU_MAX_ZONES * 2, profiler.gpuFrames[i].queries);
+  }
+  profiler.gpuReady = false;
+}
+
+void ProfileFrame() {
+  uint64_t now = GetMonotonicNanoseconds();
+  ProfileThread *thread = GetCurrentThread();
+  if (thread != NULL && profiler.frameStart != 0) {
+    PushEvent(thread, (ProfileEvent){"Frame", profiler.frameStart, now});
+  }
+  profiler.frameStart = now;
+
+  if (profiler.gpuReady) {
+    profiler.gpuFrame = (profiler.gpuFrame + 1) % PROFILE_GPU_FRAMES;
+    CollectGpuFrame(profiler.gpuFrames + profiler.gpuFrame, false);
+  }
+}
+
+void ProfileSetTracePath(const char *path) { profiler.tracePath = path; }
+
+const char *ProfileGetTracePath() { return profiler.tracePath; }
+
+static void WriteEscaped(FILE *file, const char *text) {
+  for (const char *c = text; *c != '\0'; c++) {
+    if (*c == '"' || *c == '\\') {
+      fputc('\\', file);
+    }
+
+    if ((unsigned char)*c >= 0x20) {
+      fputc(*c, file);
+    }
+  }
+}
+
+bool ProfileWriteTrace(const char *path) {
+  assert(path != NULL && "invalid arg path: cannot be NULL");
+  FILE *file = fopen(path, "w");
+  if (file == NULL) {
+    Log(LOG_ERROR, "cannot write trace: %s", path);
+    return false;
+  }
+
+  size_t written = 0;
+  fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  ProfileThread *thread = atomic_load(&profiler.threads);
+  for (; thread != NULL; thread = thread->next) {
+    fprintf(file,
+            "%s{\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"name\":\"thread_name\","
+            "\"args\":{\"name\":\"",
+            written > 0 ? ",\n" : "", thread->id);
+    WriteEscaped(file, thread->name);
+    fprintf(file, "\"}}");
+    written++;
+
+    size_t head = atomic_load_explicit(&thread->head, memory_order_acquire);
+    size_t first = head > PROFILE_RING_SIZE ? head - PROFILE_RING_SIZE : 0;
+    for (size_t i = first; i < head; i++) {
+      const ProfileEvent *event = thread->events + i % PROFILE_RING_SIZE;
+      if (event->name == NULL || event->end < event->start) {
+        continue;
+      }
+
+      fprintf(file, ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"name\":\"",
+              thread->id);
+      WriteEscaped(file, event->name);
+      fprintf(file, "\",\"ts\":%.3f,\"dur\":%.3f}",
+              (double)event->start / 1000.0,
+              (double)(event->end - event->start) / 1000.0);
+      written++;
+    }
+  }
+  fprintf(file, "\n]}\n");
+
+  bool ok = ferror(file) == 0;
+  ok = fclose(file) == 0 && ok;
+  if (!ok) {
+    Log(LOG_ERROR, "cannot write trace: %s", path);
+    return false;
+  }
+
+  Log(LOG_INFO, "wrote %zu trace events to %s", written, path);
+  return true;
+}
+
+void ProfileShutdown() {
+  ProfileThread *thread = atomic_exchange(&profiler.threads, NULL);
+  while (thread != NULL) {
+    ProfileThread *next = thread->next;
+    free(thread);
+    thread = next;
+  }
+  profiler.gpuThread = NULL;
+  profiler.frameStart = 0;
+  currentThread = NULL;
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core.h"
+
+// Events kept per thread, the oldest are overwritten when a ring is full
+#define PROFILE_RING_SIZE (1 << 15)
+
+// Frames between issuing GPU timer queries and reading them back, so the
+// readback never waits for the GPU
+#define PROFILE_GPU_FRAMES 4
+
+// GPU zones recorded per frame, the rest are ignored
+#define PROFILE_GPU_MAX_ZONES 128
+
+#define PROFILE_MAX_THREAD_NAME 32
+
+// A finished zone, times are CPU monotonic nanoseconds
+typedef struct {
+  const char *name;
+  uint64_t start;
+  uint64_t end;
+} ProfileEvent;
+
+// An open CPU zone, see PROFILE_ZONE
+typedef struct {
+  const char *name;
+  uint64_t start;
+} ProfileZone;
+
+// An open GPU zone, see PROFILE_GPU_ZONE. Index is -1 when not recorded.
+typedef struct {
+  int index;
+} ProfileGpuZone;
+
+// Scoped zones: PROFILE_ZONE("name") records the time from that line until
+// the end of the enclosing block in the calling thread, PROFILE_GPU_ZONE
+// does the same for the GL commands issued in the block. Names must be
+// string literals (only the pointer is stored). Zones nest and are compiled
+// out unless SIMPLEGLTF_PROFILE is defined.
+#ifdef SIMPLEGLTF_PROFILE
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_ZONE(name)                                                     \
+  ProfileZone PROFILE_CONCAT(profileZone, __LINE__)                            \
+      __attribute__((cleanup(ProfileZoneEnd))) = ProfileZoneBegin(name)
+#define PROFILE_GPU_ZONE(name)                                                 \
+  ProfileGpuZone PROFILE_CONCAT(profileGpuZone, __LINE__)                      \
+      __attribute__((cleanup(ProfileGpuZoneEnd))) = ProfileGpuZoneBegin(name)
+#define PROFILE_FRAME() ProfileFrame()
+#else
+#define PROFILE_ZONE(name) ((void)0)
+#define PROFILE_GPU_ZONE(name) ((void)0)
+#define PROFILE_FRAME() ((void)0)
+#endif
+
+// Open a CPU zone, prefer PROFILE_ZONE.
+ProfileZone ProfileZoneBegin(const char *name);
+
+// Close a CPU zone and record it in the ring of the calling thread.
+void ProfileZoneEnd(ProfileZone *zone);
+
+// Open a GPU zone with a timestamp query, prefer PROFILE_GPU_ZONE. Only
+// records after ProfileInitGpu, from the thread owning the GL context.
+ProfileGpuZone ProfileGpuZoneBegin(const char *name);
+
+// Close a GPU zone with a timestamp query.
+void ProfileGpuZoneEnd(ProfileGpuZone *zone);
+
+// Name the calling thread in traces (copied, truncated if too long).
+void ProfileSetThreadName(const char *name);
+
+// Create the timer queries and align the GPU clock with the CPU one. Called
+// once a GL context is current.
+StatusCode ProfileInitGpu();
+
+// Read the pending GPU zones and delete the timer queries.
+void ProfileDestroyGpu();
+
+// Mark the end of a frame: record a Frame zone since the previous mark and
+// read back the oldest GPU zones in flight, issued PROFILE_GPU_FRAMES - 1
+// frames ago.
+void ProfileFrame();
+
+// Set the path of the trace written when the app closes, NULL disables it.
+void ProfileSetTracePath(const char *path);
+
+// Return the path of the trace written when the app closes, or NULL.
+const char *ProfileGetTracePath();
+
+// Write every recorded event as Chrome trace event JSON (chrome://tracing,
+// Perfetto). Events of threads still recording may be dropped or torn.
+bool ProfileWriteTrace(const char *path);
+
+// Release the event rings of every thread, after ProfileDestroyGpu and the
+// trace are done. Threads that recorded events must not record any more.
+void ProfileShutdown();
@@ -0,0 +1,745 @@
+#include "raster.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glad/glad.h>
+
+#include "profile.h"
+#include "util.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define RASTER_USE_SSE
+#endif
+
+// A range of vertices of a draw transformed by a single job
+typedef struct {
+  Raster *raster;
+  size_t chunksCount;
+  size_t *chunkDraws;
+  size_t *chunkStarts;
+} TransformJobs;
+
+static bool ReserveVertices(Raster *raster, size_t count) {
+  if (count <= raster->verticesCapacity) {
+    return true;
+  }
+
+  size_t capacity = raster->verticesCapacity;
+  if (!Grow((void **)&raster->vertices, &capacity, count,
+            sizeof(RasterVertex))) {
+    return false;
+  }
+
+  capacity = raster->verticesCapacity;
+  if (!Grow((void **)&raster->clip, &capacity, count, sizeof(Vec4))) {
+    return false;
+  }
+
+  raster->verticesCapacity = capacity;
+  return true;
+}
+
+Raster MakeRaster(int width, int height, JobPool *pool) {
+  assert(width > 0 && "invalid arg width: must be positive");
+  assert(height > 0 && "invalid arg height: must be positive");
+
+  Raster raster = {0};
+  raster.width = width;
+  raster.height = height;
+  raster.tilesX = (width + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+  raster.tilesY = (height + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+  raster.pool = pool;
+
+  size_t pixels = (size_t)width * (size_t)height;
+  raster.color = calloc(pixels, sizeof(uint32_t));
+  raster.depth = calloc(pixels, sizeof(float));
+  if (raster.color == NULL || raster.depth == NULL) {
+    Log(LOG_ERROR, "cannot allocate raster of %dx%d", width, height);
+    raster.status = E_OUT_OF_MEMORY;
+    return raster;
+  }
+
+  raster.status = SUCCESS;
+  return raster;
+}
+
+void DestroyRaster(Raster raster) {
+  for (size_t i = 0; i < raster.chunksCapacity; i++) {
+    RasterChunk *chunk = raster.chunks + i;
+    if (chunk->bins != NULL) {
+      for (int t = 0; t < raster.tilesX * raster.tilesY; t++) {
+        free(chunk->bins[t].triangles);
+      }
+      free(chunk->bins);
+    }
+
+    free(chunk->triangles);
+    free(chunk->extra);
+  }
+
+  free(raster.chunks);
+  free(raster.color);
+  free(raster.depth);
+  free(raster.draws);
+  free(raster.clip);
+  free(raster.vertices);
+}
+
+static uint32_t PackColor(Vec4 color) {
+  float c[4] = {color.x, color.y, color.z, color.w};
+  uint32_t packed = 0;
+  for (int i = 0; i < 4; i++) {
+    float v = c[i] < 0.0f ? 0.0f : (c[i] > 1.0f ? 1.0f : c[i]);
+    packed |= (uint32_t)(v * 255.0f + 0.5f) << (i * 8);
+  }
+  return packed;
+}
+
+void RasterClear(Raster *raster, Vec4 color) {
+  assert(raster != NULL && "invalid arg raster: cannot be NULL");
+  uint32_t packed = PackColor(color);
+  size_t pixels = (size_t)raster->width * (size_t)raster->height;
+  for (size_t i = 0; i < pixels; i++) {
+    raster->color[i] = packed;
+    raster->depth[i] = 1.0f;
+  }
+}
+
+void RasterBegin(Raster *raster, Camera camera) {
+  assert(raster != NULL && "invalid arg raster: cannot be NULL");
+  raster->drawsCount = 0;
+
+  // Same matrices as the camera uniforms of the GL renderer
+  raster->viewProj = CameraGetViewProjMatrix(&camera);
+}
+
+void RasterSubmit(Raster *raster, const Model *model) {
+  assert(raster != NULL && "invalid arg raster: cannot be NULL");
+  assert(model != NULL && "invalid arg model: cannot be NULL");
+
+  size_t count = raster->drawsCount + model->meshesCount;
+  if (!Grow((void **)&raster->draws, &raster->drawsCapacity, count,
+            sizeof(RasterDraw))) {
+    Log(LOG_ERROR, "cannot grow raster draws (out of memory)");
+    raster->status = E_OUT_OF_MEMORY;
+    return;
+  }
+
+  Mat4 mvp = Mat4Mul(TransformGetModelMatrix(model->transform),
+                     raster->viewProj);
+  bool vertexColors = model->shader.variant & SHADER_VARIANT_VERTEX_COLORS;
+  for (size_t i = 0; i < model->meshesCount; i++) {
+    const Mesh *mesh = model->meshes + i;
+    if (mesh->vertices == NULL || mesh->indices == NULL) {
+      continue;
+    }
+
+    RasterDraw *draw = raster->draws + raster->drawsCount++;
+    draw->mesh = mesh;
+    draw->mvp = mvp;
+    draw->vertexColors = vertexColors;
+  }
+}
+
+static RasterVertex ProjectVertex(Vec4 clip, Vec4 col, float width,
+                                  float height) {
+  RasterVertex v;
+  v.invW = 1.0f / clip.w;
+  v.x = (clip.x * v.invW * 0.5f + 0.5f) * width;
+  v.y = (0.5f - clip.y * v.invW * 0.5f) * height;
+  v.z = clip.z * v.invW * 0.5f + 0.5f;
+  v.col = Vec4Scale(col, v.invW);
+  return v;
+}
+
+static void TransformJob(void *data, size_t index) {
+  TransformJobs *jobs = data;
+  Raster *raster = jobs->raster;
+  RasterDraw *draw = raster->draws + jobs->chunkDraws[index];
+  const Mesh *mesh = draw->mesh;
+
+  size_t start = jobs->chunkStarts[index];
+  size_t end = start + RASTER_VERTEX_CHUNK;
+  if (end > mesh->verticesCount) {
+    end = mesh->verticesCount;
+  }
+
+  Vec4 *clip = raster->clip + draw->firstVertex;
+  Mat4TransformPoints(clip + start, &draw->mvp, &mesh->vertices[start].pos,
+                      sizeof(Vertex), end - start);
+
+  RasterVertex *vertices = raster->vertices + draw->firstVertex;
+  float width = (float)raster->width;
+  float height = (float)raster->height;
+  for (size_t i = start; i < end; i++) {
+    Vec4 col = draw->vertexColors ? mesh->vertices[i].col : Vec4One;
+    vertices[i] = ProjectVertex(clip[i], col, width, height);
+  }
+}
+
+static bool TransformDraws(Raster *raster) {
+  size_t verticesCount = 0;
+  size_t chunksCount = 0;
+  for (size_t i = 0; i < raster->drawsCount; i++) {
+    RasterDraw *draw = raster->draws + i;
+    draw->firstVertex = verticesCount;
+    verticesCount += draw->mesh->verticesCount;
+    chunksCount += (draw->mesh->verticesCount + RASTER_VERTEX_CHUNK - 1) /
+                   RASTER_VERTEX_CHUNK;
+  }
+
+  if (!ReserveVertices(raster, verticesCount)) {
+    return false;
+  }
+  raster->verticesCount = verticesCount;
+
+  TransformJobs jobs = {0};
+  jobs.raster = raster;
+  jobs.chunkDraws = malloc(chunksCount * sizeof(size_t) + 1);
+  jobs.chunkStarts = malloc(chunksCount * sizeof(size_t) + 1);
+  if (jobs.chunkDraws == NULL || jobs.chunkStarts == NULL) {
+    free(jobs.chunkDraws);
+    free(jobs.chunkStarts);
+    return false;
+  }
+
+  for (size_t i = 0; i < raster->drawsCount; i++) {
+    size_t count = raster->draws[i].mesh->verticesCount;
+    for (size_t start = 0; start < count; start += RASTER_VERTEX_CHUNK) {
+      jobs.chunkDraws[jobs.chunksCount] = i;
+      jobs.chunkStarts[jobs.chunksCount] = start;
+      jobs.chunksCount++;
+    }
+  }
+
+  JobPoolParallelFor(raster->pool, jobs.chunksCount, TransformJob, &jobs);
+  free(jobs.chunkDraws);
+  free(jobs.chunkStarts);
+  return true;
+}
+
+// Range of pixel centers [x0, x1] covered by [min, max], clamped to [lo, hi].
+// Avoids the libm rounding calls, which dominate setup of small triangles.
+static inline void GetPixelRange(float min, float max, int lo, int hi,
+                                 int *x0, int *x1) {
+  min = MaxF(min - 0.5f, (float)lo - 1.0f);
+  max = MinF(max - 0.5f, (float)hi + 1.0f);
+  int i0 = (int)min;
+  int i1 = (int)max;
+  i0 += min > (float)i0;
+  i1 -= max < (float)i1;
+  *x0 = i0 > lo ? i0 : lo;
+  *x1 = i1 < hi ? i1 : hi;
+}
+
+static const RasterVertex *GetVertex(const Raster *raster,
+                                     const RasterChunk *chunk, uint32_t ref) {
+  if (ref & RASTER_EXTRA_VERTEX) {
+    return chunk->extra + (ref & ~RASTER_EXTRA_VERTEX);
+  }
+  return raster->vertices + ref;
+}
+
+static bool BinTriangle(const Raster *raster, RasterChunk *chunk,
+                        const uint32_t refs[3]) {
+  const RasterVertex *v0 = GetVertex(raster, chunk, refs[0]);
+  const RasterVertex *v1 = GetVertex(raster, chunk, refs[1]);
+  const RasterVertex *v2 = GetVertex(raster, chunk, refs[2]);
+
+  float area = (v1->x - v0->x) * (v2->y - v0->y) -
+               (v1->y - v0->y) * (v2->x - v0->x);
+  if (!(area != 0.0f)) {
+    return true;
+  }
+
+  float minX = MinF(v0->x, MinF(v1->x, v2->x));
+  float maxX = MaxF(v0->x, MaxF(v1->x, v2->x));
+  float minY = MinF(v0->y, MinF(v1->y, v2->y));
+  float maxY = MaxF(v0->y, MaxF(v1->y, v2->y));
+
+  // Pixel centers covered by the bounds, clamped to the target
+  int x0, x1, y0, y1;
+  GetPixelRange(minX, maxX, 0, raster->width - 1, &x0, &x1);
+  GetPixelRange(minY, maxY, 0, raster->height - 1, &y0, &y1);
+  if (x0 > x1 || y0 > y1) {
+    return true;
+  }
+
+  if (!Grow((void **)&chunk->triangles, &chunk->trianglesCapacity,
+            (chunk->trianglesCount + 1) * 3, sizeof(uint32_t))) {
+    return false;
+  }
+
+  uint32_t triangle = (uint32_t)chunk->trianglesCount++;
+  memcpy(chunk->triangles + triangle * 3, refs, 3 * sizeof(uint32_t));
+
+  for (int ty = y0 / RASTER_TILE_SIZE; ty <= y1 / RASTER_TILE_SIZE; ty++) {
+    for (int tx = x0 / RASTER_TILE_SIZE; tx <= x1 / RASTER_TILE_SIZE; tx++) {
+      RasterBin *bin = chunk->bins + ty * raster->tilesX + tx;
+      if (bin->count == bin->capacity &&
+          !Grow((void **)&bin->triangles, &bin->capacity, bin->count + 1,
+                sizeof(uint32_t))) {
+        return false;
+      }
+      bin->triangles[bin->count++] = triangle;
+    }
+  }
+  return true;
+}
+
+static Vec4 GetDrawColor(const RasterDraw *draw, uint32_t index) {
+  if (!draw->vertexColors) {
+    return Vec4One;
+  }
+  return draw->mesh->vertices[index - draw->firstVertex].col;
+}
+
+// Append a vertex on the near plane (z = -w) between two clip vertices
+static uint32_t AppendNearVertex(const Raster *raster, RasterChunk *chunk,
+                                 const RasterDraw *draw, uint32_t a,
+                                 uint32_t b) {
+  Vec4 ca = raster->clip[a];
+  Vec4 cb = raster->clip[b];
+  float da = ca.z + ca.w;
+  float db = cb.z + cb.w;
+  float t = da / (da - db);
+
+  Vec4 clip = Vec4Add(ca, Vec4Scale(Vec4Sub(cb, ca), t));
+
+  // Projected colors cannot be used, w is zero on the camera plane
+  Vec4 cola = GetDrawColor(draw, a);
+  Vec4 colb = GetDrawColor(draw, b);
+  Vec4 col = Vec4Add(cola, Vec4Scale(Vec4Sub(colb, cola), t));
+
+  uint32_t index = (uint32_t)chunk->extraCount++;
+  chunk->extra[index] =
+      ProjectVertex(clip, col, (float)raster->width, (float)raster->height);
+  return index | RASTER_EXTRA_VERTEX;
+}
+
+// Clip a triangle crossing the near plane into up to two triangles
+static bool ClipTriangle(const Raster *raster, RasterChunk *chunk,
+                         const RasterDraw *draw, const uint32_t in[3]) {
+  if (!Grow((void **)&chunk->extra, &chunk->extraCapacity,
+            chunk->extraCount + 2, sizeof(RasterVertex))) {
+    return false;
+  }
+
+  uint32_t polygon[4];
+  int count = 0;
+  for (int i = 0; i < 3; i++) {
+    uint32_t a = in[i];
+    uint32_t b = in[(i + 1) % 3];
+    bool aInside = raster->clip[a].z + raster->clip[a].w >= 0.0f;
+    bool bInside = raster->clip[b].z + raster->clip[b].w >= 0.0f;
+    if (aInside) {
+      polygon[count++] = a;
+    }
+
+    if (aInside != bInside) {
+      polygon[count++] = AppendNearVertex(raster, chunk, draw, a, b);
+    }
+  }
+
+  chunk->trianglesClipped++;
+  for (int i = 2; i < count; i++) {
+    uint32_t refs[3] = {polygon[0], polygon[i - 1], polygon[i]};
+    if (!BinTriangle(raster, chunk, refs)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool BinChunk(const Raster *raster, RasterChunk *chunk) {
+  size_t tilesCount = (size_t)raster->tilesX * raster->tilesY;
+  if (chunk->bins == NULL) {
+    chunk->bins = calloc(tilesCount, sizeof(RasterBin));
+    if (chunk->bins == NULL) {
+      return false;
+    }
+  }
+
+  for (size_t i = 0; i < tilesCount; i++) {
+    chunk->bins[i].count = 0;
+  }
+
+  const RasterDraw *draw = raster->draws + chunk->draw;
+  const Mesh *mesh = draw->mesh;
+  uint32_t first = (uint32_t)draw->firstVertex;
+  size_t end = chunk->firstIndex + chunk->indicesCount;
+
+  for (size_t i = chunk->firstIndex; i + 2 < end; i += 3) {
+    uint32_t tri[3];
+    bool valid = true;
+    for (int k = 0; k < 3; k++) {
+      uint32_t index = ReadIndex(mesh, i + k);
+      valid = valid && index < mesh->verticesCount;
+      tri[k] = first + index;
+    }
+
+    chunk->trianglesSubmitted++;
+    if (!valid) {
+      continue;
+    }
+
+    // Reject triangles fully outside one of the clip planes
+    const Vec4 *c0 = raster->clip + tri[0];
+    const Vec4 *c1 = raster->clip + tri[1];
+    const Vec4 *c2 = raster->clip + tri[2];
+    if ((c0->x > c0->w && c1->x > c1->w && c2->x > c2->w) ||
+        (c0->x < -c0->w && c1->x < -c1->w && c2->x < -c2->w) ||
+        (c0->y > c0->w && c1->y > c1->w && c2->y > c2->w) ||
+        (c0->y < -c0->w && c1->y < -c1->w && c2->y < -c2->w) ||
+        (c0->z > c0->w && c1->z > c1->w && c2->z > c2->w) ||
+        (c0->z < -c0->w && c1->z < -c1->w && c2->z < -c2->w)) {
+      continue;
+    }
+
+    bool ok;
+    if (c0->z < -c0->w || c1->z < -c1->w || c2->z < -c2->w) {
+      ok = ClipTriangle(raster, chunk, draw, tri);
+    } else {
+      ok = BinTriangle(raster, chunk, tri);
+    }
+
+    if (!ok) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void BinChunkJob(void *data, size_t index) {
+  Raster *raster = data;
+  RasterChunk *chunk = raster->chunks + index;
+  chunk->trianglesCount = 0;
+  chunk->extraCount = 0;
+  chunk->trianglesSubmitted = 0;
+  chunk->trianglesClipped = 0;
+  chunk->failed = !BinChunk(raster, chunk);
+}
+
+static bool BinDraws(Raster *raster) {
+  size_t chunksCount = 0;
+  for (size_t i = 0; i < raster->drawsCount; i++) {
+    size_t triangles = raster->draws[i].mesh->indicesCount / 3;
+    chunksCount +=
+        (triangles + RASTER_TRIANGLE_CHUNK - 1) / RASTER_TRIANGLE_CHUNK;
+  }
+
+  if (chunksCount > raster->chunksCapacity) {
+    size_t capacity = raster->chunksCapacity;
+    RasterChunk *chunks = raster->chunks;
+    if (!Grow((void **)&chunks, &capacity, chunksCount,
+              sizeof(RasterChunk))) {
+      return false;
+    }
+
+    memset(chunks + raster->chunksCapacity, 0,
+           (capacity - raster->chunksCapacity) * sizeof(RasterChunk));
+    raster->chunks = chunks;
+    raster->chunksCapacity = capacity;
+  }
+
+  raster->chunksCount = 0;
+  for (size_t i = 0; i < raster->drawsCount; i++) {
+    size_t indices = raster->draws[i].mesh->indicesCount / 3 * 3;
+    size_t step = (size_t)RASTER_TRIANGLE_CHUNK * 3;
+    for (size_t first = 0; first < indices; first += step) {
+      RasterChunk *chunk = raster->chunks + raster->chunksCount++;
+      chunk->draw = i;
+      chunk->firstIndex = first;
+      chunk->indicesCount = indices - first < step ? indices - first : step;
+    }
+  }
+
+  JobPoolParallelFor(raster->pool, raster->chunksCount, BinChunkJob, raster);
+
+  for (size_t i = 0; i < raster->chunksCount; i++) {
+    RasterChunk *chunk = raster->chunks + i;
+    if (chunk->failed) {
+      return false;
+    }
+
+    raster->stats.trianglesSubmitted += chunk->trianglesSubmitted;
+    raster->stats.trianglesBinned += chunk->trianglesCount;
+    raster->stats.trianglesClipped += chunk->trianglesClipped;
+  }
+  return true;
+}
+
+// Attribute interpolated across a triangle as a * x + b * y + c
+typedef struct {
+  float a;
+  float b;
+  float c;
+} Plane;
+
+// Interpolate the differences to the first vertex, rounding keeps the
+// weights from adding up to one exactly which shows up in the depth test
+static Plane MakePlane(float q0, float q1, float q2, const Plane edges[3],
+                       float invArea) {
+  float d1 = q1 - q0;
+  float d2 = q2 - q0;
+
+  Plane plane;
+  plane.a = (d1 * edges[1].a + d2 * edges[2].a) * invArea;
+  plane.b = (d1 * edges[1].b + d2 * edges[2].b) * invArea;
+  plane.c = q0 + (d1 * edges[1].c + d2 * edges[2].c) * invArea;
+  return plane;
+}
+
+// Edge function of a -> b, positive on the inside of a positive area triangle
+static Plane MakeEdge(const RasterVertex *a, const RasterVertex *b, float ox,
+                      float oy) {
+  float ax = a->x - ox;
+  float ay = a->y - oy;
+  float bx = b->x - ox;
+  float by = b->y - oy;
+
+  Plane edge;
+  edge.a = ay - by;
+  edge.b = bx - ax;
+  edge.c = ax * by - ay * bx;
+  return edge;
+}
+
+// Pixels exactly on an edge shared by two triangles belong to only one of
+// them, the edge goes in opposite directions in each one
+static bool IsEdgeInclusive(Plane edge) {
+  return edge.a > 0.0f || (edge.a == 0.0f && edge.b > 0.0f);
+}
+
+static void RasterizeTriangle(Raster *raster, const RasterChunk *chunk,
+                              uint32_t triangle, int tileX0, int tileY0,
+                              int tileX1, int tileY1) {
+  const uint32_t *refs = chunk->triangles + triangle * 3;
+  const RasterVertex *v[3] = {GetVertex(raster, chunk, refs[0]),
+                              GetVertex(raster, chunk, refs[1]),
+                              GetVertex(raster, chunk, refs[2])};
+
+  // Planes are relative to the tile origin, with screen coordinates the
+  // constant terms are large enough to cancel out the area of small triangles
+  float ox = (float)tileX0;
+  float oy = (float)tileY0;
+
+  // Edge i is opposite to vertex i so it weights that vertex
+  Plane edges[3] = {MakeEdge(v[1], v[2], ox, oy), MakeEdge(v[2], v[0], ox, oy),
+                    MakeEdge(v[0], v[1], ox, oy)};
+  float area = (v[1]->x - v[0]->x) * (v[2]->y - v[0]->y) -
+               (v[1]->y - v[0]->y) * (v[2]->x - v[0]->x);
+  if (area < 0.0f) {
+    for (int i = 0; i < 3; i++) {
+      edges[i].a = -edges[i].a;
+      edges[i].b = -edges[i].b;
+      edges[i].c = -edges[i].c;
+    }
+    area = -area;
+  }
+
+  if (!(area > 0.0f)) {
+    return;
+  }
+
+  bool inclusive[3];
+  for (int i = 0; i < 3; i++) {
+    inclusive[i] = IsEdgeInclusive(edges[i]);
+  }
+
+  float invArea = 1.0f / area;
+  Plane z = MakePlane(v[0]->z, v[1]->z, v[2]->z, edges, invArea);
+  Plane invW = MakePlane(v[0]->invW, v[1]->invW, v[2]->invW, edges, invArea);
+  Plane r = MakePlane(v[0]->col.x, v[1]->col.x, v[2]->col.x, edges, invArea);
+  Plane g = MakePlane(v[0]->col.y, v[1]->col.y, v[2]->col.y, edges, invArea);
+  Plane b = MakePlane(v[0]->col.z, v[1]->col.z, v[2]->col.z, edges, invArea);
+  Plane a = MakePlane(v[0]->col.w, v[1]->col.w, v[2]->col.w, edges, invArea);
+
+  // Bounds of the triangle inside of the tile
+  float minX = MinF(v[0]->x, MinF(v[1]->x, v[2]->x));
+  float maxX = MaxF(v[0]->x, MaxF(v[1]->x, v[2]->x));
+  float minY = MinF(v[0]->y, MinF(v[1]->y, v[2]->y));
+  float maxY = MaxF(v[0]->y, MaxF(v[1]->y, v[2]->y));
+  int x0, x1, y0, y1;
+  GetPixelRange(minX, maxX, tileX0, tileX1, &x0, &x1);
+  GetPixelRange(minY, maxY, tileY0, tileY1, &y0, &y1);
+  if (x0 > x1 || y0 > y1) {
+    return;
+  }
+
+#if defined(RASTER_USE_SSE)
+  // Four pixels of a row at a time, only the depth test and the writes are
+  // done per pixel so that neighbor tiles are never touched
+  const __m128 lanes = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 scale = _mm_set1_ps(255.0f);
+  const __m128 half = _mm_set1_ps(0.5f);
+
+  __m128 edgeA[3];
+  __m128 inclusiveMask[3];
+  for (int i = 0; i < 3; i++) {
+    edgeA[i] = _mm_set1_ps(edges[i].a);
+    inclusiveMask[i] = _mm_castsi128_ps(_mm_set1_epi32(inclusive[i] ? -1 : 0));
+  }
+
+  for (int y = y0; y <= y1; y++) {
+    float py = (float)(y - tileY0) + 0.5f;
+    __m128 edgeRow[3];
+    for (int i = 0; i < 3; i++) {
+      edgeRow[i] = _mm_set1_ps(edges[i].b * py + edges[i].c);
+    }
+
+    size_t row = (size_t)y * raster->width;
+    for (int x = x0; x <= x1; x += 4) {
+      __m128 px = _mm_add_ps(_mm_set1_ps((float)(x - tileX0)), lanes);
+      __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+      for (int i = 0; i < 3; i++) {
+        __m128 e = _mm_add_ps(_mm_mul_ps(edgeA[i], px), edgeRow[i]);
+        __m128 on = _mm_and_ps(_mm_cmpeq_ps(e, zero), inclusiveMask[i]);
+        inside = _mm_and_ps(inside, _mm_or_ps(_mm_cmpgt_ps(e, zero), on));
+      }
+
+      int mask = _mm_movemask_ps(inside);
+      if (x1 - x < 3) {
+        mask &= (1 << (x1 - x + 1)) - 1;
+      }
+
+      if (mask == 0) {
+        continue;
+      }
+
+      float depths[4];
+      __m128 depth = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(z.a), px),
+                                _mm_set1_ps(z.b * py + z.c));
+      _mm_storeu_ps(depths, depth);
+
+      float *dst = raster->depth + row + x;
+      int pass = 0;
+      for (int i = 0; i < 4; i++) {
+        if ((mask >> i) & 1 && depths[i] < dst[i] && depths[i] >= 0.0f) {
+          pass |= 1 << i;
+        }
+      }
+
+      if (pass == 0) {
+        continue;
+      }
+
+      Plane planes[4] = {r, g, b, a};
+      __m128 w = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(invW.a), px),
+                            _mm_set1_ps(invW.b * py + invW.c));
+      w = _mm_div_ps(one, w);
+
+      __m128i packed = _mm_setzero_si128();
+      for (int i = 0; i < 4; i++) {
+        __m128 c = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(planes[i].a), px),
+                              _mm_set1_ps(planes[i].b * py + planes[i].c));
+        c = _mm_min_ps(_mm_max_ps(_mm_mul_ps(c, w), zero), one);
+        __m128i channel =
+            _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(c, scale), half));
+        packed = _mm_or_si128(packed, _mm_slli_epi32(channel, i * 8));
+      }
+
+      uint32_t colors[4];
+      _mm_storeu_si128((__m128i *)colors, packed);
+      for (int i = 0; i < 4; i++) {
+        if ((pass >> i) & 1) {
+          dst[i] = depths[i];
+          raster->color[row + x + i] = colors[i];
+        }
+      }
+    }
+  }
+#else
+  for (int y = y0; y <= y1; y++) {
+    float px = (float)(x0 - tileX0) + 0.5f;
+    float py = (float)(y - tileY0) + 0.5f;
+    float e0 = edges[0].a * px + edges[0].b * py + edges[0].c;
+    float e1 = edges[1].a * px + edges[1].b * py + edges[1].c;
+    float e2 = edges[2].a * px + edges[2].b * py + edges[2].c;
+
+    size_t row = (size_t)y * raster->width;
+    for (int x = x0; x <= x1; x++) {
+      bool inside = (e0 > 0.0f || (e0 == 0.0f && inclusive[0])) &&
+                    (e1 > 0.0f || (e1 == 0.0f && inclusive[1])) &&
+                    (e2 > 0.0f || (e2 == 0.0f && inclusive[2]));
+      if (inside) {
+        px = (float)(x - tileX0) + 0.5f;
+        float depth = z.a * px + z.b * py + z.c;
+        float *dst = raster->depth + row + x;
+        if (depth < *dst && depth >= 0.0f) {
+          float w = 1.0f / (invW.a * px + invW.b * py + invW.c);
+          Vec4 col = {(r.a * px + r.b * py + r.c) * w,
+                      (g.a * px + g.b * py + g.c) * w,
+                      (b.a * px + b.b * py + b.c) * w,
+                      (a.a * px + a.b * py + a.c) * w};
+          *dst = depth;
+          raster->color[row + x] = PackColor(col);
+        }
+      }
+
+      e0 += edges[0].a;
+      e1 += edges[1].a;
+      e2 += edges[2].a;
+    }
+  }
+#endif
+}
+
+static void RasterizeTileJob(void *data, size_t index) {
+  Raster *raster = data;
+  int tx = (int)(index % raster->tilesX);
+  int ty = (int)(index / raster->tilesX);
+
+  int x0 = tx * RASTER_TILE_SIZE;
+  int y0 = ty * RASTER_TILE_SIZE;
+  int x1 = x0 + RASTER_TILE_SIZE - 1;
+  int y1 = y0 + RASTER_TILE_SIZE - 1;
+  x1 = x1 < raster->width - 1 ? x1 : raster->width - 1;
+  y1 = y1 < raster->height - 1 ? y1 : raster->height - 1;
+
+  for (size_t c = 0; c < raster->chunksCount; c++) {
+    const RasterChunk *chunk = raster->chunks + c;
+    const RasterBin *bin = chunk->bins + index;
+    for (size_t i = 0; i < bin->count; i++) {
+      RasterizeTriangle(raster, chunk, bin->triangles[i], x0, y0, x1, y1);
+    }
+  }
+}
+
+void RasterFlush(Raster *raster) {
+  assert(raster != NULL && "invalid arg raster: cannot be NULL");
+  memset(&raster->stats, 0, sizeof(RasterStats));
+  if (raster->status != SUCCESS) {
+    return;
+  }
+
+  PROFILE_ZONE("RasterFlush");
+  double start = GetTime();
+  if (!TransformDraws(raster)) {
+    Log(LOG_ERROR, "cannot transform raster vertices (out of memory)");
+    raster->status = E_OUT_OF_MEMORY;
+    return;
+  }
+
+  double transformed = GetTime();
+  if (!BinDraws(raster)) {
+    Log(LOG_ERROR, "cannot bin raster triangles (out of memory)");
+    raster->status = E_OUT_OF_MEMORY;
+    return;
+  }
+
+  double binned = GetTime();
+  JobPoolParallelFor(raster->pool, (size_t)raster->tilesX * raster->tilesY,
+                     RasterizeTileJob, raster);
+
+  double rasterized = GetTime();
+  raster->stats.transformMs = (transformed - start) * 1000.0;
+  raster->stats.binMs = (binned - transformed) * 1000.0;
+  raster->stats.rasterMs = (rasterized - binned) * 1000.0;
+}
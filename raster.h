@@ -0,0 +1,137 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <xmath/mat4.h>
+#include <xmath/vec4.h>
+
+#include "camera.h"
+#include "core.h"
+#include "jobs.h"
+#include "model.h"
+
+// Size in pixels of the square tiles rasterized by each job
+#define RASTER_TILE_SIZE 64
+
+// Vertices transformed and triangles binned per job
+#define RASTER_VERTEX_CHUNK 4096
+#define RASTER_TRIANGLE_CHUNK 8192
+
+// Marks a triangle vertex created by near plane clipping, the rest of the
+// bits index the extra vertices of its chunk
+#define RASTER_EXTRA_VERTEX 0x80000000u
+
+// A vertex after projection, attributes are divided by w so they can be
+// interpolated linearly in screen space
+typedef struct {
+  float x;
+  float y;
+  float z;
+  float invW;
+  Vec4 col;
+} RasterVertex;
+
+// A mesh submitted for the frame and where its vertices start once
+// transformed
+typedef struct {
+  const Mesh *mesh;
+  Mat4 mvp;
+  bool vertexColors;
+  size_t firstVertex;
+} RasterDraw;
+
+// Triangles overlapping a tile, in submission order
+typedef struct {
+  uint32_t *triangles;
+  size_t count;
+  size_t capacity;
+} RasterBin;
+
+// A range of triangles of a draw binned by a single job. Tiles walk the
+// chunks in order so draws keep their submission order.
+typedef struct {
+  size_t draw;
+  size_t firstIndex;
+  size_t indicesCount;
+
+  // Three vertex references per binned triangle
+  uint32_t *triangles;
+  size_t trianglesCount;
+  size_t trianglesCapacity;
+
+  // Vertices created by near plane clipping
+  RasterVertex *extra;
+  size_t extraCount;
+  size_t extraCapacity;
+
+  // One bin per tile
+  RasterBin *bins;
+  size_t trianglesSubmitted;
+  size_t trianglesClipped;
+  bool failed;
+} RasterChunk;
+
+// Counters and timings of the last flush
+typedef struct {
+  size_t trianglesSubmitted;
+  size_t trianglesBinned;
+  size_t trianglesClipped;
+  double transformMs;
+  double binMs;
+  double rasterMs;
+} RasterStats;
+
+// Raster is a software render target drawing models on the CPU. Vertices are
+// transformed with SIMD, triangles are binned into tiles and tiles are
+// rasterized in parallel with a depth test equivalent to GL_LESS.
+typedef struct {
+  int width;
+  int height;
+  int tilesX;
+  int tilesY;
+
+  // RGBA8 pixels and depth, rows go from top to bottom
+  uint32_t *color;
+  float *depth;
+
+  RasterDraw *draws;
+  size_t drawsCount;
+  size_t drawsCapacity;
+
+  // Transformed vertices of all the draws
+  Vec4 *clip;
+  RasterVertex *vertices;
+  size_t verticesCount;
+  size_t verticesCapacity;
+
+  // Triangle chunks, kept between frames to reuse their memory
+  RasterChunk *chunks;
+  size_t chunksCount;
+  size_t chunksCapacity;
+
+  Mat4 viewProj;
+  JobPool *pool;
+  RasterStats stats;
+  StatusCode status;
+} Raster;
+
+// Make a software render target, jobs run on the given pool (NULL runs them
+// on the calling thread).
+Raster MakeRaster(int width, int height, JobPool *pool);
+
+// Release all the memory held by a software render target.
+void DestroyRaster(Raster raster);
+
+// Fill the color buffer and reset the depth buffer to the far plane.
+void RasterClear(Raster *raster, Vec4 color);
+
+// Start collecting the draws of a frame seen from the given camera.
+void RasterBegin(Raster *raster, Camera camera);
+
+// Submit every mesh of a model using its CPU vertex and index data. Vertex
+// colors are used when the model shader is a SHADER_VARIANT_VERTEX_COLORS
+// variant, as LoadShader builds, and white otherwise, the same as
+// def_vs.glsl. The model must outlive the flush.
+void RasterSubmit(Raster *raster, const Model *model);
+
+// Transform, bin and rasterize all the submitted draws. Every draw is opaque.
+void RasterFlush(Raster *raster);
@@ -0,0 +1,318 @@
+#include "render.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glad/glad.h>
+
+#include "glstate.h"
+#include "profile.h"
+#include "stats.h"
+
+// Draw key layout (most significant bits first):
+//   opaque:      pass:2 | program:12 | material:12 | vao:14 | depth:24
+//   transparent: pass:2 | ~depth:24 | program:12 | material:12 | vao:14
+// Opaque draws are grouped by state and then sorted front to back, while
+// transparent draws are sorted back to front before anything else.
+#define KEY_PASS_SHIFT 62
+#define KEY_PROGRAM_BITS 12
+#define KEY_MATERIAL_BITS 12
+#define KEY_VAO_BITS 14
+#define KEY_DEPTH_BITS 24
+
+#define KEY_MASK(bits) ((UINT64_C(1) << (bits)) - 1)
+
+static uint64_t MakeDrawKey(RenderPass pass, unsigned program,
+                            unsigned material, unsigned vao, float depth) {
+  uint64_t quantDepth = (uint64_t)(depth * (float)KEY_MASK(KEY_DEPTH_BITS));
+  uint64_t state = (program & KEY_MASK(KEY_PROGRAM_BITS));
+  state <<= KEY_MATERIAL_BITS;
+  state |= (material & KEY_MASK(KEY_MATERIAL_BITS));
+  state <<= KEY_VAO_BITS;
+  state |= (vao & KEY_MASK(KEY_VAO_BITS));
+
+  uint64_t key = (uint64_t)pass << KEY_PASS_SHIFT;
+  if (pass == RENDER_PASS_TRANSPARENT) {
+    uint64_t farDepth = KEY_MASK(KEY_DEPTH_BITS) - quantDepth;
+    key |= farDepth << (KEY_PROGRAM_BITS + KEY_MATERIAL_BITS + KEY_VAO_BITS);
+    key |= state;
+  } else {
+    key |= state << KEY_DEPTH_BITS;
+    key |= quantDepth;
+  }
+  return key;
+}
+
+// LSD radix sort over the 8 bytes of the key. All histograms are built in a
+// single pass and bytes shared by every key are skipped, which is the common
+// case for the pass and the upper bits of the GL names.
+static DrawItem *SortDrawItems(DrawItem *items, DrawItem *scratch,
+                               size_t count) {
+  size_t histograms[8][256] = {0};
+  for (size_t i = 0; i < count; i++) {
+    uint64_t key = items[i].key;
+    for (int b = 0; b < 8; b++) {
+      histograms[b][(key >> (b * 8)) & 0xFF]++;
+    }
+  }
+
+  DrawItem *src = items;
+  DrawItem *dst = scratch;
+  for (int b = 0; b < 8; b++) {
+    size_t *histogram = histograms[b];
+    if (histogram[(src[0].key >> (b * 8)) & 0xFF] == count) {
+      continue;
+    }
+
+    size_t offset = 0;
+    for (int v = 0; v < 256; v++) {
+      size_t n = histogram[v];
+      histogram[v] = offset;
+      offset += n;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+      size_t v = (src[i].key >> (b * 8)) & 0xFF;
+      dst[histogram[v]++] = src[i];
+    }
+
+    DrawItem *tmp = src;
+    src = dst;
+    dst = tmp;
+  }
+
+  return src;
+}
+
+static unsigned cameraUbo = 0;
+
+CameraUniforms UploadCameraUniforms(Camera camera) {
+  CameraUniforms uniforms = {0};
+  uniforms.view = CameraGetViewMatrix(&camera);
+  uniforms.proj = CameraGetProjMatrix(&camera);
+  uniforms.viewProj = CameraGetViewProjMatrix(&camera);
+
+  if (cameraUbo == 0) {
+    glGenBuffers(1, &cameraUbo);
+    GLStateBindBuffer(GL_UNIFORM_BUFFER, cameraUbo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(CameraUniforms), NULL,
+                 GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, SHADER_CAMERA_BINDING, cameraUbo);
+  }
+
+  GLStateBindBuffer(GL_UNIFORM_BUFFER, cameraUbo);
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(CameraUniforms), &uniforms);
+  FrameStatsAdd(FRAME_STAT_UPLOADED_BYTES, sizeof(CameraUniforms));
+  return uniforms;
+}
+
+void DestroyCameraUniforms() {
+  GLStateDeleteBuffer(cameraUbo);
+  cameraUbo = 0;
+}
+
+static bool ReserveDrawItems(RenderQueue *queue, size_t count) {
+  if (queue->itemsCount + count <= queue->itemsCapacity) {
+    return true;
+  }
+
+  size_t capacity = queue->itemsCapacity > 0 ? queue->itemsCapacity : 64;
+  while (capacity < queue->itemsCount + count) {
+    capacity *= 2;
+  }
+
+  size_t size = capacity * sizeof(DrawItem);
+  DrawItem *items = realloc(queue->items, size);
+  if (items == NULL) {
+    return false;
+  }
+  queue->items = items;
+
+  // Give back what the items took so both keep the capacity of the queue
+  DrawItem *scratch = realloc(queue->scratch, size);
+  if (scratch == NULL) {
+    size_t oldSize = queue->itemsCapacity * sizeof(DrawItem);
+    if (oldSize == 0) {
+      free(queue->items);
+      queue->items = NULL;
+    } else if ((items = realloc(queue->items, oldSize)) != NULL) {
+      queue->items = items;
+    }
+    return false;
+  }
+  queue->scratch = scratch;
+
+  queue->itemsCapacity = capacity;
+  return true;
+}
+
+static bool ReserveDrawObject(RenderQueue *queue) {
+  if (queue->objectsCount < queue->objectsCapacity) {
+    return true;
+  }
+
+  size_t capacity = queue->objectsCapacity * 2;
+  if (capacity == 0) {
+    capacity = 16;
+  }
+
+  DrawObject *objects = realloc(queue->objects, capacity * sizeof(DrawObject));
+  if (objects == NULL) {
+    return false;
+  }
+
+  queue->objects = objects;
+  queue->objectsCapacity = capacity;
+  return true;
+}
+
+RenderQueue MakeRenderQueue(size_t capacity) {
+  RenderQueue queue = {0};
+  if (!ReserveDrawItems(&queue, capacity)) {
+    Log(LOG_ERROR, "cannot allocate render queue of %zu items", capacity);
+    queue.status = E_OUT_OF_MEMORY;
+    return queue;
+  }
+
+  queue.status = SUCCESS;
+  return queue;
+}
+
+void DestroyRenderQueue(RenderQueue queue) {
+  if (queue.items != NULL) {
+    free(queue.items);
+  }
+
+  if (queue.scratch != NULL) {
+    free(queue.scratch);
+  }
+
+  if (queue.objects != NULL) {
+    free(queue.objects);
+  }
+}
+
+void RenderQueueBegin(RenderQueue *queue, Camera camera) {
+  assert(queue != NULL && "invalid arg queue: cannot be NULL");
+  queue->itemsCount = 0;
+  queue->objectsCount = 0;
+  queue->status = SUCCESS;
+  queue->viewMat = UploadCameraUniforms(camera).view;
+  queue->near = camera.near;
+  queue->far = camera.far;
+}
+
+void RenderQueueSetOcclusion(RenderQueue *queue, OcclusionBuffer *occlusion) {
+  assert(queue != NULL && "invalid arg queue: cannot be NULL");
+  queue->occlusion = occlusion;
+}
+
+void RenderQueueSubmit(RenderQueue *queue, const Model *model,
+                       RenderPass pass) {
+  assert(queue != NULL && "invalid arg queue: cannot be NULL");
+  assert(model != NULL && "invalid arg model: cannot be NULL");
+  assert(pass >= RENDER_PASS_OPAQUE && pass < RENDER_PASS_COUNT &&
+         "invalid arg pass: outside range");
+
+  if (!ReserveDrawObject(queue) ||
+      !ReserveDrawItems(queue, model->meshesCount)) {
+    Log(LOG_ERROR, "cannot grow render queue (out of memory)");
+    queue->status = E_OUT_OF_MEMORY;
+    return;
+  }
+
+  uint32_t objectIndex = (uint32_t)queue->objectsCount++;
+  DrawObject *object = queue->objects + objectIndex;
+  object->model = model;
+  object->modelMat = TransformGetModelMatrix(model->transform);
+
+  // View space depth of the model origin, normalized to the clip range
+  Mat4 v = queue->viewMat;
+  Mat4 m = object->modelMat;
+  float viewZ = v.xz * m.wx + v.yz * m.wy + v.zz * m.wz + v.wz;
+  float depth = (-viewZ - queue->near) / (queue->far - queue->near);
+  // Degenerate matrices or near == far give NaN, which must not reach the
+  // integer conversion of the key
+  depth = depth > 0.0f ? (depth < 1.0f ? depth : 1.0f) : 0.0f;
+
+  for (size_t i = 0; i < model->meshesCount; i++) {
+    Mesh *mesh = model->meshes + i;
+    if (queue->occlusion != NULL &&
+        !OcclusionTestBox(queue->occlusion, object->modelMat, mesh->boundsMin,
+                          mesh->boundsMax)) {
+      FrameStatsAdd(FRAME_STAT_CULLED_MESHES, 1.0);
+      continue;
+    }
+
+    DrawItem *item = queue->items + queue->itemsCount++;
+    item->key = MakeDrawKey(pass, model->shader.spId, mesh->material,
+                            mesh->vao, depth);
+    item->object = objectIndex;
+    item->mesh = (uint32_t)i;
+  }
+}
+
+static void SetRenderPassState(RenderPass pass) {
+  if (pass == RENDER_PASS_TRANSPARENT) {
+    GLStateSetCapability(GL_BLEND, true);
+    GLStateBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    GLStateDepthMask(false);
+  } else {
+    GLStateSetCapability(GL_BLEND, false);
+    GLStateDepthMask(true);
+  }
+}
+
+void RenderQueueFlush(RenderQueue *queue) {
+  assert(queue != NULL && "invalid arg queue: cannot be NULL");
+  if (queue->itemsCount == 0) {
+    return;
+  }
+
+  PROFILE_ZONE("RenderQueueFlush");
+  PROFILE_GPU_ZONE("RenderQueueFlush");
+
+  DrawItem *items =
+      SortDrawItems(queue->items, queue->scratch, queue->itemsCount);
+
+  RenderPass curPass = RENDER_PASS_COUNT;
+  unsigned curProgram = 0;
+  uint32_t curObject = UINT32_MAX;
+
+  for (size_t i = 0; i < queue->itemsCount; i++) {
+    DrawItem item = items[i];
+    DrawObject *object = queue->objects + item.object;
+    const Model *model = object->model;
+    Mesh *mesh = model->meshes + item.mesh;
+
+    RenderPass pass = (RenderPass)(item.key >> KEY_PASS_SHIFT);
+    if (pass != curPass) {
+      SetRenderPassState(pass);
+      curPass = pass;
+    }
+
+    // Camera matrices come from the shared uniform buffer, only the per
+    // object uniforms are uploaded here
+    unsigned spid = model->shader.spId;
+    if (spid != curProgram) {
+      GLStateUseProgram(spid);
+      curProgram = spid;
+      curObject = UINT32_MAX;
+    }
+
+    if (item.object != curObject) {
+      glUniformMatrix4fv(model->shader.modelLoc, 1, GL_FALSE,
+                         Mat4Raw(&object->modelMat));
+      FrameStatsAdd(FRAME_STAT_UNIFORM_UPLOADS, 1.0);
+      curObject = item.object;
+    }
+
+    GLStateBindVertexArray(mesh->vao);
+    glDrawElements(GL_TRIANGLES, (GLsizei)mesh->indicesCount, mesh->indexType,
+                   0);
+    FrameStatsAddDraw(mesh->verticesCount, mesh->indicesCount / 3);
+  }
+
+  SetRenderPassState(RENDER_PASS_OPAQUE);
+}
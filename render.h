@@ -0,0 +1,86 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <xmath/mat4.h>
+
+#include "camera.h"
+#include "core.h"
+#include "model.h"
+#include "occlusion.h"
+
+// Render passes, flushed in the same order they are declared
+typedef enum {
+  RENDER_PASS_OPAQUE,
+  RENDER_PASS_TRANSPARENT,
+  RENDER_PASS_COUNT,
+} RenderPass;
+
+// A single mesh draw, items are sorted by key before being issued
+typedef struct {
+  uint64_t key;
+  uint32_t object;
+  uint32_t mesh;
+} DrawItem;
+
+// Camera matrices as laid out (std140) in the shared Camera uniform block
+typedef struct {
+  Mat4 view;
+  Mat4 proj;
+  Mat4 viewProj;
+} CameraUniforms;
+
+// Per-object state shared by all the draw items of a submitted model
+typedef struct {
+  const Model *model;
+  Mat4 modelMat;
+} DrawObject;
+
+// RenderQueue collects the draws of a frame and issues them sorted by state
+typedef struct {
+  DrawItem *items;
+  DrawItem *scratch;
+  size_t itemsCount;
+  size_t itemsCapacity;
+
+  DrawObject *objects;
+  size_t objectsCount;
+  size_t objectsCapacity;
+
+  Mat4 viewMat;
+  float near;
+  float far;
+
+  // Optional occlusion buffer testing every mesh before it is queued
+  OcclusionBuffer *occlusion;
+  StatusCode status;
+} RenderQueue;
+
+// Compute the camera matrices once and upload them to the uniform buffer bound
+// at SHADER_CAMERA_BINDING, shared by every program. Call once per frame.
+CameraUniforms UploadCameraUniforms(Camera camera);
+
+// Release the shared camera uniform buffer.
+void DestroyCameraUniforms();
+
+// Make an empty render queue with room for capacity draw items.
+RenderQueue MakeRenderQueue(size_t capacity);
+
+// Release all the memory held by a render queue.
+void DestroyRenderQueue(RenderQueue queue);
+
+// Start collecting the draws of a frame seen from the given camera, uploading
+// its camera uniforms. Clears the status left by a failed submit.
+void RenderQueueBegin(RenderQueue *queue, Camera camera);
+
+// Test the bounds of every submitted mesh against an occlusion buffer and
+// drop the hidden ones, NULL disables the test. The buffer must be flushed
+// for the frame before the first submit.
+void RenderQueueSetOcclusion(RenderQueue *queue, OcclusionBuffer *occlusion);
+
+// Submit every mesh of a model into a pass. The model must outlive the flush.
+void RenderQueueSubmit(RenderQueue *queue, const Model *model, RenderPass pass);
+
+// Sort all the submitted draws and issue them, changing GL state only when
+// the program, vertex array or pass differs from the previous draw. The last
+// vertex array is left bound, GL state goes through the glstate cache.
+void RenderQueueFlush(RenderQueue *queue);
@@ -0,0 +1,230 @@
+#include "stats.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glad/glad.h>
+
+#include "core.h"
+#include "glstate.h"
+
+typedef struct {
+  FrameStats frame;
+  FrameStats history[FRAME_STATS_HISTORY];
+  size_t historyCount;
+  size_t historyNext;
+
+  double frameStart;
+  double lastFrameEnd;
+  double logInterval;
+  double lastLog;
+
+  // Elapsed time queries, one per frame in flight
+  unsigned gpuQueries[FRAME_STATS_GPU_FRAMES];
+  bool gpuPending[FRAME_STATS_GPU_FRAMES];
+  size_t gpuQuery;
+  bool gpuActive;
+  double gpuMs;
+} FrameStatsState;
+
+static FrameStatsState stats = {0};
+
+static const char *statNames[FRAME_STAT_COUNT] = {
+    [FRAME_STAT_DRAW_CALLS] = "draw calls",
+    [FRAME_STAT_TRIANGLES] = "triangles",
+    [FRAME_STAT_VERTICES] = "vertices",
+    [FRAME_STAT_PROGRAM_BINDS] = "program binds",
+    [FRAME_STAT_VERTEX_ARRAY_BINDS] = "vertex array binds",
+    [FRAME_STAT_BUFFER_BINDS] = "buffer binds",
+    [FRAME_STAT_TEXTURE_BINDS] = "texture binds",
+    [FRAME_STAT_UNIFORM_UPLOADS] = "uniform uploads",
+    [FRAME_STAT_CULLED_MESHES] = "culled meshes",
+    [FRAME_STAT_UPLOADED_BYTES] = "uploaded bytes",
+    [FRAME_STAT_CPU_MS] = "cpu ms",
+    [FRAME_STAT_FRAME_MS] = "frame ms",
+    [FRAME_STAT_GPU_MS] = "gpu ms",
+};
+
+void FrameStatsAdd(FrameStat stat, double value) {
+  assert(stat >= 0 && stat < FRAME_STAT_COUNT &&
+         "invalid arg stat: outside range");
+  stats.frame.values[stat] += value;
+}
+
+void FrameStatsAddDraw(size_t vertices, size_t triangles) {
+  stats.frame.values[FRAME_STAT_DRAW_CALLS] += 1.0;
+  stats.frame.values[FRAME_STAT_VERTICES] += (double)vertices;
+  stats.frame.values[FRAME_STAT_TRIANGLES] += (double)triangles;
+}
+
+void FrameStatsBeginFrame() {
+  // Uploads done between frames (loading) count towards the next one
+  stats.frameStart = GetTime();
+
+  if (stats.gpuQueries[0] == 0) {
+    glGenQueries(FRAME_STATS_GPU_FRAMES, stats.gpuQueries);
+  }
+
+  // BeginFrame without EndFrame keeps timing the same frame
+  if (stats.gpuActive) {
+    return;
+  }
+
+  // The query of this slot was issued frames ago, it rarely waits
+  size_t slot = stats.gpuQuery;
+  if (stats.gpuPending[slot]) {
+    GLuint64 elapsed = 0;
+    glGetQueryObjectui64v(stats.gpuQueries[slot], GL_QUERY_RESULT, &elapsed);
+    stats.gpuMs = (double)elapsed * 1e-6;
+    stats.gpuPending[slot] = false;
+  }
+  glBeginQuery(GL_TIME_ELAPSED, stats.gpuQueries[slot]);
+  stats.gpuActive = true;
+}
+
+void DestroyFrameStats() {
+  if (stats.gpuQueries[0] != 0) {
+    glDeleteQueries(FRAME_STATS_GPU_FRAMES, stats.gpuQueries);
+  }
+  memset(stats.gpuQueries, 0, sizeof(stats.gpuQueries));
+  memset(stats.gpuPending, 0, sizeof(stats.gpuPending));
+  stats.gpuActive = false;
+}
+
+static void LogFrameStats() {
+  FrameStatSummary frame = GetFrameStatSummary(FRAME_STAT_FRAME_MS);
+  FrameStatSummary cpu = GetFrameStatSummary(FRAME_STAT_CPU_MS);
+  FrameStatSummary gpu = GetFrameStatSummary(FRAME_STAT_GPU_MS);
+  Log(LOG_INFO,
+      "frame %.2f ms (p50 %.2f, p95 %.2f, p99 %.2f, max %.2f), cpu %.2f ms, "
+      "gpu %.2f ms",
+      frame.avg, frame.p50, frame.p95, frame.p99, frame.max, cpu.avg,
+      gpu.avg);
+
+  // Averages of the counters on a single line
+  char line[512];
+  size_t length = 0;
+  for (int i = 0; i < FRAME_STAT_CPU_MS && length < sizeof(line); i++) {
+    FrameStatSummary summary = GetFrameStatSummary((FrameStat)i);
+    length += (size_t)snprintf(line + length, sizeof(line) - length,
+                               "%s%s %.0f", i > 0 ? ", " : "", statNames[i],
+                               summary.avg);
+  }
+  Log(LOG_INFO, "%s", line);
+}
+
+void FrameStatsEndFrame() {
+  double now = GetTime();
+  FrameStats *frame = &stats.frame;
+
+  if (stats.gpuActive) {
+    glEndQuery(GL_TIME_ELAPSED);
+    stats.gpuActive = false;
+    stats.gpuPending[stats.gpuQuery] = true;
+    stats.gpuQuery = (stats.gpuQuery + 1) % FRAME_STATS_GPU_FRAMES;
+  }
+  frame->values[FRAME_STAT_GPU_MS] = stats.gpuMs;
+
+  GLStateCounters counters = GLStateGetFrameCounters();
+  frame->values[FRAME_STAT_PROGRAM_BINDS] = counters.issued[GL_STATE_PROGRAM];
+  frame->values[FRAME_STAT_VERTEX_ARRAY_BINDS] =
+      counters.issued[GL_STATE_VERTEX_ARRAY];
+  frame->values[FRAME_STAT_BUFFER_BINDS] = counters.issued[GL_STATE_BUFFER];
+  frame->values[FRAME_STAT_TEXTURE_BINDS] = counters.issued[GL_STATE_TEXTURE];
+  frame->values[FRAME_STAT_CPU_MS] = (now - stats.frameStart) * 1000.0;
+
+  // The first frame has no previous end, use its start
+  double lastEnd =
+      stats.lastFrameEnd != 0.0 ? stats.lastFrameEnd : stats.frameStart;
+  frame->values[FRAME_STAT_FRAME_MS] = (now - lastEnd) * 1000.0;
+  stats.lastFrameEnd = now;
+
+  stats.history[stats.historyNext] = *frame;
+  stats.historyNext = (stats.historyNext + 1) % FRAME_STATS_HISTORY;
+  if (stats.historyCount < FRAME_STATS_HISTORY) {
+    stats.historyCount++;
+  }
+  memset(frame, 0, sizeof(FrameStats));
+
+  if (stats.logInterval > 0.0 && now - stats.lastLog >= stats.logInterval) {
+    LogFrameStats();
+    stats.lastLog = now;
+  }
+}
+
+FrameStats GetFrameStats() {
+  if (stats.historyCount == 0) {
+    return (FrameStats){0};
+  }
+
+  size_t last = (stats.historyNext + FRAME_STATS_HISTORY - 1) %
+                FRAME_STATS_HISTORY;
+  return stats.history[last];
+}
+
+static int CompareDoubles(const void *a, const void *b) {
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+// Nearest rank percentile of sorted values
+static double GetPercentile(const double *sorted, size_t count, double p) {
+  size_t rank = (size_t)(p * (double)count + 0.999999);
+  rank = rank < 1 ? 1 : (rank > count ? count : rank);
+  return sorted[rank - 1];
+}
+
+FrameStatSummary GetFrameStatSummary(FrameStat stat) {
+  assert(stat >= 0 && stat < FRAME_STAT_COUNT &&
+         "invalid arg stat: outside range");
+  double values[FRAME_STATS_HISTORY];
+  for (size_t i = 0; i < stats.historyCount; i++) {
+    values[i] = stats.history[i].values[stat];
+  }
+  return MakeFrameStatSummary(values, stats.historyCount);
+}
+
+FrameStatSummary MakeFrameStatSummary(double *values, size_t count) {
+  assert((values != NULL || count == 0) &&
+         "invalid arg values: cannot be NULL");
+  FrameStatSummary summary = {0};
+  if (count == 0) {
+    return summary;
+  }
+
+  double sum = 0.0;
+  for (size_t i = 0; i < count; i++) {
+    sum += values[i];
+  }
+  qsort(values, count, sizeof(double), CompareDoubles);
+
+  summary.min = values[0];
+  summary.max = values[count - 1];
+  summary.avg = sum / (double)count;
+  summary.p50 = GetPercentile(values, count, 0.50);
+  summary.p95 = GetPercentile(values, count, 0.95);
+  summary.p99 = GetPercentile(values, count, 0.99);
+  summary.frames = count;
+  return summary;
+}
+
+const char *GetFrameStatName(FrameStat stat) {
+  assert(stat >= 0 && stat < FRAME_STAT_COUNT &&
+         "invalid arg stat: outside range");
+  return statNames[stat];
+}
+
+void ResetFrameStats() {
+  stats.historyCount = 0;
+  stats.historyNext = 0;
+  stats.lastFrameEnd = 0.0;
+}
+
+void SetFrameStatsLogInterval(double seconds) {
+  assert(seconds >= 0.0 && "invalid arg seconds: cannot be negative");
+  stats.logInterval = seconds;
+  stats.lastLog = GetTime();
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+
+// Frames kept for the rolling summaries
+#define FRAME_STATS_HISTORY 240
+
+// Frames between timing a frame on the GPU and reading the time back
+#define FRAME_STATS_GPU_FRAMES 4
+
+// Values measured every frame. Counters are added by the render path from
+// the thread owning the GL context, binds come from the GL state cache.
+// Multi draws of a GpuScene count as one draw call with the triangles and
+// vertices of every instance submitted, before GPU culling.
+typedef enum {
+  FRAME_STAT_DRAW_CALLS,
+  FRAME_STAT_TRIANGLES,
+  FRAME_STAT_VERTICES,
+  FRAME_STAT_PROGRAM_BINDS,
+  FRAME_STAT_VERTEX_ARRAY_BINDS,
+  FRAME_STAT_BUFFER_BINDS,
+  FRAME_STAT_TEXTURE_BINDS,
+  FRAME_STAT_UNIFORM_UPLOADS,
+  FRAME_STAT_CULLED_MESHES,
+  FRAME_STAT_UPLOADED_BYTES,
+  // Milliseconds from BeginFrame to EndFrame and between two EndFrame
+  FRAME_STAT_CPU_MS,
+  FRAME_STAT_FRAME_MS,
+  // Milliseconds the GPU spent between BeginFrame and EndFrame. Read back
+  // FRAME_STATS_GPU_FRAMES later, frames keep the latest time available
+  // and zero until the first one is.
+  FRAME_STAT_GPU_MS,
+  FRAME_STAT_COUNT,
+} FrameStat;
+
+// Every value of a single frame
+typedef struct {
+  double values[FRAME_STAT_COUNT];
+} FrameStats;
+
+// Rolling summary of a value over the last frames
+typedef struct {
+  double min;
+  double avg;
+  double max;
+  double p50;
+  double p95;
+  double p99;
+  size_t frames;
+} FrameStatSummary;
+
+// Add to a counter of the frame in progress.
+void FrameStatsAdd(FrameStat stat, double value);
+
+// Count a draw call of the given vertices and triangles.
+void FrameStatsAddDraw(size_t vertices, size_t triangles);
+
+// Start measuring a frame, called by BeginFrame.
+void FrameStatsBeginFrame();
+
+// Delete the GPU timer queries, called by AppClose.
+void DestroyFrameStats();
+
+// Finish the frame in progress and push it to the history, called by
+// EndFrame. Logs the summaries when the log interval elapsed.
+void FrameStatsEndFrame();
+
+// Return the values of the last finished frame.
+FrameStats GetFrameStats();
+
+// Return min, average, max and percentiles of a value over the history.
+FrameStatSummary GetFrameStatSummary(FrameStat stat);
+
+// Summarize any list of values, such as a whole benchmark run. Sorts the
+// values in place.
+FrameStatSummary MakeFrameStatSummary(double *values, size_t count);
+
+// Return a short name of a value, such as "draw calls".
+const char *GetFrameStatName(FrameStat stat);
+
+// Forget the history, for instance after warming up a benchmark.
+void ResetFrameStats();
+
+// Log the summaries every given seconds, zero (default) disables it.
+void SetFrameStatsLogInterval(double seconds);
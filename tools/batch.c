@@ -0,0 +1,681 @@
+// Batch thumbnail renderer: renders every glTF file of a list into an image
+// without a window. Three stages overlap:
+//   - worker threads parse and decode the next models (DecodeModel),
+//   - the main thread uploads and renders the current one,
+//   - previous frames are read back through a ring of pixel buffers guarded
+//     by fences, and only mapped once the GPU is done with them.
+// With -r soft models are drawn by the software rasterizer instead, which
+// needs no GL driver at all.
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <glad/glad.h>
+#include <xmath/scalar.h>
+
+#include "camera.h"
+#include "core.h"
+#include "glstate.h"
+#include "jobs.h"
+#include "model.h"
+#include "profile.h"
+#include "raster.h"
+#include "render.h"
+
+#define BATCH_DEFAULT_SIZE 256
+#define BATCH_DEFAULT_WORKERS 4
+#define BATCH_DEFAULT_OUTPUT "thumbnails"
+#define BATCH_MAX_WORKERS 64
+#define BATCH_MAX_PATH 4096
+
+// Decoded models waiting to be rendered, bounds the memory held by workers
+#define BATCH_MAX_DECODED 8
+
+// Frames in flight between glReadPixels and the file write
+#define BATCH_READBACK_FRAMES 3
+
+// Fraction of the view filled by the bounding sphere of a model
+#define BATCH_FILL 0.9f
+
+typedef enum {
+  IMAGE_FORMAT_PNG,
+  IMAGE_FORMAT_PPM,
+} ImageFormat;
+
+typedef struct {
+  const char *listPath;
+  const char *outputDir;
+  int size;
+  int workersCount;
+  ImageFormat format;
+  bool software;
+  const char *tracePath;
+} BatchOptions;
+
+typedef struct {
+  Model model;
+  bool ready;
+} DecodedSlot;
+
+// Files decoded by the workers, consumed in list order by the main thread
+typedef struct {
+  char **paths;
+  size_t pathsCount;
+  size_t nextPath;
+  size_t consumed;
+  DecodedSlot slots[BATCH_MAX_DECODED];
+  bool stopped;
+
+  pthread_mutex_t mutex;
+  pthread_cond_t decoded;
+  pthread_cond_t released;
+} DecodeQueue;
+
+typedef struct {
+  unsigned pbo;
+  GLsync fence;
+  size_t path;
+  bool pending;
+} Readback;
+
+static void *DecodeWorker(void *arg) {
+  DecodeQueue *queue = arg;
+  ProfileSetThreadName("decode");
+
+  // Workers already decode several files at once, a load pool for each one
+  // would only oversubscribe the processors
+  SetLoadJobPool(NULL);
+  pthread_mutex_lock(&queue->mutex);
+  while (queue->nextPath < queue->pathsCount && !queue->stopped) {
+    size_t index = queue->nextPath++;
+
+    // Wait until the slot of this file has been consumed
+    while (index >= queue->consumed + BATCH_MAX_DECODED && !queue->stopped) {
+      pthread_cond_wait(&queue->released, &queue->mutex);
+    }
+    if (queue->stopped) {
+      break;
+    }
+    pthread_mutex_unlock(&queue->mutex);
+
+    Model model = DecodeModel(queue->paths[index]);
+
+    pthread_mutex_lock(&queue->mutex);
+    DecodedSlot *slot = queue->slots + index % BATCH_MAX_DECODED;
+    slot->model = model;
+    slot->ready = true;
+    pthread_cond_broadcast(&queue->decoded);
+  }
+  pthread_mutex_unlock(&queue->mutex);
+  return NULL;
+}
+
+static Model TakeDecodedModel(DecodeQueue *queue) {
+  pthread_mutex_lock(&queue->mutex);
+  DecodedSlot *slot = queue->slots + queue->consumed % BATCH_MAX_DECODED;
+  while (!slot->ready) {
+    pthread_cond_wait(&queue->decoded, &queue->mutex);
+  }
+
+  Model model = slot->model;
+  slot->ready = false;
+  queue->consumed++;
+  pthread_cond_broadcast(&queue->released);
+  pthread_mutex_unlock(&queue->mutex);
+  return model;
+}
+
+// Stop the workers once their current file is decoded, wakes the ones waiting
+// for a slot. Models left in the slots are destroyed by DrainDecodeQueue.
+static void StopDecodeQueue(DecodeQueue *queue) {
+  pthread_mutex_lock(&queue->mutex);
+  queue->stopped = true;
+  pthread_cond_broadcast(&queue->released);
+  pthread_cond_broadcast(&queue->decoded);
+  pthread_mutex_unlock(&queue->mutex);
+}
+
+// Destroy the models decoded but never taken, once the workers are joined
+static void DrainDecodeQueue(DecodeQueue *queue) {
+  for (size_t i = 0; i < BATCH_MAX_DECODED; i++) {
+    if (queue->slots[i].ready) {
+      DestroyModel(queue->slots[i].model);
+      queue->slots[i].ready = false;
+    }
+  }
+}
+
+static char **LoadPathList(const char *listPath, size_t *count) {
+  FILE *file = strcmp(listPath, "-") == 0 ? stdin : fopen(listPath, "r");
+  if (file == NULL) {
+    Log(LOG_ERROR, "cannot open file list: %s", listPath);
+    return NULL;
+  }
+
+  char **paths = NULL;
+  size_t capacity = 0;
+  char line[BATCH_MAX_PATH];
+  *count = 0;
+  while (fgets(line, sizeof(line), file) != NULL) {
+    line[strcspn(line, "\r\n")] = '\0';
+    if (line[0] == '\0' || line[0] == '#') {
+      continue;
+    }
+
+    if (*count == capacity) {
+      capacity = capacity > 0 ? capacity * 2 : 256;
+      char **grown = realloc(paths, capacity * sizeof(char *));
+      if (grown == NULL) {
+        break;
+      }
+      paths = grown;
+    }
+
+    paths[*count] = strdup(line);
+    if (paths[*count] == NULL) {
+      break;
+    }
+    (*count)++;
+  }
+
+  if (file != stdin) {
+    fclose(file);
+  }
+  return paths;
+}
+
+static void FreePathList(char **paths, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    free(paths[i]);
+  }
+  free(paths);
+}
+
+// Build the output name from the file name of the model, without extension
+static void MakeOutputPath(char *out, size_t size, const BatchOptions *options,
+                           const char *modelPath) {
+  const char *name = strrchr(modelPath, '/');
+  name = name != NULL ? name + 1 : modelPath;
+
+  const char *ext = strrchr(name, '.');
+  int nameLen = ext != NULL ? (int)(ext - name) : (int)strlen(name);
+  snprintf(out, size, "%s/%.*s.%s", options->outputDir, nameLen, name,
+           options->format == IMAGE_FORMAT_PNG ? "png" : "ppm");
+}
+
+static uint32_t Crc32(uint32_t crc, const uint8_t *data, size_t size) {
+  static uint32_t table[256] = {0};
+  if (table[1] == 0) {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; k++) {
+        c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      }
+      table[i] = c;
+    }
+  }
+
+  crc = ~crc;
+  for (size_t i = 0; i < size; i++) {
+    crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+  }
+  return ~crc;
+}
+
+static void PutBE32(uint8_t *out, uint32_t v) {
+  out[0] = (uint8_t)(v >> 24);
+  out[1] = (uint8_t)(v >> 16);
+  out[2] = (uint8_t)(v >> 8);
+  out[3] = (uint8_t)v;
+}
+
+static void WritePngChunk(FILE *file, const char *type, const uint8_t *data,
+                          size_t size) {
+  uint8_t header[8];
+  PutBE32(header, (uint32_t)size);
+  memcpy(header + 4, type, 4);
+  fwrite(header, 1, 8, file);
+  if (size > 0) {
+    fwrite(data, 1, size, file);
+  }
+
+  uint8_t crc[4];
+  PutBE32(crc, Crc32(Crc32(0, (const uint8_t *)type, 4), data, size));
+  fwrite(crc, 1, 4, file);
+}
+
+// Write an RGB PNG using stored (uncompressed) deflate blocks, which keeps
+// the writer free of dependencies and cheap next to the rendering
+static bool WritePng(const char *path, const uint8_t *rgb, int w, int h) {
+  size_t rowSize = (size_t)w * 3 + 1;
+  size_t rawSize = rowSize * (size_t)h;
+  size_t blocks = (rawSize + 0xFFFE) / 0xFFFF;
+  size_t zSize = 2 + rawSize + blocks * 5 + 4;
+  uint8_t *z = malloc(zSize);
+  uint8_t *raw = malloc(rawSize);
+  if (z == NULL || raw == NULL) {
+    free(z);
+    free(raw);
+    return false;
+  }
+
+  for (int y = 0; y < h; y++) {
+    raw[y * rowSize] = 0; // no filter
+    memcpy(raw + y * rowSize + 1, rgb + (size_t)y * w * 3, (size_t)w * 3);
+  }
+
+  uint8_t *out = z;
+  *out++ = 0x78;
+  *out++ = 0x01;
+  uint32_t a = 1;
+  uint32_t b = 0;
+  for (size_t offset = 0; offset < rawSize; offset += 0xFFFF) {
+    size_t len = rawSize - offset < 0xFFFF ? rawSize - offset : 0xFFFF;
+    *out++ = offset + len == rawSize ? 1 : 0;
+    *out++ = (uint8_t)len;
+    *out++ = (uint8_t)(len >> 8);
+    *out++ = (uint8_t)~len;
+    *out++ = (uint8_t)(~len >> 8);
+    memcpy(out, raw + offset, len);
+    out += len;
+
+    for (size_t i = 0; i < len; i++) {
+      a = (a + raw[offset + i]) % 65521;
+      b = (b + a) % 65521;
+    }
+  }
+  PutBE32(out, (b << 16) | a);
+  free(raw);
+
+  FILE *file = fopen(path, "wb");
+  if (file == NULL) {
+    free(z);
+    return false;
+  }
+
+  static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n',
+                                       0x1A, '\n'};
+  fwrite(signature, 1, sizeof(signature), file);
+
+  uint8_t ihdr[13] = {0};
+  PutBE32(ihdr, (uint32_t)w);
+  PutBE32(ihdr + 4, (uint32_t)h);
+  ihdr[8] = 8; // bit depth
+  ihdr[9] = 2; // truecolor
+  WritePngChunk(file, "IHDR", ihdr, sizeof(ihdr));
+  WritePngChunk(file, "IDAT", z, zSize);
+  WritePngChunk(file, "IEND", NULL, 0);
+  free(z);
+  return fclose(file) == 0;
+}
+
+static bool WritePpm(const char *path, const uint8_t *rgb, int w, int h) {
+  FILE *file = fopen(path, "wb");
+  if (file == NULL) {
+    return false;
+  }
+
+  fprintf(file, "P6\n%d %d\n255\n", w, h);
+  fwrite(rgb, 3, (size_t)w * h, file);
+  return fclose(file) == 0;
+}
+
+static bool WriteImage(const BatchOptions *options, const char *modelPath,
+                       const uint8_t *rgb) {
+  PROFILE_ZONE("WriteImage");
+  char outPath[BATCH_MAX_PATH];
+  MakeOutputPath(outPath, sizeof(outPath), options, modelPath);
+  bool written = options->format == IMAGE_FORMAT_PNG
+                     ? WritePng(outPath, rgb, options->size, options->size)
+                     : WritePpm(outPath, rgb, options->size, options->size);
+  if (!written) {
+    Log(LOG_ERROR, "cannot write image: %s", outPath);
+  }
+  return written;
+}
+
+// Map a finished readback and write it as an image, rows are flipped since
+// GL returns them bottom up
+static bool FinishReadback(Readback *readback, const BatchOptions *options,
+                           char **paths, uint8_t *rgb) {
+  glClientWaitSync(readback->fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                   GL_TIMEOUT_IGNORED);
+  glDeleteSync(readback->fence);
+  readback->fence = NULL;
+  readback->pending = false;
+
+  int size = options->size;
+  size_t rowSize = (size_t)size * 3;
+  GLStateBindBuffer(GL_PIXEL_PACK_BUFFER, readback->pbo);
+  const uint8_t *pixels = glMapBufferRange(
+      GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)(rowSize * size), GL_MAP_READ_BIT);
+  if (pixels == NULL) {
+    Log(LOG_ERROR, "cannot map readback buffer");
+    return false;
+  }
+
+  for (int y = 0; y < size; y++) {
+    memcpy(rgb + (size_t)y * rowSize, pixels + (size_t)(size - 1 - y) * rowSize,
+           rowSize);
+  }
+  glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  return WriteImage(options, paths[readback->path], rgb);
+}
+
+// Center a model at the origin and scale it so that its bounding sphere fits
+// the view of the camera
+static void FrameModel(Model *model, Camera camera) {
+  Vec3 center = Vec3Scale(Vec3Add(model->boundsMin, model->boundsMax), 0.5f);
+  float radius =
+      Vec3Len(Vec3Sub(model->boundsMax, model->boundsMin)) * 0.5f;
+  float distance = Vec3Len(camera.transform.origin);
+  float fit = distance * sinf(camera.fov * DEG2RAD * 0.5f) * BATCH_FILL;
+  float scale = radius > 0.0f ? fit / radius : 1.0f;
+
+  model->transform = MakeTransform();
+  model->transform.scale = Vec3Scale(Vec3One, scale);
+  model->transform.origin = Vec3Scale(center, -scale);
+}
+
+static void PrintUsage(const char *program) {
+  fprintf(stderr,
+          "usage: %s [-o dir] [-s size] [-j workers] [-f png|ppm] "
+          "[-r gl|soft] [-t trace.json] <list>\n"
+          "  list      text file with one glTF path per line, - for stdin\n"
+          "  -o dir    output directory (default: %s)\n"
+          "  -s size   width and height of the images (default: %d)\n"
+          "  -j n      decode worker threads (default: %d)\n"
+          "  -f fmt    image format, png or ppm (default: png)\n"
+          "  -r name   renderer, gl or soft (default: gl)\n"
+          "  -t path   write a Chrome trace of the run when done\n",
+          program, BATCH_DEFAULT_OUTPUT, BATCH_DEFAULT_SIZE,
+          BATCH_DEFAULT_WORKERS);
+}
+
+static bool ParseOptions(int argc, char **argv, BatchOptions *options) {
+  options->outputDir = BATCH_DEFAULT_OUTPUT;
+  options->size = BATCH_DEFAULT_SIZE;
+  options->workersCount = BATCH_DEFAULT_WORKERS;
+  options->format = IMAGE_FORMAT_PNG;
+
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (strcmp(arg, "-o") == 0 && hasValue) {
+      options->outputDir = argv[++i];
+    } else if (strcmp(arg, "-s") == 0 && hasValue) {
+      options->size = atoi(argv[++i]);
+    } else if (strcmp(arg, "-j") == 0 && hasValue) {
+      options->workersCount = atoi(argv[++i]);
+    } else if (strcmp(arg, "-f") == 0 && hasValue) {
+      const char *format = argv[++i];
+      if (strcmp(format, "png") == 0) {
+        options->format = IMAGE_FORMAT_PNG;
+      } else if (strcmp(format, "ppm") == 0) {
+        options->format = IMAGE_FORMAT_PPM;
+      } else {
+        return false;
+      }
+    } else if (strcmp(arg, "-r") == 0 && hasValue) {
+      const char *renderer = argv[++i];
+      if (strcmp(renderer, "gl") == 0) {
+        options->software = false;
+      } else if (strcmp(renderer, "soft") == 0) {
+        options->software = true;
+      } else {
+        return false;
+      }
+    } else if (strcmp(arg, "-t") == 0 && hasValue) {
+      options->tracePath = argv[++i];
+    } else if (arg[0] == '-' && arg[1] != '\0') {
+      return false;
+    } else {
+      options->listPath = arg;
+    }
+  }
+
+  return options->listPath != NULL && options->size > 0 &&
+         options->workersCount > 0 &&
+         options->workersCount <= BATCH_MAX_WORKERS;
+}
+
+// Images written and models that could not be decoded or uploaded, elapsed
+// time only counts the rendering loop
+typedef struct {
+  size_t written;
+  size_t failed;
+  double elapsed;
+} BatchResult;
+
+// Render every decoded model with GL, returns false when the renderer cannot
+// be created. The headless context is released by AppClose either way.
+static bool RenderGL(DecodeQueue *queue, const BatchOptions *options,
+                     uint8_t *rgb, BatchResult *result) {
+  StatusCode status = AppInitHeadless(options->size, options->size);
+  if (status != SUCCESS) {
+    return false;
+  }
+
+  Shader shader = LoadShader("assets/def_vs.glsl", "assets/def_fs.glsl");
+  if (shader.status != SUCCESS) {
+    return false;
+  }
+
+  RenderQueue renderQueue = MakeRenderQueue(64);
+  if (renderQueue.status != SUCCESS) {
+    DestroyRenderQueue(renderQueue);
+    DestroyShader(shader);
+    return false;
+  }
+
+  size_t imageSize = (size_t)options->size * options->size * 3;
+  Readback readbacks[BATCH_READBACK_FRAMES] = {0};
+  for (int i = 0; i < BATCH_READBACK_FRAMES; i++) {
+    glGenBuffers(1, &readbacks[i].pbo);
+    GLStateBindBuffer(GL_PIXEL_PACK_BUFFER, readbacks[i].pbo);
+    glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)imageSize, NULL,
+                 GL_STREAM_READ);
+  }
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+  Camera camera = MakeDefaultCamera();
+  double startTime = GetTime();
+  size_t rendered = 0;
+  for (size_t i = 0; i < queue->pathsCount; i++) {
+    Model model = TakeDecodedModel(queue);
+    if (model.status != SUCCESS || UploadModel(&model) != SUCCESS) {
+      DestroyModel(model);
+      result->failed++;
+      continue;
+    }
+
+    // Reuse the oldest readback, it was issued frames ago so the wait is
+    // usually already satisfied
+    Readback *readback = readbacks + rendered % BATCH_READBACK_FRAMES;
+    if (readback->pending) {
+      result->written += FinishReadback(readback, options, queue->paths, rgb);
+    }
+
+    BeginFrame();
+    {
+      UpdateCamera(&camera);
+      FrameModel(&model, camera);
+      model.shader = shader;
+
+      RenderQueueBegin(&renderQueue, camera);
+      RenderQueueSubmit(&renderQueue, &model, RENDER_PASS_OPAQUE);
+      RenderQueueFlush(&renderQueue);
+
+      // Copy into the pixel buffer asynchronously and fence it
+      GLStateBindBuffer(GL_PIXEL_PACK_BUFFER, readback->pbo);
+      glReadPixels(0, 0, options->size, options->size, GL_RGB,
+                   GL_UNSIGNED_BYTE, 0);
+      readback->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+      readback->path = i;
+      readback->pending = true;
+    }
+    EndFrame();
+
+    // GL keeps the buffers alive until the queued draws are done
+    DestroyModel(model);
+    rendered++;
+  }
+
+  // Drain the readbacks still in flight, oldest first
+  for (size_t i = 0; i < BATCH_READBACK_FRAMES; i++) {
+    Readback *readback = readbacks + (rendered + i) % BATCH_READBACK_FRAMES;
+    if (readback->pending) {
+      result->written += FinishReadback(readback, options, queue->paths, rgb);
+    }
+  }
+
+  result->elapsed = GetTime() - startTime;
+
+  for (int i = 0; i < BATCH_READBACK_FRAMES; i++) {
+    GLStateDeleteBuffer(readbacks[i].pbo);
+  }
+  DestroyRenderQueue(renderQueue);
+  DestroyCameraUniforms();
+  DestroyShader(shader);
+  return true;
+}
+
+// Render every decoded model with the software rasterizer
+static bool RenderSoftware(DecodeQueue *queue, const BatchOptions *options,
+                           uint8_t *rgb, BatchResult *result) {
+  JobPool *pool = MakeJobPool(GetProcessorsCount() - 1);
+  Raster raster = MakeRaster(options->size, options->size, pool);
+  if (pool == NULL || raster.status != SUCCESS) {
+    DestroyRaster(raster);
+    DestroyJobPool(pool);
+    return false;
+  }
+
+  Camera camera = MakeDefaultCamera();
+  camera.width = (float)options->size;
+  camera.height = (float)options->size;
+  camera.aspect = 1.0f;
+
+  // Every model is seen from the same camera, make its matrices only once
+  CameraGetViewProjMatrix(&camera);
+
+  double startTime = GetTime();
+  size_t pixels = (size_t)options->size * options->size;
+  for (size_t i = 0; i < queue->pathsCount; i++) {
+    Model model = TakeDecodedModel(queue);
+    if (model.status != SUCCESS) {
+      DestroyModel(model);
+      result->failed++;
+      continue;
+    }
+
+    // Same clear color and vertex colors as the shader of the GL renderer
+    FrameModel(&model, camera);
+    model.shader.variant = SHADER_VARIANT_VERTEX_COLORS;
+    RasterClear(&raster, (Vec4){0.2f, 0.3f, 0.3f, 1.0f});
+    RasterBegin(&raster, camera);
+    RasterSubmit(&raster, &model);
+    RasterFlush(&raster);
+    DestroyModel(model);
+
+    for (size_t p = 0; p < pixels; p++) {
+      uint32_t color = raster.color[p];
+      rgb[p * 3 + 0] = (uint8_t)color;
+      rgb[p * 3 + 1] = (uint8_t)(color >> 8);
+      rgb[p * 3 + 2] = (uint8_t)(color >> 16);
+    }
+    result->written += WriteImage(options, queue->paths[i], rgb);
+  }
+  result->elapsed = GetTime() - startTime;
+
+  DestroyRaster(raster);
+  DestroyJobPool(pool);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  BatchOptions options = {0};
+  if (!ParseOptions(argc, argv, &options)) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+  ProfileSetTracePath(options.tracePath);
+
+  DecodeQueue queue = {0};
+  queue.paths = LoadPathList(options.listPath, &queue.pathsCount);
+  if (queue.pathsCount == 0) {
+    Log(LOG_ERROR, "no files to render in list: %s", options.listPath);
+    FreePathList(queue.paths, queue.pathsCount);
+    return 1;
+  }
+
+  if (mkdir(options.outputDir, 0755) != 0 && errno != EEXIST) {
+    Log(LOG_ERROR, "cannot create output directory: %s", options.outputDir);
+    FreePathList(queue.paths, queue.pathsCount);
+    return 1;
+  }
+
+  uint8_t *rgb = malloc((size_t)options.size * options.size * 3);
+  if (rgb == NULL) {
+    FreePathList(queue.paths, queue.pathsCount);
+    return AppClose(E_OUT_OF_MEMORY);
+  }
+
+  // Start decoding while the renderer is created
+  pthread_mutex_init(&queue.mutex, NULL);
+  pthread_cond_init(&queue.decoded, NULL);
+  pthread_cond_init(&queue.released, NULL);
+
+  pthread_t workers[BATCH_MAX_WORKERS];
+  int workersCount = 0;
+  for (int i = 0; i < options.workersCount; i++) {
+    if (pthread_create(&workers[i], NULL, DecodeWorker, &queue) != 0) {
+      break;
+    }
+    workersCount++;
+  }
+
+  if (workersCount == 0) {
+    Log(LOG_ERROR, "cannot start decode workers");
+    free(rgb);
+    FreePathList(queue.paths, queue.pathsCount);
+    return AppClose(E_OUT_OF_MEMORY);
+  }
+
+  BatchResult result = {0};
+  bool started = options.software
+                     ? RenderSoftware(&queue, &options, rgb, &result)
+                     : RenderGL(&queue, &options, rgb, &result);
+
+  // The renderer could not start, release the workers waiting for slots and
+  // the models they already decoded
+  if (!started) {
+    Log(LOG_ERROR, "cannot start renderer");
+    StopDecodeQueue(&queue);
+  } else {
+    Log(LOG_INFO,
+        "%zu files, %zu written, %zu failed in %.2f s (%.1f files/s)",
+        queue.pathsCount, result.written, result.failed, result.elapsed,
+        result.elapsed > 0.0 ? (double)result.written / result.elapsed
+                             : 0.0);
+  }
+
+  for (int i = 0; i < workersCount; i++) {
+    pthread_join(workers[i], NULL);
+  }
+  DrainDecodeQueue(&queue);
+  pthread_cond_destroy(&queue.released);
+  pthread_cond_destroy(&queue.decoded);
+  pthread_mutex_destroy(&queue.mutex);
+
+  free(rgb);
+  FreePathList(queue.paths, queue.pathsCount);
+  if (!started) {
+    return AppClose(E_CANNOT_LOAD_GL);
+  }
+  return AppClose(result.failed == 0 ? SUCCESS : E_CANNOT_LOAD_FILE);
+}
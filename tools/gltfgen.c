@@ -0,0 +1,996 @@
+// Procedural glTF generator for scaling tests: writes a scene of jittered
+// ellipsoids with the requested meshes, vertices, attributes, index width,
+// node hierarchy, instancing and animations. The same seed and options
+// always produce the same bytes, and each mesh only depends on the seed and
+// its index, so sweeps can grow a scene without changing the meshes already
+// in it.
+//
+// The JSON is built first from the layout, which is the same for every
+// mesh, then the binary data is streamed one mesh at a time. Memory stays
+// bounded by a single mesh and outputs can reach gigabytes (.glb files are
+// limited to 4 GB by their 32 bit chunk lengths, use .gltf beyond that).
+// Embedded buffers go through a temporary file and are streamed as base64
+// into the data: URI of the buffer.
+#include <math.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define GEN_DEFAULT_MESHES 16
+#define GEN_DEFAULT_VERTICES 1024
+#define GEN_DEFAULT_INSTANCES 1
+#define GEN_DEFAULT_DEPTH 2
+#define GEN_DEFAULT_BRANCHING 4
+#define GEN_DEFAULT_KEYFRAMES 30
+#define GEN_DEFAULT_INDEX_BITS 16
+#define GEN_DEFAULT_SEED 1
+#define GEN_MAX_PATH 4096
+
+// Keyframes per second of the animations
+#define GEN_ANIMATION_FPS 30.0f
+
+// Distance between the centers of two instances, meshes fit a unit sphere
+#define GEN_SPACING 3.0f
+
+// glTF enums used by the generator
+#define GLTF_UNSIGNED_BYTE 5121
+#define GLTF_UNSIGNED_SHORT 5123
+#define GLTF_UNSIGNED_INT 5125
+#define GLTF_FLOAT 5126
+#define GLTF_ARRAY_BUFFER 34962
+#define GLTF_ELEMENT_ARRAY_BUFFER 34963
+
+#define GLB_MAGIC 0x46546C67u
+#define GLB_CHUNK_JSON 0x4E4F534Au
+#define GLB_CHUNK_BIN 0x004E4942u
+
+// Prefix of embedded buffers, their base64 data follows it
+#define GEN_DATA_URI "data:application/octet-stream;base64,"
+
+// Closing of the JSON after the uri of the buffer
+#define GEN_JSON_END "\"}]}"
+
+// Input bytes encoded at a time, a multiple of 3 so only the end is padded
+#define GEN_BASE64_CHUNK (3 * 4096)
+
+typedef enum {
+  ATTRIBUTE_POSITION,
+  ATTRIBUTE_NORMAL,
+  ATTRIBUTE_TEXCOORD,
+  ATTRIBUTE_COLOR,
+  ATTRIBUTE_TANGENT,
+  ATTRIBUTE_COUNT,
+} Attribute;
+
+typedef struct {
+  const char *option;
+  const char *semantic;
+  const char *type;
+  size_t components;
+} AttributeInfo;
+
+static const AttributeInfo attributeInfos[ATTRIBUTE_COUNT] = {
+    [ATTRIBUTE_POSITION] = {"pos", "POSITION", "VEC3", 3},
+    [ATTRIBUTE_NORMAL] = {"nor", "NORMAL", "VEC3", 3},
+    [ATTRIBUTE_TEXCOORD] = {"uv", "TEXCOORD_0", "VEC2", 2},
+    [ATTRIBUTE_COLOR] = {"col", "COLOR_0", "VEC4", 4},
+    [ATTRIBUTE_TANGENT] = {"tan", "TANGENT", "VEC4", 4},
+};
+
+typedef struct {
+  const char *outputPath;
+  size_t meshes;
+  size_t vertices;
+  size_t instances;
+  size_t depth;
+  size_t branching;
+  size_t animations;
+  size_t keyframes;
+  bool attributes[ATTRIBUTE_COUNT];
+  int indexBits;
+  uint64_t seed;
+  bool embed;
+} GenOptions;
+
+// Sizes and counts derived from the options. Every mesh has the same layout
+// so offsets are computed instead of stored.
+typedef struct {
+  size_t rows;
+  size_t cols;
+  size_t vertices;
+  size_t indices;
+  size_t indexSize;
+  size_t attributeBytes[ATTRIBUTE_COUNT];
+  size_t indexBytes;
+  size_t meshBytes;
+  size_t meshAccessors;
+
+  size_t leaves;
+  size_t groups;
+  size_t bottomGroups;
+  size_t firstBottomGroup;
+  size_t targets;
+
+  size_t timeBytes;
+  size_t rotationBytes;
+  size_t animationsOffset;
+  size_t binBytes;
+} GenLayout;
+
+typedef struct {
+  char *data;
+  size_t length;
+  size_t capacity;
+  bool failed;
+} StrBuf;
+
+static uint64_t SplitMix64(uint64_t *state) {
+  uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  return z ^ (z >> 31);
+}
+
+// Uniform float in [min, max)
+static float RandomRange(uint64_t *state, float min, float max) {
+  float unit = (float)(SplitMix64(state) >> 40) * (1.0f / 16777216.0f);
+  return min + (max - min) * unit;
+}
+
+// Independent stream for an item, so it does not depend on the items
+// generated before it
+static uint64_t MakeStream(uint64_t seed, uint64_t kind, uint64_t index) {
+  uint64_t state = seed ^ (kind * 0xD6E8FEB86659FD93ull);
+  state ^= SplitMix64(&state) + index;
+  SplitMix64(&state);
+  return state;
+}
+
+static void Append(StrBuf *buf, const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  int needed = vsnprintf(NULL, 0, format, args);
+  va_end(args);
+  if (needed < 0 || buf->failed) {
+    buf->failed = true;
+    return;
+  }
+
+  if (buf->length + (size_t)needed + 1 > buf->capacity) {
+    size_t capacity = buf->capacity > 0 ? buf->capacity * 2 : 4096;
+    while (capacity < buf->length + (size_t)needed + 1) {
+      capacity *= 2;
+    }
+
+    char *data = realloc(buf->data, capacity);
+    if (data == NULL) {
+      buf->failed = true;
+      return;
+    }
+    buf->data = data;
+    buf->capacity = capacity;
+  }
+
+  va_start(args, format);
+  vsnprintf(buf->data + buf->length, buf->capacity - buf->length, format,
+            args);
+  va_end(args);
+  buf->length += (size_t)needed;
+}
+
+static size_t Align4(size_t size) { return (size + 3) & ~(size_t)3; }
+
+static bool ComputeLayout(const GenOptions *options, GenLayout *layout) {
+  memset(layout, 0, sizeof(GenLayout));
+
+  // A grid of rows by columns over the ellipsoid, the seam column repeats
+  // the first one so texture coordinates wrap cleanly
+  size_t cols = (size_t)ceil(sqrt((double)options->vertices));
+  cols = cols < 3 ? 3 : cols;
+  size_t rows = (options->vertices + cols - 1) / cols;
+  rows = rows < 2 ? 2 : rows;
+  layout->rows = rows;
+  layout->cols = cols;
+  layout->vertices = rows * cols;
+  layout->indices = (rows - 1) * (cols - 1) * 6;
+  layout->indexSize = (size_t)options->indexBits / 8;
+
+  // The largest value of an index type is reserved for primitive restart
+  uint64_t maxIndex = (1ull << options->indexBits) - 1;
+  if (layout->vertices - 1 >= maxIndex) {
+    fprintf(stderr, "error: %zu vertices do not fit %d bit indices\n",
+            layout->vertices, options->indexBits);
+    return false;
+  }
+
+  for (int a = 0; a < ATTRIBUTE_COUNT; a++) {
+    if (options->attributes[a]) {
+      layout->attributeBytes[a] =
+          layout->vertices * attributeInfos[a].components * sizeof(float);
+      layout->meshBytes += layout->attributeBytes[a];
+      layout->meshAccessors++;
+    }
+  }
+  layout->indexBytes = Align4(layout->indices * layout->indexSize);
+  layout->meshBytes += layout->indexBytes;
+  layout->meshAccessors++;
+
+  // Groups form a full tree, leaves hang from its bottom level which needs
+  // at least one per group
+  layout->leaves = options->meshes * options->instances;
+  size_t levelGroups = 1;
+  for (size_t level = 0; level < options->depth; level++) {
+    levelGroups *= options->branching;
+    layout->groups += levelGroups;
+    if (levelGroups > layout->leaves) {
+      fprintf(stderr, "error: %zu levels of %zu groups exceed the %zu "
+                      "instances\n",
+              options->depth, options->branching, layout->leaves);
+      return false;
+    }
+  }
+  layout->bottomGroups = options->depth > 0 ? levelGroups : 0;
+  layout->firstBottomGroup = layout->groups - layout->bottomGroups;
+
+  // Groups are animated when there are any, instances otherwise
+  layout->targets = layout->groups > 0 ? layout->groups : layout->leaves;
+  if (options->animations > layout->targets) {
+    fprintf(stderr, "error: %zu animations need as many animated nodes, "
+                    "there are %zu\n",
+            options->animations, layout->targets);
+    return false;
+  }
+
+  layout->timeBytes = options->keyframes * sizeof(float);
+  layout->rotationBytes = options->keyframes * 4 * sizeof(float);
+  layout->animationsOffset = options->meshes * layout->meshBytes;
+  layout->binBytes = layout->animationsOffset;
+  if (options->animations > 0) {
+    layout->binBytes += options->animations * layout->timeBytes +
+                        layout->targets * layout->rotationBytes;
+  }
+  return true;
+}
+
+// Scratch arrays of a single mesh, NULL for attributes not generated
+typedef struct {
+  float *attributes[ATTRIBUTE_COUNT];
+  void *indices;
+  float boundsMin[3];
+  float boundsMax[3];
+} MeshData;
+
+// Generate mesh m. Random numbers are drawn in the same order whatever
+// attributes are requested, so the bounds pass matches the real one.
+static void GenerateMesh(const GenOptions *options, const GenLayout *layout,
+                         size_t m, MeshData *mesh) {
+  uint64_t rng = MakeStream(options->seed, 1, m);
+  float axes[3] = {RandomRange(&rng, 0.5f, 1.0f),
+                   RandomRange(&rng, 0.5f, 1.0f),
+                   RandomRange(&rng, 0.5f, 1.0f)};
+  float jitter = RandomRange(&rng, 0.0f, 0.1f);
+  float color[4] = {RandomRange(&rng, 0.2f, 1.0f),
+                    RandomRange(&rng, 0.2f, 1.0f),
+                    RandomRange(&rng, 0.2f, 1.0f), 1.0f};
+
+  for (int i = 0; i < 3; i++) {
+    mesh->boundsMin[i] = INFINITY;
+    mesh->boundsMax[i] = -INFINITY;
+  }
+
+  const float pi = 3.14159265358979f;
+  float *pos = mesh->attributes[ATTRIBUTE_POSITION];
+  float *nor = mesh->attributes[ATTRIBUTE_NORMAL];
+  float *uvs = mesh->attributes[ATTRIBUTE_TEXCOORD];
+  float *col = mesh->attributes[ATTRIBUTE_COLOR];
+  float *tan = mesh->attributes[ATTRIBUTE_TANGENT];
+  for (size_t r = 0; r < layout->rows; r++) {
+    float v = (float)r / (float)(layout->rows - 1);
+    float sinLat = sinf(v * pi);
+    float cosLat = cosf(v * pi);
+    float seamOffset = 0.0f;
+    for (size_t c = 0; c < layout->cols; c++) {
+      size_t i = r * layout->cols + c;
+      float u = (float)c / (float)(layout->cols - 1);
+      float sinLon = sinf(u * 2.0f * pi);
+      float cosLon = cosf(u * 2.0f * pi);
+      float unit[3] = {sinLat * cosLon, cosLat, sinLat * sinLon};
+
+      // Normal of the ellipsoid, displaced along it by the jitter. Poles are
+      // not displaced so the vertices of the seam and poles stay together.
+      float n[3] = {unit[0] / axes[0], unit[1] / axes[1], unit[2] / axes[2]};
+      float nLength = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+      float offset = jitter * sinLat * RandomRange(&rng, -1.0f, 1.0f);
+      if (c == 0) {
+        seamOffset = offset;
+      } else if (c + 1 == layout->cols) {
+        offset = seamOffset;
+      }
+      for (int k = 0; k < 3; k++) {
+        n[k] /= nLength;
+        float p = unit[k] * axes[k] + n[k] * offset;
+        mesh->boundsMin[k] = fminf(mesh->boundsMin[k], p);
+        mesh->boundsMax[k] = fmaxf(mesh->boundsMax[k], p);
+        if (pos != NULL) {
+          pos[i * 3 + k] = p;
+        }
+        if (nor != NULL) {
+          nor[i * 3 + k] = n[k];
+        }
+      }
+
+      if (uvs != NULL) {
+        uvs[i * 2 + 0] = u;
+        uvs[i * 2 + 1] = v;
+      }
+
+      if (col != NULL) {
+        memcpy(col + i * 4, color, sizeof(color));
+      }
+
+      // Along the parallels, perpendicular to the normal even at the poles
+      if (tan != NULL) {
+        float t[3] = {-sinLon * axes[0], 0.0f, cosLon * axes[2]};
+        float tLength = sqrtf(t[0] * t[0] + t[2] * t[2]);
+        tan[i * 4 + 0] = t[0] / tLength;
+        tan[i * 4 + 1] = 0.0f;
+        tan[i * 4 + 2] = t[2] / tLength;
+        tan[i * 4 + 3] = 1.0f;
+      }
+    }
+  }
+
+  if (mesh->indices == NULL) {
+    return;
+  }
+
+  // Two counter clockwise triangles per quad seen from outside
+  size_t n = 0;
+  for (size_t r = 0; r + 1 < layout->rows; r++) {
+    for (size_t c = 0; c + 1 < layout->cols; c++) {
+      uint32_t a = (uint32_t)(r * layout->cols + c);
+      uint32_t b = a + 1;
+      uint32_t d = a + (uint32_t)layout->cols;
+      uint32_t e = d + 1;
+      uint32_t quad[6] = {a, b, d, b, e, d};
+      for (int k = 0; k < 6; k++, n++) {
+        if (layout->indexSize == 1) {
+          ((uint8_t *)mesh->indices)[n] = (uint8_t)quad[k];
+        } else if (layout->indexSize == 2) {
+          ((uint16_t *)mesh->indices)[n] = (uint16_t)quad[k];
+        } else {
+          ((uint32_t *)mesh->indices)[n] = quad[k];
+        }
+      }
+    }
+  }
+}
+
+// Parent of group g, or SIZE_MAX for the groups of the first level
+static size_t GetGroupParent(const GenOptions *options, size_t g) {
+  return g < options->branching ? SIZE_MAX
+                                : (g - options->branching) / options->branching;
+}
+
+// Local translations of the nodes: groups get a small random offset and
+// instances are laid on a cube grid in world space, relative to their group
+static void ComputeTranslations(const GenOptions *options,
+                                const GenLayout *layout, float *groupWorld,
+                                float *leafLocal) {
+  uint64_t rng = MakeStream(options->seed, 2, 0);
+  for (size_t g = 0; g < layout->groups; g++) {
+    size_t parent = GetGroupParent(options, g);
+    for (int k = 0; k < 3; k++) {
+      float base = parent == SIZE_MAX ? 0.0f : groupWorld[parent * 3 + k];
+      groupWorld[g * 3 + k] = base + RandomRange(&rng, -1.0f, 1.0f);
+    }
+  }
+
+  size_t side = (size_t)ceil(cbrt((double)layout->leaves));
+  while (side * side * side < layout->leaves) {
+    side++;
+  }
+
+  float half = (float)(side - 1) * GEN_SPACING * 0.5f;
+  for (size_t l = 0; l < layout->leaves; l++) {
+    float world[3] = {(float)(l % side) * GEN_SPACING - half,
+                      (float)(l / side % side) * GEN_SPACING - half,
+                      (float)(l / (side * side)) * GEN_SPACING - half};
+    for (int k = 0; k < 3; k++) {
+      float base = 0.0f;
+      if (layout->bottomGroups > 0) {
+        size_t g = layout->firstBottomGroup + l % layout->bottomGroups;
+        base = groupWorld[g * 3 + k];
+      }
+      leafLocal[l * 3 + k] = world[k] - base;
+    }
+  }
+}
+
+// Byte offset of the rotations of animated node t, grouped by animation
+static size_t GetRotationOffset(const GenOptions *options,
+                                const GenLayout *layout, size_t t) {
+  size_t a = t % options->animations;
+  size_t before = 0;
+  for (size_t i = 0; i < a; i++) {
+    before += (layout->targets - i + options->animations - 1) /
+              options->animations;
+  }
+  return layout->animationsOffset + options->animations * layout->timeBytes +
+         (before + t / options->animations) * layout->rotationBytes;
+}
+
+static void AppendFloats(StrBuf *json, const float *values, size_t count) {
+  Append(json, "[");
+  for (size_t i = 0; i < count; i++) {
+    Append(json, "%s%.9g", i > 0 ? "," : "", values[i]);
+  }
+  Append(json, "]");
+}
+
+static void AppendBufferView(StrBuf *json, bool *first, size_t offset,
+                             size_t length, int target) {
+  Append(json, "%s{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu",
+         *first ? "" : ",", offset, length);
+  if (target != 0) {
+    Append(json, ",\"target\":%d", target);
+  }
+  Append(json, "}");
+  *first = false;
+}
+
+static void BuildJson(const GenOptions *options, const GenLayout *layout,
+                      const MeshData *bounds, const char *binUri,
+                      StrBuf *json) {
+  Append(json, "{\"asset\":{\"version\":\"2.0\",\"generator\":\"SimpleGLTF "
+               "gltfgen\",\"extras\":{\"seed\":%llu,\"meshes\":%zu,"
+               "\"vertices\":%zu,\"instances\":%zu,\"depth\":%zu,"
+               "\"branching\":%zu,\"animations\":%zu,\"keyframes\":%zu,"
+               "\"indexBits\":%d}},",
+         (unsigned long long)options->seed, options->meshes,
+         options->vertices, options->instances, options->depth,
+         options->branching, options->animations, options->keyframes,
+         options->indexBits);
+
+  // Scene roots are the first level of groups, or every instance
+  size_t roots = layout->groups > 0 ? options->branching : layout->leaves;
+  Append(json, "\"scene\":0,\"scenes\":[{\"nodes\":[");
+  for (size_t i = 0; i < roots; i++) {
+    Append(json, "%s%zu", i > 0 ? "," : "", i);
+  }
+  Append(json, "]}],");
+
+  // Nodes: groups first, then one instance per leaf
+  float *groupWorld = malloc((layout->groups + 1) * 3 * sizeof(float));
+  float *leafLocal = malloc(layout->leaves * 3 * sizeof(float));
+  if (groupWorld == NULL || leafLocal == NULL) {
+    free(groupWorld);
+    free(leafLocal);
+    json->failed = true;
+    return;
+  }
+  ComputeTranslations(options, layout, groupWorld, leafLocal);
+
+  Append(json, "\"nodes\":[");
+  for (size_t g = 0; g < layout->groups; g++) {
+    size_t parent = GetGroupParent(options, g);
+    float local[3];
+    for (int k = 0; k < 3; k++) {
+      float base = parent == SIZE_MAX ? 0.0f : groupWorld[parent * 3 + k];
+      local[k] = groupWorld[g * 3 + k] - base;
+    }
+    Append(json, "%s{\"name\":\"group%zu\",\"translation\":", g > 0 ? "," : "",
+           g);
+    AppendFloats(json, local, 3);
+    Append(json, ",\"children\":[");
+    if (g >= layout->firstBottomGroup) {
+      size_t first = g - layout->firstBottomGroup;
+      for (size_t l = first; l < layout->leaves; l += layout->bottomGroups) {
+        Append(json, "%s%zu", l > first ? "," : "", layout->groups + l);
+      }
+    } else {
+      for (size_t c = 0; c < options->branching; c++) {
+        Append(json, "%s%zu", c > 0 ? "," : "",
+               (g + 1) * options->branching + c);
+      }
+    }
+    Append(json, "]}");
+  }
+
+  uint64_t rng = MakeStream(options->seed, 3, 0);
+  for (size_t l = 0; l < layout->leaves; l++) {
+    float scale = RandomRange(&rng, 0.5f, 1.0f);
+    float scales[3] = {scale, scale, scale};
+    Append(json, "%s{\"name\":\"instance%zu\",\"mesh\":%zu,\"translation\":",
+           layout->groups + l > 0 ? "," : "", l, l % options->meshes);
+    AppendFloats(json, leafLocal + l * 3, 3);
+    Append(json, ",\"scale\":");
+    AppendFloats(json, scales, 3);
+    Append(json, "}");
+  }
+  Append(json, "],");
+  free(groupWorld);
+  free(leafLocal);
+
+  // Meshes, with their accessors numbered meshAccessors apiece
+  Append(json, "\"meshes\":[");
+  for (size_t m = 0; m < options->meshes; m++) {
+    size_t accessor = m * layout->meshAccessors;
+    Append(json, "%s{\"name\":\"mesh%zu\",\"primitives\":[{\"attributes\":{",
+           m > 0 ? "," : "", m);
+    bool first = true;
+    for (int a = 0; a < ATTRIBUTE_COUNT; a++) {
+      if (options->attributes[a]) {
+        Append(json, "%s\"%s\":%zu", first ? "" : ",",
+               attributeInfos[a].semantic, accessor++);
+        first = false;
+      }
+    }
+    Append(json, "},\"indices\":%zu,\"mode\":4}]}", accessor);
+  }
+  Append(json, "],");
+
+  // Accessors and buffer views are one to one
+  size_t meshAccessors = options->meshes * layout->meshAccessors;
+  int indexType = layout->indexSize == 1   ? GLTF_UNSIGNED_BYTE
+                  : layout->indexSize == 2 ? GLTF_UNSIGNED_SHORT
+                                           : GLTF_UNSIGNED_INT;
+  Append(json, "\"accessors\":[");
+  for (size_t m = 0; m < options->meshes; m++) {
+    size_t view = m * layout->meshAccessors;
+    for (int a = 0; a < ATTRIBUTE_COUNT; a++) {
+      if (!options->attributes[a]) {
+        continue;
+      }
+
+      Append(json, "%s{\"bufferView\":%zu,\"componentType\":%d,"
+                   "\"count\":%zu,\"type\":\"%s\"",
+             view > 0 ? "," : "", view, GLTF_FLOAT, layout->vertices,
+             attributeInfos[a].type);
+      if (a == ATTRIBUTE_POSITION) {
+        Append(json, ",\"min\":");
+        AppendFloats(json, bounds[m].boundsMin, 3);
+        Append(json, ",\"max\":");
+        AppendFloats(json, bounds[m].boundsMax, 3);
+      }
+      Append(json, "}");
+      view++;
+    }
+    Append(json, "%s{\"bufferView\":%zu,\"componentType\":%d,\"count\":%zu,"
+                 "\"type\":\"SCALAR\"}",
+           view > 0 ? "," : "", view, indexType, layout->indices);
+  }
+
+  float duration = (float)(options->keyframes - 1) / GEN_ANIMATION_FPS;
+  for (size_t a = 0; a < options->animations; a++) {
+    Append(json, "%s{\"bufferView\":%zu,\"componentType\":%d,\"count\":%zu,"
+                 "\"type\":\"SCALAR\",\"min\":[0],\"max\":[%.9g]}",
+           meshAccessors + a > 0 ? "," : "", meshAccessors + a, GLTF_FLOAT,
+           options->keyframes, duration);
+  }
+  for (size_t t = 0; options->animations > 0 && t < layout->targets; t++) {
+    size_t view = meshAccessors + options->animations + t;
+    Append(json, ",{\"bufferView\":%zu,\"componentType\":%d,\"count\":%zu,"
+                 "\"type\":\"VEC4\"}",
+           view, GLTF_FLOAT, options->keyframes);
+  }
+  Append(json, "],");
+
+  Append(json, "\"bufferViews\":[");
+  bool first = true;
+  for (size_t m = 0; m < options->meshes; m++) {
+    size_t offset = m * layout->meshBytes;
+    for (int a = 0; a < ATTRIBUTE_COUNT; a++) {
+      if (options->attributes[a]) {
+        AppendBufferView(json, &first, offset, layout->attributeBytes[a],
+                         GLTF_ARRAY_BUFFER);
+        offset += layout->attributeBytes[a];
+      }
+    }
+    AppendBufferView(json, &first, offset,
+                     layout->indices * layout->indexSize,
+                     GLTF_ELEMENT_ARRAY_BUFFER);
+  }
+  for (size_t a = 0; a < options->animations; a++) {
+    AppendBufferView(json, &first,
+                     layout->animationsOffset + a * layout->timeBytes,
+                     layout->timeBytes, 0);
+  }
+
+  // Rotation views are numbered by node and laid out by animation
+  for (size_t t = 0; options->animations > 0 && t < layout->targets; t++) {
+    AppendBufferView(json, &first, GetRotationOffset(options, layout, t),
+                     layout->rotationBytes, 0);
+  }
+  Append(json, "],");
+
+  // Animation a rotates every node t with t % animations == a, the groups
+  // or the instances when there are no groups come first in the nodes
+  if (options->animations > 0) {
+    Append(json, "\"animations\":[");
+    for (size_t a = 0; a < options->animations; a++) {
+      Append(json, "%s{\"name\":\"animation%zu\",\"channels\":[",
+             a > 0 ? "," : "", a);
+      size_t s = 0;
+      for (size_t t = a; t < layout->targets; t += options->animations, s++) {
+        Append(json, "%s{\"sampler\":%zu,\"target\":{\"node\":%zu,"
+                     "\"path\":\"rotation\"}}",
+               s > 0 ? "," : "", s, t);
+      }
+      Append(json, "],\"samplers\":[");
+      s = 0;
+      for (size_t t = a; t < layout->targets; t += options->animations, s++) {
+        Append(json, "%s{\"input\":%zu,\"output\":%zu,"
+                     "\"interpolation\":\"LINEAR\"}",
+               s > 0 ? "," : "", meshAccessors + a,
+               meshAccessors + options->animations + t);
+      }
+      Append(json, "]}");
+    }
+    Append(json, "],");
+  }
+
+  Append(json, "\"buffers\":[{\"byteLength\":%zu", layout->binBytes);
+  if (binUri != NULL) {
+    Append(json, ",\"uri\":\"%s\"", binUri);
+  }
+  Append(json, "}]}");
+}
+
+static bool WriteMeshes(const GenOptions *options, const GenLayout *layout,
+                        FILE *file) {
+  MeshData mesh = {0};
+  bool ok = true;
+  for (int a = 0; a < ATTRIBUTE_COUNT && ok; a++) {
+    if (options->attributes[a]) {
+      mesh.attributes[a] = malloc(layout->attributeBytes[a]);
+      ok = mesh.attributes[a] != NULL;
+    }
+  }
+  mesh.indices = calloc(1, layout->indexBytes);
+  ok = ok && mesh.indices != NULL;
+
+  for (size_t m = 0; m < options->meshes && ok; m++) {
+    GenerateMesh(options, layout, m, &mesh);
+    for (int a = 0; a < ATTRIBUTE_COUNT; a++) {
+      if (mesh.attributes[a] != NULL) {
+        ok = ok && fwrite(mesh.attributes[a], 1, layout->attributeBytes[a],
+                          file) == layout->attributeBytes[a];
+      }
+    }
+    ok = ok && fwrite(mesh.indices, 1, layout->indexBytes, file) ==
+                   layout->indexBytes;
+  }
+
+  for (int a = 0; a < ATTRIBUTE_COUNT; a++) {
+    free(mesh.attributes[a]);
+  }
+  free(mesh.indices);
+  return ok;
+}
+
+static bool WriteAnimations(const GenOptions *options, const GenLayout *layout,
+                            FILE *file) {
+  if (options->animations == 0) {
+    return true;
+  }
+
+  float *values = malloc(layout->rotationBytes);
+  if (values == NULL) {
+    return false;
+  }
+
+  bool ok = true;
+  for (size_t k = 0; k < options->keyframes; k++) {
+    values[k] = (float)k / GEN_ANIMATION_FPS;
+  }
+  for (size_t a = 0; a < options->animations && ok; a++) {
+    ok = fwrite(values, 1, layout->timeBytes, file) == layout->timeBytes;
+  }
+
+  // Turns around the vertical axis, slow enough that keyframes stay less
+  // than half a turn apart
+  for (size_t a = 0; a < options->animations && ok; a++) {
+    for (size_t t = a; t < layout->targets && ok; t += options->animations) {
+      uint64_t rng = MakeStream(options->seed, 4, t);
+      float phase = RandomRange(&rng, 0.0f, 6.2831853f);
+      float speed = RandomRange(&rng, -3.0f, 3.0f);
+      for (size_t k = 0; k < options->keyframes; k++) {
+        float angle = phase + speed * (float)k / GEN_ANIMATION_FPS;
+        values[k * 4 + 0] = 0.0f;
+        values[k * 4 + 1] = sinf(angle * 0.5f);
+        values[k * 4 + 2] = 0.0f;
+        values[k * 4 + 3] = cosf(angle * 0.5f);
+      }
+      ok = fwrite(values, 1, layout->rotationBytes, file) ==
+           layout->rotationBytes;
+    }
+  }
+
+  free(values);
+  return ok;
+}
+
+static void PutLE32(uint8_t *out, uint32_t v) {
+  out[0] = (uint8_t)v;
+  out[1] = (uint8_t)(v >> 8);
+  out[2] = (uint8_t)(v >> 16);
+  out[3] = (uint8_t)(v >> 24);
+}
+
+static bool EndsWith(const char *text, const char *suffix) {
+  size_t length = strlen(text);
+  size_t suffixLength = strlen(suffix);
+  return length >= suffixLength &&
+         strcmp(text + length - suffixLength, suffix) == 0;
+}
+
+// Encode a file from its current position to the end as base64 into another
+static bool WriteBase64(FILE *in, FILE *out) {
+  static const char alphabet[] =
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  static uint8_t input[GEN_BASE64_CHUNK];
+  static char output[GEN_BASE64_CHUNK / 3 * 4];
+
+  size_t read;
+  while ((read = fread(input, 1, sizeof(input), in)) > 0) {
+    size_t length = 0;
+    for (size_t i = 0; i < read; i += 3) {
+      uint32_t v = (uint32_t)input[i] << 16;
+      v |= i + 1 < read ? (uint32_t)input[i + 1] << 8 : 0;
+      v |= i + 2 < read ? input[i + 2] : 0;
+      output[length++] = alphabet[(v >> 18) & 63];
+      output[length++] = alphabet[(v >> 12) & 63];
+      output[length++] = i + 1 < read ? alphabet[(v >> 6) & 63] : '=';
+      output[length++] = i + 2 < read ? alphabet[v & 63] : '=';
+    }
+
+    if (fwrite(output, 1, length, out) != length) {
+      return false;
+    }
+  }
+  return ferror(in) == 0;
+}
+
+static void PrintUsage(const char *program) {
+  fprintf(stderr,
+          "usage: %s [-m meshes] [-v vertices] [-n instances] [-d depth] "
+          "[-b branching] [-a animations] [-k keyframes] [-A attributes] "
+          "[-i 8|16|32] [-s seed] [-e] <output.gltf|output.glb>\n"
+          "  -m n      distinct meshes (default: %d)\n"
+          "  -v n      vertices per mesh, rounded up to the grid (default: "
+          "%d)\n"
+          "  -n n      instances of every mesh (default: %d)\n"
+          "  -d n      levels of group nodes above the instances (default: "
+          "%d)\n"
+          "  -b n      children of every group (default: %d)\n"
+          "  -a n      animations rotating the groups (default: 0)\n"
+          "  -k n      keyframes per animation (default: %d)\n"
+          "  -A list   comma separated attributes among pos,nor,uv,col,tan "
+          "(default: pos,nor,uv)\n"
+          "  -i bits   index width (default: %d)\n"
+          "  -s seed   random seed (default: %d)\n"
+          "  -e        embed the buffer of a .gltf as a base64 data: URI\n"
+          "  .gltf outputs write their buffer next to them as .bin\n",
+          program, GEN_DEFAULT_MESHES, GEN_DEFAULT_VERTICES,
+          GEN_DEFAULT_INSTANCES, GEN_DEFAULT_DEPTH, GEN_DEFAULT_BRANCHING,
+          GEN_DEFAULT_KEYFRAMES, GEN_DEFAULT_INDEX_BITS, GEN_DEFAULT_SEED);
+}
+
+static bool ParseAttributes(const char *list, bool *attributes) {
+  memset(attributes, 0, sizeof(bool) * ATTRIBUTE_COUNT);
+  const char *name = list;
+  while (*name != '\0') {
+    size_t length = strcspn(name, ",");
+    bool found = false;
+    for (int a = 0; a < ATTRIBUTE_COUNT; a++) {
+      if (strlen(attributeInfos[a].option) == length &&
+          strncmp(name, attributeInfos[a].option, length) == 0) {
+        attributes[a] = true;
+        found = true;
+      }
+    }
+
+    if (!found) {
+      return false;
+    }
+    name += length + (name[length] == ',' ? 1 : 0);
+  }
+
+  // Positions are required by glTF
+  return attributes[ATTRIBUTE_POSITION];
+}
+
+static bool ParseOptions(int argc, char **argv, GenOptions *options) {
+  options->meshes = GEN_DEFAULT_MESHES;
+  options->vertices = GEN_DEFAULT_VERTICES;
+  options->instances = GEN_DEFAULT_INSTANCES;
+  options->depth = GEN_DEFAULT_DEPTH;
+  options->branching = GEN_DEFAULT_BRANCHING;
+  options->keyframes = GEN_DEFAULT_KEYFRAMES;
+  options->indexBits = GEN_DEFAULT_INDEX_BITS;
+  options->seed = GEN_DEFAULT_SEED;
+  ParseAttributes("pos,nor,uv", options->attributes);
+
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (strcmp(arg, "-m") == 0 && hasValue) {
+      options->meshes = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "-v") == 0 && hasValue) {
+      options->vertices = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "-n") == 0 && hasValue) {
+      options->instances = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "-d") == 0 && hasValue) {
+      options->depth = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "-b") == 0 && hasValue) {
+      options->branching = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "-a") == 0 && hasValue) {
+      options->animations = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "-k") == 0 && hasValue) {
+      options->keyframes = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "-A") == 0 && hasValue) {
+      if (!ParseAttributes(argv[++i], options->attributes)) {
+        return false;
+      }
+    } else if (strcmp(arg, "-i") == 0 && hasValue) {
+      options->indexBits = atoi(argv[++i]);
+    } else if (strcmp(arg, "-s") == 0 && hasValue) {
+      options->seed = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(arg, "-e") == 0) {
+      options->embed = true;
+    } else if (arg[0] == '-' && arg[1] != '\0') {
+      return false;
+    } else {
+      options->outputPath = arg;
+    }
+  }
+
+  // .glb files keep their buffer in the binary chunk
+  return options->outputPath != NULL &&
+         !(options->embed && EndsWith(options->outputPath, ".glb")) &&
+         options->meshes > 0 &&
+         options->vertices > 0 && options->instances > 0 &&
+         options->branching > 0 && options->keyframes > 1 &&
+         (options->indexBits == 8 || options->indexBits == 16 ||
+          options->indexBits == 32);
+}
+
+int main(int argc, char **argv) {
+  GenOptions options = {0};
+  if (!ParseOptions(argc, argv, &options)) {
+    PrintUsage(argv[0]);
+    return 1;
+  }
+
+  GenLayout layout;
+  if (!ComputeLayout(&options, &layout)) {
+    return 1;
+  }
+
+  bool binary = EndsWith(options.outputPath, ".glb");
+  char binPath[GEN_MAX_PATH] = {0};
+  const char *binUri = NULL;
+  if (options.embed) {
+    binUri = GEN_DATA_URI;
+  } else if (!binary) {
+    size_t length = strlen(options.outputPath);
+    if (EndsWith(options.outputPath, ".gltf")) {
+      length -= strlen(".gltf");
+    }
+    if (length + strlen(".bin") >= sizeof(binPath)) {
+      fprintf(stderr, "error: output path too long\n");
+      return 1;
+    }
+    memcpy(binPath, options.outputPath, length);
+    strcpy(binPath + length, ".bin");
+    const char *slash = strrchr(binPath, '/');
+    binUri = slash != NULL ? slash + 1 : binPath;
+  }
+
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  // Positions are generated twice, the JSON needs the bounds before the
+  // buffer is written
+  MeshData *bounds = calloc(options.meshes, sizeof(MeshData));
+  if (bounds == NULL) {
+    fprintf(stderr, "error: out of memory\n");
+    return 1;
+  }
+  for (size_t m = 0; m < options.meshes; m++) {
+    GenerateMesh(&options, &layout, m, bounds + m);
+  }
+
+  StrBuf json = {0};
+  BuildJson(&options, &layout, bounds, binUri, &json);
+  free(bounds);
+  if (json.failed) {
+    fprintf(stderr, "error: out of memory\n");
+    free(json.data);
+    return 1;
+  }
+
+  size_t jsonPadded = Align4(json.length);
+  uint64_t glbBytes = 12 + 8 + jsonPadded + 8 + layout.binBytes;
+  if (binary && glbBytes > 0xFFFFFFFFull) {
+    fprintf(stderr, "error: %llu bytes do not fit a .glb, write a .gltf\n",
+            (unsigned long long)glbBytes);
+    free(json.data);
+    return 1;
+  }
+
+  FILE *file = fopen(options.outputPath, "wb");
+  FILE *binFile = binary          ? file
+                  : options.embed ? tmpfile()
+                                  : fopen(binPath, "wb");
+  if (file == NULL || binFile == NULL) {
+    fprintf(stderr, "error: cannot write %s\n",
+            file == NULL    ? options.outputPath
+            : options.embed ? "a temporary file"
+                            : binPath);
+    if (file != NULL) {
+      fclose(file);
+    }
+    free(json.data);
+    return 1;
+  }
+
+  bool ok = true;
+  if (binary) {
+    uint8_t header[20];
+    PutLE32(header, GLB_MAGIC);
+    PutLE32(header + 4, 2);
+    PutLE32(header + 8, (uint32_t)glbBytes);
+    PutLE32(header + 12, (uint32_t)jsonPadded);
+    PutLE32(header + 16, GLB_CHUNK_JSON);
+    ok = fwrite(header, 1, sizeof(header), file) == sizeof(header);
+    ok = ok && fwrite(json.data, 1, json.length, file) == json.length;
+    ok = ok && fwrite("   ", 1, jsonPadded - json.length, file) ==
+                   jsonPadded - json.length;
+
+    PutLE32(header, (uint32_t)layout.binBytes);
+    PutLE32(header + 4, GLB_CHUNK_BIN);
+    ok = ok && fwrite(header, 1, 8, file) == 8;
+  } else if (options.embed) {
+    // The buffer goes inside the uri, before the closing of the JSON
+    size_t length = json.length - strlen(GEN_JSON_END);
+    ok = fwrite(json.data, 1, length, file) == length;
+  } else {
+    ok = fwrite(json.data, 1, json.length, file) == json.length;
+  }
+  free(json.data);
+
+  ok = ok && WriteMeshes(&options, &layout, binFile);
+  ok = ok && WriteAnimations(&options, &layout, binFile);
+  if (options.embed) {
+    ok = ok && fseek(binFile, 0, SEEK_SET) == 0;
+    ok = ok && WriteBase64(binFile, file);
+    ok = ok && fputs(GEN_JSON_END, file) != EOF;
+  }
+  ok = fclose(file) == 0 && ok;
+  if (!binary) {
+    ok = fclose(binFile) == 0 && ok;
+  }
+
+  if (!ok) {
+    fprintf(stderr, "error: cannot write %s\n", options.outputPath);
+    return 1;
+  }
+
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double elapsed = (double)(end.tv_sec - start.tv_sec) +
+                   (double)(end.tv_nsec - start.tv_nsec) * 1e-9;
+  printf("wrote %s: %zu meshes, %zu nodes, %zu vertices, %zu triangles, "
+         "%zu animations, %.2f MB of buffer in %.2f s\n",
+         options.outputPath, options.meshes, layout.groups + layout.leaves,
+         options.meshes * layout.vertices,
+         options.meshes * layout.indices / 3, options.animations,
+         (double)layout.binBytes / (1024.0 * 1024.0), elapsed);
+  return 0;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <glad/glad.h>
+
+#include "model.h"
+
+// Helpers shared by the engine sources, not part of the API. Defined here so
+// that the ones used in inner loops are inlined.
+
+static inline float MinF(float a, float b) { return a < b ? a : b; }
+static inline float MaxF(float a, float b) { return a > b ? a : b; }
+
+// Grow an array of items of the given size to hold at least count of them,
+// doubling its capacity from 64. Returns false when out of memory, the array
+// is left as it was then.
+static inline bool Grow(void **items, size_t *capacity, size_t count,
+                        size_t size) {
+  if (count <= *capacity) {
+    return true;
+  }
+
+  size_t newCapacity = *capacity > 0 ? *capacity : 64;
+  while (newCapacity < count) {
+    newCapacity *= 2;
+  }
+
+  void *grown = realloc(*items, newCapacity * size);
+  if (grown == NULL) {
+    return false;
+  }
+
+  *items = grown;
+  *capacity = newCapacity;
+  return true;
+}
+
+// Return the i-th index of a mesh, whatever its index type
+static inline uint32_t ReadIndex(const Mesh *mesh, size_t i) {
+  switch (mesh->indexType) {
+  case GL_UNSIGNED_BYTE:
+    return ((const uint8_t *)mesh->indices)[i];
+  case GL_UNSIGNED_SHORT:
+    return ((const uint16_t *)mesh->indices)[i];
+  default:
+    return ((const uint32_t *)mesh->indices)[i];
+  }
+}
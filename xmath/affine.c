@@ -0,0 +1,95 @@
+#include "affine.h"
+
+Affine3x4 Affine3x4FromMat4(const Mat4 m) {
+  Affine3x4 r;
+  r.rows[0] = (Vec4){m.xx, m.yx, m.zx, m.wx};
+  r.rows[1] = (Vec4){m.xy, m.yy, m.zy, m.wy};
+  r.rows[2] = (Vec4){m.xz, m.yz, m.zz, m.wz};
+  return r;
+}
+
+Mat4 Affine3x4ToMat4(const Affine3x4 a) {
+  const Vec4 *r = a.rows;
+  Mat4 m;
+  m.xx = r[0].x;
+  m.xy = r[1].x;
+  m.xz = r[2].x;
+  m.xw = 0.0f;
+  m.yx = r[0].y;
+  m.yy = r[1].y;
+  m.yz = r[2].y;
+  m.yw = 0.0f;
+  m.zx = r[0].z;
+  m.zy = r[1].z;
+  m.zz = r[2].z;
+  m.zw = 0.0f;
+  m.wx = r[0].w;
+  m.wy = r[1].w;
+  m.wz = r[2].w;
+  m.ww = 1.0f;
+  return m;
+}
+
+Affine3x4 Affine3x4Mul(const Affine3x4 a, const Affine3x4 b) {
+  // Rows of b weight the rows of a, the implicit (0, 0, 0, 1) row of a only
+  // carries the translation of b
+  Affine3x4 r;
+  for (int i = 0; i < 3; i++) {
+    Vec4 w = b.rows[i];
+    r.rows[i].x = w.x * a.rows[0].x + w.y * a.rows[1].x + w.z * a.rows[2].x;
+    r.rows[i].y = w.x * a.rows[0].y + w.y * a.rows[1].y + w.z * a.rows[2].y;
+    r.rows[i].z = w.x * a.rows[0].z + w.y * a.rows[1].z + w.z * a.rows[2].z;
+    r.rows[i].w =
+        w.x * a.rows[0].w + w.y * a.rows[1].w + w.z * a.rows[2].w + w.w;
+  }
+  return r;
+}
+
+Affine3x4 Affine3x4Inverse(const Affine3x4 a) {
+  const Vec4 *r = a.rows;
+
+  // Inverse of the linear part from its cofactors
+  float c00 = r[1].y * r[2].z - r[1].z * r[2].y;
+  float c01 = r[1].z * r[2].x - r[1].x * r[2].z;
+  float c02 = r[1].x * r[2].y - r[1].y * r[2].x;
+  float det = r[0].x * c00 + r[0].y * c01 + r[0].z * c02;
+  assert(det != 0.0f && "invalid arg a: singular transformation");
+
+  float inv = 1.0f / det;
+  Affine3x4 out;
+  out.rows[0].x = c00 * inv;
+  out.rows[1].x = c01 * inv;
+  out.rows[2].x = c02 * inv;
+  out.rows[0].y = (r[0].z * r[2].y - r[0].y * r[2].z) * inv;
+  out.rows[1].y = (r[0].x * r[2].z - r[0].z * r[2].x) * inv;
+  out.rows[2].y = (r[0].y * r[2].x - r[0].x * r[2].y) * inv;
+  out.rows[0].z = (r[0].y * r[1].z - r[0].z * r[1].y) * inv;
+  out.rows[1].z = (r[0].z * r[1].x - r[0].x * r[1].z) * inv;
+  out.rows[2].z = (r[0].x * r[1].y - r[0].y * r[1].x) * inv;
+
+  // Translation undone in the inverted space
+  Vec3 t = {r[0].w, r[1].w, r[2].w};
+  for (int i = 0; i < 3; i++) {
+    Vec4 *o = out.rows + i;
+    o->w = -(o->x * t.x + o->y * t.y + o->z * t.z);
+  }
+  return out;
+}
+
+Vec3 Affine3x4TransformPoint(const Affine3x4 a, const Vec3 p) {
+  const Vec4 *r = a.rows;
+  Vec3 out;
+  out.x = r[0].x * p.x + r[0].y * p.y + r[0].z * p.z + r[0].w;
+  out.y = r[1].x * p.x + r[1].y * p.y + r[1].z * p.z + r[1].w;
+  out.z = r[2].x * p.x + r[2].y * p.y + r[2].z * p.z + r[2].w;
+  return out;
+}
+
+Vec3 Affine3x4TransformDir(const Affine3x4 a, const Vec3 v) {
+  const Vec4 *r = a.rows;
+  Vec3 out;
+  out.x = r[0].x * v.x + r[0].y * v.y + r[0].z * v.z;
+  out.y = r[1].x * v.x + r[1].y * v.y + r[1].z * v.z;
+  out.z = r[2].x * v.x + r[2].y * v.y + r[2].z * v.z;
+  return out;
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include "mat4.h"
+#include "vec3.h"
+#include "vec4.h"
+
+// clang-format off
+/**
+ * \brief Affine transformation in a 3x4 matrix.
+ *
+ * The Mat4 of a transformation without projection keeps its last row as
+ * (0, 0, 0, 1), this type drops it and stores the remaining three rows: row
+ * i holds the weights of output component i, the last one being the
+ * translation. Takes 48 bytes instead of 64 and the row order is the one
+ * shaders take bone palettes as, out.x = dot(rows[0], vec4(p, 1)).
+ */
+typedef struct {
+  Vec4 rows[3];
+} Affine3x4;
+
+static const Affine3x4 Affine3x4Identity = {{
+    {1.0f, 0.0f, 0.0f, 0.0f},
+    {0.0f, 1.0f, 0.0f, 0.0f},
+    {0.0f, 0.0f, 1.0f, 0.0f},
+}};
+// clang-format on
+
+/**
+ * \brief Takes the affine part of a matrix.
+ * \param Mat4 m transformation, its projective part is dropped.
+ * \return the same transformation as a 3x4 matrix.
+ */
+Affine3x4 Affine3x4FromMat4(const Mat4 m);
+
+/**
+ * \brief Expands an affine transformation to a full matrix.
+ * \return the same transformation as a Mat4, last row (0, 0, 0, 1).
+ */
+Mat4 Affine3x4ToMat4(const Affine3x4 a);
+
+/**
+ * \brief Composes two transformations.
+ *
+ * Applies a first and b after, the same order as Mat4Mul, so that
+ * Affine3x4ToMat4(Affine3x4Mul(a, b)) is
+ * Mat4Mul(Affine3x4ToMat4(a), Affine3x4ToMat4(b)).
+ * \param Affine3x4 a transformation applied first.
+ * \param Affine3x4 b transformation applied last.
+ * \return composed transformation.
+ */
+Affine3x4 Affine3x4Mul(const Affine3x4 a, const Affine3x4 b);
+
+/**
+ * \brief Inverts a transformation, scales and shears included.
+ * \param Affine3x4 a transformation to invert, must not be singular.
+ * \return the transformation undoing a.
+ */
+Affine3x4 Affine3x4Inverse(const Affine3x4 a);
+
+/**
+ * \brief Transforms a point, translation included.
+ */
+Vec3 Affine3x4TransformPoint(const Affine3x4 a, const Vec3 p);
+
+/**
+ * \brief Transforms a direction, translation excluded.
+ */
+Vec3 Affine3x4TransformDir(const Affine3x4 a, const Vec3 v);
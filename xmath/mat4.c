@@ -1,5 +1,88 @@
 #include "mat4.h"
 
+// Kernels use the widest vectors the compiler targets. Products are summed
+// in the same order as the scalar code, without fused multiply-adds, so all
+// paths give the same bits.
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define XMATH_USE_SSE
+#if defined(__AVX__)
+#include <immintrin.h>
+#define XMATH_USE_AVX
+#endif
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define XMATH_USE_NEON
+#endif
+
+// r = a * b over raw floats, r may alias a or b. Each group of r combines the
+// four groups of b weighted by the matching group of a.
+static inline void MulRaw(float *r, const float *a, const float *b) {
+#if defined(XMATH_USE_AVX)
+  __m128 b0 = _mm_loadu_ps(b);
+  __m128 b1 = _mm_loadu_ps(b + 4);
+  __m128 b2 = _mm_loadu_ps(b + 8);
+  __m128 b3 = _mm_loadu_ps(b + 12);
+  __m256 bb0 = _mm256_insertf128_ps(_mm256_castps128_ps256(b0), b0, 1);
+  __m256 bb1 = _mm256_insertf128_ps(_mm256_castps128_ps256(b1), b1, 1);
+  __m256 bb2 = _mm256_insertf128_ps(_mm256_castps128_ps256(b2), b2, 1);
+  __m256 bb3 = _mm256_insertf128_ps(_mm256_castps128_ps256(b3), b3, 1);
+
+  // Two groups at once, one per lane. Halves are loaded apart because
+  // by-value arguments are stored 16 bytes at a time, which a 32 byte load
+  // could not forward from.
+  __m256 a01 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(a)),
+                                    _mm_loadu_ps(a + 4), 1);
+  __m256 a23 = _mm256_insertf128_ps(
+      _mm256_castps128_ps256(_mm_loadu_ps(a + 8)), _mm_loadu_ps(a + 12), 1);
+  __m256 r01 = _mm256_mul_ps(_mm256_permute_ps(a01, 0x00), bb0);
+  __m256 r23 = _mm256_mul_ps(_mm256_permute_ps(a23, 0x00), bb0);
+  r01 = _mm256_add_ps(r01, _mm256_mul_ps(_mm256_permute_ps(a01, 0x55), bb1));
+  r23 = _mm256_add_ps(r23, _mm256_mul_ps(_mm256_permute_ps(a23, 0x55), bb1));
+  r01 = _mm256_add_ps(r01, _mm256_mul_ps(_mm256_permute_ps(a01, 0xAA), bb2));
+  r23 = _mm256_add_ps(r23, _mm256_mul_ps(_mm256_permute_ps(a23, 0xAA), bb2));
+  r01 = _mm256_add_ps(r01, _mm256_mul_ps(_mm256_permute_ps(a01, 0xFF), bb3));
+  r23 = _mm256_add_ps(r23, _mm256_mul_ps(_mm256_permute_ps(a23, 0xFF), bb3));
+  _mm256_storeu_ps(r, r01);
+  _mm256_storeu_ps(r + 8, r23);
+#elif defined(XMATH_USE_SSE)
+  __m128 b0 = _mm_loadu_ps(b);
+  __m128 b1 = _mm_loadu_ps(b + 4);
+  __m128 b2 = _mm_loadu_ps(b + 8);
+  __m128 b3 = _mm_loadu_ps(b + 12);
+  for (int i = 0; i < 16; i += 4) {
+    __m128 x = _mm_mul_ps(_mm_set1_ps(a[i]), b0);
+    x = _mm_add_ps(x, _mm_mul_ps(_mm_set1_ps(a[i + 1]), b1));
+    x = _mm_add_ps(x, _mm_mul_ps(_mm_set1_ps(a[i + 2]), b2));
+    x = _mm_add_ps(x, _mm_mul_ps(_mm_set1_ps(a[i + 3]), b3));
+    _mm_storeu_ps(r + i, x);
+  }
+#elif defined(XMATH_USE_NEON)
+  float32x4_t b0 = vld1q_f32(b);
+  float32x4_t b1 = vld1q_f32(b + 4);
+  float32x4_t b2 = vld1q_f32(b + 8);
+  float32x4_t b3 = vld1q_f32(b + 12);
+  for (int i = 0; i < 16; i += 4) {
+    float32x4_t x = vmulq_n_f32(b0, a[i]);
+    x = vaddq_f32(x, vmulq_n_f32(b1, a[i + 1]));
+    x = vaddq_f32(x, vmulq_n_f32(b2, a[i + 2]));
+    x = vaddq_f32(x, vmulq_n_f32(b3, a[i + 3]));
+    vst1q_f32(r + i, x);
+  }
+#else
+  float t[16];
+  for (int i = 0; i < 16; i += 4) {
+    for (int j = 0; j < 4; j++) {
+      t[i + j] = a[i] * b[j] + a[i + 1] * b[4 + j] + a[i + 2] * b[8 + j] +
+                 a[i + 3] * b[12 + j];
+    }
+  }
+  for (int i = 0; i < 16; i++) {
+    r[i] = t[i];
+  }
+#endif
+}
+
 float *Mat4Raw(const Mat4 *m) { return (float *)&m->xx; }
 
 Vec4 Mat4Row(const Mat4 m, const unsigned int i) {
@@ -28,7 +111,24 @@ Vec4 Mat4Col(const Mat4 m, const unsigned int i) {
 
 Mat4 Mat4Transpose(const Mat4 m) {
   Mat4 r;
-
+#if defined(XMATH_USE_SSE)
+  __m128 c0 = _mm_loadu_ps(&m.xx);
+  __m128 c1 = _mm_loadu_ps(&m.yx);
+  __m128 c2 = _mm_loadu_ps(&m.zx);
+  __m128 c3 = _mm_loadu_ps(&m.wx);
+  _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+  _mm_storeu_ps(&r.xx, c0);
+  _mm_storeu_ps(&r.yx, c1);
+  _mm_storeu_ps(&r.zx, c2);
+  _mm_storeu_ps(&r.wx, c3);
+#elif defined(XMATH_USE_NEON)
+  // De-interleaving load, element i of every group goes to group i
+  float32x4x4_t t = vld4q_f32(&m.xx);
+  vst1q_f32(&r.xx, t.val[0]);
+  vst1q_f32(&r.yx, t.val[1]);
+  vst1q_f32(&r.zx, t.val[2]);
+  vst1q_f32(&r.wx, t.val[3]);
+#else
   r.xx = m.xx;
   r.xy = m.yx;
   r.xz = m.zx;
@@ -45,7 +145,7 @@ Mat4 Mat4Transpose(const Mat4 m) {
   r.wy = m.yw;
   r.wz = m.zw;
   r.ww = m.ww;
-
+#endif
   return r;
 }
 
@@ -113,39 +213,226 @@ Mat4 Mat4Scale(const Mat4 a, float s) {
 }
 
 Mat4 Mat4Mul(const Mat4 a, const Mat4 b) {
-  Mat4 r = Mat4Zero;
-
-  r.xx = a.xx * b.xx + a.xy * b.yx + a.xz * b.zx + a.xw * b.wx;
-  r.xy = a.xx * b.xy + a.xy * b.yy + a.xz * b.zy + a.xw * b.wy;
-  r.xz = a.xx * b.xz + a.xy * b.yz + a.xz * b.zz + a.xw * b.wz;
-  r.xw = a.xx * b.xw + a.xy * b.yw + a.xz * b.zw + a.xw * b.ww;
-
-  r.yx = a.yx * b.xx + a.yy * b.yx + a.yz * b.zx + a.yw * b.wx;
-  r.yy = a.yx * b.xy + a.yy * b.yy + a.yz * b.zy + a.yw * b.wy;
-  r.yz = a.yx * b.xz + a.yy * b.yz + a.yz * b.zz + a.yw * b.wz;
-  r.yw = a.yx * b.xw + a.yy * b.yw + a.yz * b.zw + a.yw * b.ww;
-
-  r.zx = a.zx * b.xx + a.zy * b.yx + a.zz * b.zx + a.zw * b.wx;
-  r.zy = a.zx * b.xy + a.zy * b.yy + a.zz * b.zy + a.zw * b.wy;
-  r.zz = a.zx * b.xz + a.zy * b.yz + a.zz * b.zz + a.zw * b.wz;
-  r.zw = a.zx * b.xw + a.zy * b.yw + a.zz * b.zw + a.zw * b.ww;
+  Mat4 r;
+  MulRaw(&r.xx, &a.xx, &b.xx);
+  return r;
+}
 
-  r.wx = a.wx * b.xx + a.wy * b.yx + a.wz * b.zx + a.ww * b.wx;
-  r.wy = a.wx * b.xy + a.wy * b.yy + a.wz * b.zy + a.ww * b.wy;
-  r.wz = a.wx * b.xz + a.wy * b.yz + a.wz * b.zz + a.ww * b.wz;
-  r.ww = a.wx * b.xw + a.wy * b.yw + a.wz * b.zw + a.ww * b.ww;
+void Mat4MulInto(Mat4 *r, const Mat4 *a, const Mat4 *b) {
+  assert(r != NULL && a != NULL && b != NULL);
+  MulRaw(&r->xx, &a->xx, &b->xx);
+}
 
-  return r;
+void Mat4MulArray(Mat4 *dst, const Mat4 *a, const Mat4 *b, size_t n) {
+  assert((dst != NULL && a != NULL && b != NULL) || n == 0);
+  for (size_t i = 0; i < n; i++) {
+    MulRaw(&dst[i].xx, &a[i].xx, &b[i].xx);
+  }
 }
 
 Vec4 Mat4MulVec4(const Mat4 a, const Vec4 b) {
   Vec4 r;
-
+#if defined(XMATH_USE_SSE)
+  // Element i of every group weighted by component i of b
+  __m128 c0 = _mm_loadu_ps(&a.xx);
+  __m128 c1 = _mm_loadu_ps(&a.yx);
+  __m128 c2 = _mm_loadu_ps(&a.zx);
+  __m128 c3 = _mm_loadu_ps(&a.wx);
+  _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+  __m128 x = _mm_mul_ps(c0, _mm_set1_ps(b.x));
+  x = _mm_add_ps(x, _mm_mul_ps(c1, _mm_set1_ps(b.y)));
+  x = _mm_add_ps(x, _mm_mul_ps(c2, _mm_set1_ps(b.z)));
+  x = _mm_add_ps(x, _mm_mul_ps(c3, _mm_set1_ps(b.w)));
+  _mm_storeu_ps(&r.x, x);
+#elif defined(XMATH_USE_NEON)
+  float32x4x4_t t = vld4q_f32(&a.xx);
+  float32x4_t x = vmulq_n_f32(t.val[0], b.x);
+  x = vaddq_f32(x, vmulq_n_f32(t.val[1], b.y));
+  x = vaddq_f32(x, vmulq_n_f32(t.val[2], b.z));
+  x = vaddq_f32(x, vmulq_n_f32(t.val[3], b.w));
+  vst1q_f32(&r.x, x);
+#else
   r.x = a.xx * b.x + a.xy * b.y + a.xz * b.z + a.xw * b.w;
   r.y = a.yx * b.x + a.yy * b.y + a.yz * b.z + a.yw * b.w;
   r.z = a.zx * b.x + a.zy * b.y + a.zz * b.z + a.zw * b.w;
   r.w = a.wx * b.x + a.wy * b.y + a.wz * b.z + a.ww * b.w;
+#endif
+  return r;
+}
+
+void Mat4TransformPoints(Vec4 *dst, const Mat4 *m, const Vec3 *points,
+                         size_t stride, size_t n) {
+  assert((dst != NULL && m != NULL && points != NULL) || n == 0);
+  const char *src = (const char *)points;
+
+  // dst = col0 * x + col1 * y + col2 * z + col3
+#if defined(XMATH_USE_SSE)
+  __m128 c0 = _mm_loadu_ps(&m->xx);
+  __m128 c1 = _mm_loadu_ps(&m->yx);
+  __m128 c2 = _mm_loadu_ps(&m->zx);
+  __m128 c3 = _mm_loadu_ps(&m->wx);
+  for (size_t i = 0; i < n; i++) {
+    const Vec3 *p = (const Vec3 *)(src + i * stride);
+    __m128 x = _mm_mul_ps(c0, _mm_set1_ps(p->x));
+    x = _mm_add_ps(x, _mm_mul_ps(c1, _mm_set1_ps(p->y)));
+    x = _mm_add_ps(x, _mm_mul_ps(c2, _mm_set1_ps(p->z)));
+    _mm_storeu_ps(&dst[i].x, _mm_add_ps(x, c3));
+  }
+#elif defined(XMATH_USE_NEON)
+  float32x4_t c0 = vld1q_f32(&m->xx);
+  float32x4_t c1 = vld1q_f32(&m->yx);
+  float32x4_t c2 = vld1q_f32(&m->zx);
+  float32x4_t c3 = vld1q_f32(&m->wx);
+  for (size_t i = 0; i < n; i++) {
+    const Vec3 *p = (const Vec3 *)(src + i * stride);
+    float32x4_t x = vmulq_n_f32(c0, p->x);
+    x = vaddq_f32(x, vmulq_n_f32(c1, p->y));
+    x = vaddq_f32(x, vmulq_n_f32(c2, p->z));
+    vst1q_f32(&dst[i].x, vaddq_f32(x, c3));
+  }
+#else
+  for (size_t i = 0; i < n; i++) {
+    Vec3 p = *(const Vec3 *)(src + i * stride);
+    dst[i].x = m->xx * p.x + m->yx * p.y + m->zx * p.z + m->wx;
+    dst[i].y = m->xy * p.x + m->yy * p.y + m->zy * p.z + m->wy;
+    dst[i].z = m->xz * p.x + m->yz * p.y + m->zz * p.z + m->wz;
+    dst[i].w = m->xw * p.x + m->yw * p.y + m->zw * p.z + m->ww;
+  }
+#endif
+}
+
+#if defined(XMATH_USE_SSE)
+#define SWIZZLE(v, x, y, z, w) _mm_shuffle_ps(v, v, _MM_SHUFFLE(w, z, y, x))
+
+// Products of 2x2 matrices stored row by row in a vector: a * b, adj(a) * b
+// and a * adj(b)
+static inline __m128 Mat2Mul(__m128 a, __m128 b) {
+  return _mm_add_ps(_mm_mul_ps(a, SWIZZLE(b, 0, 3, 0, 3)),
+                    _mm_mul_ps(SWIZZLE(a, 1, 0, 3, 2), SWIZZLE(b, 2, 1, 2, 1)));
+}
+
+static inline __m128 Mat2AdjMul(__m128 a, __m128 b) {
+  return _mm_sub_ps(_mm_mul_ps(SWIZZLE(a, 3, 3, 0, 0), b),
+                    _mm_mul_ps(SWIZZLE(a, 1, 1, 2, 2), SWIZZLE(b, 2, 3, 0, 1)));
+}
+
+static inline __m128 Mat2MulAdj(__m128 a, __m128 b) {
+  return _mm_sub_ps(_mm_mul_ps(a, SWIZZLE(b, 3, 0, 3, 0)),
+                    _mm_mul_ps(SWIZZLE(a, 1, 0, 3, 2), SWIZZLE(b, 2, 1, 2, 1)));
+}
+#endif
 
+Mat4 Mat4Inverse(const Mat4 m) {
+  Mat4 r;
+#if defined(XMATH_USE_SSE)
+  // Block inverse over the 2x2 sub matrices | A B |
+  //                                         | C D |
+  __m128 g0 = _mm_loadu_ps(&m.xx);
+  __m128 g1 = _mm_loadu_ps(&m.yx);
+  __m128 g2 = _mm_loadu_ps(&m.zx);
+  __m128 g3 = _mm_loadu_ps(&m.wx);
+  __m128 a = _mm_movelh_ps(g0, g1);
+  __m128 b = _mm_movehl_ps(g1, g0);
+  __m128 c = _mm_movelh_ps(g2, g3);
+  __m128 d = _mm_movehl_ps(g3, g2);
+
+  // Determinants of A, B, C and D
+  __m128 dets = _mm_sub_ps(
+      _mm_mul_ps(_mm_shuffle_ps(g0, g2, _MM_SHUFFLE(2, 0, 2, 0)),
+                 _mm_shuffle_ps(g1, g3, _MM_SHUFFLE(3, 1, 3, 1))),
+      _mm_mul_ps(_mm_shuffle_ps(g0, g2, _MM_SHUFFLE(3, 1, 3, 1)),
+                 _mm_shuffle_ps(g1, g3, _MM_SHUFFLE(2, 0, 2, 0))));
+  __m128 detA = SWIZZLE(dets, 0, 0, 0, 0);
+  __m128 detB = SWIZZLE(dets, 1, 1, 1, 1);
+  __m128 detC = SWIZZLE(dets, 2, 2, 2, 2);
+  __m128 detD = SWIZZLE(dets, 3, 3, 3, 3);
+
+  __m128 dc = Mat2AdjMul(d, c);
+  __m128 ab = Mat2AdjMul(a, b);
+  __m128 x = _mm_sub_ps(_mm_mul_ps(detD, a), Mat2Mul(b, dc));
+  __m128 w = _mm_sub_ps(_mm_mul_ps(detA, d), Mat2Mul(c, ab));
+  __m128 y = _mm_sub_ps(_mm_mul_ps(detB, c), Mat2MulAdj(d, ab));
+  __m128 z = _mm_sub_ps(_mm_mul_ps(detC, b), Mat2MulAdj(a, dc));
+
+  // det = |A| |D| + |B| |C| - trace(adj(A) B adj(D) C)
+  __m128 trace = _mm_mul_ps(ab, SWIZZLE(dc, 0, 2, 1, 3));
+  trace = _mm_add_ps(trace, SWIZZLE(trace, 1, 0, 3, 2));
+  trace = _mm_add_ps(trace, SWIZZLE(trace, 2, 3, 0, 1));
+  __m128 det = _mm_sub_ps(
+      _mm_add_ps(_mm_mul_ps(detA, detD), _mm_mul_ps(detB, detC)), trace);
+  assert(_mm_cvtss_f32(det) != 0.0f && "invalid arg m: singular matrix");
+
+  __m128 inv = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), det);
+  x = _mm_mul_ps(x, inv);
+  y = _mm_mul_ps(y, inv);
+  z = _mm_mul_ps(z, inv);
+  w = _mm_mul_ps(w, inv);
+
+  // Adjugates of the blocks, shuffled back into groups
+  _mm_storeu_ps(&r.xx, _mm_shuffle_ps(x, y, _MM_SHUFFLE(1, 3, 1, 3)));
+  _mm_storeu_ps(&r.yx, _mm_shuffle_ps(x, y, _MM_SHUFFLE(0, 2, 0, 2)));
+  _mm_storeu_ps(&r.zx, _mm_shuffle_ps(z, w, _MM_SHUFFLE(1, 3, 1, 3)));
+  _mm_storeu_ps(&r.wx, _mm_shuffle_ps(z, w, _MM_SHUFFLE(0, 2, 0, 2)));
+#else
+  // Cofactors from the 2x2 determinants of the first and last two groups
+  const float *a = Mat4Raw(&m);
+  float s0 = a[0] * a[5] - a[4] * a[1];
+  float s1 = a[0] * a[6] - a[4] * a[2];
+  float s2 = a[0] * a[7] - a[4] * a[3];
+  float s3 = a[1] * a[6] - a[5] * a[2];
+  float s4 = a[1] * a[7] - a[5] * a[3];
+  float s5 = a[2] * a[7] - a[6] * a[3];
+  float c5 = a[10] * a[15] - a[14] * a[11];
+  float c4 = a[9] * a[15] - a[13] * a[11];
+  float c3 = a[9] * a[14] - a[13] * a[10];
+  float c2 = a[8] * a[15] - a[12] * a[11];
+  float c1 = a[8] * a[14] - a[12] * a[10];
+  float c0 = a[8] * a[13] - a[12] * a[9];
+
+  float det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+  assert(det != 0.0f && "invalid arg m: singular matrix");
+  float inv = 1.0f / det;
+
+  float *o = Mat4Raw(&r);
+  o[0] = (a[5] * c5 - a[6] * c4 + a[7] * c3) * inv;
+  o[1] = (-a[1] * c5 + a[2] * c4 - a[3] * c3) * inv;
+  o[2] = (a[13] * s5 - a[14] * s4 + a[15] * s3) * inv;
+  o[3] = (-a[9] * s5 + a[10] * s4 - a[11] * s3) * inv;
+  o[4] = (-a[4] * c5 + a[6] * c2 - a[7] * c1) * inv;
+  o[5] = (a[0] * c5 - a[2] * c2 + a[3] * c1) * inv;
+  o[6] = (-a[12] * s5 + a[14] * s2 - a[15] * s1) * inv;
+  o[7] = (a[8] * s5 - a[10] * s2 + a[11] * s1) * inv;
+  o[8] = (a[4] * c4 - a[5] * c2 + a[7] * c0) * inv;
+  o[9] = (-a[0] * c4 + a[1] * c2 - a[3] * c0) * inv;
+  o[10] = (a[12] * s4 - a[13] * s2 + a[15] * s0) * inv;
+  o[11] = (-a[8] * s4 + a[9] * s2 - a[11] * s0) * inv;
+  o[12] = (-a[4] * c3 + a[5] * c1 - a[6] * c0) * inv;
+  o[13] = (a[0] * c3 - a[1] * c1 + a[2] * c0) * inv;
+  o[14] = (-a[12] * s3 + a[13] * s1 - a[14] * s0) * inv;
+  o[15] = (a[8] * s3 - a[9] * s1 + a[10] * s0) * inv;
+#endif
+  return r;
+}
+
+Mat4 Mat4InverseRigid(const Mat4 m) {
+  // Transposed rotation, the translation rotated by it and negated
+  Mat4 r;
+  r.xx = m.xx;
+  r.xy = m.yx;
+  r.xz = m.zx;
+  r.xw = 0.0f;
+  r.yx = m.xy;
+  r.yy = m.yy;
+  r.yz = m.zy;
+  r.yw = 0.0f;
+  r.zx = m.xz;
+  r.zy = m.yz;
+  r.zz = m.zz;
+  r.zw = 0.0f;
+  r.wx = -(m.xx * m.wx + m.xy * m.wy + m.xz * m.wz);
+  r.wy = -(m.yx * m.wx + m.yy * m.wy + m.yz * m.wz);
+  r.wz = -(m.zx * m.wx + m.zy * m.wy + m.zz * m.wz);
+  r.ww = 1.0f;
   return r;
 }
 
@@ -175,13 +462,13 @@ Mat4 Mat4MakeRotation(Vec3 u, float angle) {
 
   r.xx = a_cos + u.x * u.x * a_icos;
   r.xy = u.x * u.y * a_icos + u.z * a_sin;
-  r.xz = u.x * u.z * a_icos + u.y * a_sin;
+  r.xz = u.x * u.z * a_icos - u.y * a_sin;
 
   r.yx = u.y * u.x * a_icos - u.z * a_sin;
   r.yy = a_cos + u.y * u.y * a_icos;
   r.yz = u.y * u.z * a_icos + u.x * a_sin;
 
-  r.zx = u.z * u.x * a_icos - u.y * a_sin;
+  r.zx = u.z * u.x * a_icos + u.y * a_sin;
   r.zy = u.z * u.y * a_icos - u.x * a_sin;
   r.zz = a_cos + u.z * u.z * a_icos;
 
@@ -4,6 +4,7 @@
 #include "vec4.h"
 #include <assert.h>
 #include <math.h>
+#include <stddef.h>
 
 // clang-format off
 /**
@@ -101,11 +102,61 @@ Mat4 Mat4Scale(const Mat4 a, float s);
  */
 Mat4 Mat4Mul(const Mat4 a, const Mat4 b);
 
+/**
+ * \brief Multiplies two matrices through pointers, avoiding the copies.
+ * \param Mat4 r result, may point to a or b.
+ * \param Mat4 a left operand.
+ * \param Mat4 b right operand.
+ */
+void Mat4MulInto(Mat4 *r, const Mat4 *a, const Mat4 *b);
+
+/**
+ * \brief Multiplies n pairs of matrices, dst[i] = a[i] x b[i].
+ * \param Mat4 dst results, may be the same array as a or b.
+ * \param Mat4 a left operands.
+ * \param Mat4 b right operands.
+ * \param size_t n count of matrices in every array.
+ */
+void Mat4MulArray(Mat4 *dst, const Mat4 *a, const Mat4 *b, size_t n);
+
 /**
  * \brief Multiplies a vector with a matrix.
  */
 Vec4 Mat4MulVec4(const Mat4 a, const Vec4 b);
 
+/**
+ * \brief Transforms n points by a matrix the way shaders do (column times
+ * component, w = 1), such as model positions into clip space.
+ *
+ * \param Vec4 dst transformed points, w included.
+ * \param Mat4 m transformation.
+ * \param Vec3 points first point to transform.
+ * \param size_t stride bytes from a point to the next one, such as
+ * sizeof(Vec3) or the size of an interleaved vertex.
+ * \param size_t n count of points.
+ */
+void Mat4TransformPoints(Vec4 *dst, const Mat4 *m, const Vec3 *points,
+                         size_t stride, size_t n);
+
+/**
+ * \brief Inverts a matrix.
+ *
+ * \param Mat4 m matrix to invert, must not be singular.
+ * \return the matrix undoing m, such that Mat4Mul(m, r) is the identity.
+ */
+Mat4 Mat4Inverse(const Mat4 m);
+
+/**
+ * \brief Inverts a rotation followed by a translation.
+ *
+ * Cheaper than Mat4Inverse: transposes the rotation and rotates the negated
+ * translation. Only valid without scale, shear or projection, such as the
+ * transform of a camera.
+ * \param Mat4 m rigid transformation to invert.
+ * \return the matrix undoing m.
+ */
+Mat4 Mat4InverseRigid(const Mat4 m);
+
 /**
  * \brief Makes a new model scale matrix.
  *
@@ -0,0 +1,123 @@
+#include "quat.h"
+
+// Below this sine of the angle between rotations slerp divides by almost
+// zero, nlerp gives the same result there
+#define QUAT_SLERP_MIN_SIN 1e-4f
+
+Quat QuatMake(float x, float y, float z, float w) {
+  Quat r;
+  r.x = x;
+  r.y = y;
+  r.z = z;
+  r.w = w;
+  return r;
+}
+
+Quat QuatFromAxisAngle(Vec3 axis, float angle) {
+  Vec3 u = Vec3Norm(axis);
+  float s = sinf(angle * 0.5f);
+  return QuatMake(u.x * s, u.y * s, u.z * s, cosf(angle * 0.5f));
+}
+
+Quat QuatFromEuler(Vec3 angles) {
+  float sx = sinf(angles.x * 0.5f);
+  float cx = cosf(angles.x * 0.5f);
+  float sy = sinf(angles.y * 0.5f);
+  float cy = cosf(angles.y * 0.5f);
+  float sz = sinf(angles.z * 0.5f);
+  float cz = cosf(angles.z * 0.5f);
+
+  // Z * Y * X expanded, X is applied first
+  Quat r;
+  r.x = cz * cy * sx - sz * sy * cx;
+  r.y = cz * sy * cx + sz * cy * sx;
+  r.z = sz * cy * cx - cz * sy * sx;
+  r.w = cz * cy * cx + sz * sy * sx;
+  return r;
+}
+
+Quat QuatMul(const Quat a, const Quat b) {
+  Quat r;
+  r.x = a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y;
+  r.y = a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x;
+  r.z = a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w;
+  r.w = a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z;
+  return r;
+}
+
+Quat QuatConj(const Quat q) { return QuatMake(-q.x, -q.y, -q.z, q.w); }
+
+float QuatDot(const Quat a, const Quat b) {
+  return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+}
+
+Quat QuatNorm(const Quat q) {
+  float len = sqrtf(QuatDot(q, q));
+  if (len == 0.0f) {
+    return QuatIdentity;
+  }
+
+  float inv = 1.0f / len;
+  return QuatMake(q.x * inv, q.y * inv, q.z * inv, q.w * inv);
+}
+
+Quat QuatNlerp(const Quat a, const Quat b, float t) {
+  // q and -q are the same rotation, pick the one closer to a
+  float wb = QuatDot(a, b) < 0.0f ? -t : t;
+  float wa = 1.0f - t;
+  return QuatNorm(QuatMake(a.x * wa + b.x * wb, a.y * wa + b.y * wb,
+                           a.z * wa + b.z * wb, a.w * wa + b.w * wb));
+}
+
+Quat QuatSlerp(const Quat a, const Quat b, float t) {
+  float cosAngle = QuatDot(a, b);
+  float sign = 1.0f;
+  if (cosAngle < 0.0f) {
+    cosAngle = -cosAngle;
+    sign = -1.0f;
+  }
+
+  float sinAngle = sqrtf(fmaxf(1.0f - cosAngle * cosAngle, 0.0f));
+  if (sinAngle < QUAT_SLERP_MIN_SIN) {
+    return QuatNlerp(a, b, t);
+  }
+
+  float angle = atan2f(sinAngle, cosAngle);
+  float wa = sinf((1.0f - t) * angle) / sinAngle;
+  float wb = sign * sinf(t * angle) / sinAngle;
+  return QuatMake(a.x * wa + b.x * wb, a.y * wa + b.y * wb,
+                  a.z * wa + b.z * wb, a.w * wa + b.w * wb);
+}
+
+Vec3 QuatRotateVec3(const Quat q, const Vec3 v) {
+  // v + w * t + u x t, with t = 2 * (u x v)
+  Vec3 u = {q.x, q.y, q.z};
+  Vec3 t = Vec3Scale(Vec3Cross(u, v), 2.0f);
+  return Vec3Add(Vec3Add(v, Vec3Scale(t, q.w)), Vec3Cross(u, t));
+}
+
+Mat4 QuatToMat4(const Quat q) {
+  float xx = q.x * q.x;
+  float yy = q.y * q.y;
+  float zz = q.z * q.z;
+  float xy = q.x * q.y;
+  float xz = q.x * q.z;
+  float yz = q.y * q.z;
+  float wx = q.w * q.x;
+  float wy = q.w * q.y;
+  float wz = q.w * q.z;
+
+  Mat4 r = Mat4Identity;
+  r.xx = 1.0f - 2.0f * (yy + zz);
+  r.xy = 2.0f * (xy + wz);
+  r.xz = 2.0f * (xz - wy);
+
+  r.yx = 2.0f * (xy - wz);
+  r.yy = 1.0f - 2.0f * (xx + zz);
+  r.yz = 2.0f * (yz + wx);
+
+  r.zx = 2.0f * (xz + wy);
+  r.zy = 2.0f * (yz - wx);
+  r.zz = 1.0f - 2.0f * (xx + yy);
+  return r;
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include "mat4.h"
+#include "vec3.h"
+#include <math.h>
+
+/**
+ * \brief Rotation quaternion.
+ *
+ * Holds the imaginary part in X, Y and Z and the real part in W, the same
+ * order glTF stores node rotations in. Rotations are expected to be unit
+ * length.
+ */
+typedef struct {
+  float x;
+  float y;
+  float z;
+  float w;
+} Quat;
+
+static const Quat QuatIdentity = {0.0f, 0.0f, 0.0f, 1.0f};
+
+/**
+ * \brief Makes a Quat using x, y, z and w components.
+ * \return newly created quaternion (stack).
+ */
+Quat QuatMake(float x, float y, float z, float w);
+
+/**
+ * \brief Makes a rotation around an axis.
+ *
+ * \param Vec3 axis rotation axis, normalized by the function.
+ * \param float angle counter clockwise angle in radians.
+ * \return unit quaternion of the rotation.
+ */
+Quat QuatFromAxisAngle(Vec3 axis, float angle);
+
+/**
+ * \brief Makes the rotation of Euler angles, as Transform applies them.
+ *
+ * Rotates around X first, then around Y and last around Z, matching
+ * Mat4Mul(Mat4Mul(Mat4MakeRotationX(x), Mat4MakeRotationY(y)),
+ * Mat4MakeRotationZ(z)).
+ * \param Vec3 angles angles in radians around every axis.
+ * \return unit quaternion of the rotation.
+ */
+Quat QuatFromEuler(Vec3 angles);
+
+/**
+ * \brief Multiplies two quaternions (Hamilton product).
+ *
+ * The result rotates by b first and by a after, the reverse order of Mat4Mul.
+ * \param Quat a left operand, applied last.
+ * \param Quat b right operand, applied first.
+ * \return a times b.
+ */
+Quat QuatMul(const Quat a, const Quat b);
+
+/**
+ * \brief Conjugates a quaternion, the inverse rotation of unit quaternions.
+ */
+Quat QuatConj(const Quat q);
+
+/**
+ * \brief Adds the multiplication of each quaternion's components.
+ */
+float QuatDot(const Quat a, const Quat b);
+
+/**
+ * \brief Normalizes a quaternion, identity when it has no length.
+ */
+Quat QuatNorm(const Quat q);
+
+/**
+ * \brief Interpolates linearly and normalizes.
+ *
+ * Takes the shortest path between both rotations. Cheaper than QuatSlerp,
+ * the angular velocity is not constant but close for nearby rotations such
+ * as animation keyframes.
+ * \param Quat a rotation at t = 0.
+ * \param Quat b rotation at t = 1.
+ * \param float t interpolation factor, between 0 and 1.
+ * \return unit quaternion between a and b.
+ */
+Quat QuatNlerp(const Quat a, const Quat b, float t);
+
+/**
+ * \brief Interpolates spherically with constant angular velocity.
+ *
+ * Takes the shortest path between both rotations, falling back to QuatNlerp
+ * for nearly equal rotations.
+ * \param Quat a rotation at t = 0.
+ * \param Quat b rotation at t = 1.
+ * \param float t interpolation factor, between 0 and 1.
+ * \return unit quaternion between a and b.
+ */
+Quat QuatSlerp(const Quat a, const Quat b, float t);
+
+/**
+ * \brief Rotates a vector.
+ * \param Quat q unit rotation.
+ * \param Vec3 v vector to rotate.
+ * \return rotated vector.
+ */
+Vec3 QuatRotateVec3(const Quat q, const Vec3 v);
+
+/**
+ * \brief Makes the rotation matrix of a unit quaternion.
+ * \return matrix with the same layout as Mat4MakeRotation.
+ */
+Mat4 QuatToMat4(const Quat q);
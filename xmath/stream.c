@@ -0,0 +1,523 @@
+#include "stream.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Kernels are written once over a register of lanes. Division and square
+// roots of NEON vectors need AArch64, other targets use a single float per
+// register. Operations match the scalar Vec3 and Vec4 functions one by one,
+// so all paths give the same bits.
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define XMATH_USE_SSE
+#if defined(__AVX__)
+#include <immintrin.h>
+#define XMATH_USE_AVX
+#endif
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define XMATH_USE_NEON
+#endif
+
+#if defined(XMATH_USE_AVX)
+#define LANES 8
+typedef __m256 Lanes;
+
+static inline Lanes LanesLoad(const float *p) { return _mm256_load_ps(p); }
+static inline Lanes LanesLoadU(const float *p) { return _mm256_loadu_ps(p); }
+static inline void LanesStore(float *p, Lanes v) { _mm256_store_ps(p, v); }
+static inline void LanesStoreU(float *p, Lanes v) { _mm256_storeu_ps(p, v); }
+static inline Lanes LanesSet1(float f) { return _mm256_set1_ps(f); }
+static inline Lanes LanesAdd(Lanes a, Lanes b) { return _mm256_add_ps(a, b); }
+static inline Lanes LanesSub(Lanes a, Lanes b) { return _mm256_sub_ps(a, b); }
+static inline Lanes LanesMul(Lanes a, Lanes b) { return _mm256_mul_ps(a, b); }
+static inline Lanes LanesDiv(Lanes a, Lanes b) { return _mm256_div_ps(a, b); }
+static inline Lanes LanesSqrt(Lanes a) { return _mm256_sqrt_ps(a); }
+static inline Lanes LanesMin(Lanes a, Lanes b) { return _mm256_min_ps(a, b); }
+static inline Lanes LanesMax(Lanes a, Lanes b) { return _mm256_max_ps(a, b); }
+
+// a where b is greater than zero, zero elsewhere
+static inline Lanes LanesKeepPositive(Lanes a, Lanes b) {
+  return _mm256_and_ps(a, _mm256_cmp_ps(b, _mm256_setzero_ps(), _CMP_GT_OQ));
+}
+#elif defined(XMATH_USE_SSE)
+#define LANES 4
+typedef __m128 Lanes;
+
+static inline Lanes LanesLoad(const float *p) { return _mm_load_ps(p); }
+static inline Lanes LanesLoadU(const float *p) { return _mm_loadu_ps(p); }
+static inline void LanesStore(float *p, Lanes v) { _mm_store_ps(p, v); }
+static inline void LanesStoreU(float *p, Lanes v) { _mm_storeu_ps(p, v); }
+static inline Lanes LanesSet1(float f) { return _mm_set1_ps(f); }
+static inline Lanes LanesAdd(Lanes a, Lanes b) { return _mm_add_ps(a, b); }
+static inline Lanes LanesSub(Lanes a, Lanes b) { return _mm_sub_ps(a, b); }
+static inline Lanes LanesMul(Lanes a, Lanes b) { return _mm_mul_ps(a, b); }
+static inline Lanes LanesDiv(Lanes a, Lanes b) { return _mm_div_ps(a, b); }
+static inline Lanes LanesSqrt(Lanes a) { return _mm_sqrt_ps(a); }
+static inline Lanes LanesMin(Lanes a, Lanes b) { return _mm_min_ps(a, b); }
+static inline Lanes LanesMax(Lanes a, Lanes b) { return _mm_max_ps(a, b); }
+
+static inline Lanes LanesKeepPositive(Lanes a, Lanes b) {
+  return _mm_and_ps(a, _mm_cmpgt_ps(b, _mm_setzero_ps()));
+}
+#elif defined(XMATH_USE_NEON)
+#define LANES 4
+typedef float32x4_t Lanes;
+
+static inline Lanes LanesLoad(const float *p) { return vld1q_f32(p); }
+static inline Lanes LanesLoadU(const float *p) { return vld1q_f32(p); }
+static inline void LanesStore(float *p, Lanes v) { vst1q_f32(p, v); }
+static inline void LanesStoreU(float *p, Lanes v) { vst1q_f32(p, v); }
+static inline Lanes LanesSet1(float f) { return vdupq_n_f32(f); }
+static inline Lanes LanesAdd(Lanes a, Lanes b) { return vaddq_f32(a, b); }
+static inline Lanes LanesSub(Lanes a, Lanes b) { return vsubq_f32(a, b); }
+static inline Lanes LanesMul(Lanes a, Lanes b) { return vmulq_f32(a, b); }
+static inline Lanes LanesDiv(Lanes a, Lanes b) { return vdivq_f32(a, b); }
+static inline Lanes LanesSqrt(Lanes a) { return vsqrtq_f32(a); }
+static inline Lanes LanesMin(Lanes a, Lanes b) { return vminq_f32(a, b); }
+static inline Lanes LanesMax(Lanes a, Lanes b) { return vmaxq_f32(a, b); }
+
+static inline Lanes LanesKeepPositive(Lanes a, Lanes b) {
+  return vbslq_f32(vcgtzq_f32(b), a, vdupq_n_f32(0.0f));
+}
+#else
+#define LANES 1
+typedef float Lanes;
+
+static inline Lanes LanesLoad(const float *p) { return *p; }
+static inline Lanes LanesLoadU(const float *p) { return *p; }
+static inline void LanesStore(float *p, Lanes v) { *p = v; }
+static inline void LanesStoreU(float *p, Lanes v) { *p = v; }
+static inline Lanes LanesSet1(float f) { return f; }
+static inline Lanes LanesAdd(Lanes a, Lanes b) { return a + b; }
+static inline Lanes LanesSub(Lanes a, Lanes b) { return a - b; }
+static inline Lanes LanesMul(Lanes a, Lanes b) { return a * b; }
+static inline Lanes LanesDiv(Lanes a, Lanes b) { return a / b; }
+static inline Lanes LanesSqrt(Lanes a) { return sqrtf(a); }
+static inline Lanes LanesMin(Lanes a, Lanes b) { return a < b ? a : b; }
+static inline Lanes LanesMax(Lanes a, Lanes b) { return a > b ? a : b; }
+
+static inline Lanes LanesKeepPositive(Lanes a, Lanes b) {
+  return b > 0.0f ? a : 0.0f;
+}
+#endif
+
+// Element wise kernels run over whole registers up to here, padding included
+static inline size_t PaddedCount(size_t count) {
+  return (count + LANES - 1) & ~(size_t)(LANES - 1);
+}
+
+// Allocates dims arrays of capacity floats in a single zeroed block
+static bool AllocArrays(float **arrays, int dims, size_t count,
+                        size_t *capacity, void **block) {
+  *block = NULL;
+  *capacity = 0;
+  for (int i = 0; i < dims; i++) {
+    arrays[i] = NULL;
+  }
+
+  if (count == 0) {
+    return true;
+  }
+
+  size_t padded = (count + STREAM_LANES - 1) & ~(size_t)(STREAM_LANES - 1);
+  if (padded < count || padded > (SIZE_MAX - STREAM_ALIGN) / sizeof(float) /
+                                     (size_t)dims) {
+    return false;
+  }
+
+  *block = calloc(1, padded * sizeof(float) * (size_t)dims + STREAM_ALIGN);
+  if (*block == NULL) {
+    return false;
+  }
+
+  uintptr_t base = ((uintptr_t)*block + STREAM_ALIGN - 1) &
+                   ~(uintptr_t)(STREAM_ALIGN - 1);
+  for (int i = 0; i < dims; i++) {
+    arrays[i] = (float *)base + padded * (size_t)i;
+  }
+  *capacity = padded;
+  return true;
+}
+
+static void AddRaw(float *r, const float *a, const float *b, size_t n) {
+  for (size_t i = 0; i < n; i += LANES) {
+    LanesStore(r + i, LanesAdd(LanesLoad(a + i), LanesLoad(b + i)));
+  }
+}
+
+static void SubRaw(float *r, const float *a, const float *b, size_t n) {
+  for (size_t i = 0; i < n; i += LANES) {
+    LanesStore(r + i, LanesSub(LanesLoad(a + i), LanesLoad(b + i)));
+  }
+}
+
+static void ScaleRaw(float *r, const float *a, float s, size_t n) {
+  Lanes k = LanesSet1(s);
+  for (size_t i = 0; i < n; i += LANES) {
+    LanesStore(r + i, LanesMul(LanesLoad(a + i), k));
+  }
+}
+
+// Folds the first n floats of a, padding excluded
+static void MinMaxRaw(const float *a, size_t n, float *min, float *max) {
+  size_t full = n & ~(size_t)(LANES - 1);
+  float lo = a[0];
+  float hi = a[0];
+  if (full > 0) {
+    Lanes vlo = LanesLoad(a);
+    Lanes vhi = vlo;
+    for (size_t i = LANES; i < full; i += LANES) {
+      Lanes v = LanesLoad(a + i);
+      vlo = LanesMin(vlo, v);
+      vhi = LanesMax(vhi, v);
+    }
+
+    float los[LANES];
+    float his[LANES];
+    LanesStoreU(los, vlo);
+    LanesStoreU(his, vhi);
+    for (int l = 0; l < LANES; l++) {
+      lo = los[l] < lo ? los[l] : lo;
+      hi = his[l] > hi ? his[l] : hi;
+    }
+  }
+
+  for (size_t i = full; i < n; i++) {
+    lo = a[i] < lo ? a[i] : lo;
+    hi = a[i] > hi ? a[i] : hi;
+  }
+  *min = lo;
+  *max = hi;
+}
+
+// Stores the first n lanes of v, the others would run past dst
+static inline void StorePartial(float *dst, Lanes v, size_t n) {
+  if (n >= LANES) {
+    LanesStoreU(dst, v);
+    return;
+  }
+
+  float lanes[LANES];
+  LanesStoreU(lanes, v);
+  memcpy(dst, lanes, n * sizeof(float));
+}
+
+// 1 / len where len > 0, zero elsewhere
+static inline Lanes InvLen(Lanes sqrLen) {
+  Lanes len = LanesSqrt(sqrLen);
+  return LanesKeepPositive(LanesDiv(LanesSet1(1.0f), len), len);
+}
+
+bool Vec3StreamAlloc(Vec3Stream *s, size_t count) {
+  assert(s != NULL);
+  float *arrays[3];
+  bool ok = AllocArrays(arrays, 3, count, &s->capacity, &s->block);
+  s->x = arrays[0];
+  s->y = arrays[1];
+  s->z = arrays[2];
+  s->count = ok ? count : 0;
+  return ok;
+}
+
+void Vec3StreamFree(Vec3Stream *s) {
+  assert(s != NULL);
+  free(s->block);
+  *s = (Vec3Stream){0};
+}
+
+void Vec3StreamGather(Vec3Stream *s, const Vec3 *src, size_t stride) {
+  assert(s != NULL && (src != NULL || s->count == 0));
+  const char *p = (const char *)src;
+  for (size_t i = 0; i < s->count; i++, p += stride) {
+    const Vec3 *v = (const Vec3 *)p;
+    s->x[i] = v->x;
+    s->y[i] = v->y;
+    s->z[i] = v->z;
+  }
+}
+
+void Vec3StreamScatter(const Vec3Stream *s, Vec3 *dst, size_t stride) {
+  assert(s != NULL && (dst != NULL || s->count == 0));
+  char *p = (char *)dst;
+  for (size_t i = 0; i < s->count; i++, p += stride) {
+    Vec3 *v = (Vec3 *)p;
+    v->x = s->x[i];
+    v->y = s->y[i];
+    v->z = s->z[i];
+  }
+}
+
+void Vec3StreamAdd(Vec3Stream *dst, const Vec3Stream *a, const Vec3Stream *b) {
+  assert(dst->count == a->count && "invalid arg dst: count differs from a");
+  assert(b->count == a->count && "invalid arg b: count differs from a");
+  size_t n = PaddedCount(a->count);
+  AddRaw(dst->x, a->x, b->x, n);
+  AddRaw(dst->y, a->y, b->y, n);
+  AddRaw(dst->z, a->z, b->z, n);
+}
+
+void Vec3StreamSub(Vec3Stream *dst, const Vec3Stream *a, const Vec3Stream *b) {
+  assert(dst->count == a->count && "invalid arg dst: count differs from a");
+  assert(b->count == a->count && "invalid arg b: count differs from a");
+  size_t n = PaddedCount(a->count);
+  SubRaw(dst->x, a->x, b->x, n);
+  SubRaw(dst->y, a->y, b->y, n);
+  SubRaw(dst->z, a->z, b->z, n);
+}
+
+void Vec3StreamScale(Vec3Stream *dst, const Vec3Stream *a, float s) {
+  assert(dst->count == a->count && "invalid arg dst: count differs from a");
+  size_t n = PaddedCount(a->count);
+  ScaleRaw(dst->x, a->x, s, n);
+  ScaleRaw(dst->y, a->y, s, n);
+  ScaleRaw(dst->z, a->z, s, n);
+}
+
+void Vec3StreamDot(float *dst, const Vec3Stream *a, const Vec3Stream *b) {
+  assert(b->count == a->count && "invalid arg b: count differs from a");
+  for (size_t i = 0; i < a->count; i += LANES) {
+    Lanes r = LanesMul(LanesLoad(a->x + i), LanesLoad(b->x + i));
+    r = LanesAdd(r, LanesMul(LanesLoad(a->y + i), LanesLoad(b->y + i)));
+    r = LanesAdd(r, LanesMul(LanesLoad(a->z + i), LanesLoad(b->z + i)));
+    StorePartial(dst + i, r, a->count - i);
+  }
+}
+
+void Vec3StreamCross(Vec3Stream *dst, const Vec3Stream *a,
+                     const Vec3Stream *b) {
+  assert(dst->count == a->count && "invalid arg dst: count differs from a");
+  assert(b->count == a->count && "invalid arg b: count differs from a");
+  size_t n = PaddedCount(a->count);
+  for (size_t i = 0; i < n; i += LANES) {
+    Lanes ax = LanesLoad(a->x + i);
+    Lanes ay = LanesLoad(a->y + i);
+    Lanes az = LanesLoad(a->z + i);
+    Lanes bx = LanesLoad(b->x + i);
+    Lanes by = LanesLoad(b->y + i);
+    Lanes bz = LanesLoad(b->z + i);
+    LanesStore(dst->x + i, LanesSub(LanesMul(ay, bz), LanesMul(az, by)));
+    LanesStore(dst->y + i, LanesSub(LanesMul(az, bx), LanesMul(ax, bz)));
+    LanesStore(dst->z + i, LanesSub(LanesMul(ax, by), LanesMul(ay, bx)));
+  }
+}
+
+void Vec3StreamBlend(Vec3Stream *dst, const Vec3Stream *a, const float *wa,
+                     const Vec3Stream *b, const float *wb) {
+  assert(dst->count == a->count && "invalid arg dst: count differs from a");
+  assert(b->count == a->count && "invalid arg b: count differs from a");
+
+  // Weights are not padded, the last partial register is done one by one
+  size_t full = a->count & ~(size_t)(LANES - 1);
+  for (size_t i = 0; i < full; i += LANES) {
+    Lanes ka = LanesLoadU(wa + i);
+    Lanes kb = LanesLoadU(wb + i);
+    LanesStore(dst->x + i, LanesAdd(LanesMul(LanesLoad(a->x + i), ka),
+                                    LanesMul(LanesLoad(b->x + i), kb)));
+    LanesStore(dst->y + i, LanesAdd(LanesMul(LanesLoad(a->y + i), ka),
+                                    LanesMul(LanesLoad(b->y + i), kb)));
+    LanesStore(dst->z + i, LanesAdd(LanesMul(LanesLoad(a->z + i), ka),
+                                    LanesMul(LanesLoad(b->z + i), kb)));
+  }
+
+  for (size_t i = full; i < a->count; i++) {
+    dst->x[i] = a->x[i] * wa[i] + b->x[i] * wb[i];
+    dst->y[i] = a->y[i] * wa[i] + b->y[i] * wb[i];
+    dst->z[i] = a->z[i] * wa[i] + b->z[i] * wb[i];
+  }
+}
+
+void Vec3StreamNorm(Vec3Stream *dst, const Vec3Stream *a) {
+  assert(dst->count == a->count && "invalid arg dst: count differs from a");
+  size_t n = PaddedCount(a->count);
+  for (size_t i = 0; i < n; i += LANES) {
+    Lanes x = LanesLoad(a->x + i);
+    Lanes y = LanesLoad(a->y + i);
+    Lanes z = LanesLoad(a->z + i);
+    Lanes sqr = LanesMul(x, x);
+    sqr = LanesAdd(sqr, LanesMul(y, y));
+    sqr = LanesAdd(sqr, LanesMul(z, z));
+    Lanes k = InvLen(sqr);
+    LanesStore(dst->x + i, LanesMul(x, k));
+    LanesStore(dst->y + i, LanesMul(y, k));
+    LanesStore(dst->z + i, LanesMul(z, k));
+  }
+}
+
+void Vec3StreamMinMax(const Vec3Stream *a, Vec3 *min, Vec3 *max) {
+  assert(a->count > 0 && "invalid arg a: empty stream");
+  MinMaxRaw(a->x, a->count, &min->x, &max->x);
+  MinMaxRaw(a->y, a->count, &min->y, &max->y);
+  MinMaxRaw(a->z, a->count, &min->z, &max->z);
+}
+
+void Vec3StreamTransform(Vec3Stream *dst, const Mat4 *m, const Vec3Stream *a,
+                         float w) {
+  assert(dst->count == a->count && "invalid arg dst: count differs from a");
+  Lanes xx = LanesSet1(m->xx), yx = LanesSet1(m->yx), zx = LanesSet1(m->zx);
+  Lanes xy = LanesSet1(m->xy), yy = LanesSet1(m->yy), zy = LanesSet1(m->zy);
+  Lanes xz = LanesSet1(m->xz), yz = LanesSet1(m->yz), zz = LanesSet1(m->zz);
+  Lanes tx = LanesSet1(m->wx * w);
+  Lanes ty = LanesSet1(m->wy * w);
+  Lanes tz = LanesSet1(m->wz * w);
+
+  // dst = col0 * x + col1 * y + col2 * z + col3 * w
+  size_t n = PaddedCount(a->count);
+  for (size_t i = 0; i < n; i += LANES) {
+    Lanes x = LanesLoad(a->x + i);
+    Lanes y = LanesLoad(a->y + i);
+    Lanes z = LanesLoad(a->z + i);
+    Lanes rx = LanesAdd(LanesMul(xx, x), LanesMul(yx, y));
+    Lanes ry = LanesAdd(LanesMul(xy, x), LanesMul(yy, y));
+    Lanes rz = LanesAdd(LanesMul(xz, x), LanesMul(yz, y));
+    rx = LanesAdd(LanesAdd(rx, LanesMul(zx, z)), tx);
+    ry = LanesAdd(LanesAdd(ry, LanesMul(zy, z)), ty);
+    rz = LanesAdd(LanesAdd(rz, LanesMul(zz, z)), tz);
+    LanesStore(dst->x + i, rx);
+    LanesStore(dst->y + i, ry);
+    LanesStore(dst->z + i, rz);
+  }
+}
+
+bool Vec4StreamAlloc(Vec4Stream *s, size_t count) {
+  assert(s != NULL);
+  float *arrays[4];
+  bool ok = AllocArrays(arrays, 4, count, &s->capacity, &s->block);
+  s->x = arrays[0];
+  s->y = arrays[1];
+  s->z = arrays[2];
+  s->w = arrays[3];
+  s->count = ok ? count : 0;
+  return ok;
+}
+
+void Vec4StreamFree(Vec4Stream *s) {
+  assert(s != NULL);
+  free(s->block);
+  *s = (Vec4Stream){0};
+}
+
+void Vec4StreamGather(Vec4Stream *s, const Vec4 *src, size_t stride) {
+  assert(s != NULL && (src != NULL || s->count == 0));
+  const char *p = (const char *)src;
+  for (size_t i = 0; i < s->count; i++, p += stride) {
+    const Vec4 *v = (const Vec4 *)p;
+    s->x[i] = v->x;
+    s->y[i] = v->y;
+    s->z[i] = v->z;
+    s->w[i] = v->w;
+  }
+}
+
+void Vec4StreamScatter(const Vec4Stream *s, Vec4 *dst, size_t stride) {
+  assert(s != NULL && (dst != NULL || s->count == 0));
+  char *p = (char *)dst;
+  for (size_t i = 0; i < s->count; i++, p += stride) {
+    Vec4 *v = (Vec4 *)p;
+    v->x = s->x[i];
+    v->y = s->y[i];
+    v->z = s->z[i];
+    v->w = s->w[i];
+  }
+}
+
+void Vec4StreamAdd(Vec4Stream *dst, const Vec4Stream *a, const Vec4Stream *b) {
+  assert(dst->count == a->count && "invalid arg dst: count differs from a");
+  assert(b->count == a->count && "invalid arg b: count differs from a");
+  size_t n = PaddedCount(a->count);
+  AddRaw(dst->x, a->x, b->x, n);
+  AddRaw(dst->y, a->y, b->y, n);
+  AddRaw(dst->z, a->z, b->z, n);
+  AddRaw(dst->w, a->w, b->w, n);
+}
+
+void Vec4StreamSub(Vec4Stream *dst, const Vec4Stream *a, const Vec4Stream *b) {
+  assert(dst->count == a->count && "invalid arg dst: count differs from a");
+  assert(b->count == a->count && "invalid arg b: count differs from a");
+  size_t n = PaddedCount(a->count);
+  SubRaw(dst->x, a->x, b->x, n);
+  SubRaw(dst->y, a->y, b->y, n);
+  SubRaw(dst->z, a->z, b->z, n);
+  SubRaw(dst->w, a->w, b->w, n);
+}
+
+void Vec4StreamScale(Vec4Stream *dst, const Vec4Stream *a, float s) {
+  assert(dst->count == a->count && "invalid arg dst: count differs from a");
+  size_t n = PaddedCount(a->count);
+  ScaleRaw(dst->x, a->x, s, n);
+  ScaleRaw(dst->y, a->y, s, n);
+  ScaleRaw(dst->z, a->z, s, n);
+  ScaleRaw(dst->w, a->w, s, n);
+}
+
+void Vec4StreamDot(float *dst, const Vec4Stream *a, const Vec4Stream *b) {
+  assert(b->count == a->count && "invalid arg b: count differs from a");
+  for (size_t i = 0; i < a->count; i += LANES) {
+    Lanes r = LanesMul(LanesLoad(a->x + i), LanesLoad(b->x + i));
+    r = LanesAdd(r, LanesMul(LanesLoad(a->y + i), LanesLoad(b->y + i)));
+    r = LanesAdd(r, LanesMul(LanesLoad(a->z + i), LanesLoad(b->z + i)));
+    r = LanesAdd(r, LanesMul(LanesLoad(a->w + i), LanesLoad(b->w + i)));
+    StorePartial(dst + i, r, a->count - i);
+  }
+}
+
+void Vec4StreamNorm(Vec4Stream *dst, const Vec4Stream *a) {
+  assert(dst->count == a->count && "invalid arg dst: count differs from a");
+  size_t n = PaddedCount(a->count);
+  for (size_t i = 0; i < n; i += LANES) {
+    Lanes x = LanesLoad(a->x + i);
+    Lanes y = LanesLoad(a->y + i);
+    Lanes z = LanesLoad(a->z + i);
+    Lanes w = LanesLoad(a->w + i);
+    Lanes sqr = LanesMul(x, x);
+    sqr = LanesAdd(sqr, LanesMul(y, y));
+    sqr = LanesAdd(sqr, LanesMul(z, z));
+    sqr = LanesAdd(sqr, LanesMul(w, w));
+    Lanes k = InvLen(sqr);
+    LanesStore(dst->x + i, LanesMul(x, k));
+    LanesStore(dst->y + i, LanesMul(y, k));
+    LanesStore(dst->z + i, LanesMul(z, k));
+    LanesStore(dst->w + i, LanesMul(w, k));
+  }
+}
+
+void Vec4StreamMinMax(const Vec4Stream *a, Vec4 *min, Vec4 *max) {
+  assert(a->count > 0 && "invalid arg a: empty stream");
+  MinMaxRaw(a->x, a->count, &min->x, &max->x);
+  MinMaxRaw(a->y, a->count, &min->y, &max->y);
+  MinMaxRaw(a->z, a->count, &min->z, &max->z);
+  MinMaxRaw(a->w, a->count, &min->w, &max->w);
+}
+
+void Vec4StreamTransform(Vec4Stream *dst, const Mat4 *m, const Vec4Stream *a) {
+  assert(dst->count == a->count && "invalid arg dst: count differs from a");
+  const float *raw = Mat4Raw(m);
+  Lanes g[16];
+  for (int e = 0; e < 16; e++) {
+    g[e] = LanesSet1(raw[e]);
+  }
+
+  // Component c of dst = group0[c] * x + group1[c] * y + group2[c] * z +
+  // group3[c] * w
+  size_t n = PaddedCount(a->count);
+  float *out[4] = {dst->x, dst->y, dst->z, dst->w};
+  for (size_t i = 0; i < n; i += LANES) {
+    Lanes x = LanesLoad(a->x + i);
+    Lanes y = LanesLoad(a->y + i);
+    Lanes z = LanesLoad(a->z + i);
+    Lanes w = LanesLoad(a->w + i);
+    Lanes r[4];
+    for (int c = 0; c < 4; c++) {
+      r[c] = LanesMul(g[c], x);
+      r[c] = LanesAdd(r[c], LanesMul(g[4 + c], y));
+      r[c] = LanesAdd(r[c], LanesMul(g[8 + c], z));
+      r[c] = LanesAdd(r[c], LanesMul(g[12 + c], w));
+    }
+
+    // Every input is loaded before the stores, dst may be a
+    for (int c = 0; c < 4; c++) {
+      LanesStore(out[c] + i, r[c]);
+    }
+  }
+}
@@ -0,0 +1,197 @@
+#pragma once
+#include "mat4.h"
+#include "vec3.h"
+#include "vec4.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+// Components of a stream are aligned to this many bytes and padded to a
+// multiple of this many floats, a full AVX register
+#define STREAM_ALIGN 32
+#define STREAM_LANES 8
+
+/**
+ * \brief Many Vec3 stored by component (structure of arrays).
+ *
+ * Each component lives in its own aligned array so that kernels over the
+ * whole stream load a full register of the same component at once, instead
+ * of shuffling X, Y and Z apart from every vector. Arrays are padded up to
+ * capacity, a multiple of STREAM_LANES; padding lanes take part in the
+ * element wise kernels and hold unspecified values.
+ */
+typedef struct {
+  float *x;
+  float *y;
+  float *z;
+  size_t count;
+  size_t capacity;
+  void *block;
+} Vec3Stream;
+
+/**
+ * \brief Many Vec4 stored by component, same layout as Vec3Stream.
+ */
+typedef struct {
+  float *x;
+  float *y;
+  float *z;
+  float *w;
+  size_t count;
+  size_t capacity;
+  void *block;
+} Vec4Stream;
+
+/**
+ * \brief Allocates a stream of count vectors, all of them zero.
+ * \return false when out of memory, the stream is left empty.
+ */
+bool Vec3StreamAlloc(Vec3Stream *s, size_t count);
+
+/**
+ * \brief Releases the arrays of a stream and leaves it empty.
+ */
+void Vec3StreamFree(Vec3Stream *s);
+
+/**
+ * \brief Copies interleaved vectors into a stream.
+ *
+ * \param Vec3Stream s destination, takes s->count vectors.
+ * \param Vec3 src first vector to copy.
+ * \param size_t stride bytes from a vector to the next one, such as
+ * sizeof(Vertex) to take one attribute of a vertex array.
+ */
+void Vec3StreamGather(Vec3Stream *s, const Vec3 *src, size_t stride);
+
+/**
+ * \brief Copies a stream back into interleaved vectors, leaving the bytes
+ * between them untouched. Same parameters as Vec3StreamGather.
+ */
+void Vec3StreamScatter(const Vec3Stream *s, Vec3 *dst, size_t stride);
+
+/**
+ * \brief Adds two streams vector by vector, dst may be a or b.
+ */
+void Vec3StreamAdd(Vec3Stream *dst, const Vec3Stream *a, const Vec3Stream *b);
+
+/**
+ * \brief Subtracts two streams vector by vector, dst may be a or b.
+ */
+void Vec3StreamSub(Vec3Stream *dst, const Vec3Stream *a, const Vec3Stream *b);
+
+/**
+ * \brief Scales every vector of a stream, dst may be a.
+ */
+void Vec3StreamScale(Vec3Stream *dst, const Vec3Stream *a, float s);
+
+/**
+ * \brief Dot product of every pair of vectors.
+ * \param float dst a->count results.
+ */
+void Vec3StreamDot(float *dst, const Vec3Stream *a, const Vec3Stream *b);
+
+/**
+ * \brief Cross product of every pair of vectors, dst may be a or b.
+ */
+void Vec3StreamCross(Vec3Stream *dst, const Vec3Stream *a,
+                     const Vec3Stream *b);
+
+/**
+ * \brief Adds two streams with a weight for every vector,
+ * dst = a * wa + b * wb. dst may be a or b.
+ *
+ * \param float wa a->count weights of a.
+ * \param float wb a->count weights of b.
+ */
+void Vec3StreamBlend(Vec3Stream *dst, const Vec3Stream *a, const float *wa,
+                     const Vec3Stream *b, const float *wb);
+
+/**
+ * \brief Normalizes every vector of a stream, dst may be a.
+ *
+ * Gives the same bits as Vec3Norm, except for vectors without length which
+ * stay zero instead of turning into NaN.
+ */
+void Vec3StreamNorm(Vec3Stream *dst, const Vec3Stream *a);
+
+/**
+ * \brief Smallest and largest components over a whole stream.
+ *
+ * \param Vec3Stream a stream to reduce, must not be empty.
+ * \param Vec3 min per component minimum, same as folding Vec3Min.
+ * \param Vec3 max per component maximum, same as folding Vec3Max.
+ */
+void Vec3StreamMinMax(const Vec3Stream *a, Vec3 *min, Vec3 *max);
+
+/**
+ * \brief Transforms every vector of a stream by the affine part of a matrix.
+ *
+ * \param Vec3Stream dst transformed vectors, may be a.
+ * \param Mat4 m transformation, its projective part is ignored.
+ * \param Vec3Stream a vectors to transform.
+ * \param float w 1 for points, 0 for directions.
+ */
+void Vec3StreamTransform(Vec3Stream *dst, const Mat4 *m, const Vec3Stream *a,
+                         float w);
+
+/**
+ * \brief Allocates a stream of count vectors, all of them zero.
+ * \return false when out of memory, the stream is left empty.
+ */
+bool Vec4StreamAlloc(Vec4Stream *s, size_t count);
+
+/**
+ * \brief Releases the arrays of a stream and leaves it empty.
+ */
+void Vec4StreamFree(Vec4Stream *s);
+
+/**
+ * \brief Copies interleaved vectors into a stream, see Vec3StreamGather.
+ */
+void Vec4StreamGather(Vec4Stream *s, const Vec4 *src, size_t stride);
+
+/**
+ * \brief Copies a stream back into interleaved vectors, see
+ * Vec3StreamScatter.
+ */
+void Vec4StreamScatter(const Vec4Stream *s, Vec4 *dst, size_t stride);
+
+/**
+ * \brief Adds two streams vector by vector, dst may be a or b.
+ */
+void Vec4StreamAdd(Vec4Stream *dst, const Vec4Stream *a, const Vec4Stream *b);
+
+/**
+ * \brief Subtracts two streams vector by vector, dst may be a or b.
+ */
+void Vec4StreamSub(Vec4Stream *dst, const Vec4Stream *a, const Vec4Stream *b);
+
+/**
+ * \brief Scales every vector of a stream, dst may be a.
+ */
+void Vec4StreamScale(Vec4Stream *dst, const Vec4Stream *a, float s);
+
+/**
+ * \brief Dot product of every pair of vectors.
+ * \param float dst a->count results.
+ */
+void Vec4StreamDot(float *dst, const Vec4Stream *a, const Vec4Stream *b);
+
+/**
+ * \brief Normalizes every vector of a stream, dst may be a. Vectors without
+ * length stay zero.
+ */
+void Vec4StreamNorm(Vec4Stream *dst, const Vec4Stream *a);
+
+/**
+ * \brief Smallest and largest components over a whole stream, which must
+ * not be empty.
+ */
+void Vec4StreamMinMax(const Vec4Stream *a, Vec4 *min, Vec4 *max);
+
+/**
+ * \brief Transforms every vector of a stream the way shaders do (column
+ * times component), as Mat4TransformPoints with w taken from the stream.
+ *
+ * \param Vec4Stream dst transformed vectors, may be a.
+ */
+void Vec4StreamTransform(Vec4Stream *dst, const Mat4 *m, const Vec4Stream *a);
@@ -1,24 +1,316 @@
 #include "transform.h"
 
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define XMATH_USE_SSE
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define XMATH_USE_NEON
+#endif
+
+// Range reduction and minimax polynomials of Cephes sinf and cosf, used by
+// the batch path. |x| is reduced by multiples of pi/4 in three parts.
+#define SINCOS_FOPI 1.27323954473516f
+#define SINCOS_DP1 0.78515625f
+#define SINCOS_DP2 2.4187564849853515625e-4f
+#define SINCOS_DP3 3.77489497744594108e-8f
+#define SINCOS_S0 -1.9515295891e-4f
+#define SINCOS_S1 8.3321608736e-3f
+#define SINCOS_S2 -1.6666654611e-1f
+#define SINCOS_C0 2.443315711809948e-5f
+#define SINCOS_C1 -1.388731625493765e-3f
+#define SINCOS_C2 4.166664568298827e-2f
+
+// Transforms handled at once by the batch path
+#define TRANSFORM_BLOCK 4
+
 Transform MakeTransform() {
   return (Transform){
       .scale = Vec3One,
       .origin = Vec3Zero,
       .angles = Vec3Zero,
+      .rotation = QuatIdentity,
   };
 }
 
+static bool IsIdentity(Quat q) {
+  return q.x == 0.0f && q.y == 0.0f && q.z == 0.0f && q.w == 1.0f;
+}
+
+// Rotates the scaled Euler rotation in m by q, skipped for the identity so
+// that transforms without quaternion pay nothing
+static void ApplyRotation(Mat4 *m, Quat q) {
+  if (IsIdentity(q)) {
+    return;
+  }
+
+  Mat4 r = QuatToMat4(q);
+  float *raw = Mat4Raw(m);
+  for (int i = 0; i < 12; i += 4) {
+    float x = raw[i];
+    float y = raw[i + 1];
+    float z = raw[i + 2];
+    raw[i] = x * r.xx + y * r.yx + z * r.zx;
+    raw[i + 1] = x * r.xy + y * r.yy + z * r.zy;
+    raw[i + 2] = x * r.xz + y * r.yz + z * r.zz;
+  }
+}
+
 Mat4 TransformGetModelMatrix(Transform transform) {
-  Mat4 s = Mat4MakeScale(transform.scale);
-  Mat4 rx = Mat4MakeRotationX(transform.angles.x);
-  Mat4 ry = Mat4MakeRotationY(transform.angles.y);
-  Mat4 rz = Mat4MakeRotationZ(transform.angles.z);
-  Mat4 m = s;
-  m = Mat4Mul(m, rx);
-  m = Mat4Mul(m, ry);
-  m = Mat4Mul(m, rz);
-
-  Mat4 t = Mat4MakeTranslation(transform.origin);
-  m = Mat4Mul(m, t);
+  float sx = sinf(transform.angles.x);
+  float cx = cosf(transform.angles.x);
+  float sy = sinf(transform.angles.y);
+  float cy = cosf(transform.angles.y);
+  float sz = sinf(transform.angles.z);
+  float cz = cosf(transform.angles.z);
+  Vec3 k = transform.scale;
+
+  // Scale * RotationX * RotationY * RotationZ * Translation, products are
+  // grouped as the full matrix multiplications would group them. The
+  // quaternion goes before the translation, which it does not change.
+  float a0 = k.x * cy;
+  float a1 = k.y * sx * sy;
+  float b1 = k.y * cx;
+  float a2 = k.z * cx * sy;
+  float b2 = k.z * sx;
+
+  Mat4 m;
+  m.xx = a0 * cz;
+  m.xy = a0 * sz;
+  m.xz = -(k.x * sy);
+  m.xw = 0.0f;
+  m.yx = a1 * cz - b1 * sz;
+  m.yy = a1 * sz + b1 * cz;
+  m.yz = k.y * sx * cy;
+  m.yw = 0.0f;
+  m.zx = a2 * cz + b2 * sz;
+  m.zy = a2 * sz - b2 * cz;
+  m.zz = k.z * cx * cy;
+  m.zw = 0.0f;
+  m.wx = transform.origin.x;
+  m.wy = transform.origin.y;
+  m.wz = transform.origin.z;
+  m.ww = 1.0f;
+  ApplyRotation(&m, transform.rotation);
   return m;
 }
+
+Affine3x4 TransformGetAffine(Transform transform) {
+  return Affine3x4FromMat4(TransformGetModelMatrix(transform));
+}
+
+#if defined(XMATH_USE_SSE)
+static void SinCos4(__m128 x, __m128 *s, __m128 *c) {
+  const __m128 signBit = _mm_set1_ps(-0.0f);
+  __m128 sinSign = _mm_and_ps(x, signBit);
+  x = _mm_andnot_ps(signBit, x);
+
+  // Nearest even multiple of pi/4, its bits 1 and 2 pick the polynomial
+  // and the signs
+  __m128i j = _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(SINCOS_FOPI)));
+  j = _mm_and_si128(_mm_add_epi32(j, _mm_set1_epi32(1)), _mm_set1_epi32(~1));
+  __m128 y = _mm_cvtepi32_ps(j);
+  x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(SINCOS_DP1)));
+  x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(SINCOS_DP2)));
+  x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(SINCOS_DP3)));
+
+  __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(
+      _mm_and_si128(j, _mm_set1_epi32(2)), _mm_set1_epi32(2)));
+  sinSign = _mm_xor_ps(sinSign, _mm_castsi128_ps(_mm_slli_epi32(
+                                    _mm_and_si128(j, _mm_set1_epi32(4)), 29)));
+  __m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(
+      _mm_andnot_si128(_mm_sub_epi32(j, _mm_set1_epi32(2)),
+                       _mm_set1_epi32(4)),
+      29));
+
+  __m128 z = _mm_mul_ps(x, x);
+  __m128 pc = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(SINCOS_C0), z),
+                         _mm_set1_ps(SINCOS_C1));
+  pc = _mm_add_ps(_mm_mul_ps(pc, z), _mm_set1_ps(SINCOS_C2));
+  pc = _mm_mul_ps(_mm_mul_ps(pc, z), z);
+  pc = _mm_sub_ps(pc, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+  pc = _mm_add_ps(pc, _mm_set1_ps(1.0f));
+
+  __m128 ps = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(SINCOS_S0), z),
+                         _mm_set1_ps(SINCOS_S1));
+  ps = _mm_add_ps(_mm_mul_ps(ps, z), _mm_set1_ps(SINCOS_S2));
+  ps = _mm_mul_ps(_mm_mul_ps(ps, z), x);
+  ps = _mm_add_ps(ps, x);
+
+  __m128 sinValue =
+      _mm_or_ps(_mm_and_ps(swap, pc), _mm_andnot_ps(swap, ps));
+  __m128 cosValue =
+      _mm_or_ps(_mm_and_ps(swap, ps), _mm_andnot_ps(swap, pc));
+  *s = _mm_xor_ps(sinValue, sinSign);
+  *c = _mm_xor_ps(cosValue, cosSign);
+}
+
+// Stores row i of four matrices given as one vector per element, lane j
+// going to matrix j
+static void StoreRows4(Mat4 *dst, int row, __m128 x, __m128 y, __m128 z,
+                       __m128 w) {
+  _MM_TRANSPOSE4_PS(x, y, z, w);
+  _mm_storeu_ps(Mat4Raw(dst) + row * 4, x);
+  _mm_storeu_ps(Mat4Raw(dst + 1) + row * 4, y);
+  _mm_storeu_ps(Mat4Raw(dst + 2) + row * 4, z);
+  _mm_storeu_ps(Mat4Raw(dst + 3) + row * 4, w);
+}
+
+static void ModelMatrices4(const Transform *t, Mat4 *dst) {
+#define LANES(field)                                                          \
+  _mm_setr_ps(t[0].field, t[1].field, t[2].field, t[3].field)
+  __m128 sx, cx, sy, cy, sz, cz;
+  SinCos4(LANES(angles.x), &sx, &cx);
+  SinCos4(LANES(angles.y), &sy, &cy);
+  SinCos4(LANES(angles.z), &sz, &cz);
+  __m128 kx = LANES(scale.x);
+  __m128 ky = LANES(scale.y);
+  __m128 kz = LANES(scale.z);
+
+  __m128 a0 = _mm_mul_ps(kx, cy);
+  __m128 a1 = _mm_mul_ps(_mm_mul_ps(ky, sx), sy);
+  __m128 b1 = _mm_mul_ps(ky, cx);
+  __m128 a2 = _mm_mul_ps(_mm_mul_ps(kz, cx), sy);
+  __m128 b2 = _mm_mul_ps(kz, sx);
+
+  const __m128 zero = _mm_setzero_ps();
+  StoreRows4(dst, 0, _mm_mul_ps(a0, cz), _mm_mul_ps(a0, sz),
+             _mm_xor_ps(_mm_mul_ps(kx, sy), _mm_set1_ps(-0.0f)), zero);
+  StoreRows4(dst, 1, _mm_sub_ps(_mm_mul_ps(a1, cz), _mm_mul_ps(b1, sz)),
+             _mm_add_ps(_mm_mul_ps(a1, sz), _mm_mul_ps(b1, cz)),
+             _mm_mul_ps(_mm_mul_ps(ky, sx), cy), zero);
+  StoreRows4(dst, 2, _mm_add_ps(_mm_mul_ps(a2, cz), _mm_mul_ps(b2, sz)),
+             _mm_sub_ps(_mm_mul_ps(a2, sz), _mm_mul_ps(b2, cz)),
+             _mm_mul_ps(_mm_mul_ps(kz, cx), cy), zero);
+  StoreRows4(dst, 3, LANES(origin.x), LANES(origin.y), LANES(origin.z),
+             _mm_set1_ps(1.0f));
+#undef LANES
+
+  for (int i = 0; i < TRANSFORM_BLOCK; i++) {
+    ApplyRotation(dst + i, t[i].rotation);
+  }
+}
+#elif defined(XMATH_USE_NEON)
+static void SinCos4(float32x4_t x, float32x4_t *s, float32x4_t *c) {
+  const uint32x4_t signBit = vdupq_n_u32(0x80000000u);
+  uint32x4_t sinSign = vandq_u32(vreinterpretq_u32_f32(x), signBit);
+  x = vabsq_f32(x);
+
+  int32x4_t j = vcvtq_s32_f32(vmulq_n_f32(x, SINCOS_FOPI));
+  j = vandq_s32(vaddq_s32(j, vdupq_n_s32(1)), vdupq_n_s32(~1));
+  float32x4_t y = vcvtq_f32_s32(j);
+  x = vsubq_f32(x, vmulq_n_f32(y, SINCOS_DP1));
+  x = vsubq_f32(x, vmulq_n_f32(y, SINCOS_DP2));
+  x = vsubq_f32(x, vmulq_n_f32(y, SINCOS_DP3));
+
+  uint32x4_t swap = vtstq_s32(j, vdupq_n_s32(2));
+  sinSign = veorq_u32(
+      sinSign, vshlq_n_u32(vreinterpretq_u32_s32(
+                               vandq_s32(j, vdupq_n_s32(4))),
+                           29));
+  uint32x4_t cosSign = vshlq_n_u32(
+      vreinterpretq_u32_s32(vbicq_s32(vdupq_n_s32(4),
+                                      vsubq_s32(j, vdupq_n_s32(2)))),
+      29);
+
+  float32x4_t z = vmulq_f32(x, x);
+  float32x4_t pc =
+      vaddq_f32(vmulq_n_f32(z, SINCOS_C0), vdupq_n_f32(SINCOS_C1));
+  pc = vaddq_f32(vmulq_f32(pc, z), vdupq_n_f32(SINCOS_C2));
+  pc = vmulq_f32(vmulq_f32(pc, z), z);
+  pc = vsubq_f32(pc, vmulq_n_f32(z, 0.5f));
+  pc = vaddq_f32(pc, vdupq_n_f32(1.0f));
+
+  float32x4_t ps =
+      vaddq_f32(vmulq_n_f32(z, SINCOS_S0), vdupq_n_f32(SINCOS_S1));
+  ps = vaddq_f32(vmulq_f32(ps, z), vdupq_n_f32(SINCOS_S2));
+  ps = vmulq_f32(vmulq_f32(ps, z), x);
+  ps = vaddq_f32(ps, x);
+
+  float32x4_t sinValue = vbslq_f32(swap, pc, ps);
+  float32x4_t cosValue = vbslq_f32(swap, ps, pc);
+  *s = vreinterpretq_f32_u32(
+      veorq_u32(vreinterpretq_u32_f32(sinValue), sinSign));
+  *c = vreinterpretq_f32_u32(
+      veorq_u32(vreinterpretq_u32_f32(cosValue), cosSign));
+}
+
+static float32x4_t Lanes4(float a, float b, float c, float d) {
+  float lanes[4] = {a, b, c, d};
+  return vld1q_f32(lanes);
+}
+
+// Stores row i of four matrices, interleaving the elements so that lane j
+// goes to matrix j
+static void StoreRows4(Mat4 *dst, int row, float32x4_t x, float32x4_t y,
+                       float32x4_t z, float32x4_t w) {
+  float32x4x4_t v = {{x, y, z, w}};
+  vst4q_lane_f32(Mat4Raw(dst) + row * 4, v, 0);
+  vst4q_lane_f32(Mat4Raw(dst + 1) + row * 4, v, 1);
+  vst4q_lane_f32(Mat4Raw(dst + 2) + row * 4, v, 2);
+  vst4q_lane_f32(Mat4Raw(dst + 3) + row * 4, v, 3);
+}
+
+static void ModelMatrices4(const Transform *t, Mat4 *dst) {
+#define LANES(field)                                                          \
+  Lanes4(t[0].field, t[1].field, t[2].field, t[3].field)
+  float32x4_t sx, cx, sy, cy, sz, cz;
+  SinCos4(LANES(angles.x), &sx, &cx);
+  SinCos4(LANES(angles.y), &sy, &cy);
+  SinCos4(LANES(angles.z), &sz, &cz);
+  float32x4_t kx = LANES(scale.x);
+  float32x4_t ky = LANES(scale.y);
+  float32x4_t kz = LANES(scale.z);
+
+  float32x4_t a0 = vmulq_f32(kx, cy);
+  float32x4_t a1 = vmulq_f32(vmulq_f32(ky, sx), sy);
+  float32x4_t b1 = vmulq_f32(ky, cx);
+  float32x4_t a2 = vmulq_f32(vmulq_f32(kz, cx), sy);
+  float32x4_t b2 = vmulq_f32(kz, sx);
+
+  const float32x4_t zero = vdupq_n_f32(0.0f);
+  StoreRows4(dst, 0, vmulq_f32(a0, cz), vmulq_f32(a0, sz),
+             vnegq_f32(vmulq_f32(kx, sy)), zero);
+  StoreRows4(dst, 1, vsubq_f32(vmulq_f32(a1, cz), vmulq_f32(b1, sz)),
+             vaddq_f32(vmulq_f32(a1, sz), vmulq_f32(b1, cz)),
+             vmulq_f32(vmulq_f32(ky, sx), cy), zero);
+  StoreRows4(dst, 2, vaddq_f32(vmulq_f32(a2, cz), vmulq_f32(b2, sz)),
+             vsubq_f32(vmulq_f32(a2, sz), vmulq_f32(b2, cz)),
+             vmulq_f32(vmulq_f32(kz, cx), cy), zero);
+  StoreRows4(dst, 3, LANES(origin.x), LANES(origin.y), LANES(origin.z),
+             vdupq_n_f32(1.0f));
+#undef LANES
+
+  for (int i = 0; i < TRANSFORM_BLOCK; i++) {
+    ApplyRotation(dst + i, t[i].rotation);
+  }
+}
+#else
+static void ModelMatrices4(const Transform *t, Mat4 *dst) {
+  for (int i = 0; i < TRANSFORM_BLOCK; i++) {
+    dst[i] = TransformGetModelMatrix(t[i]);
+  }
+}
+#endif
+
+void TransformGetModelMatrices(const Transform *transforms, Mat4 *dst,
+                               size_t n) {
+  assert((transforms != NULL && dst != NULL) || n == 0);
+  size_t i = 0;
+  for (; i + TRANSFORM_BLOCK <= n; i += TRANSFORM_BLOCK) {
+    ModelMatrices4(transforms + i, dst + i);
+  }
+
+  // Pad the last block with default transforms
+  if (i < n) {
+    Transform tail[TRANSFORM_BLOCK];
+    Mat4 out[TRANSFORM_BLOCK];
+    for (size_t k = 0; k < TRANSFORM_BLOCK; k++) {
+      tail[k] = i + k < n ? transforms[i + k] : MakeTransform();
+    }
+    ModelMatrices4(tail, out);
+    for (size_t k = 0; i + k < n; k++) {
+      dst[i + k] = out[k];
+    }
+  }
+}
@@ -1,11 +1,16 @@
 #pragma once
+#include "affine.h"
 #include "mat4.h"
+#include "quat.h"
 #include "vec3.h"
 
+// Objects are scaled, rotated by the Euler angles (X, Y then Z), rotated by
+// the quaternion and then moved to their origin
 typedef struct {
   Vec3 scale;
   Vec3 origin;
   Vec3 angles;
+  Quat rotation;
 } Transform;
 
 // Returns the default transform for an object
@@ -13,3 +18,12 @@ Transform MakeTransform();
 
 // Returns the model matrix after transformations
 Mat4 TransformGetModelMatrix(Transform transform);
+
+// Returns the model matrix as an affine 3x4 matrix
+Affine3x4 TransformGetAffine(Transform transform);
+
+// Writes the model matrices of n transforms to dst, four at a time with a
+// vectorized sine and cosine. Results are within a few ulps of
+// TransformGetModelMatrix for angles of a few turns.
+void TransformGetModelMatrices(const Transform *transforms, Mat4 *dst,
+                               size_t n);
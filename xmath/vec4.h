@@ -1,3 +1,4 @@
+#pragma once
 #include "vec2.h"
 #include "vec3.h"
 #include <math.h>